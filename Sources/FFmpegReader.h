@@ -30,6 +30,8 @@
 #ifndef __FFMPEGREADER_H
 #define __FFMPEGREADER_H
 
+#include <pthread.h>
+
 #include "LynkeosFileReader.h"
 
 #include <libavcodec/avcodec.h>
@@ -45,36 +47,73 @@
 /*!
  * @struct KeyFrames_t
  * @abstract Structure used to retain the key frames position.
- * @discussion It is used to speed the seeking in the sequence.
+ * @discussion It is used to speed the seeking in the sequence. There is one
+ *    per frame, filled by reading the packets once, and saved in a cache
+ *    file for the next opening of the movie.<br>
+ *    The frames are sorted in presentation order when every packet has a
+ *    timestamp, the decoded frames are then identified by it.
  */
 typedef struct
 {
    u_long  keyFrame;       //!< Frame number of the key frame
    int64_t timestamp;      //!< Timestamp of the key frame
+   int64_t position;       //!< Offset of the frame packet in the file
+   int64_t pts;            //!< Presentation timestamp, identifies the frame
 } KeyFrames_t;
 
+@class MyAVFrameContainer;
+
+/*!
+ * @struct FFmpegDecoder_t
+ * @abstract State of one decoder of the movie
+ * @discussion Each decoder has its own demuxer and codec contexts, so that
+ *    several threads can decode sequentially in different parts of the movie.
+ */
+typedef struct
+{
+   AVFormatContext   *formatCtx;       //!< Demuxer context
+   AVCodecContext    *codecCtx;        //!< Codec context
+   AVFrame           *currentFrame;    //!< Decoded frame
+   struct SwsContext *convertCtx;      //!< Context for RGB conversion
+   //! Last frame in the reader format, the movie cache may retain it too
+   MyAVFrameContainer *convertedFrame;
+   AVPacket           packet;          //!< Last packet read
+   int                bytesRemaining;  //!< Remaining length to be decoded
+   uint8_t           *rawData;         //!< Remaining data to be decoded
+   u_long             nextIndex;       //!< Index of the next decoded frame
+   u_long             indexGeneration; //!< Frames index it was positioned with
+   u_short            users;           //!< Threads using or waiting for it
+   pthread_mutex_t    lock;            //!< Exclusive use by one thread
+} FFmpegDecoder_t;
+
 /*!
  * @class FFmpegReader
  * @abstract Class for reading movie file formats non supported by Cocoa.
+ * @discussion Each thread reading the movie gets the decoder which is the
+ *    nearest before the frame it needs, or a decoder of its own if they are
+ *    all far away. As the list pipeline readers take batches of consecutive
+ *    items, each batch is decoded forward, without seeking when it stays
+ *    between the same key frames.
  * @ingroup FileAccess
  */
-@interface FFmpegReader : NSObject <LynkeosMovieFileReader>
+@interface FFmpegReader : NSObject <LynkeosPrefetchingMovieReader>
 {
 @private
-   AVFormatContext  *_pFormatCtx;
-   AVCodecContext   *_pCodecCtx;
-   AVFrame          *_pCurrentFrame;      //!< Decoded frame
-   struct SwsContext *_convert_ctx;       //!< Context for RGB conversion
-   AVFrame          *_pConvertedFrame;    //!< Frame converted to RGB format
-   int               _pixbufSize;         //!< RGB buf size in converted frame
+   FFmpegDecoder_t **_decoders;          //!< The decoders opened
+   u_short           _nDecoders;         //!< Number of decoders opened
+   u_short           _maxDecoders;       //!< One per processor at most
+   NSString         *_path;              //!< The movie file path
+   int               _pixbufSize;        //!< Buffer size of a converted frame
+   //! Format of the frames kept : the codec one, if samples are converted
+   //! directly from it, or RGB
+   enum PixelFormat  _frameFormat;
    int               _videoStream;
-   AVPacket          _packet;             //!< Last packet read
-   int               _bytesRemaining;     //!< Remaining length to be decoded
-   uint8_t          *_rawData;            //!< Remaining data to be decoded
    u_long            _numberOfFrames;
    KeyFrames_t      *_times;
+   BOOL              _framesByPts;       //!< _times is in presentation order
+   u_long            _indexGeneration;   //!< Incremented when _times changes
+   //! Protects the decoders choice and the frames index
    NSLock           *_mutex;
-   u_long	     _nextIndex;
 }
 
 @end
@@ -23,28 +23,384 @@
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // 
 
+#include <limits.h>
+
 #import <AppKit/NSGraphics.h>
 
 #include <LynkeosCore/LynkeosProcessing.h>
+#include "processing_core.h"
 #include "MyCachePrefs.h"
 
 #include "FFmpegReader.h"
 
 #define K_TIME_PAGE_SIZE 256
 
+//! Version of the frames index cache files
+#define K_INDEX_VERSION 2
+
+static NSString * const K_INDEX_FORMAT_KEY = @"format";
+static NSString * const K_INDEX_PATH_KEY   = @"path";
+static NSString * const K_INDEX_SIZE_KEY   = @"size";
+static NSString * const K_INDEX_DATE_KEY   = @"date";
+static NSString * const K_INDEX_FRAMES_KEY = @"frames";
+
+//! Relative cost of a seek, compared to the decoding of one frame
+#define K_SEEK_COST 4
+
+//! The codec opening and closing are not thread safe
+static pthread_mutex_t codecLock = PTHREAD_MUTEX_INITIALIZER;
+
+#if !defined(DOUBLE_PIXELS) && (defined(__ALTIVEC__) || defined(__SSE__))
+#define YUV_VECTORS
+#ifndef __ALTIVEC__
+#include <xmmintrin.h>
+#endif
+#endif
+
+/*!
+ * @abstract Coefficients of the conversion from YUV to RGB
+ */
+typedef struct
+{
+   REAL y0;    //!< Luminance of black
+   REAL ky;    //!< Luminance gain
+   REAL rv;    //!< V contribution to red
+   REAL gu;    //!< U contribution to green
+   REAL gv;    //!< V contribution to green
+   REAL bu;    //!< U contribution to blue
+} YuvCoefficients_t;
+
+//! ITU-R BT.601, video range
+static const YuvCoefficients_t videoRangeYuv =
+   { 16.0, 1.164, 1.596, -0.392, -0.813, 2.017 };
+//! ITU-R BT.601, full range (JPEG)
+static const YuvCoefficients_t fullRangeYuv =
+   { 0.0, 1.0, 1.402, -0.344136, -0.714136, 1.772 };
+
+/*!
+ * @abstract Presentation timestamp of a packet, for sorting the frames index
+ */
+typedef struct
+{
+   int64_t pts;            //!< Presentation timestamp
+   u_long  frame;          //!< Index of the packet in decoding order
+} FramePts_t;
+
+/*!
+ * @abstract Compare two packets presentation timestamps for qsort
+ */
+static int compareFramePts( const void *a, const void *b )
+{
+   const FramePts_t *fa = (const FramePts_t*)a, *fb = (const FramePts_t*)b;
+
+   if ( fa->pts != fb->pts )
+      return( fa->pts < fb->pts ? -1 : 1 );
+   if ( fa->frame != fb->frame )
+      return( fa->frame < fb->frame ? -1 : 1 );
+   return( 0 );
+}
+
+/*!
+ * @abstract Whether the samples can be converted straight from that format
+ */
+static BOOL isDirectFormat( enum PixelFormat fmt )
+{
+   switch( fmt )
+   {
+      case PIX_FMT_YUV420P:
+      case PIX_FMT_YUV422P:
+      case PIX_FMT_YUV444P:
+      case PIX_FMT_YUV411P:
+      case PIX_FMT_YUV410P:
+      case PIX_FMT_YUVJ420P:
+      case PIX_FMT_YUVJ422P:
+      case PIX_FMT_YUVJ444P:
+      case PIX_FMT_YUYV422:
+      case PIX_FMT_UYVY422:
+      case PIX_FMT_GRAY8:
+      case PIX_FMT_RGB24:
+      case PIX_FMT_BGR24:
+         return( YES );
+      default:
+         return( NO );
+   }
+}
+
+/*!
+ * @abstract Read a part of a frame row
+ * @discussion For YUV formats, the luminance is read in r, and the centered
+ *    chrominances in g and b.
+ * @param frame The frame
+ * @param fmt The frame pixel format
+ * @param x Abscissa of the first pixel
+ * @param y Ordinate of the row
+ * @param w Number of pixels to read
+ * @param r Red, or luminance
+ * @param g Green, or U
+ * @param b Blue, or V
+ * @result Whether a YUV to RGB conversion is still needed
+ */
+static BOOL read_rgb_row( const AVFrame *frame, enum PixelFormat fmt,
+                          u_short x, u_short y, u_short w,
+                          REAL *r, REAL *g, REAL *b )
+{
+   u_short i;
+
+   switch( fmt )
+   {
+      case PIX_FMT_RGB24:
+      case PIX_FMT_BGR24:
+      {
+         const u_char *v = frame->data[0] + y*frame->linesize[0] + x*3;
+         REAL * const first = (fmt == PIX_FMT_RGB24 ? r : b);
+         REAL * const last = (fmt == PIX_FMT_RGB24 ? b : r);
+
+         for( i = 0; i < w; i++, v += 3 )
+         {
+            first[i] = v[0];
+            g[i] = v[1];
+            last[i] = v[2];
+         }
+         return( NO );
+      }
+      case PIX_FMT_GRAY8:
+      {
+         const u_char *v = frame->data[0] + y*frame->linesize[0] + x;
+
+         for( i = 0; i < w; i++ )
+            r[i] = g[i] = b[i] = v[i];
+         return( NO );
+      }
+      case PIX_FMT_YUYV422:
+      case PIX_FMT_UYVY422:
+      {
+         // Pairs of pixels share their chrominances
+         const u_char *v = frame->data[0] + y*frame->linesize[0];
+         const u_short yo = (fmt == PIX_FMT_YUYV422 ? 0 : 1);
+         const u_short uo = (fmt == PIX_FMT_YUYV422 ? 1 : 0);
+
+         for( i = 0; i < w; i++ )
+         {
+            const u_char *p = v + (x+i)*2;
+            const u_char *c = v + ((x+i)&~1)*2;
+
+            r[i] = p[yo];
+            g[i] = (REAL)c[uo] - 128.0;
+            b[i] = (REAL)c[uo+2] - 128.0;
+         }
+         return( YES );
+      }
+      default:
+      {
+         // Planar YUV
+         const u_char *yv = frame->data[0] + y*frame->linesize[0] + x;
+         const u_char *u, *v;
+         int hs, vs;
+
+         avcodec_get_chroma_sub_sample( fmt, &hs, &vs );
+         u = frame->data[1] + (y>>vs)*frame->linesize[1];
+         v = frame->data[2] + (y>>vs)*frame->linesize[2];
+
+         for( i = 0; i < w; i++ )
+         {
+            r[i] = yv[i];
+            g[i] = (REAL)u[(x+i)>>hs] - 128.0;
+            b[i] = (REAL)v[(x+i)>>hs] - 128.0;
+         }
+         return( YES );
+      }
+   }
+}
+
+/*!
+ * @abstract Convert a row from YUV to RGB, in place
+ */
+static void std_yuv_to_rgb( REAL *r, REAL *g, REAL *b, u_short w,
+                            const YuvCoefficients_t *k )
+{
+   u_short i;
+
+   for( i = 0; i < w; i++ )
+   {
+      const REAL l = (r[i] - k->y0)*k->ky, u = g[i], v = b[i];
+      REAL c[3];
+      u_short j;
+
+      c[0] = l + k->rv*v;
+      c[1] = l + k->gu*u + k->gv*v;
+      c[2] = l + k->bu*u;
+      for( j = 0; j < 3; j++ )
+      {
+         if ( c[j] < 0.0 )
+            c[j] = 0.0;
+         else if ( c[j] > 255.0 )
+            c[j] = 255.0;
+      }
+      r[i] = c[0];
+      g[i] = c[1];
+      b[i] = c[2];
+   }
+}
+
+/*!
+ * @abstract Convert a row of luminances to monochrome levels, in place
+ */
+static void std_yuv_to_luma( REAL *l, u_short w, const YuvCoefficients_t *k )
+{
+   u_short i;
+
+   for( i = 0; i < w; i++ )
+   {
+      const REAL c = (l[i] - k->y0)*k->ky;
+
+      l[i] = (c < 0.0 ? 0.0 : (c > 255.0 ? 255.0 : c));
+   }
+}
+
+/*!
+ * @abstract Write a converted row in a sample plane
+ */
+static void std_write_row( void * const plane, floating_precision_t precision,
+                           u_short y, u_short lineW,
+                           const REAL *v, u_short w )
+{
+   u_short x;
+
+   for( x = 0; x < w; x++ )
+      SET_SAMPLE( plane, precision, x, y, lineW, v[x] );
+}
+
+#ifdef YUV_VECTORS
+/*!
+ * @abstract Same conversion, on 4 pixels at a time
+ */
+static void vect_yuv_to_rgb( REAL *r, REAL *g, REAL *b, u_short w,
+                             const YuvCoefficients_t *k )
+{
+   const REALVECT zero = { 0.0, 0.0, 0.0, 0.0 };
+   const REALVECT top = { 255.0, 255.0, 255.0, 255.0 };
+   const REALVECT y0 = { k->y0, k->y0, k->y0, k->y0 };
+   const REALVECT ky = { k->ky, k->ky, k->ky, k->ky };
+   const REALVECT rv = { k->rv, k->rv, k->rv, k->rv };
+   const REALVECT gu = { k->gu, k->gu, k->gu, k->gu };
+   const REALVECT gv = { k->gv, k->gv, k->gv, k->gv };
+   const REALVECT bu = { k->bu, k->bu, k->bu, k->bu };
+   REALVECT * const rp = (REALVECT*)r;
+   REALVECT * const gp = (REALVECT*)g;
+   REALVECT * const bp = (REALVECT*)b;
+   const u_short nv = w/4;
+   u_short i;
+
+   for( i = 0; i < nv; i++ )
+   {
+      const REALVECT l = (rp[i] - y0)*ky, u = gp[i], v = bp[i];
+
+#ifdef __ALTIVEC__
+      rp[i] = vec_min( vec_max( l + rv*v, zero ), top );
+      gp[i] = vec_min( vec_max( l + gu*u + gv*v, zero ), top );
+      bp[i] = vec_min( vec_max( l + bu*u, zero ), top );
+#else
+      rp[i] = (REALVECT)_mm_min_ps( _mm_max_ps( (__m128)(l + rv*v),
+                                                (__m128)zero ),
+                                    (__m128)top );
+      gp[i] = (REALVECT)_mm_min_ps( _mm_max_ps( (__m128)(l + gu*u + gv*v),
+                                                (__m128)zero ),
+                                    (__m128)top );
+      bp[i] = (REALVECT)_mm_min_ps( _mm_max_ps( (__m128)(l + bu*u),
+                                                (__m128)zero ),
+                                    (__m128)top );
+#endif
+   }
+
+   // The remaining pixels
+   std_yuv_to_rgb( &r[nv*4], &g[nv*4], &b[nv*4], w - nv*4, k );
+}
+
+/*!
+ * @abstract Same luminance conversion, on 4 pixels at a time
+ */
+static void vect_yuv_to_luma( REAL *l, u_short w, const YuvCoefficients_t *k )
+{
+   const REALVECT zero = { 0.0, 0.0, 0.0, 0.0 };
+   const REALVECT top = { 255.0, 255.0, 255.0, 255.0 };
+   const REALVECT y0 = { k->y0, k->y0, k->y0, k->y0 };
+   const REALVECT ky = { k->ky, k->ky, k->ky, k->ky };
+   REALVECT * const lp = (REALVECT*)l;
+   const u_short nv = w/4;
+   u_short i;
+
+   for( i = 0; i < nv; i++ )
+   {
+#ifdef __ALTIVEC__
+      lp[i] = vec_min( vec_max( (lp[i] - y0)*ky, zero ), top );
+#else
+      lp[i] = (REALVECT)_mm_min_ps( _mm_max_ps( (__m128)((lp[i] - y0)*ky),
+                                                (__m128)zero ),
+                                    (__m128)top );
+#endif
+   }
+
+   std_yuv_to_luma( &l[nv*4], w - nv*4, k );
+}
+
+/*!
+ * @abstract Same write, 4 pixels at a time when the plane row is aligned
+ */
+static void vect_write_row( void * const plane, floating_precision_t precision,
+                            u_short y, u_short lineW,
+                            const REAL *v, u_short w )
+{
+   REAL * const row = (REAL*)plane + y*lineW;
+   const REALVECT * const vp = (const REALVECT*)v;
+   REALVECT * const rp = (REALVECT*)row;
+   const u_short nv = w/4;
+   u_short x;
+
+   if ( precision != SINGLE_PRECISION
+        || ((u_long)row % sizeof(REALVECT)) != 0 )
+   {
+      std_write_row( plane, precision, y, lineW, v, w );
+      return;
+   }
+
+   for( x = 0; x < nv; x++ )
+      rp[x] = vp[x];
+
+   // The remaining pixels
+   for( x = nv*4; x < w; x++ )
+      row[x] = v[x];
+}
+#endif
+
+/*!
+ * @abstract Owner of a converted frame
+ * @discussion It is shared by the decoder which converted it, the movie cache
+ *    and the readers using it, the last one to release it frees the frame.
+ */
 @interface MyAVFrameContainer : NSObject
 {
 @public
    AVFrame *_frame;
 }
-- (id) initWithAVFrame:(AVFrame*)frame ;
+- (id) initWithFormat:(enum PixelFormat)fmt size:(int)size
+                width:(int)width height:(int)height ;
 @end
 
 @implementation MyAVFrameContainer
-- (id) initWithAVFrame:(AVFrame*)frame
+- (id) initWithFormat:(enum PixelFormat)fmt size:(int)size
+                width:(int)width height:(int)height
 {
    if ( (self = [self init]) != nil )
-      _frame = frame;
+   {
+      uint8_t *buffer = (uint8_t*)av_malloc( sizeof(uint8_t)*size );
+
+      _frame = avcodec_alloc_frame();
+      NSAssert( _frame != NULL && buffer != NULL,
+                @"Could not allocate a converted frame" );
+
+      // Assign appropriate parts of buffer to image planes
+      avpicture_fill( (AVPicture *)_frame, buffer, fmt, width, height );
+   }
    return( self );
 }
 
@@ -70,24 +426,568 @@
 @interface FFmpegReader(Private)
 
 /*!
- * @method nextFrame
+ * @abstract Open a new decoder on the movie file
+ * @result The decoder, or NULL if it failed
+ */
+- (FFmpegDecoder_t*) openDecoder ;
+
+/*!
+ * @abstract Free a decoder and its contexts
+ * @param dec The decoder
+ */
+- (void) closeDecoder:(FFmpegDecoder_t*)dec ;
+
+/*!
+ * @abstract Number of frames to decode for getting a frame with a decoder
+ * @param dec The decoder, or NULL for a new decoder
+ * @param index The index of the frame
+ * @result The cost, a seek being counted as K_SEEK_COST frames
+ */
+- (u_long) costOfFrame:(u_long)index withDecoder:(FFmpegDecoder_t*)dec ;
+
+/*!
+ * @abstract Choose the cheapest decoder for a frame, and lock it
+ * @param index The index of the frame
+ * @result The decoder, for the exclusive use of the calling thread
+ */
+- (FFmpegDecoder_t*) lockDecoderForIndex:(u_long)index ;
+
+/*!
+ * @abstract Give back a decoder
+ * @param dec The decoder
+ */
+- (void) unlockDecoder:(FFmpegDecoder_t*)dec ;
+
+/*!
+ * @abstract Path of the frames index cache file for this movie
+ */
+- (NSString*) indexCachePath ;
+
+/*!
+ * @abstract Identification of the index format and of the movie file
+ * @discussion The cache is valid only for the same movie size and date, and
+ *    for the same index layout.
+ * @result The dictionary to compare with the cache file, nil if the movie
+ *    file is not accessible
+ */
+- (NSMutableDictionary*) indexIdentification ;
+
+/*!
+ * @abstract Read the frames index from its cache file
+ * @result Wether a valid index was found
+ */
+- (BOOL) readIndexCache ;
+
+/*!
+ * @abstract Save the frames index in its cache file
+ */
+- (void) writeIndexCache ;
+
+/*!
+ * @abstract Build the frames index, by reading every packet of the movie
+ * @discussion The packets are only read, not decoded.
+ * @param dec The decoder used for reading
+ * @result Wether at least one frame was found
+ */
+- (BOOL) buildIndex:(FFmpegDecoder_t*)dec ;
+
+/*!
+ * @abstract Reorder the frames index from decoding to presentation order
+ * @discussion The index is left in decoding order when some packet has no
+ *    presentation timestamp, or when a frame would be shown before its key
+ *    frame.
+ */
+- (void) sortIndexByPts ;
+
+/*!
+ * @abstract Update the decoder position after a frame was decoded
+ * @discussion When the index is in presentation order, the frame is found
+ *    by its timestamp, as the decoder may skip frames after a seek.
+ *    Otherwise, the frames are counted.
+ * @param dec The decoder
+ */
+- (void) frameDecoded:(FFmpegDecoder_t*)dec ;
+
+/*!
+ * @method nextFrame:
  * @abstract Access the next frame in the movie.
+ * @param dec The decoder
  * @result Wether a frame was succesfully read
  */
-- (BOOL) nextFrame ;
+- (BOOL) nextFrame:(FFmpegDecoder_t*)dec ;
 
 /*!
- * @method getFrame:
+ * @method getFrame:decoder:
  * @abstract Get and convert the needed frame
+ * @discussion Without a movie cache, the frame is reused by the decoder and
+ *    shall only be read while it is locked.
  * @param index The index of the frame to get
+ * @param dec The decoder, locked by the caller
+ * @result The frame, retained until the caller's pool is released
  */
-- (AVFrame*) getFrame :(u_long) index ;
+- (MyAVFrameContainer*) getFrame:(u_long)index decoder:(FFmpegDecoder_t*)dec ;
 
 @end
 
 @implementation FFmpegReader(Private)
 
-- (BOOL) nextFrame
+- (FFmpegDecoder_t*) openDecoder
+{
+   FFmpegDecoder_t *dec;
+   AVCodec *pCodec;
+   unsigned int i;
+   int ret;
+
+   dec = (FFmpegDecoder_t*)malloc( sizeof(FFmpegDecoder_t) );
+   NSAssert( dec != NULL, @"FFmpeg decoder allocation failed" );
+   dec->formatCtx = NULL;
+   dec->codecCtx = NULL;
+   dec->currentFrame = NULL;
+   dec->convertCtx = NULL;
+   dec->convertedFrame = nil;
+   dec->packet.data = NULL;
+   dec->bytesRemaining = 0;
+   dec->rawData = NULL;
+   dec->nextIndex = 0;
+   dec->indexGeneration = _indexGeneration;
+   dec->users = 0;
+   pthread_mutex_init( &dec->lock, NULL );
+
+   // Open video file
+   ret = av_open_input_file( &dec->formatCtx, [_path fileSystemRepresentation],
+                             NULL, 0, NULL );
+   if ( ret != 0 )
+   {
+      NSLog( @"Could not open file %@", _path );
+      [self closeDecoder:dec];
+      return( NULL );
+   }
+
+   // Retrieve stream information
+   ret = av_find_stream_info(dec->formatCtx);
+   if ( ret < 0 )
+   {
+      NSLog( @"Could not find any stream info");
+      [self closeDecoder:dec];
+      return( NULL );
+   }
+
+   // Find the first video stream, the first time
+   if ( _videoStream == -1 )
+   {
+      for ( i = 0; i < dec->formatCtx->nb_streams; i++ )
+      {
+         if( dec->formatCtx->streams[i]->codec->codec_type
+             == CODEC_TYPE_VIDEO )
+         {
+            _videoStream = i;
+            break;
+         }
+      }
+
+      if( _videoStream == -1 )
+      {
+         NSLog( @"Could not find a video stream");
+         [self closeDecoder:dec];
+         return( NULL );
+      }
+   }
+
+   // Get a pointer to the codec context for the video stream
+   dec->codecCtx = dec->formatCtx->streams[_videoStream]->codec;
+
+   // Find the decoder for the video stream
+   pCodec = avcodec_find_decoder(dec->codecCtx->codec_id);
+   if ( pCodec == NULL )
+   {
+      NSLog( @"Codec not found");
+      dec->codecCtx = NULL;
+      [self closeDecoder:dec];
+      return( NULL );
+   }
+
+   // Inform the codec that we can handle truncated bitstreams -- i.e.,
+   // bitstreams where frame boundaries can fall in the middle of packets
+   if ( pCodec->capabilities & CODEC_CAP_TRUNCATED )
+      dec->codecCtx->flags |= CODEC_FLAG_TRUNCATED;
+
+   // Open codec
+   pthread_mutex_lock( &codecLock );
+   ret = avcodec_open(dec->codecCtx, pCodec);
+   pthread_mutex_unlock( &codecLock );
+   if ( ret < 0 )
+   {
+      NSLog( @"Can't open the codec" );
+      dec->codecCtx = NULL;
+      [self closeDecoder:dec];
+      return( NULL );
+   }
+
+   // Allocate video frame
+   dec->currentFrame = avcodec_alloc_frame();
+
+   // Allocate a RGB converter
+   dec->convertCtx = sws_getCachedContext(NULL,
+                                 dec->codecCtx->width, dec->codecCtx->height,
+                                 dec->codecCtx->pix_fmt,
+                                 dec->codecCtx->width, dec->codecCtx->height,
+                                 PIX_FMT_RGB24, SWS_BICUBIC,
+                                 NULL, NULL, NULL);
+   if( dec->convertCtx == NULL )
+   {
+      NSLog(@"Cannot initialize the conversion context!");
+      [self closeDecoder:dec];
+      return( NULL );
+   }
+
+   return( dec );
+}
+
+- (void) closeDecoder:(FFmpegDecoder_t*)dec
+{
+   if ( dec->codecCtx != NULL )
+   {
+      pthread_mutex_lock( &codecLock );
+      avcodec_close(dec->codecCtx);
+      pthread_mutex_unlock( &codecLock );
+   }
+   if ( dec->convertedFrame != nil )
+      [dec->convertedFrame release];
+   if ( dec->currentFrame != NULL )
+      av_free(dec->currentFrame);
+   if ( dec->convertCtx != NULL )
+      sws_freeContext( dec->convertCtx );
+   if ( dec->packet.data != NULL )
+      av_free_packet( &dec->packet );
+   if ( dec->formatCtx != NULL )
+      av_close_input_file( dec->formatCtx );
+   pthread_mutex_destroy( &dec->lock );
+   free( dec );
+}
+
+- (u_long) costOfFrame:(u_long)index withDecoder:(FFmpegDecoder_t*)dec
+{
+   if ( dec != NULL )
+   {
+      // Already decoded
+      if ( dec->nextIndex != 0 && index == dec->nextIndex - 1 )
+         return( 0 );
+
+      // Decoded forward without seeking
+      if ( index >= dec->nextIndex && dec->nextIndex < _numberOfFrames
+           && _times[index].keyFrame == _times[dec->nextIndex].keyFrame )
+         return( index - dec->nextIndex + 1 );
+   }
+
+   // Seek to the key frame and decode from it
+   return( index - _times[index].keyFrame + 1 + K_SEEK_COST );
+}
+
+- (FFmpegDecoder_t*) lockDecoderForIndex:(u_long)index
+{
+   FFmpegDecoder_t *best = NULL;
+   u_long bestCost = ULONG_MAX, cost;
+   u_short i;
+
+   [_mutex lock];
+
+   // The cheapest free decoder
+   for( i = 0; i < _nDecoders; i++ )
+   {
+      if ( _decoders[i]->users == 0
+           && (cost = [self costOfFrame:index withDecoder:_decoders[i]])
+              < bestCost )
+      {
+         best = _decoders[i];
+         bestCost = cost;
+      }
+   }
+
+   // Rather than moving another span decoder, open a new one
+   if ( _nDecoders < _maxDecoders
+        && [self costOfFrame:index withDecoder:NULL] < bestCost )
+   {
+      FFmpegDecoder_t *dec = [self openDecoder];
+
+      if ( dec != NULL )
+      {
+         // Start "beyond the end" as after the initial scan
+         dec->nextIndex = _numberOfFrames + 1;
+         _decoders[_nDecoders] = dec;
+         _nDecoders++;
+         best = dec;
+      }
+   }
+
+   // If they are all in use, wait for the cheapest
+   if ( best == NULL )
+   {
+      for( i = 0; i < _nDecoders; i++ )
+      {
+         if ( (cost = [self costOfFrame:index withDecoder:_decoders[i]])
+              < bestCost )
+         {
+            best = _decoders[i];
+            bestCost = cost;
+         }
+      }
+   }
+
+   best->users++;
+
+   [_mutex unlock];
+
+   pthread_mutex_lock( &best->lock );
+
+   return( best );
+}
+
+- (void) unlockDecoder:(FFmpegDecoder_t*)dec
+{
+   pthread_mutex_unlock( &dec->lock );
+
+   [_mutex lock];
+   dec->users--;
+   [_mutex unlock];
+}
+
+- (NSString*) indexCachePath
+{
+   NSArray *caches = NSSearchPathForDirectoriesInDomains( NSCachesDirectory,
+                                                          NSUserDomainMask,
+                                                          YES );
+
+   if ( [caches count] == 0 )
+      return( nil );
+
+   return( [[[[caches objectAtIndex:0]
+               stringByAppendingPathComponent:@"Lynkeos"]
+               stringByAppendingPathComponent:@"MovieIndex"]
+               stringByAppendingPathComponent:
+                  [NSString stringWithFormat:@"%08lx-%@.plist",
+                                (u_long)[_path hash],
+                                [_path lastPathComponent]]] );
+}
+
+- (NSMutableDictionary*) indexIdentification
+{
+   NSDictionary *attr = [[NSFileManager defaultManager]
+                                   fileAttributesAtPath:_path traverseLink:YES];
+
+   if ( attr == nil )
+      return( nil );
+
+   return( [NSMutableDictionary dictionaryWithObjectsAndKeys:
+               [NSString stringWithFormat:@"%d-%lu-%ld",
+                             K_INDEX_VERSION, (u_long)sizeof(KeyFrames_t),
+                             (long)NSHostByteOrder()],
+                                                           K_INDEX_FORMAT_KEY,
+               _path,                                      K_INDEX_PATH_KEY,
+               [NSNumber numberWithUnsignedLongLong:[attr fileSize]],
+                                                           K_INDEX_SIZE_KEY,
+               [attr fileModificationDate],                K_INDEX_DATE_KEY,
+               nil] );
+}
+
+- (BOOL) readIndexCache
+{
+   NSString *cachePath = [self indexCachePath];
+   NSMutableDictionary *ident = [self indexIdentification];
+   NSDictionary *cache;
+   NSData *frames;
+   NSEnumerator *keys;
+   NSString *key;
+
+   if ( cachePath == nil || ident == nil )
+      return( NO );
+
+   cache = [NSDictionary dictionaryWithContentsOfFile:cachePath];
+   if ( cache == nil )
+      return( NO );
+
+   // The cache shall be for the same movie, unchanged
+   keys = [ident keyEnumerator];
+   while ( (key = [keys nextObject]) != nil )
+      if ( ![[ident objectForKey:key] isEqual:[cache objectForKey:key]] )
+         return( NO );
+
+   frames = [cache objectForKey:K_INDEX_FRAMES_KEY];
+   if ( frames == nil || [frames length] == 0
+        || [frames length] % sizeof(KeyFrames_t) != 0 )
+      return( NO );
+
+   _numberOfFrames = [frames length] / sizeof(KeyFrames_t);
+   _times = (KeyFrames_t*)malloc( [frames length] );
+   NSAssert( _times != NULL, @"Frames index allocation failed" );
+   [frames getBytes:_times];
+
+   return( YES );
+}
+
+- (void) writeIndexCache
+{
+   NSString *cachePath = [self indexCachePath];
+   NSMutableDictionary *cache = [self indexIdentification];
+   NSFileManager *fMgr = [NSFileManager defaultManager];
+   NSString *dir, *parent;
+
+   if ( cachePath == nil || cache == nil )
+      return;
+
+   // Create the cache directories if needed
+   dir = [cachePath stringByDeletingLastPathComponent];
+   parent = [dir stringByDeletingLastPathComponent];
+   if ( ![fMgr fileExistsAtPath:parent] )
+      [fMgr createDirectoryAtPath:parent attributes:nil];
+   if ( ![fMgr fileExistsAtPath:dir] )
+      [fMgr createDirectoryAtPath:dir attributes:nil];
+
+   [cache setObject:[NSData dataWithBytes:_times
+                                   length:_numberOfFrames*sizeof(KeyFrames_t)]
+             forKey:K_INDEX_FRAMES_KEY];
+
+   // A failure only costs a new indexing, next time
+   if ( ![cache writeToFile:cachePath atomically:YES] )
+      NSLog( @"Could not save the frames index in %@", cachePath );
+}
+
+- (BOOL) buildIndex:(FFmpegDecoder_t*)dec
+{
+   AVPacket packet;
+   u_long arraySize = 0, keyIndex = 0, prevKeyIndex = 0;
+   int64_t keyTimestamp = 0, prevKeyTimestamp = 0, keyPts = AV_NOPTS_VALUE;
+
+   _numberOfFrames = 0;
+   while ( av_read_frame( dec->formatCtx, &packet ) >= 0 )
+   {
+      if ( packet.stream_index == _videoStream )
+      {
+         if ( _numberOfFrames >= arraySize )
+         {
+            arraySize += K_TIME_PAGE_SIZE;
+            _times = (KeyFrames_t*)realloc( _times,
+                                            arraySize*sizeof(KeyFrames_t) );
+            NSAssert( _times != NULL, @"Frames index allocation failed" );
+         }
+
+         // Seeking is done on the decoding timestamp of the key frames
+         if ( (packet.flags & PKT_FLAG_KEY) != 0 || _numberOfFrames == 0 )
+         {
+            prevKeyIndex = keyIndex;
+            prevKeyTimestamp = keyTimestamp;
+            keyIndex = _numberOfFrames;
+            keyTimestamp = (packet.dts != AV_NOPTS_VALUE ?
+                            packet.dts : packet.pts);
+            keyPts = packet.pts;
+         }
+
+         // In an open GOP, the frames shown before the key frame also
+         // depend on the previous GOP
+         if ( packet.pts != AV_NOPTS_VALUE && keyPts != AV_NOPTS_VALUE
+              && packet.pts < keyPts )
+         {
+            _times[_numberOfFrames].keyFrame = prevKeyIndex;
+            _times[_numberOfFrames].timestamp = prevKeyTimestamp;
+         }
+         else
+         {
+            _times[_numberOfFrames].keyFrame = keyIndex;
+            _times[_numberOfFrames].timestamp = keyTimestamp;
+         }
+         _times[_numberOfFrames].position = packet.pos;
+         _times[_numberOfFrames].pts = packet.pts;
+         _numberOfFrames++;
+      }
+
+      av_free_packet( &packet );
+   }
+
+   if ( _numberOfFrames != 0 )
+      [self sortIndexByPts];
+
+   return( _numberOfFrames != 0 );
+}
+
+- (void) sortIndexByPts
+{
+   FramePts_t *order;
+   u_long *rank;
+   KeyFrames_t *sorted;
+   u_long i;
+
+   for( i = 0; i < _numberOfFrames; i++ )
+      if ( _times[i].pts == AV_NOPTS_VALUE )
+         return;
+
+   order = (FramePts_t*)malloc( _numberOfFrames*sizeof(FramePts_t) );
+   rank = (u_long*)malloc( _numberOfFrames*sizeof(u_long) );
+   sorted = (KeyFrames_t*)malloc( _numberOfFrames*sizeof(KeyFrames_t) );
+   NSAssert( order != NULL && rank != NULL && sorted != NULL,
+             @"Frames index allocation failed" );
+
+   for( i = 0; i < _numberOfFrames; i++ )
+   {
+      order[i].pts = _times[i].pts;
+      order[i].frame = i;
+   }
+   qsort( order, _numberOfFrames, sizeof(FramePts_t), compareFramePts );
+   for( i = 0; i < _numberOfFrames; i++ )
+      rank[order[i].frame] = i;
+
+   for( i = 0; i < _numberOfFrames; i++ )
+   {
+      sorted[i] = _times[order[i].frame];
+      sorted[i].keyFrame = rank[sorted[i].keyFrame];
+
+      // Decoding from that key frame would not give this one
+      if ( sorted[i].keyFrame > i )
+         break;
+   }
+
+   if ( i == _numberOfFrames )
+   {
+      free( _times );
+      _times = sorted;
+   }
+   else
+   {
+      NSLog( @"Frames of %@ kept in decoding order", _path );
+      free( sorted );
+   }
+
+   free( order );
+   free( rank );
+}
+
+- (void) frameDecoded:(FFmpegDecoder_t*)dec
+{
+   const int64_t pts = dec->currentFrame->reordered_opaque;
+   u_long first = 0, last = _numberOfFrames;
+
+   if ( _framesByPts && pts != AV_NOPTS_VALUE )
+   {
+      // Dichotomic search of the frame timestamp
+      while ( first < last )
+      {
+         const u_long mid = (first + last)/2;
+
+         if ( _times[mid].pts < pts )
+            first = mid + 1;
+         else
+            last = mid;
+      }
+
+      if ( first < _numberOfFrames && _times[first].pts == pts )
+      {
+         dec->nextIndex = first + 1;
+         return;
+      }
+   }
+
+   dec->nextIndex++;
+}
+
+- (BOOL) nextFrame:(FFmpegDecoder_t*)dec
 {
    int ret;
    int bytesDecoded;
@@ -97,12 +997,15 @@
    while (YES)
    {
       // Work on the current packet until we have decoded all of it
-      while ( _bytesRemaining > 0 )
+      while ( dec->bytesRemaining > 0 )
       {
-         // Decode the next chunk of data
-         bytesDecoded = avcodec_decode_video( _pCodecCtx, _pCurrentFrame,
+         // Decode the next chunk of data, the frame will give back its
+         // packet timestamp
+         dec->codecCtx->reordered_opaque = dec->packet.pts;
+         bytesDecoded = avcodec_decode_video( dec->codecCtx, dec->currentFrame,
                                               &frameFinished,
-                                              _rawData, _bytesRemaining);
+                                              dec->rawData,
+                                              dec->bytesRemaining);
 
          // Was there an error?
          if ( bytesDecoded < 0 )
@@ -111,13 +1014,13 @@
                return( NO );
          }
 
-         _bytesRemaining -= bytesDecoded;
-         _rawData += bytesDecoded;
+         dec->bytesRemaining -= bytesDecoded;
+         dec->rawData += bytesDecoded;
 
          // Did we finish the current frame? Then we can return
          if ( frameFinished )
          {
-            _nextIndex ++;
+            [self frameDecoded:dec];
             return( YES );
          }
       }
@@ -127,74 +1030,98 @@
       do
       {
          // Free old packet
-         if ( _packet.data != NULL )
-            av_free_packet( &_packet );
+         if ( dec->packet.data != NULL )
+            av_free_packet( &dec->packet );
 
          // Read new packet
-         ret = av_read_frame(_pFormatCtx, &_packet);
+         ret = av_read_frame(dec->formatCtx, &dec->packet);
 
       } while( ret >= 0 &&
-               ( _packet.stream_index != _videoStream ) );
+               ( dec->packet.stream_index != _videoStream ) );
 
       if ( ret < 0 )
          break;
 
-      _bytesRemaining = _packet.size;
-      _rawData = _packet.data;
+      dec->bytesRemaining = dec->packet.size;
+      dec->rawData = dec->packet.data;
    }
 
    // Decode the rest of the last frame
-   bytesDecoded = avcodec_decode_video( _pCodecCtx, _pCurrentFrame, 
-                                        &frameFinished, 
-                                        _rawData, _bytesRemaining );
+   dec->codecCtx->reordered_opaque = AV_NOPTS_VALUE;
+   bytesDecoded = avcodec_decode_video( dec->codecCtx, dec->currentFrame,
+                                        &frameFinished,
+                                        dec->rawData, dec->bytesRemaining );
 
    // Free last packet
-   if ( _packet.data != NULL )
-      av_free_packet(&_packet);
+   if ( dec->packet.data != NULL )
+      av_free_packet(&dec->packet);
 
    if ( frameFinished )
-      _nextIndex++;
+      [self frameDecoded:dec];
 
    return( frameFinished != 0 );
 }
 
-- (AVFrame*) getFrame :(u_long) index
+- (MyAVFrameContainer*) getFrame:(u_long)index decoder:(FFmpegDecoder_t*)dec
 {
-   NSString *key =
-             [NSString stringWithFormat:@"%s&%06d",_pFormatCtx->filename,index];
+   NSString *key = [NSString stringWithFormat:@"%@&%06lu",_path,index];
    LynkeosObjectCache *movieCache = [LynkeosObjectCache movieCache];
    MyAVFrameContainer *pix;
 
+   // The cache gives it retained and autoreleased
    if ( movieCache != nil &&
        (pix=(MyAVFrameContainer*)[movieCache getObjectForKey:key]) != nil )
-      return( pix->_frame );
-
-   int ret;
-   BOOL success;
+      return( pix );
 
-   // Do not move if the frame already read is asked
-   if ( index == (_nextIndex - 1) )
-      return( _pConvertedFrame );
+   int ret = 0;
+   BOOL success = NO;
 
    for( ;; )
    {
+      KeyFrames_t keyFrame;
+      int64_t keyPosition;
+      BOOL seek;
+
+      // Another decoder may revert the index to sequential read meanwhile
+      [_mutex lock];
+      if ( dec->indexGeneration != _indexGeneration )
+      {
+         // Its position was found with the previous index
+         dec->nextIndex = _numberOfFrames + 1;
+         dec->indexGeneration = _indexGeneration;
+      }
+      keyFrame = _times[index];
+      keyPosition = _times[keyFrame.keyFrame].position;
+      seek = ( index < dec->nextIndex
+               || keyFrame.keyFrame != _times[dec->nextIndex].keyFrame );
+      [_mutex unlock];
+
+      // Do not move if the frame already read is asked
+      if ( index == (dec->nextIndex - 1) && dec->convertedFrame != nil )
+         return( [[dec->convertedFrame retain] autorelease] );
+
       // Go to the previous key frame if needed
-      if ( index < _nextIndex
-          || _times[index].keyFrame != _times[_nextIndex].keyFrame )
+      if ( seek )
       {
          // Reset the decoder
-         av_free_packet( &_packet );
-         _bytesRemaining = 0;
-         avcodec_flush_buffers(_pCodecCtx);
-
-         ret = av_seek_frame( _pFormatCtx, _videoStream,
-                             _times[index].timestamp,
-                             AVSEEK_FLAG_BACKWARD );
+         av_free_packet( &dec->packet );
+         dec->bytesRemaining = 0;
+         avcodec_flush_buffers(dec->codecCtx);
+
+         if ( keyFrame.timestamp != AV_NOPTS_VALUE )
+            ret = av_seek_frame( dec->formatCtx, _videoStream,
+                                 keyFrame.timestamp,
+                                 AVSEEK_FLAG_BACKWARD );
+         else
+            // No timestamp, go straight to the key frame packet
+            ret = av_seek_frame( dec->formatCtx, _videoStream,
+                                 keyPosition,
+                                 AVSEEK_FLAG_BYTE );
 
          if ( ret == 0 )
-            _nextIndex = _times[index].keyFrame;
+            dec->nextIndex = keyFrame.keyFrame;
          else
-            _nextIndex = _numberOfFrames + 1;
+            dec->nextIndex = _numberOfFrames + 1;
       }
       else
          ret = 0;
@@ -202,72 +1129,103 @@
       if ( ret == 0 )
       {
          success = YES;
-         while ( _nextIndex <= index && success )
+         while ( dec->nextIndex <= index && success )
          {
-            success = [self nextFrame];
+            success = [self nextFrame:dec];
 
             if ( !success )
                NSLog( @"Failed to advance to the next frame" );
 
-            // Keep the lasts frames in cache for list processing
+            // Keep the lasts frames in cache for list processing, the
+            // last one decoded is always converted
             if ( success
-                 && ( _nextIndex == index+1
-                      || (movieCache != nil 
-                          && _nextIndex+numberOfCpus > index) ) )
+                 && ( dec->nextIndex > index
+                      || (movieCache != nil
+                          && dec->nextIndex+numberOfCpus > index) ) )
             {
-               if ( movieCache != nil || _pConvertedFrame == nil )
-               {
-                  uint8_t *buffer;
-                  // Cache will take care of freeing the previous frame
-                  _pConvertedFrame = avcodec_alloc_frame();
-
-                  buffer = (uint8_t*) malloc( sizeof(uint8_t)*_pixbufSize );
+               AVFrame *frame;
 
-                  // Assign appropriate parts of buffer to image planes
-                  // in pFrameRGB
-                  avpicture_fill( (AVPicture *)_pConvertedFrame, buffer,
-                         PIX_FMT_RGB24, _pCodecCtx->width, _pCodecCtx->height );
+               // The cache and the readers may still use the previous one
+               if ( movieCache != nil || dec->convertedFrame == nil )
+               {
+                  if ( dec->convertedFrame != nil )
+                     [dec->convertedFrame release];
+                  dec->convertedFrame = [[MyAVFrameContainer alloc]
+                                             initWithFormat:_frameFormat
+                                                       size:_pixbufSize
+                                                      width:
+                                                        dec->codecCtx->width
+                                                     height:
+                                                        dec->codecCtx->height];
                }
+               frame = dec->convertedFrame->_frame;
 
-               // Convert the picture in a RGB buffer
-               ret = sws_scale(_convert_ctx,
-                           _pCurrentFrame->data, _pCurrentFrame->linesize,
-                           0, _pCodecCtx->height, 
-                           _pConvertedFrame->data, _pConvertedFrame->linesize);
-/*
-               ret = img_convert( (AVPicture *)_pConvertedFrame, PIX_FMT_RGB24,
-                              (AVPicture*)_pCurrentFrame, _pCodecCtx->pix_fmt, 
-                              _pCodecCtx->width, _pCodecCtx->height );
-*/
+               if ( _frameFormat == dec->codecCtx->pix_fmt )
+               {
+                  // Keep the codec format, only the samples are converted
+                  av_picture_copy( (AVPicture*)frame,
+                                   (AVPicture*)dec->currentFrame,
+                                   _frameFormat,
+                                   dec->codecCtx->width,
+                                   dec->codecCtx->height );
+                  ret = 1;
+               }
+               else
+                  // Convert the picture in a RGB buffer
+                  ret = sws_scale(dec->convertCtx,
+                              dec->currentFrame->data,
+                              dec->currentFrame->linesize,
+                              0, dec->codecCtx->height,
+                              frame->data,
+                              frame->linesize);
                if ( ret > 0 )
                {
                   if ( movieCache != nil )
-                     [movieCache setObject:
-                        [[[MyAVFrameContainer alloc] initWithAVFrame:
-                                                  _pConvertedFrame] autorelease]
+                     [movieCache setObject:dec->convertedFrame
                                     forKey:
-                                       [NSString stringWithFormat:@"%s&%06d",
-                                           _pFormatCtx->filename,_nextIndex-1]];
+                                       [NSString stringWithFormat:@"%@&%06lu",
+                                           _path,dec->nextIndex-1]];
                }
                else
                   NSLog( @"Image conversion failed" );
             }
          }
+
+         // The decoder went past the frame without giving it
+         if ( success && dec->nextIndex != index+1 )
+         {
+            NSLog( @"Frame %lu not found after the seek", index );
+            success = NO;
+         }
       }
       else
          NSLog( @"Seek to frame failed" );
 
       if ( (! success || ret <= 0)
-          && (_times[index].keyFrame != 0 || _times[index].timestamp != 0) )
+          && (keyFrame.keyFrame != 0 || keyFrame.timestamp != 0) )
       { // Hack to try to read buggy sequences (or which makes FFmpeg bug ;o)
          unsigned int i;
          NSLog( @"Trying to revert to sequential read" );
+         [_mutex lock];
          for( i = 1; i < _numberOfFrames; i++ )
          {
             _times[i].keyFrame = 0;
             _times[i].timestamp = 0;
          }
-         _nextIndex = _numberOfFrames;
+         // The other decoders positions are no more trusted, those in use
+         // will notice the new generation on their next frame
+         _indexGeneration++;
+         for( i = 0; i < _nDecoders; i++ )
+         {
+            if ( _decoders[i]->users == 0 )
+            {
+               _decoders[i]->nextIndex = _numberOfFrames + 1;
+               _decoders[i]->indexGeneration = _indexGeneration;
+            }
+         }
+         dec->indexGeneration = _indexGeneration;
+         [_mutex unlock];
+         dec->nextIndex = _numberOfFrames;
       }
       else
          // Succeeded or hopeless
@@ -276,11 +1234,12 @@
 
    if( !success || ret <= 0 )
    {
-      av_freep( &_pConvertedFrame );
-      _pConvertedFrame = NULL;
+      if ( dec->convertedFrame != nil )
+         [dec->convertedFrame release];
+      dec->convertedFrame = nil;
    }
 
-   return( _pConvertedFrame );
+   return( [[dec->convertedFrame retain] autorelease] );
 }
 
 @end
@@ -305,160 +1264,77 @@
    self = [super init];
    if ( self != nil )
    {
-      _pFormatCtx = NULL;
-      _pCodecCtx = NULL;
-      _pCurrentFrame = NULL;
-      _pConvertedFrame = NULL;
-      _convert_ctx = NULL;
+      _maxDecoders = (numberOfCpus > 1 ? numberOfCpus : 1);
+      _decoders = (FFmpegDecoder_t**)malloc( _maxDecoders
+                                             * sizeof(FFmpegDecoder_t*) );
+      _nDecoders = 0;
+      _path = nil;
       _videoStream = -1;
-      _packet.data = NULL;
-      _bytesRemaining = 0;
       _numberOfFrames = 0;
-      _nextIndex = 0;
       _mutex = [[NSLock alloc] init];
       _times = NULL;
+      _framesByPts = NO;
+      _indexGeneration = 0;
    }
    return( self );
 }
 
 - (id) initWithURL:(NSURL*)url
 {
-   unsigned int i;
-   int      ret;
-   AVCodec *pCodec;
-   u_long   arraySize;
-   BOOL     validFrame;
-   int64_t  /*startTime, timestamp,*/ keyTimestamp;
-   u_long   keyIndex;
+   FFmpegDecoder_t *dec;
+   u_long i;
 
    self = [self init];
 
    if ( self != nil )
    {
-      // Open video file
-      ret = av_open_input_file( &_pFormatCtx, 
-                                [[url path] fileSystemRepresentation], 
-                                NULL, 0, NULL );
-      if ( ret != 0 )
-      {
-         NSLog( @"Could not open file %@", [url absoluteString] );
-         [self release];
-         return( nil );
-      }
-
-      // Retrieve stream information
-      ret = av_find_stream_info(_pFormatCtx);
-      if ( ret < 0 )
-      {
-         NSLog( @"Could not find any stream info");
-         [self release];
-         return( nil );
-      }
-
-      // Find the first video stream
-      _videoStream = -1;
-      for ( i = 0; i < _pFormatCtx->nb_streams; i++ )
-      {
-         if( _pFormatCtx->streams[i]->codec->codec_type == CODEC_TYPE_VIDEO )
-         {
-            _videoStream = i;
-            break;
-         }
-      }
-
-      if( _videoStream == -1 )
-      {
-         NSLog( @"Could not find a video stream");
-         [self release];
-         return( nil );
-      }
-
-      // Get a pointer to the codec context for the video stream
-      _pCodecCtx = _pFormatCtx->streams[_videoStream]->codec;
-
-      // Find the decoder for the video stream
-      pCodec = avcodec_find_decoder(_pCodecCtx->codec_id);
-      if ( pCodec == NULL )
-      {
-         NSLog( @"Codec not found");
-         [self release];
-         return( nil );
-      }
-
-      // Inform the codec that we can handle truncated bitstreams -- i.e.,
-      // bitstreams where frame boundaries can fall in the middle of packets
-      if ( pCodec->capabilities & CODEC_CAP_TRUNCATED )
-         _pCodecCtx->flags |= CODEC_FLAG_TRUNCATED;
+      _path = [[url path] retain];
 
-      // Open codec
-      if ( avcodec_open(_pCodecCtx, pCodec) < 0 )
+      // The first decoder also reads the packets for the index
+      dec = [self openDecoder];
+      if ( dec == NULL )
       {
-         NSLog( @"Can't open the codec" );
          [self release];
          return( nil );
       }
-
-      // Allocate video frame
-      _pCurrentFrame = avcodec_alloc_frame();
+      _decoders[0] = dec;
+      _nDecoders = 1;
+
+      // Keep the codec format when the samples can be converted from it.
+      // The chrominances are then taken from the nearest sample, instead of
+      // the bicubic upsampling of swscale
+      if ( isDirectFormat( dec->codecCtx->pix_fmt ) )
+         _frameFormat = dec->codecCtx->pix_fmt;
+      else
+         _frameFormat = PIX_FMT_RGB24;
 
       // Determine required buffer size and allocate buffer
-      _pixbufSize = avpicture_get_size( PIX_FMT_RGB24, 
-                                     _pCodecCtx->width, _pCodecCtx->height );
-
-      // Allocate a RGB converter
-      _convert_ctx = sws_getCachedContext(_convert_ctx,
-                                    _pCodecCtx->width, _pCodecCtx->height, 
-                                    _pCodecCtx->pix_fmt, 
-                                    _pCodecCtx->width, _pCodecCtx->height,
-                                    PIX_FMT_RGB24, SWS_BICUBIC, 
-                                    NULL, NULL, NULL);
-      if(_convert_ctx == NULL)
-      {
-         NSLog(@"Cannot initialize the conversion context!");
-         [self release];
-         return( nil );
-      }
+      _pixbufSize = avpicture_get_size( _frameFormat,
+                                        dec->codecCtx->width,
+                                        dec->codecCtx->height );
 
-      // Get the frames times
-      arraySize = 0;
-//      startTime = _pFormatCtx->streams[_videoStream]->start_time;
-      //frameDuration = (int64_t)
-      //          ((double)_pFormatCtx->streams[_videoStream]->r_frame_rate.den
-      //	  / (double)_pFormatCtx->streams[_videoStream]->r_frame_rate.num
-      //	  * (double)_pFormatCtx->streams[_videoStream]->time_base.den
-      //	  / (double)_pFormatCtx->streams[_videoStream]->time_base.num
-      //	  + 0.5 );
-//      timestamp = startTime;
-      keyIndex = 0;
-      keyTimestamp = 0/*startTime*/;
-      for( validFrame = YES; validFrame; )
+      // Get the frames index, it is saved as building it reads all the file
+      if ( ![self readIndexCache] )
       {
-         validFrame = [self nextFrame];
-
-         if ( validFrame )
+         if ( ![self buildIndex:dec] )
          {
-            if ( _numberOfFrames >= arraySize )
-            {
-               arraySize += K_TIME_PAGE_SIZE;
-               _times = (KeyFrames_t*)realloc( _times, 
-                                               arraySize*sizeof(KeyFrames_t) );
-            }
-/*
-            if ( _pCurrentFrame->key_frame )
-            {
-               keyTimestamp = timestamp;
-               keyIndex = _numberOfFrames;
-            }
- */
-            _times[_numberOfFrames].timestamp = keyTimestamp;
-            _times[_numberOfFrames].keyFrame = keyIndex;
-
-            _numberOfFrames ++;
-//            timestamp = _pFormatCtx->streams[_videoStream]->cur_dts;
+            NSLog( @"No frame found in %@", _path );
+            [self release];
+            return( nil );
          }
+         [self writeIndexCache];
       }
-      // We are now pointing beyond sequence end
-      _nextIndex = _numberOfFrames + 1;
+
+      // The decoded frames are identified by their timestamp, when the
+      // index is in presentation order
+      _framesByPts = YES;
+      for( i = 0; i < _numberOfFrames && _framesByPts; i++ )
+         if ( _times[i].pts == AV_NOPTS_VALUE
+              || (i > 0 && _times[i].pts <= _times[i-1].pts) )
+            _framesByPts = NO;
+
+      // Point beyond sequence end, to force a seek on the first read
+      dec->nextIndex = _numberOfFrames + 1;
    }
 
    return( self );
@@ -466,22 +1342,14 @@
 
 - (void) dealloc
 {
+   u_short i;
+
    [_mutex release];
-   if ( _pCodecCtx != NULL )
-      avcodec_close(_pCodecCtx);
-   if ( [LynkeosObjectCache movieCache] != nil && _pConvertedFrame != NULL )
-   {
-      av_free(((AVPicture *)(_pConvertedFrame))->data[0]);
-      av_free(_pConvertedFrame);
-   }
-   if ( _pCurrentFrame != NULL )
-      av_free(_pCurrentFrame);
-   if ( _convert_ctx != NULL )
-      sws_freeContext( _convert_ctx );
-   if ( _packet.data != NULL )
-      av_free_packet( &_packet );
-   if ( _pFormatCtx != NULL )
-      av_close_input_file( _pFormatCtx );
+   for( i = 0; i < _nDecoders; i++ )
+      [self closeDecoder:_decoders[i]];
+   free( _decoders );
+   if ( _path != nil )
+      [_path release];
    if ( _times != NULL )
       free( _times );
 
@@ -490,8 +1358,8 @@
 
 - (void) imageWidth:(u_short*)w height:(u_short*)h
 {   
-   *w = _pCodecCtx->width;
-   *h = _pCodecCtx->height;
+   *w = _decoders[0]->codecCtx->width;
+   *h = _decoders[0]->codecCtx->height;
 }
 
 - (u_short) numberOfPlanes
@@ -510,17 +1378,35 @@
    return( _numberOfFrames );
 }
 
+- (void) prefetchFrameAtIndex:(u_long)index
+{
+   FFmpegDecoder_t *dec;
+
+   // Without a cache, the decoded frame would be lost
+   if ( [LynkeosObjectCache movieCache] == nil )
+      return;
+
+   NSAssert( index < _numberOfFrames, @"Prefetch beyond sequence end" );
+
+   dec = [self lockDecoderForIndex:index];
+   [self getFrame:index decoder:dec];
+   [self unlockDecoder:dec];
+}
+
 - (NSImage*) getNSImageAtIndex:(u_long)index
 {
    NSImage *image = nil;
    NSBitmapImageRep* bitmap;
+   u_short width, height;
 
    NSAssert( index < _numberOfFrames, @"Access beyond sequence end" );
 
+   [self imageWidth:&width height:&height];
+
    // Create a RGB bitmap
    bitmap = [[[NSBitmapImageRep alloc] initWithBitmapDataPlanes:NULL
-                                                   pixelsWide:_pCodecCtx->width
-                                                   pixelsHigh:_pCodecCtx->height
+                                                   pixelsWide:width
+                                                   pixelsHigh:height
                                                   bitsPerSample:8
                                                 samplesPerPixel:3
                                                        hasAlpha:NO
@@ -532,28 +1418,39 @@
 
    if ( bitmap != nil )
    {
-      u_long lineLength = _pCodecCtx->width*3;
+      u_long lineLength = width*3;
       u_char *pixels = (u_char*)[bitmap bitmapData];
       int bpr = [bitmap bytesPerRow];
+      FFmpegDecoder_t *dec;
+      MyAVFrameContainer *pix;
       AVFrame *frame;
       u_short y;
 
-      [_mutex lock];
+      dec = [self lockDecoderForIndex:index];
 
-      frame = [self getFrame:index];
+      pix = [self getFrame:index decoder:dec];
+      frame = (pix != nil ? pix->_frame : NULL);
 
-      if ( frame != NULL )
+      if ( frame != NULL && _frameFormat == PIX_FMT_RGB24 )
       {
-         for( y = 0; y < _pCodecCtx->height; y++ )
+         for( y = 0; y < height; y++ )
             memcpy( &pixels[y*bpr],
                     frame->data[0]+y*frame->linesize[0],
                     lineLength );
       }
+      else if ( frame != NULL )
+      {
+         // Convert the whole frame, straight in the bitmap
+         uint8_t *bitmapData[4] = { pixels, NULL, NULL, NULL };
+         int bitmapLinesize[4] = { bpr, 0, 0, 0 };
 
-      [_mutex unlock];
+         sws_scale( dec->convertCtx, frame->data, frame->linesize,
+                    0, height, bitmapData, bitmapLinesize );
+      }
 
-      image = [[[NSImage alloc] initWithSize:NSMakeSize(_pCodecCtx->width,
-                                                       _pCodecCtx->height)]
+      [self unlockDecoder:dec];
+
+      image = [[[NSImage alloc] initWithSize:NSMakeSize(width,height)]
                                                                    autorelease];
 
       if ( image != nil )
@@ -569,45 +1466,88 @@
                     atX:(u_short)x Y:(u_short)y W:(u_short)w H:(u_short)h
               lineWidth:(u_short)lineW
 {
-   u_short xs, ys, cs;
+   FFmpegDecoder_t *dec;
+   MyAVFrameContainer *pix;
+   AVFrame *frame;
+   enum PixelFormat fmt;
+   const YuvCoefficients_t *coef;
+   void (*yuv_to_rgb)( REAL*, REAL*, REAL*, u_short,
+                       const YuvCoefficients_t* ) = std_yuv_to_rgb;
+   void (*yuv_to_luma)( REAL*, u_short,
+                        const YuvCoefficients_t* ) = std_yuv_to_luma;
+   void (*write_row)( void * const, floating_precision_t, u_short, u_short,
+                      const REAL*, u_short ) = std_write_row;
+   const u_short wpad = (w + 3) & ~3;
+   REAL *r, *g, *b;
+   u_short width, height;
+   u_short xs, ys;
+
+   [self imageWidth:&width height:&height];
 
    NSAssert( index < _numberOfFrames, @"Access beyond sequence end" );
-   NSAssert( x+w <= _pCodecCtx->width && y+h <= _pCodecCtx->height, 
+   NSAssert( x+w <= width && y+h <= height,
              @"Sample at least partly outside the image" );
 
-   [_mutex lock];
+   // Rows of the sample, each plane starts on a vector boundary
+   r = (REAL*)malloc( 3*wpad*sizeof(REAL) );
+   NSAssert( r != NULL, @"Could not allocate the sample rows" );
+   g = r + wpad;
+   b = g + wpad;
+
+   fmt = _frameFormat;
+   coef = (fmt == PIX_FMT_YUVJ420P || fmt == PIX_FMT_YUVJ422P
+           || fmt == PIX_FMT_YUVJ444P) ? &fullRangeYuv : &videoRangeYuv;
+#ifdef YUV_VECTORS
+   if ( hasSIMD && ((u_long)r % sizeof(REALVECT)) == 0 )
+   {
+      yuv_to_rgb = vect_yuv_to_rgb;
+      yuv_to_luma = vect_yuv_to_luma;
+      write_row = vect_write_row;
+   }
+#endif
 
-   AVFrame *frame;
-   frame = [self getFrame:index];
+   dec = [self lockDecoderForIndex:index];
+
+   pix = [self getFrame:index decoder:dec];
+   frame = (pix != nil ? pix->_frame : NULL);
 
    if ( frame == NULL )
    {
-      [_mutex unlock];
+      [self unlockDecoder:dec];
+      free( r );
       NSAssert( NO, @"Could not access FFMpeg frame" );
    }
 
-   for ( ys = 0; ys < h; ys++ )
+   // Convert only the pixels of the sample
+   if ( nPlanes == 1 )
    {
-      for( xs = 0; xs < w; xs++ )
+      for ( ys = 0; ys < h; ys++ )
       {
-         u_char *v = frame->data[0]
-                     + (y+ys)*frame->linesize[0] + (x+xs)*3;
-
-         if ( nPlanes == 1 )
-         {
-            // Convert to monochrome
-            SET_SAMPLE( sample[0],precision,xs,ys,lineW, 
-                        (v[0]+v[1]+v[2])/3.0 );
-         }
+         // Monochrome is the luminance itself, when the frame has one
+         if ( read_rgb_row( frame, fmt, x, y+ys, w, r, g, b ) )
+            yuv_to_luma( r, w, coef );
          else
-         {
-            for( cs = 0; cs < nPlanes; cs++ )
-               SET_SAMPLE( sample[cs],precision,xs,ys,lineW, v[cs] );
-         }
+            for( xs = 0; xs < w; xs++ )
+               r[xs] = (r[xs]+g[xs]+b[xs])/3.0;
+
+         write_row( sample[0], precision, ys, lineW, r, w );
       }
    }
+   else
+   {
+      for ( ys = 0; ys < h; ys++ )
+      {
+         if ( read_rgb_row( frame, fmt, x, y+ys, w, r, g, b ) )
+            yuv_to_rgb( r, g, b, w, coef );
 
-   [_mutex unlock];
+         write_row( sample[0], precision, ys, lineW, r, w );
+         write_row( sample[1], precision, ys, lineW, g, w );
+         write_row( sample[2], precision, ys, lineW, b, w );
+      }
+   }
+
+   [self unlockDecoder:dec];
+   free( r );
 }
 
 - (NSDictionary*) getMetaData 
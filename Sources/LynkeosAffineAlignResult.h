@@ -0,0 +1,48 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun Apr 3 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+/*!
+ * @header
+ * @abstract Alignment result class with an affine transform
+ */
+#ifndef __LYNKEOSAFFINEALIGNRESULT_H
+#define __LYNKEOSAFFINEALIGNRESULT_H
+
+#import <Foundation/Foundation.h>
+
+#include "LynkeosCore/LynkeosBasicAlignResult.h"
+
+/*!
+ * @abstract Alignment result for an image distorted by an affine transform
+ * @discussion The point of the reference image P is found in the image at
+ *    T(P), where T is the transform. The inherited offset is the translation
+ *    at the image center, for the users which do not need more.
+ */
+@interface LynkeosAffineAlignResult : LynkeosBasicAlignResult
+{
+@public
+   //! Transform from the reference to the image coordinates
+   NSAffineTransformStruct _transform;
+}
+@end
+
+#endif
@@ -0,0 +1,96 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun Apr 3 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "LynkeosAffineAlignResult.h"
+
+#define K_AFFINE_M11_KEY      @"m11"     ///< Key for saving the transform
+#define K_AFFINE_M12_KEY      @"m12"     ///< Key for saving the transform
+#define K_AFFINE_M21_KEY      @"m21"     ///< Key for saving the transform
+#define K_AFFINE_M22_KEY      @"m22"     ///< Key for saving the transform
+#define K_AFFINE_TX_KEY       @"tx"      ///< Key for saving the transform
+#define K_AFFINE_TY_KEY       @"ty"      ///< Key for saving the transform
+
+@implementation LynkeosAffineAlignResult
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _transform.m11 = 1.0;
+      _transform.m12 = 0.0;
+      _transform.m21 = 0.0;
+      _transform.m22 = 1.0;
+      _transform.tX = 0.0;
+      _transform.tY = 0.0;
+   }
+
+   return( self );
+}
+
+- (NSAffineTransform*) alignTransform
+{
+   // Inverse of the image transform, to display the image as the reference
+   NSAffineTransform *tr = [NSAffineTransform transform];
+   [tr setTransformStruct:_transform];
+   [tr invert];
+
+   return( tr );
+}
+
+- (NSPoint) correctedCoordinatesFor:(NSPoint)source
+{
+   NSPoint p = { _transform.m11*source.x + _transform.m21*source.y
+                 + _transform.tX,
+                 _transform.m12*source.x + _transform.m22*source.y
+                 + _transform.tY };
+
+   return( p );
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+   [super encodeWithCoder:encoder];
+
+   [encoder encodeDouble:_transform.m11 forKey:K_AFFINE_M11_KEY];
+   [encoder encodeDouble:_transform.m12 forKey:K_AFFINE_M12_KEY];
+   [encoder encodeDouble:_transform.m21 forKey:K_AFFINE_M21_KEY];
+   [encoder encodeDouble:_transform.m22 forKey:K_AFFINE_M22_KEY];
+   [encoder encodeDouble:_transform.tX forKey:K_AFFINE_TX_KEY];
+   [encoder encodeDouble:_transform.tY forKey:K_AFFINE_TY_KEY];
+}
+
+- (id) initWithCoder:(NSCoder *)decoder
+{
+   self = [super initWithCoder:decoder];
+
+   if ( self != nil && [decoder containsValueForKey:K_AFFINE_M11_KEY] )
+   {
+      _transform.m11 = [decoder decodeDoubleForKey:K_AFFINE_M11_KEY];
+      _transform.m12 = [decoder decodeDoubleForKey:K_AFFINE_M12_KEY];
+      _transform.m21 = [decoder decodeDoubleForKey:K_AFFINE_M21_KEY];
+      _transform.m22 = [decoder decodeDoubleForKey:K_AFFINE_M22_KEY];
+      _transform.tX = [decoder decodeDoubleForKey:K_AFFINE_TX_KEY];
+      _transform.tY = [decoder decodeDoubleForKey:K_AFFINE_TY_KEY];
+   }
+
+   return( self );
+}
+@end
@@ -276,4 +276,21 @@
                                                      W:(u_short)w H:(u_short)h ;
 @end
 
+/*!
+ * @abstract Optional protocol for the movie readers which can decode ahead
+ * @discussion Before a list processing reaches a frame, the prefetcher asks
+ *   the reader to decode it in the movie cache, from another thread.
+ * @ingroup FileAccess
+ */
+@protocol LynkeosPrefetchingMovieReader <LynkeosMovieFileReader>
+
+/*!
+ * @abstract Decode a frame which will be read soon
+ * @discussion The reader shall do nothing if it has no cache to keep it.
+ * @param index The index of the frame
+ */
+- (void) prefetchFrameAtIndex:(u_long)index ;
+
+@end
+
 #endif
@@ -66,6 +66,8 @@ typedef void(*SpectrumProcessOneLine_t)(LynkeosFourierBuffer *a,
    //! The spectrum has only half the image width (complex pixels)
    u_short     _halfw;
    u_short     _spadw;     //!< Spectrum padded width
+   //! Number of images transformed together, stacked vertically in each plane
+   u_short     _batch;
 @private
    u_char      _goal;      //!< The kind of transform that will be performed
    void       *_direct;    //!< FFTW plan for direct transform, if any
@@ -108,6 +110,25 @@ typedef void(*SpectrumProcessOneLine_t)(LynkeosFourierBuffer *a,
                      withGoal:(u_char)goal
                    isSpectrum:(BOOL)isSpectrum;
 
+/*!
+ * @abstract Allocates a new empty buffer for a batch of images
+ * @discussion The images of the batch are stacked vertically in each plane,
+ *    the buffer height is the batch size times the height of one image. All
+ *    the images are transformed by one FFTW call.
+ * @param nPlanes Number of color planes for this image
+ * @param w Image pixels width
+ * @param h Pixels height of one image of the batch
+ * @param batch Number of images in the batch
+ * @param goal What kind of transform to prepare, direct, inverse or both.
+ * @param isSpectrum Whether the initial data is a spectrum
+ * @result The allocated and initialized buffer, ready for FFT.
+ */
+- (id) initWithNumberOfPlanes:(u_char)nPlanes 
+                        width:(u_short)w height:(u_short)h 
+                        batch:(u_short)batch
+                     withGoal:(u_char)goal
+                   isSpectrum:(BOOL)isSpectrum;
+
 /*!
  * @abstract Tells whether the instance is a spectrum or an image
  * @result YES if the instance is a spectrum
@@ -176,6 +197,21 @@ typedef void(*SpectrumProcessOneLine_t)(LynkeosFourierBuffer *a,
                                              height:(u_short)h 
                                            withGoal:(u_char)goal ;
 
+/*!
+ * @abstract Allocates a new empty buffer for a batch of images
+ * @param nPlanes Number of color planes for this image
+ * @param w Image pixels width
+ * @param h Pixels height of one image of the batch
+ * @param batch Number of images in the batch
+ * @param goal What kind of transform to prepare, direct, inverse or both.
+ * @result The allocated and initialized buffer, ready for FFT.
+ */
++ (LynkeosFourierBuffer*) fourierBufferWithNumberOfPlanes:(u_char)nPlanes 
+                                              width:(u_short)w 
+                                             height:(u_short)h 
+                                              batch:(u_short)batch
+                                           withGoal:(u_char)goal ;
+
 @end
 
 /*!
@@ -27,6 +27,8 @@
 #include <CoreServices/CoreServices.h>
 #endif
 #include <pthread.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include "processing_core.h"
 #include "LynkeosFourierBuffer.h"
@@ -60,6 +62,14 @@ static unsigned fftwDefaultFlag;
 // Mutex used to protect every call to FFTW except fftw_execute
 static pthread_mutex_t fftwLock;
 
+//! Mark of a list thread in the CPU budget thread key, aside its optimizations
+#define K_LIST_THREAD_MARK 0x1000
+
+// The CPU budget
+static pthread_mutex_t budgetLock;
+static pthread_key_t budgetKey;        // List thread mark and optimizations
+static u_short runningListThreads = 0; // Number of list threads not finished
+
 /*!
 * To initialize the processing, we need to check if the processor 
  * support Altivec instructions and configure FFTW3 calls accordingly ; and 
@@ -99,10 +109,58 @@ void initializeProcessing(void)
    // Create a lock for FFTW non thread safe functions
    pthread_mutex_init( &fftwLock, NULL );
 
+   // And the CPU budget bookkeeping
+   pthread_mutex_init( &budgetLock, NULL );
+   pthread_key_create( &budgetKey, NULL );
+
    // Prepare FFTW to work with threads
    FFTW_INIT_THREADS();
 }
 
+u_short cpuBudgetStartListThreads( ParallelOptimization_t optim )
+{
+   const u_short n = ( (optim & ListThreadsOptimizations) != 0 ?
+                       numberOfCpus : 1 );
+
+   pthread_mutex_lock( &budgetLock );
+   runningListThreads += n;
+   pthread_mutex_unlock( &budgetLock );
+
+   return( n );
+}
+
+void cpuBudgetEnterListThread( ParallelOptimization_t optim )
+{
+   pthread_setspecific( budgetKey,
+                        (void*)(intptr_t)(optim | K_LIST_THREAD_MARK) );
+}
+
+void cpuBudgetLeaveListThread( void )
+{
+   // The thread keeps its mark, to stay limited to its optimizations
+   pthread_mutex_lock( &budgetLock );
+   NSCAssert( runningListThreads > 0, @"Unbalanced CPU budget release" );
+   runningListThreads--;
+   pthread_mutex_unlock( &budgetLock );
+}
+
+u_short cpuBudgetForItem( ParallelOptimization_t kind )
+{
+   const intptr_t mark = (intptr_t)pthread_getspecific( budgetKey );
+   u_short n;
+
+   if ( (mark & K_LIST_THREAD_MARK) != 0 && (mark & kind) == 0 )
+      return( 1 );
+
+   // Share the CPUs evenly between the list threads still running
+   pthread_mutex_lock( &budgetLock );
+   n = ( runningListThreads > 1 ? numberOfCpus/runningListThreads
+                                : numberOfCpus );
+   pthread_mutex_unlock( &budgetLock );
+
+   return( n > 0 ? n : 1 );
+}
+
 /*!
  * @abstract Multiply method for strategy "without vectors"
  */
@@ -422,6 +480,7 @@ static void vect_spectrum_div_one_line(LynkeosFourierBuffer *a,
    {
       _halfw = 0;
       _spadw = 0;
+      _batch = 1;
       _goal = 0;
       _direct = NULL;
       _inverse = NULL;
@@ -460,9 +519,21 @@ static void vect_spectrum_div_one_line(LynkeosFourierBuffer *a,
                         width:(u_short)w height:(u_short)h 
                      withGoal:(u_char)goal
                    isSpectrum:(BOOL)isSpectrum
+{
+   return( [self initWithNumberOfPlanes:nPlanes width:w height:h batch:1
+                               withGoal:goal isSpectrum:isSpectrum] );
+}
+
+- (id) initWithNumberOfPlanes:(u_char)nPlanes 
+                        width:(u_short)w height:(u_short)h 
+                        batch:(u_short)batch
+                     withGoal:(u_char)goal
+                   isSpectrum:(BOOL)isSpectrum
 {
    NSAssert( nPlanes == 1 || nPlanes == 3, 
              @"MyFourierBuffer handles only monochrome or RGB images" );
+   NSAssert( batch != 0 && (u_long)h*batch <= USHRT_MAX,
+             @"Invalid Fourier buffer batch size" );
 
    if ( (self = [self init]) != nil )
    {
@@ -476,31 +547,35 @@ static void vect_spectrum_div_one_line(LynkeosFourierBuffer *a,
       _spadw = (_halfw*sizeof(COMPLEX) + 4*sizeof(float) - 1)/4/sizeof(float);
       _spadw *= 4*sizeof(float)/sizeof(COMPLEX);
       _padw = _spadw*sizeof(COMPLEX)/sizeof(REAL);    // Padded real pixels
-      _h = h;
+      _batch = batch;
+      _h = h*batch;
       _goal = goal;
       _isSpectrum = isSpectrum;
 
       pthread_mutex_lock( &fftwLock );
 
+      FFTW_PLAN_WITH_NTHREADS( cpuBudgetForItem(FFTW3ThreadsOptimization) );
       _data = FFT_MALLOC( _nPlanes*sizeof(COMPLEX)*_spadw*_h );
       NSAssert( _data != NULL, @"FFT buffer allocation failed" );
       _freeWhenDone = YES;
 
-      sizes[0] = _h;
+      // Each image of the batch is transformed separately, as if it was
+      // another plane
+      sizes[0] = h;
       sizes[1] = _w;
-      realPaddedSizes[0] = _h;
+      realPaddedSizes[0] = h;
       realPaddedSizes[1] = _padw;
-      complexPaddedSizes[0] = _h;
+      complexPaddedSizes[0] = h;
       complexPaddedSizes[1] = _spadw;
 
       if ( _goal & FOR_DIRECT )
-         _direct = FFT_PLAN_R2C( 2, sizes, _nPlanes,
+         _direct = FFT_PLAN_R2C( 2, sizes, _nPlanes*_batch,
                               _data, realPaddedSizes, 1, _padw*h,
                               (COMPLEX*)_data, complexPaddedSizes, 1, _spadw*h,
                               fftwDefaultFlag | FFTW_MEASURE );
 
       if ( _goal & FOR_INVERSE )
-         _inverse = FFT_PLAN_C2R( 2, sizes,  _nPlanes,
+         _inverse = FFT_PLAN_C2R( 2, sizes,  _nPlanes*_batch,
                                (COMPLEX*)_data, complexPaddedSizes, 1, _spadw*h,
                                _data, realPaddedSizes, 1, _padw*h,
                                fftwDefaultFlag | FFTW_MEASURE );
@@ -533,8 +608,10 @@ static void vect_spectrum_div_one_line(LynkeosFourierBuffer *a,
    LynkeosFourierBuffer *buf =
       [[LynkeosFourierBuffer allocWithZone:zone] initWithNumberOfPlanes:_nPlanes
                                                              width:_w
-                                                            height:_h
-                                                          withGoal:_goal];
+                                                            height:_h/_batch
+                                                             batch:_batch
+                                                          withGoal:_goal
+                                                        isSpectrum:NO];
    memcpy( buf->_data, _data, _nPlanes*sizeof(COMPLEX)*_spadw*_h );
    buf->_isSpectrum = _isSpectrum;
 
@@ -571,7 +648,7 @@ static void vect_spectrum_div_one_line(LynkeosFourierBuffer *a,
 
 - (void) inverseTransform
 {
-   const REAL area = _w*_h;
+   const REAL area = _w*(_h/_batch);
    u_short x, y, c;
 
    NSAssert( _goal & FOR_INVERSE, @"Non scheduled inverse transform" );
@@ -736,4 +813,16 @@ static void vect_spectrum_div_one_line(LynkeosFourierBuffer *a,
                                            width:w height:h 
                                         withGoal:goal] autorelease] );
 }
+
++ (LynkeosFourierBuffer*) fourierBufferWithNumberOfPlanes:(u_char)nPlanes 
+                                              width:(u_short)w 
+                                             height:(u_short)h 
+                                              batch:(u_short)batch
+                                           withGoal:(u_char)goal
+{
+   return( [[[self alloc] initWithNumberOfPlanes:nPlanes
+                                           width:w height:h batch:batch
+                                        withGoal:goal isSpectrum:NO]
+            autorelease] );
+}
 @end
@@ -0,0 +1,74 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sat Mar 12 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+/*!
+ * @header
+ * @abstract Multi-point alignment result class
+ */
+#ifndef __LYNKEOSMULTIPOINTALIGNRESULT_H
+#define __LYNKEOSMULTIPOINTALIGNRESULT_H
+
+#import <Foundation/Foundation.h>
+
+#include "LynkeosCore/LynkeosBasicAlignResult.h"
+
+/*!
+ * @abstract Alignment result with a local displacement field
+ * @discussion The offset inherited from LynkeosBasicAlignResult is the global
+ *    offset of the image. The displacement field is sampled on a regular grid
+ *    of points, in the reference image coordinates, and interpolated 
+ *    bilinearly between them. The point of the reference image P is found in
+ *    the image at P - offset(P).
+ */
+@interface LynkeosMultiPointAlignResult : LynkeosBasicAlignResult
+{
+@public
+   NSPoint          _gridOrigin;    //!< Position of the first grid point
+   NSSize           _gridStep;      //!< Distance between grid points
+   u_short          _gridColumns;   //!< Number of grid points along X
+   u_short          _gridRows;      //!< Number of grid points along Y
+   //! Offset at each grid point, stored row by row
+   NSPoint          *_displacements;
+}
+
+/*!
+ * @abstract Initializes an empty displacement field
+ * @discussion Each grid point offset is initialized to 0.
+ * @param columns Number of grid points along X
+ * @param rows Number of grid points along Y
+ * @param origin Position of the first grid point
+ * @param step Distance between grid points
+ * @result The initialized alignment result
+ */
+- (id) initWithColumns:(u_short)columns rows:(u_short)rows
+                origin:(NSPoint)origin step:(NSSize)step ;
+
+/*!
+ * @abstract Interpolated offset at some point
+ * @discussion Outside of the grid, the nearest grid points are used.
+ * @param p The point, in the reference image coordinates
+ * @result The local offset at that point
+ */
+- (NSPoint) offsetAt:(NSPoint)p ;
+@end
+
+#endif
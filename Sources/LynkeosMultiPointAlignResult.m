@@ -0,0 +1,180 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sat Mar 12 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "LynkeosMultiPointAlignResult.h"
+
+#define K_GRID_ORIGIN_KEY     @"gridorigin"  ///< Key for saving the grid origin
+#define K_GRID_STEP_KEY       @"gridstep"    ///< Key for saving the grid step
+#define K_GRID_COLUMNS_KEY    @"gridcolumns" ///< Key for saving the columns nb
+#define K_GRID_ROWS_KEY       @"gridrows"    ///< Key for saving the rows nb
+//! Key for saving the grid points offsets
+#define K_GRID_DISPLACEMENTS_KEY @"displacements"
+
+/*!
+ * @abstract Position of a coordinate in the grid
+ * @discussion The result is clamped so that the interpolation always uses 
+ *    valid grid points
+ */
+static inline void gridPosition( double p, double origin, double step,
+                                 u_short n, u_short *i, double *frac )
+{
+   double g = (step > 0.0 ? (p - origin)/step : 0.0);
+
+   if ( g <= 0.0 || n < 2 )
+   {
+      *i = 0;
+      *frac = 0.0;
+   }
+   else if ( g >= (double)(n - 1) )
+   {
+      *i = n - 2;
+      *frac = 1.0;
+   }
+   else
+   {
+      *i = (u_short)g;
+      *frac = g - (double)*i;
+   }
+}
+
+@implementation LynkeosMultiPointAlignResult
+
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _gridOrigin = NSMakePoint(0.0, 0.0);
+      _gridStep = NSMakeSize(0.0, 0.0);
+      _gridColumns = 0;
+      _gridRows = 0;
+      _displacements = NULL;
+   }
+
+   return( self );
+}
+
+- (id) initWithColumns:(u_short)columns rows:(u_short)rows
+                origin:(NSPoint)origin step:(NSSize)step
+{
+   NSAssert( columns != 0 && rows != 0, @"Empty multi-point grid" );
+
+   if ( (self = [self init]) != nil )
+   {
+      _gridOrigin = origin;
+      _gridStep = step;
+      _gridColumns = columns;
+      _gridRows = rows;
+      _displacements = (NSPoint*)calloc( columns*rows, sizeof(NSPoint) );
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   if ( _displacements != NULL )
+      free( _displacements );
+
+   [super dealloc];
+}
+
+- (NSPoint) offsetAt:(NSPoint)p
+{
+   u_short i, j;
+   double fx, fy;
+   u_short i1, j1;
+   NSPoint d00, d10, d01, d11, d;
+
+   if ( _displacements == NULL )
+      return( _alignOffset );
+
+   gridPosition( p.x, _gridOrigin.x, _gridStep.width, _gridColumns, &i, &fx );
+   gridPosition( p.y, _gridOrigin.y, _gridStep.height, _gridRows, &j, &fy );
+   i1 = (_gridColumns > 1 ? i + 1 : i);
+   j1 = (_gridRows > 1 ? j + 1 : j);
+
+   d00 = _displacements[j*_gridColumns+i];
+   d10 = _displacements[j*_gridColumns+i1];
+   d01 = _displacements[j1*_gridColumns+i];
+   d11 = _displacements[j1*_gridColumns+i1];
+
+   d.x = (d00.x*(1.0-fx) + d10.x*fx)*(1.0-fy) + (d01.x*(1.0-fx) + d11.x*fx)*fy;
+   d.y = (d00.y*(1.0-fx) + d10.y*fx)*(1.0-fy) + (d01.y*(1.0-fx) + d11.y*fx)*fy;
+
+   return( d );
+}
+
+- (NSPoint) correctedCoordinatesFor:(NSPoint)source
+{
+   NSPoint d = [self offsetAt:source];
+   NSPoint p = { source.x - d.x, source.y - d.y };
+   return( p );
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+   NSMutableArray *field =
+                [NSMutableArray arrayWithCapacity:_gridColumns*_gridRows];
+   u_long i;
+
+   [super encodeWithCoder:encoder];
+
+   [encoder encodePoint:_gridOrigin forKey:K_GRID_ORIGIN_KEY];
+   [encoder encodeSize:_gridStep forKey:K_GRID_STEP_KEY];
+   [encoder encodeInt:_gridColumns forKey:K_GRID_COLUMNS_KEY];
+   [encoder encodeInt:_gridRows forKey:K_GRID_ROWS_KEY];
+   for( i = 0; i < _gridColumns*_gridRows; i++ )
+      [field addObject:NSStringFromPoint(_displacements[i])];
+   [encoder encodeObject:field forKey:K_GRID_DISPLACEMENTS_KEY];
+}
+
+- (id) initWithCoder:(NSCoder *)decoder
+{
+   self = [super initWithCoder:decoder];
+
+   if ( self != nil && [decoder containsValueForKey:K_GRID_DISPLACEMENTS_KEY] )
+   {
+      NSArray *field = [decoder decodeObjectForKey:K_GRID_DISPLACEMENTS_KEY];
+      u_long i;
+
+      _gridOrigin = [decoder decodePointForKey:K_GRID_ORIGIN_KEY];
+      _gridStep = [decoder decodeSizeForKey:K_GRID_STEP_KEY];
+      _gridColumns = [decoder decodeIntForKey:K_GRID_COLUMNS_KEY];
+      _gridRows = [decoder decodeIntForKey:K_GRID_ROWS_KEY];
+
+      if ( [field count] == (u_long)_gridColumns*_gridRows && [field count] != 0 )
+      {
+         _displacements = (NSPoint*)malloc( [field count]*sizeof(NSPoint) );
+         for( i = 0; i < [field count]; i++ )
+            _displacements[i] = NSPointFromString([field objectAtIndex:i]);
+      }
+      else
+      {
+         NSLog( @"Inconsistent multi-point alignment, using the global offset" );
+         _gridColumns = 0;
+         _gridRows = 0;
+      }
+   }
+
+   return( self );
+}
+@end
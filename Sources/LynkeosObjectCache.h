@@ -55,6 +55,7 @@ typedef enum
    u_long               _capacity;     //!< Maximum number or size
    u_long               _size;         //!< Current size
    u_short              _policy;       //!< Refresh policy
+   NSLock              *_lock;         //!< The prefetcher also fills it
 }
 
 /*!
@@ -104,6 +105,8 @@ typedef enum
 
 /*!
  * @abstract Retrieve an object from the cache
+ * @discussion The object is retained and autoreleased, so that it stays valid
+ *    if another thread deletes it from the cache.
  * @param key the key for this object
  * @result The object it it was found in the cache, nil otherwise
  */
@@ -114,6 +117,11 @@ typedef enum
  * @param capacity The new size
  */
 - (void) setCapacity:(u_long)capacity ;
+
+/*!
+ * @abstract The maximum number or size of the objects in the cache
+ */
+- (u_long) capacity ;
 @end
 
 #endif
\ No newline at end of file
@@ -98,6 +98,7 @@ static LynkeosObjectCache *imageProcessingCache = nil;
       _capacity = capacity;
       _policy = policy;
       _size = 0;
+      _lock = [[NSLock alloc] init];
    }
 
    return( self );
@@ -107,6 +108,7 @@ static LynkeosObjectCache *imageProcessingCache = nil;
 {
    [_cacheDict release];
    [_keyAge release];
+   [_lock release];
 
    [super dealloc];
 }
@@ -119,6 +121,8 @@ static LynkeosObjectCache *imageProcessingCache = nil;
       NSAssert( [obj conformsToProtocol:@protocol(LynkeosImageBuffer)],
                 @"Inconsistent object for memory size cache strategy" );
 
+   [_lock lock];
+
    // Put the object in the dictionary
    [_cacheDict setObject:obj forKey:key];
 
@@ -146,12 +150,18 @@ static LynkeosObjectCache *imageProcessingCache = nil;
          [_keyAge removeObjectAtIndex:keyIdx];
       }
    }
+
+   [_lock unlock];
 }
 
 - (NSObject*) getObjectForKey:(id)key
 {
+   NSObject *obj;
+
+   [_lock lock];
+
    // Find the object if still in the cache
-   NSObject *obj = [_cacheDict objectForKey:key];
+   obj = [[[_cacheDict objectForKey:key] retain] autorelease];
 
    // Change keys order according to policy
    if ( obj != nil && (_policy & ReadRefresh) )
@@ -161,14 +171,22 @@ static LynkeosObjectCache *imageProcessingCache = nil;
       [_keyAge removeObjectAtIndex:keyIdx];
    }
 
+   [_lock unlock];
+
    return( obj );
 }
 
 - (void) setCapacity:(u_long)capacity
 {
+   [_lock lock];
+
    _capacity = capacity;
 
    // Delete now obsolete object
    [self adjustCacheSize];
+
+   [_lock unlock];
 }
+
+- (u_long) capacity { return( _capacity ); }
 @end
@@ -602,9 +602,10 @@ extern NSString * const LynkeosDataModeChangeNotification;
  */
 typedef enum
 {
-   NoParallelOptimization = 0,   //!< No optimisation at all
-   FFTW3ThreadsOptimization = 1, //!< Use FFTW3 threading
-   ListThreadsOptimizations = 2  //!< Use list processing threading
+   NoParallelOptimization = 0,     //!< No optimisation at all
+   FFTW3ThreadsOptimization = 1,   //!< Use FFTW3 threading
+   ListThreadsOptimizations = 2,   //!< Use list processing threading
+   ImageOperatorsOptimization = 4  //!< Use parallelized image operators
 } ParallelOptimization_t;
 
 /*!
@@ -617,6 +618,44 @@ typedef enum
 - (oneway void) itemWasProcessed:(id <LynkeosProcessableItem>)item;
 @end
 
+/*!
+ * @abstract Reserve the CPUs for the list threads of a new processing
+ * @discussion The CPUs are shared between all the list threads running, and
+ *    the threads used inside the processing of one item (FFTW and parallelized
+ *    image operators) get what remains. The reservation is released by each
+ *    list thread, with cpuBudgetLeaveListThread.
+ * @param optim The optimizations supported by the processing class
+ * @result The number of list threads to start
+ * @ingroup Processing
+ */
+extern u_short cpuBudgetStartListThreads( ParallelOptimization_t optim );
+
+/*!
+ * @abstract Register the current thread as a list thread
+ * @param optim The optimizations supported by its processing class
+ * @ingroup Processing
+ */
+extern void cpuBudgetEnterListThread( ParallelOptimization_t optim );
+
+/*!
+ * @abstract Release the CPU reserved for the current list thread
+ * @discussion It is called before the end of processing, so that the last
+ *    thread gets all the CPUs for finishing the job.
+ * @ingroup Processing
+ */
+extern void cpuBudgetLeaveListThread( void );
+
+/*!
+ * @abstract Number of threads the current thread may use inside an item
+ * @discussion A list thread gets only one if its processing class does not
+ *    support this kind of optimization. Any other thread (ie: the main thread)
+ *    gets the same share as a list thread.
+ * @param kind The kind of item level optimization
+ * @result The number of threads, at least one
+ * @ingroup Processing
+ */
+extern u_short cpuBudgetForItem( ParallelOptimization_t kind );
+
 /*!
  * @abstract Common protocol for all processing classes.
  * @discussion The class will be instantiated in a thread by 
@@ -665,4 +704,30 @@ typedef enum
 
 @end
 
+/*!
+ * @abstract Processing classes which samples can be read ahead
+ * @discussion When the processing class also conforms to this protocol, the
+ *    list processing is executed as a pipeline : reader threads read and
+ *    calibrate the sample of each item, while the processing threads work on
+ *    the items already read. The processing gets the prepared sample without
+ *    any I/O, when it calls getImageSample:inRect: with the same rectangle.
+ * @ingroup Processing
+ */
+@protocol LynkeosPipelinedProcessing <LynkeosProcessing>
+
+/*!
+ * @abstract The sample which will be read in an item, when processing it
+ * @discussion This method is called in the reader threads. It shall only read
+ *    the item and the processing parameters.
+ * @param rect The sample rectangle, in bitmap coordinates
+ * @param item The item which will be processed
+ * @param params The parameters given to the processing initialization
+ * @result NO if the sample cannot be known in advance for that item
+ */
++ (BOOL) sampleRectangle:(LynkeosIntegerRect*)rect
+                 forItem:(id <LynkeosProcessableItem>)item
+              parameters:(id <NSObject>)params ;
+
+@end
+
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun Mar 20 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+/*!
+ * @header
+ * @abstract Alignment result class with rotation and scale
+ */
+#ifndef __LYNKEOSROTATIONALIGNRESULT_H
+#define __LYNKEOSROTATIONALIGNRESULT_H
+
+#import <Foundation/Foundation.h>
+
+#include "LynkeosCore/LynkeosBasicAlignResult.h"
+
+/*!
+ * @abstract Alignment result for a rotated (and scaled) image
+ * @discussion The point of the reference image P is found in the image at
+ *    C + s.R(a).(P - offset - C), where C is the rotation center, a the
+ *    rotation angle and s the scale.
+ */
+@interface LynkeosRotationAlignResult : LynkeosBasicAlignResult
+{
+@public
+   NSPoint          _center;        //!< Rotation center, in image coordinates
+   double           _rotation;      //!< Rotation angle in radians
+   double           _scale;         //!< Scale factor
+}
+@end
+
+#endif
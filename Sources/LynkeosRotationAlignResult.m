@@ -0,0 +1,86 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun Mar 20 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "LynkeosRotationAlignResult.h"
+
+#define K_ROTATION_CENTER_KEY @"rotcenter" ///< Key for saving the center
+#define K_ROTATION_ANGLE_KEY  @"rotation"  ///< Key for saving the angle
+#define K_SCALE_KEY           @"scale"     ///< Key for saving the scale
+
+@implementation LynkeosRotationAlignResult
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _center = NSMakePoint(0.0, 0.0);
+      _rotation = 0.0;
+      _scale = 1.0;
+   }
+
+   return( self );
+}
+
+- (NSAffineTransform*) alignTransform
+{
+   // Inverse of the image transform, to display the image as the reference
+   NSAffineTransform *tr = [NSAffineTransform transform];
+   [tr translateXBy:_center.x + _alignOffset.x yBy:_center.y + _alignOffset.y];
+   [tr rotateByRadians:-_rotation];
+   [tr scaleBy:1.0/_scale];
+   [tr translateXBy:-_center.x yBy:-_center.y];
+
+   return( tr );
+}
+
+- (NSPoint) correctedCoordinatesFor:(NSPoint)source
+{
+   const double c = cos(_rotation)*_scale, s = sin(_rotation)*_scale;
+   const double dx = source.x - _alignOffset.x - _center.x,
+                dy = source.y - _alignOffset.y - _center.y;
+   NSPoint p = { _center.x + c*dx - s*dy, _center.y + s*dx + c*dy };
+
+   return( p );
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+   [super encodeWithCoder:encoder];
+
+   [encoder encodePoint:_center forKey:K_ROTATION_CENTER_KEY];
+   [encoder encodeDouble:_rotation forKey:K_ROTATION_ANGLE_KEY];
+   [encoder encodeDouble:_scale forKey:K_SCALE_KEY];
+}
+
+- (id) initWithCoder:(NSCoder *)decoder
+{
+   self = [super initWithCoder:decoder];
+
+   if ( self != nil && [decoder containsValueForKey:K_ROTATION_ANGLE_KEY] )
+   {
+      _center = [decoder decodePointForKey:K_ROTATION_CENTER_KEY];
+      _rotation = [decoder decodeDoubleForKey:K_ROTATION_ANGLE_KEY];
+      _scale = [decoder decodeDoubleForKey:K_SCALE_KEY];
+   }
+
+   return( self );
+}
+@end
@@ -50,6 +50,12 @@ typedef union
    LynkeosStandardImageBuffer *term; //!< When operator acts on an image
    float  fscalar;         //!< When operator acts on a single precision scalar
    double dscalar;         //!< When operator acts on a double precision scalar
+   //! When operator acts on an image weighted by a scalar
+   struct
+   {
+      LynkeosStandardImageBuffer *term; //!< The image
+      double                     weight; //!< Its weight
+   } weighted;
 } ArithmeticOperand_t;
 
 /*!
@@ -86,6 +92,10 @@ typedef void(*ImageProcessOneLine_t)(LynkeosStandardImageBuffer*,
    ImageProcessOneLine_t _scale_one_image_line;
    //! Strategy method for dividing a line, with vectorization, or not
    ImageProcessOneLine_t _div_one_image_line;
+   //! Strategy method for adding a line, with vectorization, or not
+   ImageProcessOneLine_t _add_one_image_line;
+   //! Strategy method for a weighted add of a line, with vectorization, or not
+   ImageProcessOneLine_t _wadd_one_image_line;
    //! Strategy method for processing an image, actually for debug
    SEL     _process_image_selector;
    //! Strategy method for processing an image, func pointer which is called
@@ -198,6 +208,20 @@ typedef void(*ImageProcessOneLine_t)(LynkeosStandardImageBuffer*,
                                withOffsets:(const NSPoint*)offsets 
                                withExpansion:(u_short)expand;
 
+/*!
+ * @abstract Shifts another image and add it to this one with a weight
+ * @discussion The weight is applied while shifting, in the same pass.
+ * @param image The other image to add
+ * @param offsets An array of offsets (one per plane) expressed in the 
+ *   coordinate system of "image".
+ * @param expand The pixel expansion of the resulting image
+ * @param weight The factor applied to the other image values
+ */
+- (void) add:(LynkeosStandardImageBuffer*)image
+                               withOffsets:(const NSPoint*)offsets 
+                               withExpansion:(u_short)expand
+                                    weight:(REAL)weight ;
+
 /*!
  * @abstract Multiplication
  * @discussion Term shall either have the same number of planes as the receiver
@@ -226,6 +250,39 @@ typedef void(*ImageProcessOneLine_t)(LynkeosStandardImageBuffer*,
 - (void) divideBy:(LynkeosStandardImageBuffer*)denom
                                result:(LynkeosStandardImageBuffer*)result ;
 
+/*!
+ * @abstract Addition
+ * @discussion term shall either have the same number of planes as the receiver
+ *    or only one plane. In the latter case, the plane is added to each planes
+ *    of the receiver.
+ * @param term other term
+ * @param result where the result is stored, can be one of the terms
+ */
+- (void) add:(LynkeosStandardImageBuffer*)term
+                               result:(LynkeosStandardImageBuffer*)result ;
+
+/*!
+ * @abstract Weighted addition
+ * @discussion The term is multiplied by the weight while it is added, it shall
+ *    have the same number of planes as the receiver or only one plane.
+ * @param term other term
+ * @param weight the factor applied to term
+ * @param result where the result is stored, can be one of the terms
+ */
+- (void) add:(LynkeosStandardImageBuffer*)term
+                               weight:(double)weight
+                               result:(LynkeosStandardImageBuffer*)result ;
+
+/*!
+ * @abstract Pixel by pixel maximum or minimum of two images
+ * @param term other term, with the same number of planes
+ * @param result where the result is stored, can be one of the terms
+ * @param maximum Whether to keep the maximum or the minimum
+ */
+- (void) extremumWith:(LynkeosStandardImageBuffer*)term
+                               result:(LynkeosStandardImageBuffer*)result
+                              maximum:(BOOL)maximum ;
+
 /*!
  * @abstract Convenience empty image buffer creator
  * @param nPlanes Number of color planes for this image
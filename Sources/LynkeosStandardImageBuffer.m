@@ -311,6 +311,147 @@ static void std_image_div_one_line(LynkeosStandardImageBuffer *a,
       }
 }
 
+/*!
+ * @abstract Add method for strategy "without vectors"
+ */
+static void std_image_add_one_line(LynkeosStandardImageBuffer *a,
+                                   ArithmeticOperand_t b,
+                                   LynkeosStandardImageBuffer *res,
+                                   u_short y )
+{
+   u_short x, c, ct;
+
+   for( x = 0; x < a->_w; x++ )
+      for( c = 0; c < a->_nPlanes; c++ )
+      {
+         if ( b.term->_nPlanes == 1 )
+            ct = 0;
+         else
+            ct = c;
+         REAL r = colorValue(a,x,y,c) + colorValue(b.term,x,y,ct);
+         colorValue(res,x,y,c) = r;
+      }
+}
+
+#if !defined(DOUBLE_PIXELS) || defined(__i386__)
+/*!
+ * @abstract Add method for strategy "with vectors"
+ */
+static void vect_image_add_one_line(LynkeosStandardImageBuffer *a,
+                                    ArithmeticOperand_t b,
+                                    LynkeosStandardImageBuffer *res,
+                                    u_short y )
+{
+   u_short x, c, ct;
+
+   for( x = 0; x < a->_w; x += 4 )
+   {
+      for( c = 0; c < a->_nPlanes; c++ )
+      {
+         REALVECT r = *((REALVECT*)&colorValue(a,x,y,c));
+
+         if ( b.term->_nPlanes == 1 )
+            ct = 0;
+         else
+            ct = c;
+
+         r += *((REALVECT*)&colorValue(b.term,x,y,ct));
+         *((REALVECT*)&colorValue(res,x,y,c)) = r;
+      }
+   }
+}
+#endif
+
+/*!
+ * @abstract Weighted add method for strategy "without vectors"
+ */
+static void std_image_wadd_one_line(LynkeosStandardImageBuffer *a,
+                                    ArithmeticOperand_t b,
+                                    LynkeosStandardImageBuffer *res,
+                                    u_short y )
+{
+   const REAL w = b.weighted.weight;
+   u_short x, c, ct;
+
+   for( x = 0; x < a->_w; x++ )
+      for( c = 0; c < a->_nPlanes; c++ )
+      {
+         if ( b.weighted.term->_nPlanes == 1 )
+            ct = 0;
+         else
+            ct = c;
+         REAL r = colorValue(a,x,y,c) + w*colorValue(b.weighted.term,x,y,ct);
+         colorValue(res,x,y,c) = r;
+      }
+}
+
+#if !defined(DOUBLE_PIXELS) || defined(__i386__)
+/*!
+ * @abstract Weighted add method for strategy "with vectors"
+ */
+static void vect_image_wadd_one_line(LynkeosStandardImageBuffer *a,
+                                     ArithmeticOperand_t b,
+                                     LynkeosStandardImageBuffer *res,
+                                     u_short y )
+{
+   const REAL s = b.weighted.weight;
+   const REALVECT w = { s, s, s, s };
+   u_short x, c, ct;
+
+   for( x = 0; x < a->_w; x += 4 )
+   {
+      for( c = 0; c < a->_nPlanes; c++ )
+      {
+         REALVECT r = *((REALVECT*)&colorValue(a,x,y,c));
+
+         if ( b.weighted.term->_nPlanes == 1 )
+            ct = 0;
+         else
+            ct = c;
+
+         r += w * *((REALVECT*)&colorValue(b.weighted.term,x,y,ct));
+         *((REALVECT*)&colorValue(res,x,y,c)) = r;
+      }
+   }
+}
+#endif
+
+/*!
+ * @abstract Maximum method
+ */
+static void std_image_max_one_line(LynkeosStandardImageBuffer *a,
+                                   ArithmeticOperand_t b,
+                                   LynkeosStandardImageBuffer *res,
+                                   u_short y )
+{
+   u_short x, c;
+
+   for( x = 0; x < a->_w; x++ )
+      for( c = 0; c < a->_nPlanes; c++ )
+      {
+         REAL u = colorValue(a,x,y,c), v = colorValue(b.term,x,y,c);
+         colorValue(res,x,y,c) = ( u > v ? u : v );
+      }
+}
+
+/*!
+ * @abstract Minimum method
+ */
+static void std_image_min_one_line(LynkeosStandardImageBuffer *a,
+                                   ArithmeticOperand_t b,
+                                   LynkeosStandardImageBuffer *res,
+                                   u_short y )
+{
+   u_short x, c;
+
+   for( x = 0; x < a->_w; x++ )
+      for( c = 0; c < a->_nPlanes; c++ )
+      {
+         REAL u = colorValue(a,x,y,c), v = colorValue(b.term,x,y,c);
+         colorValue(res,x,y,c) = ( u < v ? u : v );
+      }
+}
+
 /*!
  * @abstract Phases of the parallel processing for the lock condition
  */
@@ -336,6 +477,7 @@ typedef enum
                          LynkeosStandardImageBuffer*,
                          u_short);
    NSConditionLock *lock;           //!< Exclusive access to this object
+   u_short nThreads;                //!< Number of threads sharing the lines
    u_short startedThreads;         //!< Total number of started threads
    u_short livingThreads;         //!< Number of still living threads
 }
@@ -349,8 +491,10 @@ typedef enum
  * @abstract Stacks one color plane
  * @param plane The color plane to stack
  * @param image The image to add to ourselves
+ * @param k Factor applied to the image values
  */
-- (void) stackPlane:(u_short)plane fromImage:(LynkeosStandardImageBuffer*)image ;
+- (void) stackPlane:(u_short)plane fromImage:(LynkeosStandardImageBuffer*)image
+             weight:(REAL)k ;
 
 /*!
  * @abstract Stacks one color plane with an image shift
@@ -358,15 +502,18 @@ typedef enum
  * @param image The image to add to ourselves
  * @param offset Offset applied to the other image before adding.
  * @param expand The pixel expansion factor
+ * @param k Factor applied to the image values
  */
 - (void) stackPlane:(u_short)plane fromImage:(LynkeosStandardImageBuffer*)image 
-         withOffset:(NSPoint)offset withExpansion:(u_short)expand ;
+         withOffset:(NSPoint)offset withExpansion:(u_short)expand
+             weight:(REAL)k ;
 
 /*!
  * @abstract Stack the plane 0 of the argument image into our luminance channel
  * @param image The image to add to ourselves
+ * @param k Factor applied to the image values
  */
-- (void) stackLRGBfromImage:(LynkeosStandardImageBuffer*)image ;
+- (void) stackLRGBfromImage:(LynkeosStandardImageBuffer*)image weight:(REAL)k ;
 
 /*!
  * @abstract Stack the plane 0 of the argument image with a shift into our 
@@ -374,9 +521,11 @@ typedef enum
  * @param image The image to add to ourselves
  * @param offset Offset applied to the other image before adding.
  * @param expand The pixel expansion factor
+ * @param k Factor applied to the image values
  */
 - (void) stackLRGBfromImage:(LynkeosStandardImageBuffer*)image
-                 withOffset:(NSPoint)offset withExpansion:(u_short)expand;
+                 withOffset:(NSPoint)offset withExpansion:(u_short)expand
+                     weight:(REAL)k ;
 
 /*!
  * @abstract "Shared" multiply method
@@ -418,10 +567,11 @@ typedef enum
  * Both layers are required to have the same size.
  */
 - (void) stackPlane:(u_short)plane fromImage:(LynkeosStandardImageBuffer*)image
+             weight:(REAL)k
 {
    u_short x, y;
 
-   ADD_RGB( colorValue(image,x,y,plane) );
+   ADD_RGB( k*colorValue(image,x,y,plane) );
 }
 
 /*!
@@ -431,6 +581,7 @@ typedef enum
  */
 - (void) stackPlane:(u_short)plane fromImage:(LynkeosStandardImageBuffer*)image 
          withOffset:(NSPoint)offset withExpansion:(u_short)expand
+             weight:(REAL)k
 {
    short i_dx, i_dy;
    REAL f_dx, f_dy;
@@ -441,8 +592,8 @@ typedef enum
    weight = getWeights( expand, f_dx, f_dy );
 
    /* Add the layer with the shift */
-   ADD_RGB( shiftedPixelValue( image, plane, expand,
-                               x - i_dx, y - i_dy, weight ) );
+   ADD_RGB( k*shiftedPixelValue( image, plane, expand,
+                                 x - i_dx, y - i_dy, weight ) );
 }
 
 /*! Macro for the common part of the add routines. */
@@ -466,19 +617,19 @@ typedef enum
 /*!
  * Both layers are required to have the same size.
  */
-- (void) stackLRGBfromImage:(LynkeosStandardImageBuffer*)image
+- (void) stackLRGBfromImage:(LynkeosStandardImageBuffer*)image weight:(REAL)k
 {
    u_short x, y;
 
    /* Add the monochrome layer */
-   ADD_LRGB( colorValue(image,x, y,0) );
+   ADD_LRGB( k*colorValue(image,x, y,0) );
 }
 
 /*!
  * Both layers are required to have the same size.
  */
 - (void) stackLRGBfromImage:(LynkeosStandardImageBuffer*)image withOffset:(NSPoint)offset 
-              withExpansion:(u_short)expand
+              withExpansion:(u_short)expand weight:(REAL)k
 {
    short i_dx, i_dy;
    REAL f_dx, f_dy;
@@ -489,8 +640,8 @@ typedef enum
    weight = getWeights( expand, f_dx, f_dy );
 
    /* Add the monochrome layer with the shift */
-   ADD_LRGB( shiftedPixelValue( image, 0, expand, 
-                                x - i_dx, y - i_dy, weight ) );
+   ADD_LRGB( k*shiftedPixelValue( image, 0, expand, 
+                                  x - i_dx, y - i_dy, weight ) );
 }
 
 - (void) one_thread_process_image:(id)arg
@@ -502,12 +653,12 @@ typedef enum
    [args->lock lock];
    ourY = *(args->y);
    (*(args->y))++;
-   if ( args->startedThreads < numberOfCpus )
+   if ( args->startedThreads < args->nThreads )
       args->startedThreads++;
    else
       NSLog( @"Too much thread start in one_thread_process_image" );
    args->livingThreads++;
-   if ( args->startedThreads == numberOfCpus )
+   if ( args->startedThreads == args->nThreads )
       [args->lock unlockWithCondition:OperationStarted];
    else
       [args->lock unlock];
@@ -557,22 +708,32 @@ typedef enum
                                          LynkeosStandardImageBuffer*,
                                          u_short))processOneLine
 {
-   NSConditionLock *lock =
-                    [[NSConditionLock alloc] initWithCondition:OperationInited];
+   const u_short nThreads = cpuBudgetForItem( ImageOperatorsOptimization );
+   NSConditionLock *lock;
    u_short y = 0;
-   ParallelImageMultiplyArgs *args = [[ParallelImageMultiplyArgs alloc] init];
+   ParallelImageMultiplyArgs *args;
    int i;
 
+   // No need for threads if the CPUs are already busy
+   if ( nThreads <= 1 )
+   {
+      [self std_image_process:term result:res processOneLine:processOneLine];
+      return;
+   }
+
+   lock = [[NSConditionLock alloc] initWithCondition:OperationInited];
+   args = [[ParallelImageMultiplyArgs alloc] init];
    args->op = term;
    args->res = res;
    args->y = &y;
    args->lock = lock;
    args->processOneLine = processOneLine;
+   args->nThreads = nThreads;
    args->startedThreads = 0;
    args->livingThreads = 0;
 
    // Start a thread for each "other processor"
-   for( i =  1; i < numberOfCpus; i++ )
+   for( i =  1; i < nThreads; i++ )
       [NSThread detachNewThreadSelector:@selector(one_thread_process_image:)
                                toTarget:self
                              withObject:args];
@@ -608,11 +769,15 @@ typedef enum
       {
          _mul_one_image_line = vect_image_mul_one_line;
          _scale_one_image_line = vect_image_scale_one_line;
+         _add_one_image_line = vect_image_add_one_line;
+         _wadd_one_image_line = vect_image_wadd_one_line;
       }
       else
       {
          _mul_one_image_line = std_image_mul_one_line;
          _scale_one_image_line = std_image_scale_one_line;
+         _add_one_image_line = std_image_add_one_line;
+         _wadd_one_image_line = std_image_wadd_one_line;
       }
       _div_one_image_line = std_image_div_one_line;
 
@@ -682,6 +847,8 @@ typedef enum
       {
          _mul_one_image_line = std_image_mul_one_line;
          _scale_one_image_line = std_image_scale_one_line;
+         _add_one_image_line = std_image_add_one_line;
+         _wadd_one_image_line = std_image_wadd_one_line;
       }
 
       for( c = 0; c < nPlanes; c++ )
@@ -1007,6 +1174,14 @@ typedef enum
 - (void) add:(LynkeosStandardImageBuffer*)image
             withOffsets:(const NSPoint*)offsets 
           withExpansion:(u_short)expand
+{
+   [self add:image withOffsets:offsets withExpansion:expand weight:1.0];
+}
+
+- (void) add:(LynkeosStandardImageBuffer*)image
+            withOffsets:(const NSPoint*)offsets 
+          withExpansion:(u_short)expand
+                 weight:(REAL)weight
 {
    NSAssert( expand != 0, @"Illegal expansion factor" );
    NSAssert( _w == image->_w*expand && _h == image->_h*expand, 
@@ -1023,10 +1198,10 @@ typedef enum
       {
          if ( offsets[plane].x == 0.0 && offsets[plane].y == 0.0 
               && expand == 1 )
-            [self stackPlane:plane fromImage:image];
+            [self stackPlane:plane fromImage:image weight:weight];
          else
             [self stackPlane:plane fromImage:image withOffset:offsets[plane]
-                  withExpansion:expand];
+                  withExpansion:expand weight:weight];
       }
    }
    else
@@ -1036,10 +1211,10 @@ typedef enum
       {
          if ( offsets[0].x == 0.0 && offsets[0].y == 0.0 
               && expand == 1 )
-            [self stackLRGBfromImage:image];
+            [self stackLRGBfromImage:image weight:weight];
          else
             [self stackLRGBfromImage:image withOffset:offsets[0] 
-                  withExpansion:expand];
+                  withExpansion:expand weight:weight];
       }
 
       else
@@ -1066,15 +1241,15 @@ typedef enum
          {
             if ( offsets[plane].x == 0.0 && offsets[plane].y == 0.0
                  && expand == 1 )
-               [self stackPlane:plane fromImage:image];
+               [self stackPlane:plane fromImage:image weight:weight];
             else
                [self stackPlane:plane fromImage:image 
                      withOffset:offsets[plane]
-                     withExpansion:expand];
+                     withExpansion:expand weight:weight];
          }
 
          // And add the former (ourself) monochrome image with no offset
-         [self stackLRGBfromImage:monoImage];
+         [self stackLRGBfromImage:monoImage weight:1.0];
       }
    }
 }
@@ -1123,6 +1298,55 @@ typedef enum
                   _div_one_image_line );
 }
 
+- (void) add:(LynkeosStandardImageBuffer*)term
+      result:(LynkeosStandardImageBuffer*)result
+{
+   NSAssert( (_nPlanes == term->_nPlanes || term->_nPlanes == 1)
+            && _nPlanes == result->_nPlanes 
+            && _w == term->_w && _h == term->_h
+            && _w == result->_w && _h == result->_h,
+            @"Incompatible terms in addition" );
+   ArithmeticOperand_t op = { .term=term };
+
+   [self resetMinMax];
+   _process_image( self, _process_image_selector, op, result,
+                  _add_one_image_line );
+}
+
+- (void) add:(LynkeosStandardImageBuffer*)term
+      weight:(double)weight
+      result:(LynkeosStandardImageBuffer*)result
+{
+   NSAssert( (_nPlanes == term->_nPlanes || term->_nPlanes == 1)
+            && _nPlanes == result->_nPlanes 
+            && _w == term->_w && _h == term->_h
+            && _w == result->_w && _h == result->_h,
+            @"Incompatible terms in weighted addition" );
+   ArithmeticOperand_t op;
+
+   op.weighted.term = term;
+   op.weighted.weight = weight;
+
+   [self resetMinMax];
+   _process_image( self, _process_image_selector, op, result,
+                  _wadd_one_image_line );
+}
+
+- (void) extremumWith:(LynkeosStandardImageBuffer*)term
+               result:(LynkeosStandardImageBuffer*)result
+              maximum:(BOOL)maximum
+{
+   NSAssert( _nPlanes == term->_nPlanes && _nPlanes == result->_nPlanes 
+            && _w == term->_w && _h == term->_h
+            && _w == result->_w && _h == result->_h,
+            @"Incompatible terms in extremum" );
+   ArithmeticOperand_t op = { .term=term };
+
+   [self resetMinMax];
+   _process_image( self, _process_image_selector, op, result,
+                  (maximum ? std_image_max_one_line : std_image_min_one_line) );
+}
+
 
 - (void) calibrateWithDarkFrame:(id <LynkeosImageBuffer>)darkFrame
                       flatField:(id <LynkeosImageBuffer>)flatField
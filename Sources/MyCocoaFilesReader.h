@@ -60,7 +60,7 @@
  * @abstract Class for reading QuickTime movie files.
  * @ingroup FileAccess
  */
-@interface MyQuickTimeReader : NSObject <LynkeosMovieFileReader>
+@interface MyQuickTimeReader : NSObject <LynkeosPrefetchingMovieReader>
 {
 @private
    QTMovie          *_movie;           //!< The movie being read
@@ -523,6 +523,17 @@ static void getImageSample( void * const * const sample,
    return( _imageNumber );
 }
 
+- (void) prefetchFrameAtIndex:(u_long)index
+{
+   // Without a cache, the decoded frame would be lost
+   if ( [LynkeosObjectCache movieCache] == nil )
+      return;
+
+   [_qtLock lock];
+   CVPixelBufferRelease( [self getPixelBufferAtIndex:index] );
+   [_qtLock unlock];
+}
+
 - (NSImage*) getNSImageAtIndex:(u_long)index
 {
    // Quicktime operations are not thread safe
@@ -0,0 +1,73 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun Apr 24 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+/*!
+ * @header
+ * @abstract Definitions for the capture directory watcher
+ */
+#ifndef __MYDIRECTORYWATCHER_H
+#define __MYDIRECTORYWATCHER_H
+
+#import <Foundation/Foundation.h>
+
+/*!
+ * @class MyDirectoryWatcher
+ * @abstract Watcher of the files written in a directory
+ * @discussion The directory is polled, which works the same with every
+ *    file system. A file is considered complete when its size and modification
+ *    date did not change between two polls ; it is then reported only once.
+ * @ingroup Models
+ */
+@interface MyDirectoryWatcher : NSObject
+{
+   NSString*            _path;       //!< Watched directory
+   NSSet*               _fileTypes;  //!< Lower case extensions to report
+   //! Size and date of the files not yet complete, keyed by name
+   NSMutableDictionary* _pending;
+   NSMutableSet*        _reported;   //!< Names of the files already reported
+}
+
+/*!
+ * @abstract Initialize a watcher
+ * @param path The directory to watch
+ * @param types The file extensions to report, nil for any file
+ * @result The initialized watcher
+ */
+- (id) initWithPath:(NSString*)path fileTypes:(NSArray*)types ;
+
+/*!
+ * @abstract The watched directory
+ */
+- (NSString*) path ;
+
+/*!
+ * @abstract Poll the directory
+ * @discussion The files already present when the watcher was created are
+ *    also reported, once complete.
+ * @result The full paths of the files completed since the previous poll,
+ *    sorted by name
+ */
+- (NSArray*) pollCompletedFiles ;
+
+@end
+
+#endif
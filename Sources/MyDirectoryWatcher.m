@@ -0,0 +1,131 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun Apr 24 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "MyDirectoryWatcher.h"
+
+@implementation MyDirectoryWatcher
+
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _path = nil;
+      _fileTypes = nil;
+      _pending = [[NSMutableDictionary alloc] init];
+      _reported = [[NSMutableSet alloc] init];
+   }
+
+   return( self );
+}
+
+- (id) initWithPath:(NSString*)path fileTypes:(NSArray*)types
+{
+   if ( (self = [self init]) != nil )
+   {
+      _path = [path retain];
+
+      if ( types != nil )
+      {
+         NSMutableSet *set = [NSMutableSet setWithCapacity:[types count]];
+         NSEnumerator *list = [types objectEnumerator];
+         NSString *type;
+
+         while ( (type = [list nextObject]) != nil )
+            [set addObject:[type lowercaseString]];
+         _fileTypes = [set retain];
+      }
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   [_path release];
+   if ( _fileTypes != nil )
+      [_fileTypes release];
+   [_pending release];
+   [_reported release];
+
+   [super dealloc];
+}
+
+- (NSString*) path { return( _path ); }
+
+- (NSArray*) pollCompletedFiles
+{
+   NSFileManager *fMgr = [NSFileManager defaultManager];
+   NSArray *contents = [fMgr directoryContentsAtPath:_path];
+   NSMutableArray *complete = [NSMutableArray array];
+   NSMutableDictionary *stillPending = [NSMutableDictionary dictionary];
+   NSEnumerator *list;
+   NSString *name;
+
+   if ( contents == nil )
+   {
+      NSLog( @"Cannot read the watched directory %@", _path );
+      return( complete );
+   }
+
+   list = [[contents sortedArrayUsingSelector:@selector(compare:)]
+                                                              objectEnumerator];
+   while ( (name = [list nextObject]) != nil )
+   {
+      NSString *file = [_path stringByAppendingPathComponent:name];
+      NSDictionary *attr;
+      NSArray *state, *previous;
+
+      if ( [_reported containsObject:name]
+           || [name hasPrefix:@"."]
+           || ( _fileTypes != nil
+                && ![_fileTypes containsObject:
+                                       [[name pathExtension] lowercaseString]] ) )
+         continue;
+
+      attr = [fMgr fileAttributesAtPath:file traverseLink:YES];
+      if ( attr == nil
+           || ![[attr fileType] isEqualToString:NSFileTypeRegular]
+           || [attr fileSize] == 0 )
+         continue;
+
+      // The file is complete when it did not change since the previous poll
+      state = [NSArray arrayWithObjects:
+                          [NSNumber numberWithUnsignedLongLong:[attr fileSize]],
+                          [attr fileModificationDate],
+                          nil];
+      previous = [_pending objectForKey:name];
+      if ( previous != nil && [previous isEqualToArray:state] )
+      {
+         [complete addObject:file];
+         [_reported addObject:name];
+      }
+      else
+         [stillPending setObject:state forKey:name];
+   }
+
+   // Forget the files which disappeared
+   [_pending setDictionary:stillPending];
+
+   return( complete );
+}
+
+@end
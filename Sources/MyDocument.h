@@ -41,7 +41,9 @@
 #include "MyImageList.h"
 #include "MyCalibrationLock.h"
 #include "MyProcessingThread.h"
+#include "MyProcessingPipeline.h"
 #include "ProcessStackManager.h"
+#include "MyDirectoryWatcher.h"
 
 /*!
  * @abstract The document controler
@@ -67,6 +69,9 @@
 
    // Multithread control
    NSMutableArray      *_threads;         //!< Living threads
+   MyItemQueue         *_itemQueue;       //!< Items of the list processing
+   //! Reader stage of the list processing, if it reads ahead
+   MyProcessingPipeline *_pipeline;
    Class               _currentProcessingClass; //!< What processing is running
    //! Item being processed, nil if it is a list processing
    id <LynkeosProcessableItem> _processedItem;
@@ -76,6 +81,12 @@
    NSEnumerator         *_initialProcessEnum;
    BOOL                 _isInitialProcessing;
 
+   // Live stacking
+   MyDirectoryWatcher   *_liveWatcher;    //!< Capture directory, if live
+   NSTimer              *_liveTimer;      //!< Throttles the live updates
+   //! Items added by the live stacking, and not yet aligned
+   NSMutableArray       *_liveItems;
+
 #if !defined GNUSTEP
    io_connect_t         _rootPort;        //!< Sleep control
 #endif
@@ -132,6 +143,40 @@
  * @param obj The proxy for the thread that is ending.
  */
 - (void) processEnded: (id)obj ;
+
+/*!
+ * @abstract Signals that several items were used in the process
+ * @discussion This is the coalesced form of itemWasProcessed, sent by the
+ *    processing threads. A notification is posted for each item, in order.
+ * @param items The items which were processed
+ */
+- (oneway void) itemsWereProcessed:(NSArray*)items ;
+//@}
+
+/// \name Live stacking
+/// The images written in a capture directory are aligned and stacked as they
+/// arrive
+//@{
+/*!
+ * @abstract Start the live stacking
+ * @discussion The images of the directory are added to the image list when
+ *    complete, then aligned against the current reference and added to the
+ *    stack. The processings run at most once per refresh interval.
+ *    Only the standard stacking is allowed, as it alone adds the new images
+ *    to the previous sums, in a single pass.
+ * @param path The capture directory to watch
+ * @result Whether the alignment and stacking parameters allowed to start
+ */
+- (BOOL) startLiveStackFromDirectory:(NSString*)path ;
+/*!
+ * @abstract Stop watching the capture directory
+ * @discussion The processing being run, if any, is not interrupted.
+ */
+- (void) stopLiveStack ;
+/*!
+ * @abstract Whether the live stacking is active
+ */
+- (BOOL) isLiveStacking ;
 //@}
 @end
 
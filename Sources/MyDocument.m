@@ -42,10 +42,16 @@
 
 #include "MyDocumentData.h"
 #include "MyGeneralPrefs.h"
+#include "MyItemPrefetcher.h"
 
 // Needed for setting calibration frames align offset (it's a bad hack)
 #include "MyImageAligner.h"
 
+// Needed for the live stacking
+#include "MyImageListEnumerator.h"
+#include "MyImageStacker.h"
+#include "MyImageStackerPrefs.h"
+
 #define K_DOCUMENT_TYPE		@"Lynkeos project"
 
 // A bad hack for relative URL resolution (until I find a better solution)
@@ -77,6 +83,8 @@ NSString *basePath = nil;
                orItem: (id <LynkeosProcessableItem>)item
            parameters: (id <NSObject>)params ;
 - (BOOL) continueProcessing ;
+- (void) liveStackUpdate:(NSTimer*)timer ;
+- (void) startLiveStack:(Class)processingClass ;
 @end
 
 #if !defined GNUSTEP
@@ -150,6 +158,7 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
                orItem: (id <LynkeosProcessableItem>)item
            parameters: (id <NSObject>)params
 {
+   ParallelOptimization_t optim;
    u_char i, nListThreads;
 
    NSAssert( enumerator == nil || item == nil,
@@ -160,16 +169,43 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
    NSAssert( [_threads count] == 0, 
              @"Trying to start a process while one is already running" );
 
-   // Start the process according to user preferences
-   nListThreads = 1;
+   // Start the process according to user preferences, the threads inside
+   // each item processing are given by the CPU budget
+   optim = [processingClass supportParallelization];
+   nListThreads = cpuBudgetStartListThreads( optim );
 
-   ParallelOptimization_t optim = [processingClass supportParallelization];
+   // The items are queued here, the threads need no lock to share them
+   if ( enumerator != nil )
+   {
+      NSArray *items = [enumerator allObjects];
 
-   if ( (optim & ListThreadsOptimizations) != 0 )
-      // Parallel list processing
-      nListThreads = numberOfCpus;
-   FFTW_PLAN_WITH_NTHREADS( (optim & FFTW3ThreadsOptimization) != 0 ?
-                            numberOfCpus : 1 );
+      if ( [processingClass conformsToProtocol:
+                                      @protocol(LynkeosPipelinedProcessing)] )
+      {
+         // Read the samples ahead, while the processing threads compute
+         _pipeline = [[MyProcessingPipeline alloc] initWithItems:items
+                                                processingClass:processingClass
+                                                     parameters:params
+                                                          depth:
+                                                K_PIPELINE_DEPTH*nListThreads];
+         _itemQueue = [[_pipeline outputQueue] retain];
+         [_pipeline startReaders:nListThreads];
+      }
+      else
+         _itemQueue = [[MyItemQueue alloc] initWithItems:items];
+
+      // Warm the caches with the next items to be read
+      if ( [items count] > 1 )
+      {
+         MyItemPrefetcher *prefetcher =
+            [[MyItemPrefetcher alloc] initWithItems:items
+                                       consumedFrom:(_pipeline != nil ?
+                                                     [_pipeline inputQueue] :
+                                                     _itemQueue)];
+         [prefetcher start];
+         [prefetcher release];
+      }
+   }
 
    // Notify that the processing is starting
    _currentProcessingClass = processingClass;
@@ -196,8 +232,8 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
       // Give attributes to the thread controller
       [attrib setObject:thr->_cnx forKey: K_PROCESS_CONNECTION];
       [attrib setObject:processingClass forKey: K_PROCESS_CLASS_KEY];
-      if ( enumerator != nil )
-         [attrib setObject:enumerator forKey: K_PROCESS_ENUMERATOR_KEY];
+      if ( _itemQueue != nil )
+         [attrib setObject:_itemQueue forKey: K_PROCESS_QUEUE_KEY];
       if ( item != nil )
          [attrib setObject:item forKey: K_PROCESS_ITEM_KEY];
       if ( params != nil )
@@ -255,6 +291,91 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
 
    return( _processedItem != nil );
 }
+
+- (void) liveStackUpdate:(NSTimer*)timer
+{
+   NSEnumerator *files = [[_liveWatcher pollCompletedFiles] objectEnumerator];
+   NSString *file;
+   BOOL added = NO;
+
+   // Add the new images to the list
+   while ( (file = [files nextObject]) != nil )
+   {
+      MyImageListItem *item =
+            [MyImageListItem imageListItemWithURL:[NSURL fileURLWithPath:file]];
+
+      if ( item == nil )
+         NSLog( @"Live stacking skips the unreadable file %@", file );
+      else if ( ! [_calibrationLock addImageItem:item] )
+         NSLog( @"Live stacking skips the incompatible image %@", file );
+      else
+      {
+         [_imageList addItem:item];
+         [_liveItems addObject:item];
+         added = YES;
+      }
+   }
+
+   if ( added )
+   {
+      [self updateChangeCount:NSChangeDone];
+      [_notifQueue enqueueNotification:
+               [NSNotification notificationWithName:LynkeosItemAddedNotification
+                                             object:self]
+                          postingStyle:NSPostASAP];
+   }
+
+   // The images arrived during a processing will be processed at next update
+   if ( [_threads count] == 0 && [_liveItems count] != 0 )
+   {
+      MyImageStackerParameters *stackParams =
+         [_imageList getProcessingParameterWithRef:myImageStackerParametersRef
+                                     forProcessing:myImageStackerRef];
+
+      // The stacking method may have been changed in the meantime
+      if ( stackParams->_stackMethod != Stacking_Standard )
+      {
+         NSLog( @"Live stacking stops, it needs the standard stacking" );
+         [self stopLiveStack];
+      }
+      else
+         [self startLiveStack:[MyImageAligner class]];
+   }
+}
+
+- (void) startLiveStack:(Class)processingClass
+{
+   if ( processingClass == [MyImageAligner class] )
+   {
+      // Align the new images against the current reference
+      MyImageAlignerListParameters *params =
+         [_imageList getProcessingParameterWithRef:myImageAlignerParametersRef
+                                     forProcessing:myImageAlignerRef];
+      NSEnumerator *strider =
+         [[[MyImageListEnumerator alloc] initWithImageList:
+                                        [NSArray arrayWithArray:_liveItems]]
+                                                                  autorelease];
+
+      if ( params->_referenceItem == nil )
+         params->_referenceItem = [_liveItems objectAtIndex:0];
+      [_liveItems removeAllObjects];
+
+      [self startProcess:processingClass withEnumerator:strider
+              parameters:params];
+   }
+   else
+   {
+      // Then add them to the stack
+      MyImageStackerList *docParam =
+                              [[[MyImageStackerList alloc] init] autorelease];
+      NSEnumerator *strider = [MyImageStacker prepareStackOfList:_imageList
+                                                          inMode:ImageMode];
+
+      docParam->_list = _imageList;
+      [self startProcess:processingClass withEnumerator:strider
+              parameters:docParam];
+   }
+}
 @end
 
 @implementation MyDocument
@@ -283,12 +404,17 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
       _myWindow = nil;
 
       _threads = [[NSMutableArray array] retain];
+      _itemQueue = nil;
+      _pipeline = nil;
       _currentProcessingClass = nil;
       _processedItem = nil;
       _processStackMgr = [[ProcessStackManager alloc] init];
       _initialProcessEnum = nil;
       _isInitialProcessing = NO;
       _imageListSequenceNumber = 0;
+      _liveWatcher = nil;
+      _liveTimer = nil;
+      _liveItems = [[NSMutableArray alloc] init];
 
       _notifCenter = [NSNotificationCenter defaultCenter];
       _notifQueue = [NSNotificationQueue defaultQueue];
@@ -329,6 +455,11 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
    [_windowSizes release];
 
    [_threads release];
+   if ( _itemQueue != nil )
+      [_itemQueue release];
+   if ( _pipeline != nil )
+      [_pipeline release];
+   [_liveItems release];
 
    [_parameters release];
 
@@ -830,6 +961,9 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
    NSEnumerator *threadList;
    ThreadControl *thr;
 
+   // The queue stops the list threads without waiting for their run loop
+   [_itemQueue stop];
+
    threadList = [_threads objectEnumerator];
    while( (thr = [threadList nextObject]) != nil )
       [thr->_threaded stopProcessing];
@@ -853,6 +987,19 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
    if ( [_threads count] == 0 )
    {
       BOOL listProcessing = YES;
+      Class endedProcessingClass = _currentProcessingClass;
+
+      if ( _itemQueue != nil )
+      {
+         [_itemQueue release];
+         _itemQueue = nil;
+      }
+      // The readers, if still running, stop with the queue
+      if ( _pipeline != nil )
+      {
+         [_pipeline release];
+         _pipeline = nil;
+      }
 
       // Notify of processing end
       [_notifCenter postNotificationName: LynkeosProcessEndedNotification
@@ -906,10 +1053,26 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
 
       if (listProcessing )
       {
-         // Announce the great news
+         // Live stacking goes on from the alignment to the stack
+         if ( endedProcessingClass == [MyImageAligner class]
+              && _liveWatcher != nil )
+         {
+            [MyImageAligner releaseReferenceCache:
+               [_imageList getProcessingParameterWithRef:
+                                                    myImageAlignerParametersRef
+                                           forProcessing:myImageAlignerRef]];
+            [self startLiveStack:[MyImageStacker class]];
+            return;
+         }
+         else if ( endedProcessingClass == [MyImageStacker class]
+                   && _liveWatcher != nil && _currentList == _imageList )
+            // Display the updated stack
+            [self setDataMode:ResultData];
+
+         // Announce the great news, only once for a live stacking
          NSString *soundName = [[NSUserDefaults standardUserDefaults]
                                          objectForKey:K_PREF_END_PROCESS_SOUND];
-         if ( [soundName length] != 0 )
+         if ( _liveWatcher == nil && [soundName length] != 0 )
          {
             NSSound *snd = [NSSound soundNamed:soundName];
             [snd play];
@@ -930,6 +1093,65 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
    }
 }
 
+- (BOOL) startLiveStackFromDirectory:(NSString*)path
+{
+   MyImageAlignerListParameters *alignParams =
+      [_imageList getProcessingParameterWithRef:myImageAlignerParametersRef
+                                  forProcessing:myImageAlignerRef];
+   MyImageStackerParameters *stackParams =
+      [_imageList getProcessingParameterWithRef:myImageStackerParametersRef
+                                  forProcessing:myImageStackerRef];
+   double interval = [[NSUserDefaults standardUserDefaults] floatForKey:
+                                                    K_PREF_LIVE_STACK_INTERVAL];
+
+   NSAssert( _liveWatcher == nil, @"Live stacking started twice" );
+
+   // The alignment square and stacking rectangle shall be already defined,
+   // and the other stacking methods would read again all the images
+   if ( alignParams == nil || alignParams->_alignSize.width == 0
+        || alignParams->_alignSize.height == 0
+        || stackParams == nil || stackParams->_cropRectangle.size.width == 0
+        || stackParams->_cropRectangle.size.height == 0
+        || stackParams->_stackMethod != Stacking_Standard )
+      return( NO );
+
+   if ( interval < 1.0 )
+      interval = 5.0;
+
+   _liveWatcher = [[MyDirectoryWatcher alloc] initWithPath:path
+                                                 fileTypes:
+                                      [MyImageListItem imageListItemFileTypes]];
+   _liveTimer = [[NSTimer scheduledTimerWithTimeInterval:interval
+                                                  target:self
+                                            selector:@selector(liveStackUpdate:)
+                                                userInfo:nil
+                                                 repeats:YES] retain];
+
+   return( YES );
+}
+
+- (void) stopLiveStack
+{
+   if ( _liveWatcher == nil )
+      return;
+
+   [_liveTimer invalidate];
+   [_liveTimer release];
+   _liveTimer = nil;
+   [_liveWatcher release];
+   _liveWatcher = nil;
+   [_liveItems removeAllObjects];
+}
+
+- (BOOL) isLiveStacking { return( _liveWatcher != nil ); }
+
+- (void) close
+{
+   // The timer retains the document
+   [self stopLiveStack];
+   [super close];
+}
+
 - (oneway void) itemWasProcessed:(id <LynkeosProcessableItem>) item
 {
    // Notify of processing progress
@@ -939,6 +1161,15 @@ static void MySleepCallBack(void * x, io_service_t y, natural_t messageType,
                                                    forKey:LynkeosUserInfoItem]];
 }
 
+- (oneway void) itemsWereProcessed:(NSArray*)items
+{
+   NSEnumerator *list = [items objectEnumerator];
+   id <LynkeosProcessableItem> item;
+
+   while ( (item = [list nextObject]) != nil )
+      [self itemWasProcessed:item];
+}
+
 - (void) setProcessingParameter:(id <LynkeosProcessingParameter>)parameter
                         withRef:(NSString*)ref 
                   forProcessing:(NSString*)processing
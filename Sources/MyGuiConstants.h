@@ -31,6 +31,7 @@
 #define K_ADD_IMAGE_TAG          104   //!< File->"Add image"
 #define K_SAVE_IMAGE_TAG         105   //!< File->"Save image"
 #define K_EXPORT_MOVIE_TAG       106   //!< File->"Export movie"
+#define K_LIVE_STACK_TAG         107   //!< File->"Live stack"
 
 #define K_UNDO_TAG               201   //!< Edit->Undo
 #define K_REDO_TAG               202   //!< Edit->Redo
@@ -0,0 +1,60 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sat Apr 9 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+/*!
+ * @header
+ * @abstract Combined alignment and analysis process class
+ */
+#ifndef __MYIMAGE_ALIGN_ANALYZER_H
+#define __MYIMAGE_ALIGN_ANALYZER_H
+
+#include "MyImageAligner.h"
+#include "MyImageAnalyzer.h"
+
+/*!
+ * @abstract Alignment and quality analysis in one pass on the list
+ * @discussion The quality is evaluated on the alignment square sample, or on
+ *   its spectrum, which the aligner reads anyway. Each frame is then read
+ *   (and decoded, and calibrated) only once.<br>
+ *   The alignment parameters shall contain the analysis parameters.
+ * @ingroup Processing
+ */
+@interface MyImageAlignAnalyzer : MyImageAligner
+{
+@private
+   MyImageAlignerListParameters *_listParams; //!< Alignment parameters
+   MyAnalysisMethod     _method;          //!< Analysis method used
+   //! Lower frequency cutoff for power spectrum analysis (denormalized)
+   double               _lowerCutoff;
+   //! Upper frequency cutoff for power spectrum analysis (denormalized)
+   double               _upperCutoff;
+   //! Whether the item being processed was analyzed on the alignment sample
+   BOOL                 _analyzed;
+   //! Per thread buffer for the items not aligned by correlation
+   LynkeosFourierBuffer *_analysisSample;
+   //! Per thread histogram for the entropy
+   EntropyHistogram_t  *_entropyHistogram;
+}
+
+@end
+
+#endif
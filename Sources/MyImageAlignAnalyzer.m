@@ -0,0 +1,160 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sat Apr 9 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "MyImageAlignAnalyzer.h"
+
+@interface MyImageAlignAnalyzer(Private)
+/*!
+ * @abstract Save the quality of an item
+ * @param quality The quality
+ * @param item The analyzed item
+ */
+- (void) setQuality:(double)quality ofItem:(id <LynkeosProcessableItem>)item ;
+@end
+
+@implementation MyImageAlignAnalyzer(Private)
+- (void) setQuality:(double)quality ofItem:(id <LynkeosProcessableItem>)item
+{
+   MyImageAnalyzerResult *res = [[[MyImageAnalyzerResult alloc] init]
+                                                                  autorelease];
+
+   res->_quality = quality;
+   [item setProcessingParameter:res withRef:myImageAnalyzerResultRef 
+                  forProcessing:myImageAnalyzerRef];
+   _analyzed = YES;
+}
+@end
+
+@implementation MyImageAlignAnalyzer
+- (id <LynkeosProcessing>) initWithDocument: (id <LynkeosDocument>)document
+                                 parameters:(id <NSObject>)params
+                                  precision: (floating_precision_t)precision
+{
+   MyImageAnalyzerParameters *analysis;
+
+   self = (MyImageAlignAnalyzer*)[super initWithDocument:document
+                                              parameters:params
+                                               precision:precision];
+   if ( self == nil )
+      return( self );
+
+   _listParams = [params retain];
+   analysis = _listParams->_analysisParams;
+   NSAssert( analysis != nil, @"No analysis parameters for the alignment" );
+
+   _method = analysis->_method;
+   _lowerCutoff = analysis->_lowerCutoff*_listParams->_alignSize.width;
+   _upperCutoff = analysis->_upperCutoff*_listParams->_alignSize.width;
+   _analyzed = NO;
+   _analysisSample = nil;
+   if ( _method == EntropyAnalysis )
+      _entropyHistogram = allocEntropyHistogram();
+   else
+      _entropyHistogram = NULL;
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   if ( _analysisSample != nil )
+      [_analysisSample release];
+   if ( _entropyHistogram != NULL )
+      freeEntropyHistogram( _entropyHistogram );
+   [_listParams release];
+
+   [super dealloc];
+}
+
+- (void) inspectSample:(LynkeosFourierBuffer*)sample
+                ofItem:(id <LynkeosProcessableItem>)item
+            isSpectrum:(BOOL)isSpectrum
+{
+   if ( _method == SpectrumAnalysis )
+   {
+      if ( isSpectrum )
+         [self setQuality:spectrumQuality( sample, _lowerCutoff, _upperCutoff )
+                   ofItem:item];
+   }
+   else if ( !isSpectrum )
+      [self setQuality:(_method == EntropyAnalysis ?
+                        entropyQuality( sample, _entropyHistogram ) :
+                        stencilQuality( sample, _method ))
+                ofItem:item];
+}
+
+- (void) processItem:(id <LynkeosProcessableItem>)item
+{
+   _analyzed = NO;
+
+   [super processItem:item];
+
+   // The reference item, and the items not aligned by correlation, were not
+   // sampled by the aligner
+   if ( !_analyzed )
+   {
+      const LynkeosIntegerSize imageSize = [item imageSize];
+      LynkeosIntegerRect r = { _listParams->_alignOrigin,
+                               _listParams->_alignSize };
+      id <LynkeosAlignResult> aligned =
+         (id <LynkeosAlignResult>)[item getProcessingParameterWithRef:
+                                                         LynkeosAlignResultRef
+                                                        forProcessing:
+                                                               LynkeosAlignRef];
+
+      // Take alignment into account
+      if ( aligned != nil )
+      {
+         NSPoint p = [aligned offset];
+         r.origin.x -= (short)floorf(p.x + 0.5);
+         r.origin.y -= (short)floorf(p.y + 0.5);
+      }
+      if ( r.origin.x < 0 )
+         r.origin.x = 0;
+      else if ( r.origin.x + r.size.width > imageSize.width )
+         r.origin.x = imageSize.width - r.size.width;
+      if ( r.origin.y < 0 )
+         r.origin.y = 0;
+      else if ( r.origin.y + r.size.height > imageSize.height )
+         r.origin.y = imageSize.height - r.size.height;
+
+      // Convert from Cocoa to bitmap coordinates
+      r.origin.y = imageSize.height - r.origin.y - r.size.height;
+
+      if ( _analysisSample == nil )
+         _analysisSample = [[LynkeosFourierBuffer
+                                 fourierBufferWithNumberOfPlanes:1
+                                             width:_listParams->_alignSize.width
+                                            height:_listParams->_alignSize.height
+                                          withGoal:FOR_DIRECT] retain];
+
+      [item getImageSample:(LynkeosStandardImageBuffer**)&_analysisSample
+                    inRect:r];
+      [self inspectSample:_analysisSample ofItem:item isSpectrum:NO];
+      if ( _method == SpectrumAnalysis )
+      {
+         [_analysisSample directTransform];
+         [self inspectSample:_analysisSample ofItem:item isSpectrum:YES];
+      }
+   }
+}
+@end
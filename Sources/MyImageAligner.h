@@ -30,6 +30,8 @@
 #include "LynkeosCore/LynkeosFourierBuffer.h"
 #include "LynkeosCore/LynkeosProcessing.h"
 
+@class MyImageAnalyzerParameters;
+
 /*!
  * @abstract Reference string for this process
  * @ingroup Processing
@@ -42,6 +44,18 @@ extern NSString * const myImageAlignerRef;
  */
 extern NSString * const myImageAlignerParametersRef;
 
+/*!
+ * @abstract Alignment methods
+ * @ingroup Processing
+ */
+typedef enum
+{
+   CorrelationAlign,         //!< Correlation of the alignment squares
+   CentroidAlign,            //!< Centroid of the image bright part
+   CentroidCorrelationAlign, //!< Centroid pre-alignment, then correlation
+   StarsAlign                //!< Registration of the stars pattern
+} AlignMethod_t;
+
 /*!
  * @abstract General entry parameters for alignment
  * @ingroup Processing
@@ -69,6 +83,23 @@ extern NSString * const myImageAlignerParametersRef;
    //! is failed
    double                 _precisionThreshold;   
    BOOL                  _checkAlignResult;  //!< Check for false align
+   //! Number of squares along each axis for multi-point alignment, no 
+   //! multi-point alignment is done when there is only one square
+   LynkeosIntegerSize     _multiPointGrid;
+   //! Search for a field rotation. The rotation search makes its own
+   //! translation alignment : there is then no multi-point alignment and no
+   //! alignment check
+   BOOL                  _rotationAlign;
+   BOOL                  _scaleAlign;        //!< Search also for a scale change
+   AlignMethod_t         _alignMethod;       //!< How to align
+   //! Whether to refine the centroid by fitting a circle on the limb
+   BOOL                  _limbFit;
+   //! Level above which the pixels enter the centroid, relative to the
+   //! reference image range
+   double                _centroidLevel;
+   //! Whether the stars registration fits an affine transform rather than
+   //! a rotation and scale
+   BOOL                  _affineStars;
 
    //! This lock is not saved with the document. It's sole purpose is to 
    //! enforce that only one processing thread computes the 
@@ -79,6 +110,35 @@ extern NSString * const myImageAlignerParametersRef;
    //! threads. And is no more saved.<br>
    //! It shall be nil at process creation.
    LynkeosFourierBuffer         *_referenceSpectrum;   
+   //! The spectra of the reference squares for multi-point alignment, 
+   //! transformed in one batch. Not saved, it is nil at process creation.
+   LynkeosFourierBuffer         *_referenceGridSpectrum;
+   //! Minimum correlation peak height for each square of the grid
+   double                       *_gridValueThresholds;
+   //! Spectrum of the log-polar resampling of the reference square spectrum,
+   //! for rotation alignment. Not saved, it is nil at process creation.
+   LynkeosFourierBuffer         *_referenceLogPolarSpectrum;
+   //! Radius logarithm step of the log-polar resampling
+   double                        _logPolarRadiusStep;
+   //! Spectrum of the stack of the best items, used instead of the reference
+   //! item for a second alignment round. Not saved, nil for the first round.
+   LynkeosFourierBuffer         *_syntheticReference;
+   //! Spectra of the multi-point squares of the same stack, in one batch.
+   //! Not saved, nil for the first round or without multi-point alignment.
+   LynkeosFourierBuffer         *_syntheticGridSpectrum;
+   //! Pixel value threshold for the centroid, computed on the reference
+   REAL                          _centroidThreshold;
+   //! Centroid of the reference, in the reference coordinates
+   NSPoint                       _referenceCentroid;
+   //! Triangles index of the reference stars. Not saved, it is NULL at
+   //! process creation.
+   struct star_index            *_starIndex;
+   //! Align method of the current run : the saved one, or correlation when
+   //! the reference has no centroid or not enough stars. Not saved.
+   AlignMethod_t                 _runAlignMethod;
+   //! Analysis parameters for a combined alignment and analysis pass. Not
+   //! saved, nil when only aligning.
+   MyImageAnalyzerParameters    *_analysisParams;
 }
 @end
 
@@ -100,8 +160,57 @@ extern NSString * const myImageAlignerParametersRef;
    double                 _valueThreshold;   //!< Peak minimum height
    //!< Per thread buffer for Fourier transform
    LynkeosFourierBuffer      *_bufferSpectrum;
+   //! Per thread buffer for the multi-point squares batch transform
+   LynkeosFourierBuffer      *_bufferGridSpectrum;
+   //! Per thread sample of the item, for rotation alignment
+   LynkeosStandardImageBuffer *_rotationSample;
+   //! Per thread buffer for the windowed square spectrum
+   LynkeosFourierBuffer      *_bufferWindowed;
+   //! Per thread buffer for the log-polar resampling
+   LynkeosFourierBuffer      *_bufferLogPolar;
+   //! Per thread buffer for the whole frame, for centroid alignment
+   LynkeosStandardImageBuffer *_frameSample;
 }
 
+/*!
+ * @abstract Build a synthetic reference for a second alignment round
+ * @discussion The alignment squares of the best aligned items, according to
+ *   the analysis quality, are stacked in the Fourier domain, each one shifted
+ *   by its sub-pixel offset. Only the translation part of the alignment is
+ *   taken into account. The multi-point alignment squares are stacked the
+ *   same way. In the round against it, every item is correlated, the
+ *   reference item included, and the squares are placed according to the
+ *   previous round, without centroid search.
+ * @param params The list alignment parameters, which receive the reference
+ * @param list The aligned list
+ * @param count Maximum number of items to stack
+ * @result Wether the synthetic reference was built
+ */
++ (BOOL) prepareSyntheticReference:(MyImageAlignerListParameters*)params
+                           forList:(id <LynkeosImageList>)list
+                             count:(u_short)count ;
+
+/*!
+ * @abstract Release what was computed on the reference during an alignment
+ * @discussion The synthetic reference and analysis parameters are left
+ *   untouched.
+ * @param params The list alignment parameters
+ */
++ (void) releaseReferenceCache:(MyImageAlignerListParameters*)params ;
+
+/*!
+ * @abstract Hook on the correlation square of each item
+ * @discussion It is called once on the sample read, then once on its
+ *   spectrum, before the frequency cutoff. It does nothing here ; subclasses
+ *   override it to get more out of the sample without reading it again.
+ * @param sample The sample, or its spectrum
+ * @param item The item being aligned
+ * @param isSpectrum Whether the sample was already transformed
+ */
+- (void) inspectSample:(LynkeosFourierBuffer*)sample
+                ofItem:(id <LynkeosProcessableItem>)item
+            isSpectrum:(BOOL)isSpectrum ;
+
 @end
 
 #endif
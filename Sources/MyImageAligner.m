@@ -24,11 +24,16 @@
  */
 #include "processing_core.h"
 #include "corelation.h"
+#include "star_pattern.h"
 #include "LynkeosStandardImageBufferAdditions.h"
 
 #include "LynkeosBasicAlignResult.h"
+#include "LynkeosAffineAlignResult.h"
+#include "LynkeosMultiPointAlignResult.h"
+#include "LynkeosRotationAlignResult.h"
 
 #include "MyImageAlignerPrefs.h"
+#include "MyImageAnalyzer.h"
 #include "MyImageAligner.h"
 
 NSString * const myImageAlignerRef = @"MyImageAligner";
@@ -42,6 +47,23 @@ NSString * const myImageAlignerParametersRef = @"AlignParams";
 #define K_ALIGN_CUTOFF_KEY    @"cutoff" ///< Key for saving the cutoff threshold
 //! Key for saving the align precision threshold
 #define K_ALIGN_PRECISION_KEY @"precision"
+//! Key for saving the multi-point alignment grid size
+#define K_ALIGN_GRID_KEY      @"multipoint"
+//! Key for saving the rotation alignment activation
+#define K_ALIGN_ROTATION_KEY  @"rotation"
+//! Key for saving the scale alignment activation
+#define K_ALIGN_SCALE_KEY     @"scale"
+//! Key for saving the alignment method
+#define K_ALIGN_METHOD_KEY    @"method"
+//! Key for saving the limb fitting activation
+#define K_ALIGN_LIMB_KEY      @"limbfit"
+//! Key for saving the stars transform kind
+#define K_ALIGN_AFFINE_KEY    @"affinestars"
+
+//! Number of rays on which the limb is searched
+#define K_LIMB_RAYS           64
+//! Number of stars used for the stars pattern registration
+#define K_MAX_STARS           30
 
 //==============================================================================
 // Generic processing functions
@@ -53,21 +75,23 @@ NSString * const myImageAlignerParametersRef = @"AlignParams";
 static void cutoffSpectrum( LynkeosFourierBuffer *spectrum, u_short cutoff )
 {
    u_short x, y;
-   u_short h_2 = spectrum->_h/2;
+   const u_short h = spectrum->_h/spectrum->_batch;
+   u_short h_2 = h/2;
    u_long cut2 = cutoff*cutoff;
 
    // Save time if there is no cutoff at all
-   if ( cutoff >= sqrt(spectrum->_w*spectrum->_w+spectrum->_h*spectrum->_h) )
+   if ( cutoff >= sqrt(spectrum->_w*spectrum->_w+h*h) )
       return;
 
    for ( y = 0; y < spectrum->_h; y++ )
    {
       for ( x = 0; x < spectrum->_halfw; x++ )
       {
-         short dx = x, dy = y;
+         // Each image of a batch has its own frequencies origin
+         short dx = x, dy = y % h;
          u_long f2; 
          if ( dy >= h_2 )
-            dy -= spectrum->_h;
+            dy -= h;
          f2 = dx*dx + dy*dy;
 
          if ( f2 > cut2 )
@@ -81,6 +105,374 @@ static void cutoffSpectrum( LynkeosFourierBuffer *spectrum, u_short cutoff )
    }
 }
 
+/*!
+ * Rectangle of one multi-point alignment square, in the Cocoa coordinate system
+ */
+static LynkeosIntegerRect gridSquareRect(MyImageAlignerListParameters *params,
+                                         LynkeosIntegerSize imageSize,
+                                         u_short col, u_short row )
+{
+   LynkeosIntegerRect r;
+
+   r.size = params->_alignSize;
+   r.origin.x = (2*col+1)*imageSize.width/params->_multiPointGrid.width/2
+                - r.size.width/2;
+   r.origin.y = (2*row+1)*imageSize.height/params->_multiPointGrid.height/2
+                - r.size.height/2;
+
+   return( r );
+}
+
+/*!
+ * Read all the squares of the grid in a batch buffer
+ */
+static void getGridSamples( id <LynkeosProcessableItem> item,
+                            MyImageAlignerListParameters *params,
+                            LynkeosIntegerPoint shift,
+                            LynkeosFourierBuffer *batch )
+{
+   const LynkeosIntegerSize imageSize = [item imageSize];
+   const u_short h = batch->_h/batch->_batch;
+   u_short col, row;
+
+   for( row = 0; row < params->_multiPointGrid.height; row++ )
+   {
+      for( col = 0; col < params->_multiPointGrid.width; col++ )
+      {
+         LynkeosIntegerRect r = gridSquareRect( params, imageSize, col, row );
+         // The square is a window on its part of the batch buffer
+         LynkeosStandardImageBuffer *square =
+            [LynkeosStandardImageBuffer imageBufferWithData:
+                   &colorValue(batch,0,(row*params->_multiPointGrid.width+col)*h,0)
+                                                       copy:NO
+                                               freeWhenDone:NO
+                                             numberOfPlanes:1
+                                                      width:batch->_w
+                                                paddedWidth:batch->_padw
+                                                     height:h];
+
+         r.origin.x -= shift.x;
+         r.origin.y -= shift.y;
+         // Convert the coordinate system from Cocoa to bitmap
+         r.origin.y = imageSize.height - r.origin.y - r.size.height;
+
+         [item getImageSample:&square inRect:r];
+      }
+   }
+}
+
+/*!
+ * Apply a Hann window to a square sample, for its spectrum not to be 
+ * polluted by the borders
+ */
+static void windowSample( LynkeosStandardImageBuffer *sample,
+                          LynkeosFourierBuffer *windowed )
+{
+   u_short x, y;
+
+   for( y = 0; y < sample->_h; y++ )
+   {
+      const double wy = 0.5 - 0.5*cos(2.0*M_PI*(double)y/(double)sample->_h);
+
+      for( x = 0; x < sample->_w; x++ )
+      {
+         const double wx =
+                        0.5 - 0.5*cos(2.0*M_PI*(double)x/(double)sample->_w);
+
+         colorValue(windowed,x,y,0) = colorValue(sample,x,y,0)*wx*wy;
+      }
+   }
+}
+
+/*!
+ * Resample a square sample, rotated and scaled around its center. The pixels
+ * which fall outside of the sample are set to zero.
+ */
+static void rotateSample( LynkeosStandardImageBuffer *sample,
+                          LynkeosFourierBuffer *rotated,
+                          double angle, double scale )
+{
+   const double cx = (sample->_w - 1)/2.0, cy = (sample->_h - 1)/2.0;
+   const double ca = scale*cos(angle), sa = scale*sin(angle);
+   u_short x, y;
+
+   for( y = 0; y < sample->_h; y++ )
+   {
+      for( x = 0; x < sample->_w; x++ )
+      {
+         const double dx = x - cx, dy = y - cy;
+         const double sx = cx + ca*dx - sa*dy, sy = cy + sa*dx + ca*dy;
+         const long ix = (long)floor(sx), iy = (long)floor(sy);
+         const double ax = sx - ix, ay = sy - iy;
+
+         if ( ix < 0 || iy < 0 || ix+1 >= sample->_w || iy+1 >= sample->_h )
+            colorValue(rotated,x,y,0) = 0.0;
+         else
+            colorValue(rotated,x,y,0) =
+               (colorValue(sample,ix,iy,0)*(1.0-ax)
+                + colorValue(sample,ix+1,iy,0)*ax)*(1.0-ay)
+               + (colorValue(sample,ix,iy+1,0)*(1.0-ax)
+                  + colorValue(sample,ix+1,iy+1,0)*ax)*ay;
+      }
+   }
+}
+
+/*!
+ * Shift an image by a sub-pixel amount, in the Fourier domain. Each image of
+ * a batch is shifted by the same amount.
+ */
+static void shiftSpectrum( LynkeosFourierBuffer *spectrum, double dx, double dy )
+{
+   const u_short h = spectrum->_h/spectrum->_batch;
+   u_short x, y, c;
+
+   for( y = 0; y < spectrum->_h; y++ )
+   {
+      const u_short yb = y % h;
+      const double fy = (double)(2*yb < h ? yb : yb - h)/(double)h;
+
+      for( x = 0; x < spectrum->_halfw; x++ )
+      {
+         const double phase = -2.0*M_PI*((double)x/(double)spectrum->_w*dx
+                                         + fy*dy);
+         const double cp = cos(phase), sp = sin(phase);
+
+         for( c = 0; c < spectrum->_nPlanes; c++ )
+         {
+            COMPLEX v = colorComplexValue(spectrum,x,y,c);
+            __real__ colorComplexValue(spectrum,x,y,c) =
+                                           __real__ v * cp - __imag__ v * sp;
+            __imag__ colorComplexValue(spectrum,x,y,c) =
+                                           __real__ v * sp + __imag__ v * cp;
+         }
+      }
+   }
+}
+
+/*!
+ * Sums for the centroid of the pixels above a threshold, on one line
+ */
+static void std_centroid_line( LynkeosStandardImageBuffer *image, u_short y,
+                               REAL threshold, double *sum, double *sumx )
+{
+   u_short x;
+
+   *sum = 0.0;
+   *sumx = 0.0;
+   for( x = 0; x < image->_w; x++ )
+   {
+      REAL v = colorValue(image,x,y,0) - threshold;
+
+      if ( v > 0.0 )
+      {
+         *sum += v;
+         *sumx += x*v;
+      }
+   }
+}
+
+#if !defined(DOUBLE_PIXELS) || defined(__i386__)
+/*!
+ * Absolute value of a vector
+ */
+static inline REALVECT vect_abs( REALVECT v )
+{
+#ifdef __ALTIVEC__
+   return( vec_abs( v ) );
+#else
+   // Clear the sign bits
+#ifdef DOUBLE_PIXELS
+   typedef int64_t MASKVECT __attribute__ ((vector_size (32)));
+   const MASKVECT mask = { 0x7fffffffffffffffLL, 0x7fffffffffffffffLL,
+                           0x7fffffffffffffffLL, 0x7fffffffffffffffLL };
+#else
+   typedef int32_t MASKVECT __attribute__ ((vector_size (16)));
+   const MASKVECT mask = { 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff };
+#endif
+   return( (REALVECT)((MASKVECT)v & mask) );
+#endif
+}
+
+/*!
+ * Same sums for the centroid, with vectors. The pixels under the threshold
+ * are cleared without any branch, as v + |v| is twice the positive part of v
+ */
+static void vect_centroid_line( LynkeosStandardImageBuffer *image, u_short y,
+                                REAL threshold, double *sum, double *sumx )
+{
+   const REALVECT t = { threshold, threshold, threshold, threshold };
+   const REALVECT four = { 4.0, 4.0, 4.0, 4.0 };
+   REALVECT xv = { 0.0, 1.0, 2.0, 3.0 };
+   REALVECT s = { 0.0, 0.0, 0.0, 0.0 }, sx = { 0.0, 0.0, 0.0, 0.0 };
+   const REAL *ps = (const REAL*)&s, *psx = (const REAL*)&sx;
+   const u_short wv = image->_w & ~3;
+   u_short x;
+
+   for( x = 0; x < wv; x += 4 )
+   {
+      REALVECT v = *((REALVECT*)&colorValue(image,x,y,0)) - t;
+
+      v += vect_abs( v );
+      s += v;
+      sx += xv*v;
+      xv += four;
+   }
+
+   *sum = ((double)ps[0] + (double)ps[1] + (double)ps[2] + (double)ps[3])/2.0;
+   *sumx = ((double)psx[0] + (double)psx[1] + (double)psx[2]
+            + (double)psx[3])/2.0;
+
+   // The remaining pixels, the line padding is not read
+   for( ; x < image->_w; x++ )
+   {
+      REAL v = colorValue(image,x,y,0) - threshold;
+
+      if ( v > 0.0 )
+      {
+         *sum += v;
+         *sumx += x*v;
+      }
+   }
+}
+#endif
+
+/*!
+ * Centroid of the pixels above a threshold, in one pass on the image
+ */
+static BOOL imageCentroid( LynkeosStandardImageBuffer *image, REAL threshold,
+                           NSPoint *center )
+{
+   void (*centroid_line)( LynkeosStandardImageBuffer*, u_short, REAL,
+                          double*, double* ) = std_centroid_line;
+   double s = 0.0, sx = 0.0, sy = 0.0;
+   u_short y;
+
+#if !defined(DOUBLE_PIXELS) || defined(__i386__)
+   // Vectorized instructions are only usable if aligned
+   if ( hasSIMD && (image->_padw % 4) == 0
+        && ((u_long)image->_data % sizeof(REALVECT)) == 0 )
+      centroid_line = vect_centroid_line;
+#endif
+
+   for( y = 0; y < image->_h; y++ )
+   {
+      double ls, lsx;
+
+      centroid_line( image, y, threshold, &ls, &lsx );
+      s += ls;
+      sx += lsx;
+      sy += y*ls;
+   }
+
+   if ( s <= 0.0 )
+      return( NO );
+
+   center->x = sx/s;
+   center->y = sy/s;
+
+   return( YES );
+}
+
+/*!
+ * Refine a disk center by a least square fit of a circle on its limb.
+ * The limb is searched on rays starting from the centroid.
+ */
+static BOOL limbCenter( LynkeosStandardImageBuffer *image, REAL threshold,
+                        NSPoint *center )
+{
+   double sxx = 0.0, sxy = 0.0, syy = 0.0, sx = 0.0, sy = 0.0;
+   double sxz = 0.0, syz = 0.0, sz = 0.0, det;
+   u_short k, n = 0;
+
+   for( k = 0; k < K_LIMB_RAYS; k++ )
+   {
+      const double a = 2.0*M_PI*(double)k/(double)K_LIMB_RAYS;
+      const double dx = cos(a), dy = sin(a);
+      REAL v0 = threshold;
+      double r;
+
+      for( r = 0.0; ; r += 1.0 )
+      {
+         const long px = (long)floor(center->x + r*dx + 0.5),
+                    py = (long)floor(center->y + r*dy + 0.5);
+         REAL v;
+
+         if ( px < 0 || py < 0 || px >= image->_w || py >= image->_h )
+            break;  // No limb on this ray
+
+         v = colorValue(image,px,py,0);
+         if ( r > 0.0 && v0 >= threshold && v < threshold )
+         {
+            // Interpolate the crossing, relatively to the centroid
+            const double rc = r - 1.0 + (v0 - threshold)/(v0 - v);
+            const double x = rc*dx, y = rc*dy, z = x*x + y*y;
+
+            sxx += x*x; sxy += x*y; syy += y*y;
+            sx += x; sy += y;
+            sxz += x*z; syz += y*z; sz += z;
+            n++;
+            break;
+         }
+         v0 = v;
+      }
+   }
+
+   // Too much of the limb is outside of the image
+   if ( n < K_LIMB_RAYS/2 )
+      return( NO );
+
+   // Solve the circle equation x^2+y^2+D.x+E.y+F = 0 by Cramer's rule
+   det = sxx*(syy*n - sy*sy) - sxy*(sxy*n - sy*sx) + sx*(sxy*sy - syy*sx);
+   if ( fabs(det) < 1e-12 )
+      return( NO );
+
+   center->x += -(-sxz*(syy*n - sy*sy) + sxy*(syz*n - sy*sz)
+                  - sx*(syz*sy - syy*sz)) / det / 2.0;
+   center->y += -(sxx*(-syz*n + sy*sz) + sxz*(sxy*n - sy*sx)
+                  + sx*(-sxy*sz + syz*sx)) / det / 2.0;
+
+   return( YES );
+}
+
+/*!
+ * Sort the items by decreasing analysis quality
+ */
+static int compareQuality( id item1, id item2, void *context )
+{
+   double q1 = ((MyImageAnalyzerResult*)
+                [item1 getProcessingParameterWithRef:myImageAnalyzerResultRef
+                                       forProcessing:myImageAnalyzerRef])
+               ->_quality;
+   double q2 = ((MyImageAnalyzerResult*)
+                [item2 getProcessingParameterWithRef:myImageAnalyzerResultRef
+                                       forProcessing:myImageAnalyzerRef])
+               ->_quality;
+
+   if ( q1 > q2 )
+      return( NSOrderedAscending );
+   else if ( q1 < q2 )
+      return( NSOrderedDescending );
+   else
+      return( NSOrderedSame );
+}
+
+static BOOL alignSpectrum( LynkeosFourierBuffer *buf,
+                           LynkeosFourierBuffer *ref,
+                           double cutoff,
+                           double sigmaThreshold,
+                           double valueThreshold,
+                           CORRELATION_PEAK *peak )
+{
+   cutoffSpectrum( buf, cutoff );
+
+   // correlate it against the reference
+   correlate_spectrums( ref, buf, buf );
+   corelation_peak( buf, peak );
+
+   return( peak->val >= valueThreshold &&
+           peak->sigma_x < sigmaThreshold && peak->sigma_y < sigmaThreshold );
+}
+
 static BOOL performAlignment( id <LynkeosProcessableItem> item,
                               LynkeosIntegerRect extractRect,
                               LynkeosFourierBuffer *buf,
@@ -92,14 +484,9 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
 {
    // Get the spectrum of that other image
    [item getFourierTransform:&buf forRect:extractRect prepareInverse:NO];
-   cutoffSpectrum( buf, cutoff );
-
-   // correlate it against the reference
-   correlate_spectrums( ref, buf, buf );
-   corelation_peak( buf, peak );
 
-   return( peak->val >= valueThreshold &&
-           peak->sigma_x < sigmaThreshold && peak->sigma_y < sigmaThreshold );
+   return( alignSpectrum( buf, ref, cutoff, sigmaThreshold, valueThreshold,
+                          peak ) );
 }
 
 @implementation MyImageAlignerParameters
@@ -149,6 +536,24 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
       _cutoff = 0.0;
       _precisionThreshold = 0.0;
       _checkAlignResult = NO;
+      _multiPointGrid = LynkeosMakeIntegerSize(1,1);
+      _referenceGridSpectrum = nil;
+      _gridValueThresholds = NULL;
+      _rotationAlign = NO;
+      _scaleAlign = NO;
+      _referenceLogPolarSpectrum = nil;
+      _logPolarRadiusStep = 0.0;
+      _syntheticReference = nil;
+      _syntheticGridSpectrum = nil;
+      _alignMethod = CorrelationAlign;
+      _limbFit = NO;
+      _centroidLevel = 0.5;
+      _centroidThreshold = 0.0;
+      _referenceCentroid = NSMakePoint(0.0, 0.0);
+      _affineStars = NO;
+      _starIndex = NULL;
+      _runAlignMethod = CorrelationAlign;
+      _analysisParams = nil;
    }
 
    return( self );
@@ -160,6 +565,20 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
       [_refSpectrumLock release];
    if ( _referenceSpectrum != nil )
       [_referenceSpectrum release];
+   if ( _referenceGridSpectrum != nil )
+      [_referenceGridSpectrum release];
+   if ( _gridValueThresholds != NULL )
+      free( _gridValueThresholds );
+   if ( _referenceLogPolarSpectrum != nil )
+      [_referenceLogPolarSpectrum release];
+   if ( _syntheticReference != nil )
+      [_syntheticReference release];
+   if ( _syntheticGridSpectrum != nil )
+      [_syntheticGridSpectrum release];
+   if ( _starIndex != NULL )
+      free_star_index( _starIndex );
+   if ( _analysisParams != nil )
+      [_analysisParams release];
 
    [super dealloc];
 }
@@ -171,6 +590,13 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
    [encoder encodeSize: NSSizeFromIntegerSize(_alignSize) 
                  forKey: K_ALIGN_SIZE_KEY];
    [encoder encodeConditionalObject:_referenceItem forKey:K_ALIGN_REF_KEY];
+   [encoder encodeSize: NSSizeFromIntegerSize(_multiPointGrid)
+                forKey: K_ALIGN_GRID_KEY];
+   [encoder encodeBool:_rotationAlign forKey:K_ALIGN_ROTATION_KEY];
+   [encoder encodeBool:_scaleAlign forKey:K_ALIGN_SCALE_KEY];
+   [encoder encodeInt:_alignMethod forKey:K_ALIGN_METHOD_KEY];
+   [encoder encodeBool:_limbFit forKey:K_ALIGN_LIMB_KEY];
+   [encoder encodeBool:_affineStars forKey:K_ALIGN_AFFINE_KEY];
 }
 
 - (id) initWithCoder:(NSCoder *)decoder
@@ -183,6 +609,19 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
          _alignSize = LynkeosIntegerSizeFromNSSize(
                                 [decoder decodeSizeForKey:K_ALIGN_SIZE_KEY]);
       _referenceItem = [decoder decodeObjectForKey:K_ALIGN_REF_KEY];
+      if ( [decoder containsValueForKey:K_ALIGN_GRID_KEY] )
+         _multiPointGrid = LynkeosIntegerSizeFromNSSize(
+                                [decoder decodeSizeForKey:K_ALIGN_GRID_KEY]);
+      if ( [decoder containsValueForKey:K_ALIGN_ROTATION_KEY] )
+         _rotationAlign = [decoder decodeBoolForKey:K_ALIGN_ROTATION_KEY];
+      if ( [decoder containsValueForKey:K_ALIGN_SCALE_KEY] )
+         _scaleAlign = [decoder decodeBoolForKey:K_ALIGN_SCALE_KEY];
+      if ( [decoder containsValueForKey:K_ALIGN_METHOD_KEY] )
+         _alignMethod = [decoder decodeIntForKey:K_ALIGN_METHOD_KEY];
+      if ( [decoder containsValueForKey:K_ALIGN_LIMB_KEY] )
+         _limbFit = [decoder decodeBoolForKey:K_ALIGN_LIMB_KEY];
+      if ( [decoder containsValueForKey:K_ALIGN_AFFINE_KEY] )
+         _affineStars = [decoder decodeBoolForKey:K_ALIGN_AFFINE_KEY];
    }
 
    return( self );
@@ -190,8 +629,613 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
 
 @end
 
+/*!
+ * @abstract Multi-point alignment methods
+ */
+@interface MyImageAligner(MultiPoint)
+/*!
+ * @abstract Compute the spectra of the reference squares in one batch
+ * @param shift The integer offset of the reference item
+ */
+- (void) prepareReferenceGridWithShift:(LynkeosIntegerPoint)shift ;
+
+/*!
+ * @abstract Align each square of the grid
+ * @param item The item to align
+ * @param offset The global offset of this item
+ * @result The alignment result, with the displacement of every square
+ */
+- (LynkeosMultiPointAlignResult*) alignGridOfItem:
+                                          (id <LynkeosProcessableItem>)item
+                                       withOffset:(NSPoint)offset ;
+@end
+
+@implementation MyImageAligner(MultiPoint)
+- (void) prepareReferenceGridWithShift:(LynkeosIntegerPoint)shift
+{
+   const u_short nSquares = _rootParams->_multiPointGrid.width
+                            * _rootParams->_multiPointGrid.height;
+   const u_short h = _rootParams->_alignSize.height;
+   LynkeosFourierBuffer *refGrid;
+   u_short n;
+
+   if ( _rootParams->_syntheticGridSpectrum != nil )
+   {
+      // Second round, against the stack of the best items
+      refGrid = [_rootParams->_syntheticGridSpectrum copy];
+      [refGrid inverseTransform];
+   }
+   else
+   {
+      refGrid = [[LynkeosFourierBuffer fourierBufferWithNumberOfPlanes:1 
+                                       width:_rootParams->_alignSize.width
+                                      height:h
+                                       batch:nSquares
+                                    withGoal: FOR_DIRECT|FOR_INVERSE] retain];
+      getGridSamples( _rootParams->_referenceItem, _rootParams, shift,
+                      refGrid );
+   }
+
+   // Calculate the minimum valid correlation peak height of each square
+   _rootParams->_gridValueThresholds =
+                                 (double*)malloc( nSquares*sizeof(double) );
+   for( n = 0; n < nSquares; n++ )
+   {
+      REAL vmin = HUGE, vmax = -HUGE;
+      u_short x, y;
+
+      for( y = n*h; y < (n+1)*h; y++ )
+      {
+         for( x = 0; x < refGrid->_w; x++ )
+         {
+            REAL v = colorValue(refGrid,x,y,0);
+            if ( v < vmin )
+               vmin = v;
+            if ( v > vmax )
+               vmax = v;
+         }
+      }
+      _rootParams->_gridValueThresholds[n] = (vmax-vmin)*(vmax-vmin);
+   }
+
+   // All the squares are transformed together
+   [refGrid directTransform];
+   cutoffSpectrum( refGrid, _cutoff );
+
+   _rootParams->_referenceGridSpectrum = refGrid;
+}
+
+- (LynkeosMultiPointAlignResult*) alignGridOfItem:
+                                          (id <LynkeosProcessableItem>)item
+                                       withOffset:(NSPoint)offset
+{
+   const LynkeosIntegerSize imageSize = [item imageSize];
+   const u_short nSquares = _rootParams->_multiPointGrid.width
+                            * _rootParams->_multiPointGrid.height;
+   const double maxShift = _rootParams->_alignSize.width/4.0;
+   LynkeosIntegerRect r0 = gridSquareRect( _rootParams, imageSize, 0, 0 );
+   LynkeosMultiPointAlignResult *res;
+   CORRELATION_PEAK *peaks;
+   LynkeosIntegerPoint shift;
+   u_short n;
+
+   res = [[[LynkeosMultiPointAlignResult alloc]
+              initWithColumns:_rootParams->_multiPointGrid.width
+                         rows:_rootParams->_multiPointGrid.height
+                       origin:NSMakePoint(r0.origin.x + r0.size.width/2.0,
+                                          r0.origin.y + r0.size.height/2.0)
+                         step:NSMakeSize(
+              (double)imageSize.width/(double)_rootParams->_multiPointGrid.width,
+              (double)imageSize.height/(double)_rootParams->_multiPointGrid.height)]
+          autorelease];
+   res->_alignOffset = offset;
+
+   // Place the squares on the globally aligned image
+   shift.x = (short)floorf(offset.x + 0.5);
+   shift.y = (short)floorf(offset.y + 0.5);
+   getGridSamples( item, _rootParams, shift, _bufferGridSpectrum );
+
+   // Correlate all the squares with one transform in each direction
+   [_bufferGridSpectrum directTransform];
+   cutoffSpectrum( _bufferGridSpectrum, _cutoff );
+   correlate_spectrums( _rootParams->_referenceGridSpectrum,
+                        _bufferGridSpectrum, _bufferGridSpectrum );
+
+   peaks = (CORRELATION_PEAK*)malloc( nSquares*sizeof(CORRELATION_PEAK) );
+   corelation_peak( _bufferGridSpectrum, peaks );
+
+   for( n = 0; n < nSquares; n++ )
+   {
+      if ( peaks[n].val >= _rootParams->_gridValueThresholds[n]
+           && peaks[n].sigma_x < _precisionThreshold
+           && peaks[n].sigma_y < _precisionThreshold
+           && fabs(peaks[n].x) < maxShift && fabs(peaks[n].y) < maxShift )
+      {
+         // Beware, there is a y-flip between the bitmap and the screen
+         res->_displacements[n].x = peaks[n].x + (double)shift.x;
+         res->_displacements[n].y = -peaks[n].y + (double)shift.y;
+      }
+      else
+         // Featureless or distorted square, keep the global alignment
+         res->_displacements[n] = offset;
+   }
+
+   free( peaks );
+
+   return( res );
+}
+@end
+
+/*!
+ * @abstract Rotation alignment methods
+ */
+@interface MyImageAligner(Rotation)
+/*!
+ * @abstract Compute the spectrum of the reference log-polar spectrum module
+ * @param refSample The reference square
+ */
+- (void) prepareReferenceLogPolar:(LynkeosStandardImageBuffer*)refSample ;
+
+/*!
+ * @abstract Align a square of an item, which can be rotated and scaled
+ * @discussion The rotation and scale are found by correlating the log-polar
+ *   resampling of the spectra modules. The square is then derotated and
+ *   correlated against the reference for the translation.
+ * @param item The item to align
+ * @param r The square to align, in the Cocoa coordinate system
+ * @result The alignment result, nil if the alignment failed
+ */
+- (LynkeosRotationAlignResult*) alignRotationOfItem:
+                                          (id <LynkeosProcessableItem>)item
+                                             inRect:(LynkeosIntegerRect)r ;
+@end
+
+@implementation MyImageAligner(Rotation)
+- (void) prepareReferenceLogPolar:(LynkeosStandardImageBuffer*)refSample
+{
+   LynkeosFourierBuffer *refLogPolar =
+      [[LynkeosFourierBuffer fourierBufferWithNumberOfPlanes:1
+                                       width:_rootParams->_alignSize.width
+                                      height:_rootParams->_alignSize.height
+                                    withGoal: FOR_DIRECT|FOR_INVERSE] retain];
+
+   windowSample( refSample, _bufferWindowed );
+   [_bufferWindowed directTransform];
+   _rootParams->_logPolarRadiusStep =
+                             log_polar_magnitude( _bufferWindowed, refLogPolar );
+   [refLogPolar directTransform];
+
+   _rootParams->_referenceLogPolarSpectrum = refLogPolar;
+}
+
+- (LynkeosRotationAlignResult*) alignRotationOfItem:
+                                          (id <LynkeosProcessableItem>)item
+                                             inRect:(LynkeosIntegerRect)r
+{
+   LynkeosIntegerRect extractRect = r;
+   LynkeosRotationAlignResult *res;
+   CORRELATION_PEAK peak, bestPeak;
+   double angle, bestAngle = 0.0, scale = 1.0;
+   u_short k;
+
+   // Convert the coordinate system from Cocoa to bitmap
+   extractRect.origin.y = [item imageSize].height
+                          - r.origin.y - r.size.height;
+   [item getImageSample:&_rotationSample inRect:extractRect];
+
+   // Rotation and scale are a translation of the log-polar spectrum module
+   windowSample( _rotationSample, _bufferWindowed );
+   [_bufferWindowed directTransform];
+   log_polar_magnitude( _bufferWindowed, _bufferLogPolar );
+   [_bufferLogPolar directTransform];
+   correlate_spectrums( _rootParams->_referenceLogPolarSpectrum,
+                        _bufferLogPolar, _bufferLogPolar );
+   corelation_peak( _bufferLogPolar, &peak );
+
+   angle = -peak.x*M_PI/(double)_bufferLogPolar->_w;
+   if ( _rootParams->_scaleAlign )
+      scale = exp( peak.y*_rootParams->_logPolarRadiusStep );
+
+   // The spectrum module is symmetric, the angle is known modulo pi
+   bestPeak.val = -HUGE;
+   for( k = 0; k < 2; k++ )
+   {
+      rotateSample( _rotationSample, _bufferSpectrum, angle + k*M_PI, scale );
+      [_bufferSpectrum directTransform];
+      cutoffSpectrum( _bufferSpectrum, _cutoff );
+      correlate_spectrums( _rootParams->_referenceSpectrum, _bufferSpectrum,
+                           _bufferSpectrum );
+      corelation_peak( _bufferSpectrum, &peak );
+
+      if ( peak.val > bestPeak.val )
+      {
+         bestPeak = peak;
+         bestAngle = angle + k*M_PI;
+      }
+   }
+
+   if ( bestPeak.val < _valueThreshold
+        || bestPeak.sigma_x >= _precisionThreshold
+        || bestPeak.sigma_y >= _precisionThreshold )
+      return( nil );
+
+   res = [[[LynkeosRotationAlignResult alloc] init] autorelease];
+   // Beware, there is a y-flip between the bitmap and the screen
+   res->_alignOffset.x = bestPeak.x - r.origin.x + _rootParams->_alignOrigin.x;
+   res->_alignOffset.y = -bestPeak.y - r.origin.y + _rootParams->_alignOrigin.y;
+   res->_rotation = -bestAngle;
+   res->_scale = scale;
+   res->_center = NSMakePoint( r.origin.x + (r.size.width - 1)/2.0,
+                               r.origin.y + (r.size.height - 1)/2.0 );
+
+   return( res );
+}
+@end
+
+/*!
+ * @abstract Centroid alignment methods
+ */
+@interface MyImageAligner(Centroid)
+/*!
+ * @abstract Read the whole frame of an item
+ * @param item The item to read
+ */
+- (void) readFrameOfItem:(id <LynkeosProcessableItem>)item ;
+
+/*!
+ * @abstract Locate the bright object in the frame read last
+ * @param center The centroid, in the item Cocoa coordinates
+ * @result Wether the centroid was found
+ */
+- (BOOL) frameCentroid:(NSPoint*)center ;
+
+/*!
+ * @abstract Compute the centroid threshold and the reference centroid
+ * @param offset The offset of the reference item
+ */
+- (void) prepareReferenceCentroidWithOffset:(NSPoint)offset ;
+@end
+
+@implementation MyImageAligner(Centroid)
+- (void) readFrameOfItem:(id <LynkeosProcessableItem>)item
+{
+   const LynkeosIntegerSize size = [item imageSize];
+
+   if ( _frameSample != nil
+        && ( _frameSample->_w != size.width || _frameSample->_h != size.height ))
+   {
+      [_frameSample release];
+      _frameSample = nil;
+   }
+   if ( _frameSample == nil )
+      _frameSample = [[LynkeosStandardImageBuffer
+                                 imageBufferWithNumberOfPlanes:1
+                                                         width:size.width
+                                                        height:size.height]
+                      retain];
+
+   [item getImageSample:&_frameSample
+                 inRect:LynkeosMakeIntegerRect(0,0,size.width,size.height)];
+}
+
+- (BOOL) frameCentroid:(NSPoint*)center
+{
+   if ( ! imageCentroid( _frameSample, _rootParams->_centroidThreshold,
+                         center ) )
+      return( NO );
+
+   if ( _rootParams->_limbFit )
+   {
+      NSPoint c = *center;
+
+      // Keep the centroid if there is not enough limb
+      if ( limbCenter( _frameSample, _rootParams->_centroidThreshold, &c ) )
+         *center = c;
+   }
+
+   // Convert to the Cocoa coordinate system
+   center->y = _frameSample->_h - 1 - center->y;
+
+   return( YES );
+}
+
+- (void) prepareReferenceCentroidWithOffset:(NSPoint)offset
+{
+   double vmin, vmax;
+
+   [self readFrameOfItem:_rootParams->_referenceItem];
+   [_frameSample getMinLevel:&vmin maxLevel:&vmax];
+   _rootParams->_centroidThreshold = vmin
+                                 + _rootParams->_centroidLevel*(vmax - vmin);
+
+   if ( [self frameCentroid:&_rootParams->_referenceCentroid] )
+   {
+      _rootParams->_referenceCentroid.x += offset.x;
+      _rootParams->_referenceCentroid.y += offset.y;
+   }
+   else
+   {
+      NSLog( @"No centroid in the reference, aligning by correlation" );
+      _rootParams->_runAlignMethod = CorrelationAlign;
+   }
+}
+@end
+
+/*!
+ * @abstract Stars pattern alignment methods
+ */
+@interface MyImageAligner(Stars)
+/*!
+ * @abstract Detect the stars in the frame read last
+ * @param stars Array of K_MAX_STARS stars, in the item Cocoa coordinates
+ * @result The number of stars found
+ */
+- (u_short) frameStars:(STAR*)stars ;
+
+/*!
+ * @abstract Build the triangles index of the reference stars
+ * @param offset The offset of the reference item
+ */
+- (void) prepareReferenceStarsWithOffset:(NSPoint)offset ;
+
+/*!
+ * @abstract Register the stars of an item against the reference ones
+ * @param item The item to align
+ * @result The alignment result, nil if the registration failed
+ */
+- (LynkeosBasicAlignResult*) alignStarsOfItem:
+                                         (id <LynkeosProcessableItem>)item ;
+@end
+
+@implementation MyImageAligner(Stars)
+- (u_short) frameStars:(STAR*)stars
+{
+   const u_short n = detect_stars( _frameSample, stars, K_MAX_STARS );
+   u_short i;
+
+   // Convert to the Cocoa coordinate system
+   for( i = 0; i < n; i++ )
+      stars[i].y = _frameSample->_h - 1 - stars[i].y;
+
+   return( n );
+}
+
+- (void) prepareReferenceStarsWithOffset:(NSPoint)offset
+{
+   STAR stars[K_MAX_STARS];
+   u_short n, i;
+
+   [self readFrameOfItem:_rootParams->_referenceItem];
+   n = [self frameStars:stars];
+   for( i = 0; i < n; i++ )
+   {
+      stars[i].x += offset.x;
+      stars[i].y += offset.y;
+   }
+
+   _rootParams->_starIndex = build_star_index( stars, n );
+   if ( _rootParams->_starIndex == NULL )
+   {
+      NSLog( @"Not enough stars in the reference, aligning by correlation" );
+      _rootParams->_runAlignMethod = CorrelationAlign;
+   }
+}
+
+- (LynkeosBasicAlignResult*) alignStarsOfItem:
+                                         (id <LynkeosProcessableItem>)item
+{
+   const LynkeosIntegerSize size = [item imageSize];
+   const NSPoint c = { (double)(size.width - 1)/2.0,
+                       (double)(size.height - 1)/2.0 };
+   STAR stars[K_MAX_STARS];
+   STAR_TRANSFORM t;
+   u_short n;
+
+   [self readFrameOfItem:item];
+   n = [self frameStars:stars];
+   if ( match_stars( _rootParams->_starIndex, stars, n,
+                     _rootParams->_affineStars, &t ) == 0 )
+      return( nil );
+
+   if ( _rootParams->_affineStars )
+   {
+      LynkeosAffineAlignResult *res =
+                        [[[LynkeosAffineAlignResult alloc] init] autorelease];
+
+      res->_transform.m11 = t.a;
+      res->_transform.m21 = t.b;
+      res->_transform.m12 = t.c;
+      res->_transform.m22 = t.d;
+      res->_transform.tX = t.tx;
+      res->_transform.tY = t.ty;
+      // The translation at the image center
+      res->_alignOffset.x = c.x - (t.a*c.x + t.b*c.y + t.tx);
+      res->_alignOffset.y = c.y - (t.c*c.x + t.d*c.y + t.ty);
+
+      return( res );
+   }
+   else
+   {
+      LynkeosRotationAlignResult *res =
+                     [[[LynkeosRotationAlignResult alloc] init] autorelease];
+      const double dx = c.x - t.tx, dy = c.y - t.ty;
+
+      // Express the similarity as a rotation and scale around the center
+      res->_center = c;
+      res->_scale = hypot( t.a, t.c );
+      res->_rotation = atan2( t.c, t.a );
+      res->_alignOffset.x = (cos(res->_rotation)*dx + sin(res->_rotation)*dy)
+                            /res->_scale - c.x;
+      res->_alignOffset.y = (-sin(res->_rotation)*dx + cos(res->_rotation)*dy)
+                            /res->_scale - c.y;
+
+      return( res );
+   }
+}
+@end
+
 @implementation MyImageAligner
 
++ (void) releaseReferenceCache:(MyImageAlignerListParameters*)params
+{
+   if ( params->_referenceSpectrum != nil )
+   {
+      [params->_referenceSpectrum release];
+      params->_referenceSpectrum = nil;
+   }
+   if ( params->_referenceGridSpectrum != nil )
+   {
+      [params->_referenceGridSpectrum release];
+      params->_referenceGridSpectrum = nil;
+   }
+   if ( params->_gridValueThresholds != NULL )
+   {
+      free( params->_gridValueThresholds );
+      params->_gridValueThresholds = NULL;
+   }
+   if ( params->_referenceLogPolarSpectrum != nil )
+   {
+      [params->_referenceLogPolarSpectrum release];
+      params->_referenceLogPolarSpectrum = nil;
+   }
+   if ( params->_starIndex != NULL )
+   {
+      free_star_index( params->_starIndex );
+      params->_starIndex = NULL;
+   }
+}
+
++ (BOOL) prepareSyntheticReference:(MyImageAlignerListParameters*)params
+                           forList:(id <LynkeosImageList>)list
+                             count:(u_short)count
+{
+   NSMutableArray *items = [NSMutableArray array];
+   NSEnumerator *strider = [list imageEnumeratorStartAt:nil
+                                            directSense:YES
+                                         skipUnselected:YES];
+   const u_short nSquares = params->_multiPointGrid.width
+                            * params->_multiPointGrid.height;
+   LynkeosFourierBuffer *buf, *synth = nil, *gridBuf, *synthGrid = nil;
+   id <LynkeosProcessableItem> item;
+   u_short n;
+
+   // Keep only the items which are aligned and analyzed
+   while ( (item = [strider nextObject]) != nil )
+   {
+      if ( [item getProcessingParameterWithRef:LynkeosAlignResultRef
+                                 forProcessing:LynkeosAlignRef] != nil
+           && [item getProcessingParameterWithRef:myImageAnalyzerResultRef
+                                    forProcessing:myImageAnalyzerRef] != nil )
+         [items addObject:item];
+   }
+   if ( [items count] < 2 )
+   {
+      NSLog( @"Not enough analyzed items for a synthetic alignment reference" );
+      return( NO );
+   }
+   [items sortUsingFunction:compareQuality context:NULL];
+   if ( count > [items count] )
+      count = [items count];
+
+   for( n = 0; n < count; n++ )
+   {
+      LynkeosBasicAlignResult *align;
+      LynkeosIntegerRect r;
+      LynkeosIntegerPoint gridShift;
+      NSPoint shift;
+
+      item = [items objectAtIndex:n];
+      align = (LynkeosBasicAlignResult*)
+                       [item getProcessingParameterWithRef:LynkeosAlignResultRef
+                                             forProcessing:LynkeosAlignRef];
+
+      // Extract the square at the nearest pixel, as the aligner does
+      r.size = params->_alignSize;
+      r.origin.x = params->_alignOrigin.x
+                   - (short)floorf(align->_alignOffset.x + 0.5);
+      r.origin.y = params->_alignOrigin.y
+                   - (short)floorf(align->_alignOffset.y + 0.5);
+      shift.x = align->_alignOffset.x + (double)(r.origin.x 
+                                                 - params->_alignOrigin.x);
+      shift.y = align->_alignOffset.y + (double)(r.origin.y
+                                                 - params->_alignOrigin.y);
+      r.origin.y = [item imageSize].height - r.origin.y - r.size.height;
+
+      // The buffers stay spectra once summed, take new ones for each item
+      buf = nil;
+      [item getFourierTransform:&buf forRect:r prepareInverse:YES];
+
+      // Apply the remaining sub-pixel offset (y is flipped in the bitmap)
+      shiftSpectrum( buf, shift.x, -shift.y );
+
+      if ( synth == nil )
+         synth = [buf copy];
+      else
+      {
+         u_short x, y;
+
+         for( y = 0; y < synth->_h; y++ )
+            for( x = 0; x < synth->_halfw; x++ )
+               colorComplexValue(synth,x,y,0) += colorComplexValue(buf,x,y,0);
+      }
+
+      // The multi-point squares, at the same integer offset
+      if ( nSquares > 1 )
+      {
+         gridBuf = [LynkeosFourierBuffer fourierBufferWithNumberOfPlanes:1
+                                       width:params->_alignSize.width
+                                      height:params->_alignSize.height
+                                       batch:nSquares
+                                    withGoal: FOR_DIRECT|FOR_INVERSE];
+         gridShift.x = (short)floorf(align->_alignOffset.x + 0.5);
+         gridShift.y = (short)floorf(align->_alignOffset.y + 0.5);
+         getGridSamples( item, params, gridShift, gridBuf );
+         [gridBuf directTransform];
+         shiftSpectrum( gridBuf, shift.x, -shift.y );
+
+         if ( synthGrid == nil )
+            synthGrid = [gridBuf copy];
+         else
+         {
+            u_short x, y;
+
+            for( y = 0; y < synthGrid->_h; y++ )
+               for( x = 0; x < synthGrid->_halfw; x++ )
+                  colorComplexValue(synthGrid,x,y,0) +=
+                                            colorComplexValue(gridBuf,x,y,0);
+         }
+      }
+   }
+
+   // Normalize to the mean, for the value threshold to keep its meaning
+   for( n = 0; n < synth->_h; n++ )
+   {
+      u_short x;
+
+      for( x = 0; x < synth->_halfw; x++ )
+         colorComplexValue(synth,x,n,0) /= (REAL)count;
+   }
+   if ( synthGrid != nil )
+   {
+      for( n = 0; n < synthGrid->_h; n++ )
+      {
+         u_short x;
+
+         for( x = 0; x < synthGrid->_halfw; x++ )
+            colorComplexValue(synthGrid,x,n,0) /= (REAL)count;
+      }
+   }
+
+   if ( params->_syntheticReference != nil )
+      [params->_syntheticReference release];
+   params->_syntheticReference = synth;
+   if ( params->_syntheticGridSpectrum != nil )
+      [params->_syntheticGridSpectrum release];
+   params->_syntheticGridSpectrum = synthGrid;
+
+   return( YES );
+}
+
 + (ParallelOptimization_t) supportParallelization
 {
    return( [[NSUserDefaults standardUserDefaults] integerForKey:
@@ -216,6 +1260,33 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
    _precisionThreshold = _rootParams->_precisionThreshold
                          * _rootParams->_alignSize.width;
 
+   // Rotation alignment buffers are needed to prepare the reference
+   if ( _rootParams->_rotationAlign )
+   {
+      _rotationSample = [[LynkeosStandardImageBuffer
+                                       imageBufferWithNumberOfPlanes:1
+                                       width:_rootParams->_alignSize.width
+                                      height:_rootParams->_alignSize.height]
+                         retain];
+      _bufferWindowed = [[LynkeosFourierBuffer
+                                       fourierBufferWithNumberOfPlanes:1
+                                       width:_rootParams->_alignSize.width
+                                      height:_rootParams->_alignSize.height
+                                    withGoal: FOR_DIRECT] retain];
+      _bufferLogPolar = [[LynkeosFourierBuffer
+                                       fourierBufferWithNumberOfPlanes:1
+                                       width:_rootParams->_alignSize.width
+                                      height:_rootParams->_alignSize.height
+                                    withGoal: FOR_DIRECT|FOR_INVERSE] retain];
+   }
+   else
+   {
+      _rotationSample = nil;
+      _bufferWindowed = nil;
+      _bufferLogPolar = nil;
+   }
+   _frameSample = nil;
+
    // Prepare the reference spectrum in only one thread
    if ( [_rootParams->_refSpectrumLock tryLock] )
    {
@@ -254,23 +1325,70 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
                          - (short)floorf(align->_alignOffset.y + 0.5);
          }
 
+         // The second round places the squares with the first round
+         // results, and only correlates them
+         if ( _rootParams->_syntheticReference == nil )
+         {
+            const NSPoint refOffset =
+                        NSMakePoint(_rootParams->_alignOrigin.x - r.origin.x,
+                                    _rootParams->_alignOrigin.y - r.origin.y);
+
+            // The first round decides the align method of the run, the
+            // other threads wait for the reference before reading it
+            _rootParams->_runAlignMethod = _rootParams->_alignMethod;
+
+            // Locate the reference bright object for the centroid methods
+            if ( _rootParams->_runAlignMethod == CentroidAlign
+                 || _rootParams->_runAlignMethod == CentroidCorrelationAlign )
+               [self prepareReferenceCentroidWithOffset:refOffset];
+            // Or its stars pattern
+            else if ( _rootParams->_runAlignMethod == StarsAlign )
+               [self prepareReferenceStarsWithOffset:refOffset];
+         }
+
          // Convert the coordinate system from Cocoa to bitmap
          r.origin.y = [_rootParams->_referenceItem imageSize].height 
                        - r.origin.y - r.size.height;
 
          // Get the sample
-         [_rootParams->_referenceItem getImageSample:&refSpectrum
-                                              inRect:r];
+         if ( _rootParams->_syntheticReference != nil )
+         {
+            // Second round, against the stack of the best items
+            [refSpectrum release];
+            refSpectrum = [_rootParams->_syntheticReference copy];
+            [refSpectrum inverseTransform];
+         }
+         else
+            [_rootParams->_referenceItem getImageSample:&refSpectrum
+                                                 inRect:r];
          // Calculate the minimum valid correlation peak height
          double vmin, vmax;
          [refSpectrum getMinLevel:&vmin maxLevel:&vmax];
          _valueThreshold = (vmax-vmin)*(vmax-vmin);
+         // Prepare the rotation search while the sample is still there
+         if ( _rootParams->_rotationAlign )
+            [self prepareReferenceLogPolar:refSpectrum];
          // Get the spectrum
          [refSpectrum directTransform];
 
          // Cut the highest frequencies
          cutoffSpectrum( refSpectrum, _cutoff );
 
+         // Prepare the reference squares for the multi-point alignment
+         if ( !_rootParams->_rotationAlign
+              && _rootParams->_multiPointGrid.width
+                 * _rootParams->_multiPointGrid.height > 1 )
+         {
+            LynkeosIntegerPoint shift = {0, 0};
+
+            if ( align != nil )
+            {
+               shift.x = (short)floorf(align->_alignOffset.x + 0.5);
+               shift.y = (short)floorf(align->_alignOffset.y + 0.5);
+            }
+            [self prepareReferenceGridWithShift:shift];
+         }
+
          // The spectrum is ready to be shared
          _rootParams->_referenceSpectrum = refSpectrum;
       }
@@ -282,6 +1400,19 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
                                        width:_rootParams->_alignSize.width
                                       height:_rootParams->_alignSize.height 
                                     withGoal: FOR_DIRECT|FOR_INVERSE] retain];
+   // Rotation alignment takes precedence over multi-point alignment
+   if ( !_rootParams->_rotationAlign
+        && _rootParams->_multiPointGrid.width
+           * _rootParams->_multiPointGrid.height > 1 )
+      _bufferGridSpectrum = [[LynkeosFourierBuffer
+                                       fourierBufferWithNumberOfPlanes:1 
+                                       width:_rootParams->_alignSize.width
+                                      height:_rootParams->_alignSize.height
+                                       batch:_rootParams->_multiPointGrid.width
+                                             *_rootParams->_multiPointGrid.height
+                                    withGoal: FOR_DIRECT|FOR_INVERSE] retain];
+   else
+      _bufferGridSpectrum = nil;
 
    return( self );
 }
@@ -289,6 +1420,16 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
 - (void) dealloc
 {
    [_bufferSpectrum release];
+   if ( _bufferGridSpectrum != nil )
+      [_bufferGridSpectrum release];
+   if ( _rotationSample != nil )
+      [_rotationSample release];
+   if ( _bufferWindowed != nil )
+      [_bufferWindowed release];
+   if ( _bufferLogPolar != nil )
+      [_bufferLogPolar release];
+   if ( _frameSample != nil )
+      [_frameSample release];
    [_rootParams release];
 
    [super dealloc];
@@ -320,13 +1461,44 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
                    - (short)floorf(align->_alignOffset.y + 0.5);
    }
 
-   if ( item == _rootParams->_referenceItem )
+   // In a second round, the reference item is aligned on the best items
+   if ( item == _rootParams->_referenceItem
+        && _rootParams->_syntheticReference == nil )
    {
       // Set the reference item to 0,0 offset
-      LynkeosBasicAlignResult *res =
-                           [[[LynkeosBasicAlignResult alloc] init] autorelease];
-      res->_alignOffset.x = -r.origin.x + _rootParams->_alignOrigin.x;
-      res->_alignOffset.y = -r.origin.y + _rootParams->_alignOrigin.y;
+      LynkeosBasicAlignResult *res;
+      NSPoint offset = {-r.origin.x + _rootParams->_alignOrigin.x,
+                        -r.origin.y + _rootParams->_alignOrigin.y};
+
+      if ( _bufferGridSpectrum != nil )
+      {
+         // No local displacement for the reference
+         LynkeosIntegerRect r0 = gridSquareRect( _rootParams, [item imageSize],
+                                                 0, 0 );
+         LynkeosMultiPointAlignResult *gridRes =
+            [[[LynkeosMultiPointAlignResult alloc]
+                  initWithColumns:_rootParams->_multiPointGrid.width
+                             rows:_rootParams->_multiPointGrid.height
+                           origin:NSMakePoint(r0.origin.x+r0.size.width/2.0,
+                                              r0.origin.y+r0.size.height/2.0)
+                             step:NSMakeSize(
+                  (double)[item imageSize].width
+                  /(double)_rootParams->_multiPointGrid.width,
+                  (double)[item imageSize].height
+                  /(double)_rootParams->_multiPointGrid.height)]
+             autorelease];
+         u_short n;
+
+         for( n = 0; 
+              n < gridRes->_gridColumns*gridRes->_gridRows;
+              n++ )
+            gridRes->_displacements[n] = offset;
+         res = gridRes;
+      }
+      else
+         res = [[[LynkeosBasicAlignResult alloc] init] autorelease];
+
+      res->_alignOffset = offset;
       [item setProcessingParameter:res withRef:LynkeosAlignResultRef 
                      forProcessing:LynkeosAlignRef];
    }
@@ -335,6 +1507,8 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
       LynkeosIntegerRect extractRect;
       CORRELATION_PEAK peak;
       BOOL isAligned;
+      BOOL centroidFound = NO;
+      NSPoint centroidOffset = {0.0, 0.0};
 
       // Check the reference spectrum availability before corelating against it
       if ( _rootParams->_referenceSpectrum == nil )
@@ -344,14 +1518,77 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
          [_rootParams->_refSpectrumLock unlock];
       }
 
+      // Locate the bright object, for a coarse or final alignment. The
+      // second round squares are already placed by the first round.
+      if ( _rootParams->_syntheticReference == nil
+           && ( _rootParams->_runAlignMethod == CentroidAlign
+                || _rootParams->_runAlignMethod == CentroidCorrelationAlign ) )
+      {
+         const LynkeosIntegerSize imageSize = [item imageSize];
+         NSPoint center;
+
+         [self readFrameOfItem:item];
+         centroidFound = [self frameCentroid:&center];
+         if ( centroidFound )
+         {
+            centroidOffset.x = _rootParams->_referenceCentroid.x - center.x;
+            centroidOffset.y = _rootParams->_referenceCentroid.y - center.y;
+
+            // Place the correlation square on the coarse alignment
+            r.origin.x = _rootParams->_alignOrigin.x
+                         - (short)floorf(centroidOffset.x + 0.5);
+            r.origin.y = _rootParams->_alignOrigin.y
+                         - (short)floorf(centroidOffset.y + 0.5);
+            if ( r.origin.x < 0 )
+               r.origin.x = 0;
+            else if ( r.origin.x + r.size.width > imageSize.width )
+               r.origin.x = imageSize.width - r.size.width;
+            if ( r.origin.y < 0 )
+               r.origin.y = 0;
+            else if ( r.origin.y + r.size.height > imageSize.height )
+               r.origin.y = imageSize.height - r.size.height;
+         }
+      }
+
+      // These methods do not go through the reference square correlation
+      if ( _rootParams->_runAlignMethod == CentroidAlign
+           || _rootParams->_runAlignMethod == StarsAlign
+           || _rootParams->_rotationAlign )
+      {
+         LynkeosBasicAlignResult *res = nil;
+
+         if ( _rootParams->_runAlignMethod == CentroidAlign )
+         {
+            if ( centroidFound )
+            {
+               res = [[[LynkeosBasicAlignResult alloc] init] autorelease];
+               res->_alignOffset = centroidOffset;
+            }
+         }
+         else if ( _rootParams->_runAlignMethod == StarsAlign )
+            res = [self alignStarsOfItem:item];
+         else
+            // The rotation search includes its own translation alignment
+            res = [self alignRotationOfItem:item inRect:r];
+
+         [item setProcessingParameter:res withRef:LynkeosAlignResultRef 
+                        forProcessing:LynkeosAlignRef];
+         return;
+      }
+
       // correlate it against the reference
       extractRect = r;
       extractRect.origin.y = [item imageSize].height 
                              - extractRect.origin.y - extractRect.size.height;
-      isAligned = performAlignment( item, extractRect, _bufferSpectrum,
-                                    _rootParams->_referenceSpectrum, _cutoff,
-                                    _precisionThreshold, _valueThreshold,
-                                    &peak );
+      [item getImageSample:(LynkeosStandardImageBuffer**)&_bufferSpectrum
+                    inRect:extractRect];
+      [self inspectSample:_bufferSpectrum ofItem:item isSpectrum:NO];
+      [_bufferSpectrum directTransform];
+      [self inspectSample:_bufferSpectrum ofItem:item isSpectrum:YES];
+      isAligned = alignSpectrum( _bufferSpectrum,
+                                 _rootParams->_referenceSpectrum,
+                                 _cutoff, _precisionThreshold,
+                                 _valueThreshold, &peak );
 
       if ( isAligned && _rootParams->_checkAlignResult )
       {
@@ -421,12 +1658,21 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
 
       if ( isAligned )
       {
-         LynkeosBasicAlignResult *res =
-                           [[[LynkeosBasicAlignResult alloc] init] autorelease];
+         LynkeosBasicAlignResult *res;
+         NSPoint offset;
 
          // Beware, there is a y-flip between the bitmap and the screen
-         res->_alignOffset.x= peak.x - r.origin.x + _rootParams->_alignOrigin.x;
-         res->_alignOffset.y= -peak.y - r.origin.y +_rootParams->_alignOrigin.y;
+         offset.x = peak.x - r.origin.x + _rootParams->_alignOrigin.x;
+         offset.y = -peak.y - r.origin.y +_rootParams->_alignOrigin.y;
+
+         // Refine locally, if required
+         if ( _bufferGridSpectrum != nil )
+            res = [self alignGridOfItem:item withOffset:offset];
+         else
+         {
+            res = [[[LynkeosBasicAlignResult alloc] init] autorelease];
+            res->_alignOffset = offset;
+         }
 
          [item setProcessingParameter:res withRef:LynkeosAlignResultRef 
                         forProcessing:LynkeosAlignRef];
@@ -437,6 +1683,12 @@ static BOOL performAlignment( id <LynkeosProcessableItem> item,
    }
 }
 
+- (void) inspectSample:(LynkeosFourierBuffer*)sample
+                ofItem:(id <LynkeosProcessableItem>)item
+            isSpectrum:(BOOL)isSpectrum
+{
+}
+
 - (void) finishProcessing
 {
 }
@@ -39,6 +39,25 @@ extern NSString * const K_PREF_ALIGN_IMAGE_UPDATING;
 extern NSString * const K_PREF_ALIGN_CHECK;
 //! What kind of multiprocessor optimization to use for alignment
 extern NSString * const K_PREF_ALIGN_MULTIPROC;
+//! Number of squares along each axis for multi-point alignment
+extern NSString * const K_PREF_ALIGN_MULTIPOINT_GRID;
+//! Wether to search for a field rotation during alignment, it excludes the
+//! alignment check and the multi-point alignment
+extern NSString * const K_PREF_ALIGN_ROTATION;
+//! Wether to search also for a scale change during rotation alignment
+extern NSString * const K_PREF_ALIGN_SCALE;
+//! Number of best items stacked as reference for a second alignment round
+extern NSString * const K_PREF_ALIGN_REFINE_COUNT;
+//! Alignment method (correlation, centroid or both)
+extern NSString * const K_PREF_ALIGN_METHOD;
+//! Wether to refine the centroid by fitting the limb
+extern NSString * const K_PREF_ALIGN_LIMB_FIT;
+//! Level of the centroid threshold, relative to the reference levels
+extern NSString * const K_PREF_ALIGN_CENTROID_LEVEL;
+//! Whether the stars registration fits an affine transform
+extern NSString * const K_PREF_ALIGN_STAR_AFFINE;
+//! Whether the alignment also analyzes the items quality
+extern NSString * const K_PREF_ALIGN_ANALYZE;
 
 @interface MyImageAlignerPrefs : NSObject <LynkeosPreferences>
 {
@@ -56,6 +75,15 @@ extern NSString * const K_PREF_ALIGN_MULTIPROC;
    BOOL                       _alignImageUpdating;
    BOOL                       _alignCheck;
    ParallelOptimization_t     _alignMultiProc;
+   double                     _alignMultiPointGrid;
+   BOOL                       _alignRotation;
+   BOOL                       _alignScale;
+   double                     _alignRefineCount;
+   double                     _alignMethod;
+   BOOL                       _alignLimbFit;
+   double                     _alignCentroidLevel;
+   BOOL                       _alignStarAffine;
+   BOOL                       _alignAnalyze;
 }
 
 /*!
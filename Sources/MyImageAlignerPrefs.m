@@ -28,6 +28,15 @@ NSString * const K_PREF_ALIGN_PRECISION_THRESHOLD = @"Align precision threshold"
 NSString * const K_PREF_ALIGN_IMAGE_UPDATING = @"Align image updating";
 NSString * const K_PREF_ALIGN_CHECK = @"Align check";
 NSString * const K_PREF_ALIGN_MULTIPROC = @"Multiprocessor align";
+NSString * const K_PREF_ALIGN_MULTIPOINT_GRID = @"Align multipoint grid";
+NSString * const K_PREF_ALIGN_ROTATION = @"Align rotation";
+NSString * const K_PREF_ALIGN_SCALE = @"Align scale";
+NSString * const K_PREF_ALIGN_REFINE_COUNT = @"Align refinement count";
+NSString * const K_PREF_ALIGN_METHOD = @"Align method";
+NSString * const K_PREF_ALIGN_LIMB_FIT = @"Align limb fit";
+NSString * const K_PREF_ALIGN_CENTROID_LEVEL = @"Align centroid level";
+NSString * const K_PREF_ALIGN_STAR_AFFINE = @"Align star affine";
+NSString * const K_PREF_ALIGN_ANALYZE = @"Align with analysis";
 
 static MyImageAlignerPrefs *myImageAlignerPrefsInstance = nil;
 
@@ -46,6 +55,15 @@ static MyImageAlignerPrefs *myImageAlignerPrefsInstance = nil;
    _alignImageUpdating = YES;
    _alignCheck = NO;
    _alignMultiProc = ListThreadsOptimizations;
+   _alignMultiPointGrid = 1.0;
+   _alignRotation = NO;
+   _alignScale = NO;
+   _alignRefineCount = 0.0;
+   _alignMethod = 0.0;
+   _alignLimbFit = NO;
+   _alignCentroidLevel = 0.5;
+   _alignStarAffine = NO;
+   _alignAnalyze = NO;
 }
 
 - (void) readPrefs
@@ -69,6 +87,18 @@ static MyImageAlignerPrefs *myImageAlignerPrefsInstance = nil;
       else
          _alignMultiProc = opt;
    }
+   getNumericPref(&_alignMultiPointGrid, K_PREF_ALIGN_MULTIPOINT_GRID,
+                  1.0, 8.0);
+   _alignRotation = [user boolForKey:K_PREF_ALIGN_ROTATION];
+   _alignScale = [user boolForKey:K_PREF_ALIGN_SCALE];
+   getNumericPref(&_alignRefineCount, K_PREF_ALIGN_REFINE_COUNT,
+                  0.0, 1000.0);
+   getNumericPref(&_alignMethod, K_PREF_ALIGN_METHOD, 0.0, 3.0);
+   _alignLimbFit = [user boolForKey:K_PREF_ALIGN_LIMB_FIT];
+   getNumericPref(&_alignCentroidLevel, K_PREF_ALIGN_CENTROID_LEVEL,
+                  0.0, 1.0);
+   _alignStarAffine = [user boolForKey:K_PREF_ALIGN_STAR_AFFINE];
+   _alignAnalyze = [user boolForKey:K_PREF_ALIGN_ANALYZE];
 }
 
 - (void) updatePanel
@@ -80,6 +110,8 @@ static MyImageAlignerPrefs *myImageAlignerPrefsInstance = nil;
    [_alignImageUpdatingButton setState: 
                                 (_alignImageUpdating ? NSOnState : NSOffState)];
    [_alignCheckButton setState:(_alignCheck ? NSOnState : NSOffState)];
+   // The rotation alignment is not checked
+   [_alignCheckButton setEnabled:!_alignRotation];
    [_alignMultiProcPopup selectItemWithTag: _alignMultiProc];
 }
 @end
@@ -142,6 +174,16 @@ static MyImageAlignerPrefs *myImageAlignerPrefsInstance = nil;
    [prefs setBool:_alignImageUpdating forKey:K_PREF_ALIGN_IMAGE_UPDATING];
    [prefs setBool:_alignCheck forKey:K_PREF_ALIGN_CHECK];
    [prefs setInteger:_alignMultiProc forKey:K_PREF_ALIGN_MULTIPROC];
+   [prefs setInteger:(int)_alignMultiPointGrid
+              forKey:K_PREF_ALIGN_MULTIPOINT_GRID];
+   [prefs setBool:_alignRotation forKey:K_PREF_ALIGN_ROTATION];
+   [prefs setBool:_alignScale forKey:K_PREF_ALIGN_SCALE];
+   [prefs setInteger:(int)_alignRefineCount forKey:K_PREF_ALIGN_REFINE_COUNT];
+   [prefs setInteger:(int)_alignMethod forKey:K_PREF_ALIGN_METHOD];
+   [prefs setBool:_alignLimbFit forKey:K_PREF_ALIGN_LIMB_FIT];
+   [prefs setFloat:_alignCentroidLevel forKey:K_PREF_ALIGN_CENTROID_LEVEL];
+   [prefs setBool:_alignStarAffine forKey:K_PREF_ALIGN_STAR_AFFINE];
+   [prefs setBool:_alignAnalyze forKey:K_PREF_ALIGN_ANALYZE];
 }
 
 - (void) revertPreferences
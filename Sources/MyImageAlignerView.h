@@ -57,6 +57,9 @@
    BOOL                       _isAligning;     //!< Alignment is under process
    //! Whether to update image display after aligning each item
    BOOL                       _imageUpdate;
+   //! Number of best items to stack for a second alignment round, 0 when no
+   //! second round is pending
+   u_short                    _refineCount;
 }
 
 /*!
@@ -25,8 +25,11 @@
 #include "MyUserPrefsController.h"
 #include "LynkeosColumnDescriptor.h"
 #include "MyImageListItem.h"
+#include "star_pattern.h"
 #include "MyImageAligner.h"
 #include "MyImageAlignerPrefs.h"
+#include "MyImageAlignAnalyzer.h"
+#include "MyImageAnalyzerPrefs.h"
 #include "MyImageAlignerView.h"
 
 static NSMutableDictionary *monitorDictionary = nil;
@@ -173,6 +176,7 @@ static NSMutableDictionary *monitorDictionary = nil;
 - (void) processEnded:(NSNotification*)notif ;
 - (void) itemChanged:(NSNotification*)notif ;
 - (void) listModified:(NSNotification*)notif ;
+- (void) startAlignment:(MyImageAlignerListParameters*)listParams ;
 @end
 
 @implementation MyImageAlignerView(Private)
@@ -299,14 +303,55 @@ static NSMutableDictionary *monitorDictionary = nil;
 
 - (void) processEnded:(NSNotification*)notif
 {
+   MyImageAlignerListParameters *params = 
+      [_list getProcessingParameterWithRef:myImageAlignerParametersRef
+                             forProcessing:myImageAlignerRef];
+
+   // Clean up parameters
+   [MyImageAligner releaseReferenceCache:params];
+
+   // Realign against the best items stack, if required
+   if ( _refineCount > 1 )
+   {
+      u_short count = _refineCount;
+
+      _refineCount = 0;
+      if ( [MyImageAligner prepareSyntheticReference:params
+                                             forList:_list
+                                               count:count] )
+      {
+         [self startAlignment:params];
+         return;
+      }
+      else
+         // Keep the first round result, but tell it
+         NSRunAlertPanel(NSLocalizedString(@"RefineNotReadyTitle",
+                                      @"Alignment refinement impossible title"),
+                         NSLocalizedString(@"RefineNotReadyText",
+                                       @"Alignment refinement impossible text"),
+                         nil, nil, nil );
+   }
+   if ( params->_syntheticReference != nil )
+   {
+      [params->_syntheticReference release];
+      params->_syntheticReference = nil;
+   }
+   if ( params->_syntheticGridSpectrum != nil )
+   {
+      [params->_syntheticGridSpectrum release];
+      params->_syntheticGridSpectrum = nil;
+   }
+   if ( params->_analysisParams != nil )
+   {
+      [params->_analysisParams release];
+      params->_analysisParams = nil;
+   }
+
    // Change the button title
    [_alignButton setTitle:NSLocalizedString(@"Align",@"Align tool")];
    [_alignButton setEnabled:YES];
 
    // Reset the hilight
-   MyImageAlignerListParameters *params = 
-      [_list getProcessingParameterWithRef:myImageAlignerParametersRef
-                             forProcessing:myImageAlignerRef];
    [_window highlightItem:(MyImageListItem*)params->_referenceItem];
 
    // Register again for notifications
@@ -319,10 +364,6 @@ static NSMutableDictionary *monitorDictionary = nil;
    _isAligning = NO;
    [self highlightChange:nil];
    [_searchSideMenu setEnabled:(_sideMenuLimit > 0)];
-
-   // Clean up parameters
-   [params->_referenceSpectrum release];
-   params->_referenceSpectrum = nil;
 }
 
 - (void) itemChanged:(NSNotification*)notif
@@ -491,6 +532,21 @@ static NSMutableDictionary *monitorDictionary = nil;
                            forProcessing:myImageAlignerRef];
    }
 }
+
+- (void) startAlignment:(MyImageAlignerListParameters*)listParams
+{
+   // Get an enumerator on the images
+   NSEnumerator *strider = [_list imageEnumeratorStartAt:nil
+                                             directSense:YES
+                                          skipUnselected:YES];
+
+   // Ask the doc to align, and analyze in the same pass if required
+   [_document startProcess:(listParams->_analysisParams != nil ?
+                            [MyImageAlignAnalyzer class] :
+                            [MyImageAligner class])
+            withEnumerator:strider
+                parameters:listParams];
+}
 @end
 
 @implementation MyImageAlignerView
@@ -570,6 +626,7 @@ static NSMutableDictionary *monitorDictionary = nil;
       _imageView = nil;
       _sideMenuLimit = -1;
       _isAligning = NO;
+      _refineCount = 0;
 
       [NSBundle loadNibNamed:@"MyImageAligner" owner:self];
    }
@@ -823,7 +880,10 @@ static NSMutableDictionary *monitorDictionary = nil;
    [sender setEnabled:NO];
 
    if ( _isAligning )
+   {
+      _refineCount = 0;
       [_document stopProcess];
+   }
 
    else
    {
@@ -850,17 +910,51 @@ static NSMutableDictionary *monitorDictionary = nil;
       listParams->_cutoff =[defaults floatForKey:K_PREF_ALIGN_FREQUENCY_CUTOFF];
       listParams->_precisionThreshold = [defaults floatForKey:
                                               K_PREF_ALIGN_PRECISION_THRESHOLD];
-      listParams->_checkAlignResult = [defaults boolForKey:K_PREF_ALIGN_CHECK];
+      listParams->_rotationAlign = [defaults boolForKey:K_PREF_ALIGN_ROTATION];
+      listParams->_scaleAlign = [defaults boolForKey:K_PREF_ALIGN_SCALE];
+      // The rotation search is neither checked nor refined locally
+      listParams->_checkAlignResult = ( !listParams->_rotationAlign
+                                 && [defaults boolForKey:K_PREF_ALIGN_CHECK] );
+      u_short grid = [defaults integerForKey:K_PREF_ALIGN_MULTIPOINT_GRID];
+      if ( grid < 1 || listParams->_rotationAlign )
+         grid = 1;
+      listParams->_multiPointGrid = LynkeosMakeIntegerSize(grid,grid);
+      listParams->_alignMethod = [defaults integerForKey:K_PREF_ALIGN_METHOD];
+      listParams->_limbFit = [defaults boolForKey:K_PREF_ALIGN_LIMB_FIT];
+      listParams->_centroidLevel = [defaults floatForKey:
+                                                   K_PREF_ALIGN_CENTROID_LEVEL];
+      listParams->_affineStars = [defaults boolForKey:K_PREF_ALIGN_STAR_AFFINE];
       _imageUpdate = [defaults boolForKey:K_PREF_ALIGN_IMAGE_UPDATING];
+      // The synthetic reference does not compensate rotations, and only the
+      // correlation methods use it
+      _refineCount = (listParams->_rotationAlign
+                      || listParams->_alignMethod == StarsAlign
+                      || listParams->_alignMethod == CentroidAlign ? 0 :
+                      [defaults integerForKey:K_PREF_ALIGN_REFINE_COUNT]);
+
+      // Analyze the items quality on the alignment squares, if required
+      if ( [defaults boolForKey:K_PREF_ALIGN_ANALYZE] )
+      {
+         MyImageAnalyzerParameters *listAnalysis =
+            [_list getProcessingParameterWithRef:myImageAnalyzerParametersRef
+                                   forProcessing:myImageAnalyzerRef];
+         // The aligner has its own copy, the analyzer ones are left untouched
+         MyImageAnalyzerParameters *analysis =
+                          [[[MyImageAnalyzerParameters alloc] init] autorelease];
+
+         if ( listAnalysis != nil )
+         {
+            analysis->_analysisRect = listAnalysis->_analysisRect;
+            analysis->_method = listAnalysis->_method;
+         }
+         analysis->_lowerCutoff = [defaults floatForKey:
+                                                  K_PREF_ANALYSIS_LOWER_CUTOFF];
+         analysis->_upperCutoff = [defaults floatForKey:
+                                                  K_PREF_ANALYSIS_UPPER_CUTOFF];
+         listParams->_analysisParams = [analysis retain];
+      }
 
-      // Get an enumerator on the images
-      NSEnumerator *strider = [_list imageEnumeratorStartAt:nil
-                                                directSense:YES
-                                             skipUnselected:YES];
-
-      // Ask the doc to align
-      [_document startProcess:[MyImageAligner class] withEnumerator:strider
-                   parameters:listParams];
+      [self startAlignment:listParams];
    }
 }
 @end
@@ -62,7 +62,10 @@ extern NSString * const myAutoselectParameterRef;
 typedef enum
 {
    EntropyAnalysis,
-   SpectrumAnalysis
+   SpectrumAnalysis,
+   LaplacianAnalysis,   //!< Variance of the Laplacian
+   TenengradAnalysis,   //!< Sobel gradient energy
+   ContrastAnalysis     //!< Deviation from the 3x3 neighbourhood mean
 } MyAnalysisMethod;
 
 /*!
@@ -112,11 +115,64 @@ typedef enum
 }
 @end
 
+/*!
+ * @abstract Evaluate the quality of a sample by its power spectrum
+ * @param spectrum The sample spectrum
+ * @param down Lower frequency cutoff, in pixels
+ * @param up Upper frequency cutoff, in pixels
+ * @result The mean normalized power between the cutoffs
+ * @ingroup Processing
+ */
+extern double spectrumQuality( LynkeosFourierBuffer *spectrum, u_short down,
+                               u_short up );
+
+//! Work histogram of the entropy evaluation
+typedef struct EntropyHistogram EntropyHistogram_t;
+
+/*!
+ * @abstract Allocate a cleared histogram for the entropy evaluation
+ * @discussion Each thread shall have its own, to reuse for all its items.
+ * @result The histogram, to free with freeEntropyHistogram
+ * @ingroup Processing
+ */
+extern EntropyHistogram_t *allocEntropyHistogram( void );
+
+/*!
+ * @abstract Free an entropy evaluation histogram
+ * @param h The histogram
+ * @ingroup Processing
+ */
+extern void freeEntropyHistogram( EntropyHistogram_t *h );
+
+/*!
+ * @abstract Evaluate the quality of a sample by its entropy
+ * @discussion The pixels values are accumulated in one pass, in a
+ *   logarithmic histogram, from which the entropy is derived.
+ * @param image The sample
+ * @param h The histogram, it is left cleared for the next sample
+ * @result The entropy quality, higher for the sharpest samples
+ * @ingroup Processing
+ */
+extern double entropyQuality( LynkeosStandardImageBuffer *image,
+                              EntropyHistogram_t *h );
+
+/*!
+ * @abstract Evaluate the quality of a sample with a 3x3 stencil
+ * @discussion The stencil response is accumulated in one pass on the sample,
+ *   and normalized by the squared mean level.
+ * @param image The sample
+ * @param method One of the stencil methods (Laplacian, Tenengrad, contrast)
+ * @result The stencil quality, higher for the sharpest samples
+ * @ingroup Processing
+ */
+extern double stencilQuality( LynkeosStandardImageBuffer *image,
+                              MyAnalysisMethod method );
+
 /*!
  * @abstract Image analysis processing class
  * @ingroup Processing
  */
-@interface MyImageAnalyzer : NSObject <LynkeosProcessing>
+@interface MyImageAnalyzer : NSObject <LynkeosPipelinedProcessing>
 {
 @private
    id <LynkeosDocument> _document;  //!< The document in which we are processing
@@ -127,6 +183,8 @@ typedef enum
    double               _upperCutoff;
    //! Per thread buffer for Fourier transform
    LynkeosFourierBuffer      *_bufferSpectrum;
+   //! Per thread histogram for the entropy
+   EntropyHistogram_t  *_entropyHistogram;
 }
 
 @end
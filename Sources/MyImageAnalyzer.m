@@ -20,6 +20,8 @@
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
 
+#include <pthread.h>
+
 #include "processing_core.h"
 #include "MyImageAnalyzerPrefs.h"
 #include "MyImageAnalyzer.h"
@@ -33,6 +35,17 @@ static NSString * const K_ANALYSIS_METHOD_KEY = @"analysmethod";
 static NSString * const K_ANALYZE_RECT_KEY    = @"analysrect";
 static NSString * const K_QUALITY_KEY         = @"quality";
 
+//! Log2 of the number of entropy histogram bins per octave
+#define K_ENTROPY_SUBBINS_LOG2 6
+//! Number of entropy histogram bins per octave
+#define K_ENTROPY_SUBBINS      (1<<K_ENTROPY_SUBBINS_LOG2)
+//! Exponent of the lowest entropy histogram octave
+#define K_ENTROPY_MIN_EXP      (-32)
+//! Number of octaves in the entropy histogram
+#define K_ENTROPY_OCTAVES      64
+//! Total number of bins in the entropy histogram
+#define K_ENTROPY_BINS         (K_ENTROPY_OCTAVES*K_ENTROPY_SUBBINS)
+
 @implementation MyImageAnalyzerParameters
 - (id) init
 {
@@ -94,10 +107,8 @@ static NSString * const K_QUALITY_KEY         = @"quality";
 - (NSNumber*) quality { return( [NSNumber numberWithDouble:_quality]  ); }
 @end
 
-/*!
- * Evaluate the power spectrum quality
- */
-static double quality( LynkeosFourierBuffer *spectrum, u_short down, u_short up )
+double spectrumQuality( LynkeosFourierBuffer *spectrum, u_short down,
+                        u_short up )
 {
    u_short x, y, c;
    double q = 0.0;
@@ -134,47 +145,392 @@ static double quality( LynkeosFourierBuffer *spectrum, u_short down, u_short up
    return( q/(double)n );
 }
 
-static double entropy( LynkeosStandardImageBuffer *image, double *n )
+/*!
+ * @abstract Accumulation of the pixels values for the entropy
+ * @discussion The pixels are binned on a logarithmic scale, with
+ *    K_ENTROPY_SUBBINS bins per octave, which needs no normalization
+ *    beforehand. The exact sum of the values in each bin allows to evaluate
+ *    v.log(v) to the first order around the bin center.
+ */
+struct EntropyHistogram
 {
-   double v, e = 0, bmax = 0;
-   u_short x, y, c;
-   u_long nb = 0;
+   u_long count[K_ENTROPY_BINS];  //!< Number of pixels in each bin
+   double sum[K_ENTROPY_BINS];    //!< Sum of the pixels values in each bin
+   double sum2;                   //!< Sum of the squared pixels values
+};
 
-   // Compute the quadratic pixel sum
-   for( c = 0; c < image->_nPlanes; c++ )
+static double entropyBinValue[K_ENTROPY_BINS]; //!< Bins center value
+static double entropyBinLog[K_ENTROPY_BINS];   //!< Log of the bins center
+static pthread_once_t entropyTablesOnce = PTHREAD_ONCE_INIT;
+
+static void initEntropyTables( void )
+{
+   u_long k;
+
+   for( k = 0; k < K_ENTROPY_BINS; k++ )
+   {
+      const int e = (int)(k >> K_ENTROPY_SUBBINS_LOG2) + K_ENTROPY_MIN_EXP;
+      const double m = (double)(k & (K_ENTROPY_SUBBINS-1));
+
+      entropyBinValue[k] = ldexp( 1.0 + (m + 0.5)/K_ENTROPY_SUBBINS, e );
+      entropyBinLog[k] = log( entropyBinValue[k] );
+   }
+}
+
+/*!
+ * Bin of a (positive) value, taken from its exponent and mantissa
+ */
+static inline u_long entropyBin( REAL v )
+{
+   long e;
+   u_long m;
+#ifdef DOUBLE_PIXELS
+   uint64_t bits;
+
+   memcpy( &bits, &v, sizeof(bits) );
+   e = (long)((bits >> 52) & 0x7ff) - 1023;
+   m = (u_long)(bits >> (52 - K_ENTROPY_SUBBINS_LOG2))
+       & (K_ENTROPY_SUBBINS-1);
+#else
+   uint32_t bits;
+
+   memcpy( &bits, &v, sizeof(bits) );
+   e = (long)((bits >> 23) & 0xff) - 127;
+   m = (bits >> (23 - K_ENTROPY_SUBBINS_LOG2)) & (K_ENTROPY_SUBBINS-1);
+#endif
+
+   e -= K_ENTROPY_MIN_EXP;
+   if ( e < 0 )
+      return( 0 );
+   else if ( e >= K_ENTROPY_OCTAVES )
+      return( K_ENTROPY_BINS - 1 );
+
+   return( ((u_long)e << K_ENTROPY_SUBBINS_LOG2) | m );
+}
+
+static void entropy_lines( LynkeosStandardImageBuffer *image, u_short c,
+                           u_short y0, u_short y1, EntropyHistogram_t *h )
+{
+   u_short x, y;
+
+   for( y = y0; y < y1; y++ )
    {
-      for( y = 0; y < image->_h; y++ )
+      for( x = 0; x < image->_w; x++ )
       {
-         for( x = 0; x < image->_w; x++ )
+         const REAL v = colorValue(image,x,y,c);
+
+         if ( v > 0.0 )
          {
-            v = colorValue(image,x,y,c);
-            if ( v > 0.0 )
-               bmax += v*v;
+            const u_long k = entropyBin( v );
+
+            h->count[k]++;
+            h->sum[k] += v;
+            h->sum2 += (double)v*(double)v;
          }
       }
    }
+}
 
-   bmax = sqrt(bmax);
+EntropyHistogram_t *allocEntropyHistogram( void )
+{
+   EntropyHistogram_t *h =
+                 (EntropyHistogram_t*)calloc( 1, sizeof(EntropyHistogram_t) );
+
+   NSCAssert( h != NULL, @"Entropy histogram allocation failed" );
+   pthread_once( &entropyTablesOnce, initEntropyTables );
+
+   return( h );
+}
+
+void freeEntropyHistogram( EntropyHistogram_t *h )
+{
+   free( h );
+}
+
+double entropyQuality( LynkeosStandardImageBuffer *image,
+                       EntropyHistogram_t *h )
+{
+   double sv = 0.0, svlogv = 0.0, sum2, bmax, e, sqrt_n;
+   u_long k, nb = 0;
+   u_short c;
 
-   // Compute the entropy
    for( c = 0; c < image->_nPlanes; c++ )
+      entropy_lines( image, c, 0, image->_h, h );
+
+   // Evaluate the sum of v.log(v), and leave the histogram cleared
+   for( k = 0; k < K_ENTROPY_BINS; k++ )
+   {
+      const u_long count = h->count[k];
+      const double sum = h->sum[k];
+
+      if ( count == 0 )
+         continue;
+      h->count[k] = 0;
+      h->sum[k] = 0.0;
+
+      // First order expansion around the bin center
+      nb += count;
+      sv += sum;
+      svlogv += (double)count*entropyBinValue[k]*entropyBinLog[k]
+                + (sum - (double)count*entropyBinValue[k])
+                  *(entropyBinLog[k] + 1.0);
+   }
+   sum2 = h->sum2;
+   h->sum2 = 0.0;
+
+   if ( nb == 0 )
+      return( 0.0 );
+
+   // With b = v/bmax, -sum(b.log(b)) = (sum(v).log(bmax) - sum(v.log(v)))/bmax
+   bmax = sqrt(sum2);
+   e = (sv*log(bmax) - svlogv)/bmax;
+
+   // Maximum entropy of N pixels is sqrt(N)*log(sqrt(N))
+   sqrt_n = sqrt((double)nb);
+
+   return( (sqrt_n*log(sqrt_n) / e -  1.0) * 10.0 );
+}
+
+/*!
+ * Sums accumulated by the stencils on a line : pixels values, stencil response
+ * and its square
+ */
+typedef enum { SumValue, SumStencil, SumSquare } StencilSum_t;
+
+/*!
+ * Line accumulation function, on [x0,x1[
+ */
+typedef void (*StencilLine_t)( LynkeosStandardImageBuffer*, u_short, u_short,
+                               u_short, double* );
+
+#define P(dx,dy) colorValue(image,x+(dx),y+(dy),0) //!< Stencil pixel access
+
+static void std_laplacian_line( LynkeosStandardImageBuffer *image, u_short y,
+                                u_short x0, u_short x1, double *sums )
+{
+   u_short x;
+
+   for( x = x0; x < x1; x++ )
+   {
+      const double l = 4.0*P(0,0) - P(-1,0) - P(1,0) - P(0,-1) - P(0,1);
+
+      sums[SumValue] += P(0,0);
+      sums[SumStencil] += l;
+      sums[SumSquare] += l*l;
+   }
+}
+
+static void std_tenengrad_line( LynkeosStandardImageBuffer *image, u_short y,
+                                u_short x0, u_short x1, double *sums )
+{
+   u_short x;
+
+   // The gradient energy is not centered, its sum is left null
+   for( x = x0; x < x1; x++ )
+   {
+      const double gx = P(1,-1) + 2.0*P(1,0) + P(1,1)
+                        - P(-1,-1) - 2.0*P(-1,0) - P(-1,1);
+      const double gy = P(-1,1) + 2.0*P(0,1) + P(1,1)
+                        - P(-1,-1) - 2.0*P(0,-1) - P(1,-1);
+
+      sums[SumValue] += P(0,0);
+      sums[SumSquare] += gx*gx + gy*gy;
+   }
+}
+
+static void std_contrast_line( LynkeosStandardImageBuffer *image, u_short y,
+                               u_short x0, u_short x1, double *sums )
+{
+   u_short x;
+
+   for( x = x0; x < x1; x++ )
+   {
+      const double m = P(-1,-1) + P(0,-1) + P(1,-1)
+                       + P(-1,0) + P(0,0) + P(1,0)
+                       + P(-1,1) + P(0,1) + P(1,1);
+      const double c = P(0,0) - m/9.0;
+
+      sums[SumValue] += P(0,0);
+      sums[SumStencil] += c;
+      sums[SumSquare] += c*c;
+   }
+}
+
+#if !defined(DOUBLE_PIXELS) || defined(__i386__)
+/*!
+ * The neighbours of an aligned vector are not aligned
+ */
+static inline REALVECT load_vect( const REAL *p )
+{
+   REALVECT v;
+
+   memcpy( &v, p, sizeof(REALVECT) );
+
+   return( v );
+}
+
+#define V(dx,dy) load_vect(&P(dx,dy))  //!< Stencil vector access
+
+/*!
+ * Sum of the vector elements
+ */
+static inline double vect_sum( REALVECT v )
+{
+   const REAL * const e = (const REAL*)&v;
+
+   return( (double)e[0] + (double)e[1] + (double)e[2] + (double)e[3] );
+}
+
+static void vect_laplacian_line( LynkeosStandardImageBuffer *image, u_short y,
+                                 u_short x0, u_short x1, double *sums )
+{
+   const REALVECT four = { 4.0, 4.0, 4.0, 4.0 };
+   REALVECT sv = { 0.0, 0.0, 0.0, 0.0 }, sl = sv, sl2 = sv;
+   u_short x;
+
+   for( x = x0; x + 4 <= x1; x += 4 )
+   {
+      const REALVECT c = V(0,0);
+      const REALVECT l = four*c - V(-1,0) - V(1,0) - V(0,-1) - V(0,1);
+
+      sv += c;
+      sl += l;
+      sl2 += l*l;
+   }
+
+   sums[SumValue] += vect_sum( sv );
+   sums[SumStencil] += vect_sum( sl );
+   sums[SumSquare] += vect_sum( sl2 );
+
+   std_laplacian_line( image, y, x, x1, sums );
+}
+
+static void vect_tenengrad_line( LynkeosStandardImageBuffer *image, u_short y,
+                                 u_short x0, u_short x1, double *sums )
+{
+   const REALVECT two = { 2.0, 2.0, 2.0, 2.0 };
+   REALVECT sv = { 0.0, 0.0, 0.0, 0.0 }, sg2 = sv;
+   u_short x;
+
+   for( x = x0; x + 4 <= x1; x += 4 )
+   {
+      const REALVECT ul = V(-1,-1), ur = V(1,-1), dl = V(-1,1), dr = V(1,1);
+      const REALVECT gx = ur + two*V(1,0) + dr - ul - two*V(-1,0) - dl;
+      const REALVECT gy = dl + two*V(0,1) + dr - ul - two*V(0,-1) - ur;
+
+      sv += V(0,0);
+      sg2 += gx*gx + gy*gy;
+   }
+
+   sums[SumValue] += vect_sum( sv );
+   sums[SumSquare] += vect_sum( sg2 );
+
+   std_tenengrad_line( image, y, x, x1, sums );
+}
+
+static void vect_contrast_line( LynkeosStandardImageBuffer *image, u_short y,
+                                u_short x0, u_short x1, double *sums )
+{
+   const REALVECT ninth = { 1.0/9.0, 1.0/9.0, 1.0/9.0, 1.0/9.0 };
+   REALVECT sv = { 0.0, 0.0, 0.0, 0.0 }, sc = sv, sc2 = sv;
+   u_short x;
+
+   for( x = x0; x + 4 <= x1; x += 4 )
    {
-      for( y = 0; y < image->_h; y++ )
+      const REALVECT v = V(0,0);
+      const REALVECT c = v - (V(-1,-1) + V(0,-1) + V(1,-1)
+                              + V(-1,0) + v + V(1,0)
+                              + V(-1,1) + V(0,1) + V(1,1))*ninth;
+
+      sv += v;
+      sc += c;
+      sc2 += c*c;
+   }
+
+   sums[SumValue] += vect_sum( sv );
+   sums[SumStencil] += vect_sum( sc );
+   sums[SumSquare] += vect_sum( sc2 );
+
+   std_contrast_line( image, y, x, x1, sums );
+}
+#endif
+
+double stencilQuality( LynkeosStandardImageBuffer *image,
+                       MyAnalysisMethod method )
+{
+   StencilLine_t stencil_line = NULL;
+   double sums[3] = { 0.0, 0.0, 0.0 };
+   double n, mean;
+   u_short y;
+
+   if ( image->_w < 3 || image->_h < 3 )
+      return( 0.0 );
+
+   switch( method )
+   {
+      case LaplacianAnalysis: stencil_line = std_laplacian_line; break;
+      case TenengradAnalysis: stencil_line = std_tenengrad_line; break;
+      case ContrastAnalysis:  stencil_line = std_contrast_line; break;
+      default:
+         NSCAssert( NO, @"Invalid stencil analysis method" );
+         return( 0.0 );
+   }
+#if !defined(DOUBLE_PIXELS) || defined(__i386__)
+   if ( hasSIMD )
+   {
+      switch( method )
       {
-         for( x = 0; x < image->_w; x++ )
-         {
-            double b = colorValue(image,x,y,c)/bmax;
-            if ( b > 0.0 )
-            {
-               nb++;
-               e -= b * log(b);
-            }
-         }
+         case LaplacianAnalysis: stencil_line = vect_laplacian_line; break;
+         case TenengradAnalysis: stencil_line = vect_tenengrad_line; break;
+         case ContrastAnalysis:  stencil_line = vect_contrast_line; break;
+         default: break;
       }
    }
-   *n = (double)nb;
+#endif
+
+   // Only the pixels with all their neighbours
+   for( y = 1; y < image->_h - 1; y++ )
+      stencil_line( image, y, 1, image->_w - 1, sums );
+
+   n = (double)(image->_w - 2)*(double)(image->_h - 2);
+   mean = sums[SumValue]/n;
+   if ( mean <= 0.0 )
+      return( 0.0 );
+
+   // Variance of the stencil response, relative to the image level
+   return( (sums[SumSquare]/n - sums[SumStencil]*sums[SumStencil]/n/n)
+           / mean / mean );
+}
+
+/*!
+ * @abstract Sample to analyze in an item
+ * @param item The item to analyze
+ * @param params The analysis parameters
+ * @result The sample rectangle, in bitmap coordinates
+ */
+static LynkeosIntegerRect analysisSampleRect( id <LynkeosProcessableItem> item,
+                                           MyImageAnalyzerParameters *params )
+{
+   LynkeosIntegerRect r = params->_analysisRect;
+   id <LynkeosAlignResult> aligned =
+      (id <LynkeosAlignResult>)[item getProcessingParameterWithRef:
+                                                         LynkeosAlignResultRef
+                                                         forProcessing:
+                                                               LynkeosAlignRef];
+
+   // Take alignment into account
+   if ( aligned != nil )
+   {
+      NSPoint p = [aligned offset];
+      // Shift the crop rectangle in the opposite direction
+      r.origin.x -= (int)(p.x+0.5);
+      r.origin.y -= (int)(p.y+0.5);
+   }
+
+   // Convert from Cocoa to bitmap coordinates
+   r.origin.y = [item imageSize].height - r.origin.y - r.size.height;
 
-   return( e );
+   return( r );
 }
 
 @implementation MyImageAnalyzer
@@ -185,6 +541,15 @@ static double entropy( LynkeosStandardImageBuffer *image, double *n )
            & ListThreadsOptimizations );
 }
 
++ (BOOL) sampleRectangle:(LynkeosIntegerRect*)rect
+                 forItem:(id <LynkeosProcessableItem>)item
+              parameters:(id <NSObject>)params
+{
+   *rect = analysisSampleRect( item, (MyImageAnalyzerParameters*)params );
+
+   return( YES );
+}
+
 - (id <LynkeosProcessing>) initWithDocument: (id <LynkeosDocument>)document
                                  parameters:(id <NSObject>)params
                                   precision: (floating_precision_t)precision
@@ -212,6 +577,11 @@ static double entropy( LynkeosStandardImageBuffer *image, double *n )
          [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:1 
                           width:_params->_analysisRect.size.width
                           height:_params->_analysisRect.size.height] retain];
+   if ( _params->_method == EntropyAnalysis )
+      _entropyHistogram = allocEntropyHistogram();
+   else
+      _entropyHistogram = NULL;
+
    return( self );
 }
 
@@ -219,6 +589,8 @@ static double entropy( LynkeosStandardImageBuffer *image, double *n )
 {
    if ( _bufferSpectrum != nil )
       [_bufferSpectrum release];
+   if ( _entropyHistogram != NULL )
+      freeEntropyHistogram( _entropyHistogram );
    [_params release];
 
    [super dealloc];
@@ -228,30 +600,11 @@ static double entropy( LynkeosStandardImageBuffer *image, double *n )
 // (be lazy).
 - (void) processItem:(id <LynkeosProcessableItem>)item
 {
-   LynkeosIntegerRect r = _params->_analysisRect;
-   id <LynkeosAlignResult> aligned =
-      (id <LynkeosAlignResult>)[item getProcessingParameterWithRef:
-                                                         LynkeosAlignResultRef
-                                                         forProcessing:
-                                                               LynkeosAlignRef];
-   LynkeosIntegerSize imageSize = [item imageSize];
    MyImageAnalyzerResult *res;
-   double sqrt_n;
-
-   // Take alignment into account
-   if ( aligned != nil )
-   {
-      NSPoint p = [aligned offset];
-      // Shift the crop rectangle in the opposite direction
-      r.origin.x -= (int)(p.x+0.5);
-      r.origin.y -= (int)(p.y+0.5);
-   }
-
-   // Convert from Cocoa to bitmap coordinates
-   r.origin.y = imageSize.height - r.origin.y - r.size.height;
 
    // Get the sample in that image
-   [item getImageSample:&_bufferSpectrum inRect:r];
+   [item getImageSample:&_bufferSpectrum
+                 inRect:analysisSampleRect( item, _params )];
 
    if ( _params->_method == SpectrumAnalysis )
       [_bufferSpectrum directTransform];
@@ -261,13 +614,16 @@ static double entropy( LynkeosStandardImageBuffer *image, double *n )
    switch ( _params->_method )
    {
       case SpectrumAnalysis:
-         res->_quality = quality( _bufferSpectrum, _lowerCutoff, _upperCutoff );
+         res->_quality = spectrumQuality( _bufferSpectrum,
+                                          _lowerCutoff, _upperCutoff );
          break;
       case EntropyAnalysis:
-         // Maximum entropy of N pixels is sqrt(N)*log(sqrt(N))
-         res->_quality = entropy(_bufferSpectrum, &sqrt_n);
-         sqrt_n = sqrt(sqrt_n);
-         res->_quality = (sqrt_n*log(sqrt_n) / res->_quality -  1.0) * 10.0;
+         res->_quality = entropyQuality( _bufferSpectrum, _entropyHistogram );
+         break;
+      case LaplacianAnalysis:
+      case TenengradAnalysis:
+      case ContrastAnalysis:
+         res->_quality = stencilQuality( _bufferSpectrum, _params->_method );
          break;
       default:
          NSAssert(NO, @"Invalid analysis method");
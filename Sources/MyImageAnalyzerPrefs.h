@@ -37,6 +37,8 @@ extern NSString * const K_PREF_ANALYSIS_UPPER_CUTOFF;
 extern NSString * const K_PREF_ANALYSIS_IMAGE_UPDATING;
 //! What kind of multiprocessor optimization to use for analysis
 extern NSString * const K_PREF_ANALYSIS_MULTIPROC;
+//! Percentage of the best items to select after analysis, none if null
+extern NSString * const K_PREF_ANALYSIS_BEST_PERCENT;
 
 @interface MyImageAnalyzerPrefs : NSObject <LynkeosPreferences>
 {
@@ -52,6 +54,7 @@ extern NSString * const K_PREF_ANALYSIS_MULTIPROC;
    double                     _analysisUpperCutoff;
    BOOL                       _analysisImageUpdating;
    ParallelOptimization_t     _analysisMultiProc;   
+   double                     _analysisBestPercent;
 }
 
 /*!
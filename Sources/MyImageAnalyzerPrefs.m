@@ -27,6 +27,7 @@ NSString * const K_PREF_ANALYSIS_LOWER_CUTOFF = @"Analysis lower cutoff";
 NSString * const K_PREF_ANALYSIS_UPPER_CUTOFF = @"Analysis upper cutoff";
 NSString * const K_PREF_ANALYSIS_IMAGE_UPDATING = @"Analysis image updating";
 NSString * const K_PREF_ANALYSIS_MULTIPROC = @"Multiprocessor analysis";
+NSString * const K_PREF_ANALYSIS_BEST_PERCENT = @"Analysis best percentage";
 
 static MyImageAnalyzerPrefs *myImageAnalyzerPrefsInstance = nil;
 
@@ -44,6 +45,7 @@ static MyImageAnalyzerPrefs *myImageAnalyzerPrefsInstance = nil;
    _analysisUpperCutoff = 0.7;
    _analysisImageUpdating = NO;
    _analysisMultiProc = ListThreadsOptimizations;
+   _analysisBestPercent = 0.0;
 }
 
 - (void) readPrefs
@@ -66,6 +68,8 @@ static MyImageAnalyzerPrefs *myImageAnalyzerPrefsInstance = nil;
       else
          _analysisMultiProc = opt;
    }
+   getNumericPref(&_analysisBestPercent, K_PREF_ANALYSIS_BEST_PERCENT,
+                  0.0, 100.0);
 }
 
 - (void) updatePanel
@@ -136,6 +140,7 @@ static MyImageAnalyzerPrefs *myImageAnalyzerPrefsInstance = nil;
    [prefs setFloat:_analysisUpperCutoff forKey:K_PREF_ANALYSIS_UPPER_CUTOFF];
    [prefs setBool:_analysisImageUpdating forKey:K_PREF_ANALYSIS_IMAGE_UPDATING];
    [prefs setInteger:_analysisMultiProc forKey:K_PREF_ANALYSIS_MULTIPROC];
+   [prefs setFloat:_analysisBestPercent forKey:K_PREF_ANALYSIS_BEST_PERCENT];
 }
 
 - (void) revertPreferences
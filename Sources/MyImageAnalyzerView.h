@@ -64,6 +64,14 @@
    BOOL                       _isAnalyzing;    //!< Is analysis being processed
    //! Whether to redisplay each image after analysis
    BOOL                       _imageUpdate;
+   //! Min-heap of the best qualities of the running analysis, the root is
+   //! the worst quality to keep. NULL when no best items selection is done.
+   double                    *_bestQualities;
+   u_long                     _bestCount;      //!< Qualities in the heap
+   u_long                     _bestCapacity;   //!< Number of items to keep
+   //! Items of the running analysis which were not analyzed yet
+   u_long                     _itemsToAnalyze;
+   BOOL                       _analysisStopped; //!< Stopped by the user
 }
 
 /*!
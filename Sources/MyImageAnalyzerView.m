@@ -20,6 +20,7 @@
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
 
+#include "MyImageList.h"
 #include "MyImageListItem.h"
 #include "LynkeosColumnDescriptor.h"
 #include "MyImageAnalyzer.h"
@@ -32,6 +33,44 @@ NSString * const K_SELECT_THRESHOLD_KEY = @"selectthr";
 
 static NSMutableDictionary *monitorDictionary = nil;
 
+/*!
+ * @abstract Insert a quality in a bounded min-heap
+ * @discussion When the heap is full, the quality replaces the root if it is
+ *    better, so that the heap always contains the best qualities seen.
+ */
+static void pushBestQuality( double *heap, u_long *count, u_long capacity,
+                             double q )
+{
+   u_long i;
+
+   if ( *count < capacity )
+   {
+      // Sift up from the new leaf
+      for( i = (*count)++; i > 0 && heap[(i-1)/2] > q; i = (i-1)/2 )
+         heap[i] = heap[(i-1)/2];
+      heap[i] = q;
+   }
+   else if ( capacity > 0 && q > heap[0] )
+   {
+      // Sift down from the root
+      i = 0;
+      for( ;; )
+      {
+         u_long c = 2*i + 1;
+
+         if ( c >= capacity )
+            break;
+         if ( c + 1 < capacity && heap[c+1] < heap[c] )
+            c++;
+         if ( heap[c] >= q )
+            break;
+         heap[i] = heap[c];
+         i = c;
+      }
+      heap[i] = q;
+   }
+}
+
 /*!
  * @abstract Lightweight object for validating
  * @discussion This object monitors the document for validating the process
@@ -161,6 +200,9 @@ static NSMutableDictionary *monitorDictionary = nil;
 - (void) updateNumSelectedAndMinMax:(BOOL)minMax ;
 - (void) itemChanged:(NSNotification*)notif ;
 - (void) listModified:(NSNotification*)notif ;
+- (void) saveAutoselect:(double)threshold
+               selected:(int)numSel amongst:(int)numImages ;
+- (void) selectBestItems ;
 @end
 
 @implementation MyImageAnalyzerView(Private)
@@ -236,6 +278,15 @@ static NSMutableDictionary *monitorDictionary = nil;
 
 - (void) processEnded:(NSNotification*)notif
 {
+   // Keep only the best items, if required and if every item was analyzed
+   if ( _bestQualities != NULL )
+   {
+      if ( !_analysisStopped && _itemsToAnalyze == 0 )
+         [self selectBestItems];
+      free( _bestQualities );
+      _bestQualities = NULL;
+   }
+
    // Change the button title
    [_analyzeButton setTitle:NSLocalizedString(@"AnalyseTool",@"Analysis tool")];
    [_analyzeButton setEnabled:YES];
@@ -363,7 +414,7 @@ static NSMutableDictionary *monitorDictionary = nil;
 
    if ( _isAnalyzing )
    {
-      if ( item != nil )
+      if ( item != nil && item != _list )
       {
          MyImageAnalyzerResult *res = [item getProcessingParameterWithRef:
                                                         myImageAnalyzerResultRef
@@ -375,7 +426,12 @@ static NSMutableDictionary *monitorDictionary = nil;
                _minQuality = res->_quality;
             if ( res->_quality > _maxQuality )
                _maxQuality = res->_quality;
+            if ( _bestQualities != NULL )
+               pushBestQuality( _bestQualities, &_bestCount, _bestCapacity,
+                                res->_quality );
          }
+         if ( _itemsToAnalyze > 0 )
+            _itemsToAnalyze--;
 
          [_window highlightItem:item];
       }
@@ -416,6 +472,63 @@ static NSMutableDictionary *monitorDictionary = nil;
       [self updateNumSelectedAndMinMax:NO];
 }
 
+- (void) saveAutoselect:(double)threshold
+               selected:(int)numSel amongst:(int)numImages
+{
+   _qualityThreshold = threshold;
+
+   if ( numImages != 0 )
+   {
+      [_numSelectedTail setHidden:NO];
+      [_numSelectedText setIntValue:numSel];
+   }
+   else
+   {
+      [_numSelectedTail setHidden:YES];
+      [_numSelectedText setStringValue:@""];
+   }
+
+   // Save the autoselect parameters in the document, this notifies the
+   // selection change for the whole list at once
+   MyAutoselectParams *params = [[[MyAutoselectParams alloc] init] autorelease];
+   params->_qualityThreshold = _qualityThreshold;
+   [_list setProcessingParameter:params withRef:myAutoselectParameterRef
+                       forProcessing:myImageAnalyzerRef];
+}
+
+- (void) selectBestItems
+{
+   NSEnumerator* list;
+   MyImageListItem* item;
+   double threshold;
+   int numSel = 0, numImages = 0;
+
+   if ( _bestCount == 0 )
+      return;
+
+   // The root of the heap is the worst of the best qualities
+   threshold = _bestQualities[0];
+
+   list = [_list imageEnumerator];
+   while ( (item = [list nextObject]) != nil )
+   {
+      MyImageAnalyzerResult *res =
+                   [item getProcessingParameterWithRef:myImageAnalyzerResultRef
+                                         forProcessing:myImageAnalyzerRef];
+      BOOL selected = ( res != nil && res->_quality >= threshold );
+
+      [item setSelected:selected notify:NO];
+      numImages++;
+      if ( selected )
+         numSel++;
+   }
+
+   // One notification for the whole list
+   [(MyImageList*)_list notifyItemsModification];
+
+   [self saveAutoselect:threshold selected:numSel amongst:numImages];
+}
+
 - (void) listModified:(NSNotification*)notif
 {
    MyImageAnalyzerParameters *params =
@@ -545,8 +658,24 @@ static NSMutableDictionary *monitorDictionary = nil;
       _maxQuality = -1.0;
       _qualityThreshold = 0.0;
       _isAnalyzing = NO;
+      _bestQualities = NULL;
+      _bestCount = 0;
+      _bestCapacity = 0;
+      _itemsToAnalyze = 0;
+      _analysisStopped = NO;
 
       [NSBundle loadNibNamed:@"MyImageAnalyzer" owner:self];
+
+      // The stencil methods are not in the nib
+      [_analyzeMethodMenu addItemWithTitle:
+                   NSLocalizedString(@"LaplacianAnalysis",@"Laplacian method")];
+      [[_analyzeMethodMenu lastItem] setTag:LaplacianAnalysis];
+      [_analyzeMethodMenu addItemWithTitle:
+                   NSLocalizedString(@"TenengradAnalysis",@"Tenengrad method")];
+      [[_analyzeMethodMenu lastItem] setTag:TenengradAnalysis];
+      [_analyzeMethodMenu addItemWithTitle:
+                     NSLocalizedString(@"ContrastAnalysis",@"Contrast method")];
+      [[_analyzeMethodMenu lastItem] setTag:ContrastAnalysis];
    }
 
    return( self );
@@ -733,24 +862,7 @@ static NSMutableDictionary *monitorDictionary = nil;
          numSel++;
    }
 
-   _qualityThreshold = selectThreshold;
-
-   if ( numImages != 0 )
-   {
-      [_numSelectedTail setHidden:NO];
-      [_numSelectedText setIntValue:numSel];
-   }
-   else
-   {
-      [_numSelectedTail setHidden:YES];
-      [_numSelectedText setStringValue:@""];
-   }
-
-   // Save the autoselect parameters in the document
-   MyAutoselectParams *params = [[[MyAutoselectParams alloc] init] autorelease];
-   params->_qualityThreshold = _qualityThreshold;
-   [_list setProcessingParameter:params withRef:myAutoselectParameterRef
-                       forProcessing:myImageAnalyzerRef];
+   [self saveAutoselect:selectThreshold selected:numSel amongst:numImages];
 }
 
 - (IBAction) analyzeAction :(id)sender
@@ -762,7 +874,11 @@ static NSMutableDictionary *monitorDictionary = nil;
    [sender setEnabled:NO];
 
    if ( _isAnalyzing )
+   {
+      // The partial results shall not change the selection
+      _analysisStopped = YES;
       [_document stopProcess];
+   }
 
    else
    {
@@ -791,6 +907,30 @@ static NSMutableDictionary *monitorDictionary = nil;
                                                   K_PREF_ANALYSIS_UPPER_CUTOFF];
       _imageUpdate = [defaults boolForKey:K_PREF_ANALYSIS_IMAGE_UPDATING];
 
+      // Prepare the best items selection
+      NSEnumerator *items = [_list imageEnumerator];
+      double bestPercent = 0.0;
+      u_long n = 0;
+
+      getNumericPref( &bestPercent, K_PREF_ANALYSIS_BEST_PERCENT,
+                      0.0, 100.0 );
+      while ( [items nextObject] != nil )
+         n++;
+      _itemsToAnalyze = n;
+      _analysisStopped = NO;
+      if ( _bestQualities != NULL )
+      {
+         free( _bestQualities );
+         _bestQualities = NULL;
+      }
+      if ( bestPercent > 0.0 )
+      {
+         _bestCapacity = (u_long)ceil( (double)n*bestPercent/100.0 );
+         _bestCount = 0;
+         if ( _bestCapacity > 0 )
+            _bestQualities = (double*)malloc( _bestCapacity*sizeof(double) );
+      }
+
       // Get an enumerator on the images
       NSEnumerator *strider = [_list imageEnumerator];
 
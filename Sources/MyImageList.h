@@ -70,6 +70,12 @@
  */
 - (BOOL) changeItemSelection :(MyImageListItem*)item value:(BOOL)v ;
 
+/*!
+ * @abstract Notify once of a change in many items of the list
+ * @discussion Used after items were modified without notification.
+ */
+- (void) notifyItemsModification ;
+
 /*!
  * @abstract Set the parent object for parameters chain
  * @param parent The parent of this item in the parameter chain
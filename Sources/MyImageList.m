@@ -395,6 +395,11 @@ static NSString * const K_DECONV_THRESHOLD_KEY	= @"dthreshold";
    return( YES );
 }
 
+- (void) notifyItemsModification
+{
+   [_parameters notifyItemModification:self];
+}
+
 - (void) setParametersParent :(LynkeosProcessingParameterMgr*)parent
 {
    if ( _parameters->_parent != nil )
@@ -96,7 +96,7 @@
 
 - (NSArray *) allObjects
 {
-   NSMutableArray *array = [NSArray array];
+   NSMutableArray *array = [NSMutableArray array];
    id item;
 
    [_lock lock];
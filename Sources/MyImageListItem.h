@@ -70,6 +70,11 @@ extern NSString * const myImageListItemFlatField;   ///< Flat field param key
 
    id <LynkeosImageBuffer> _flat;         //!< Cached flat field
    id <LynkeosImageBuffer> _dark;         //!< Cached dark frame
+
+   //! Sample read ahead for the next processing, if any
+   LynkeosStandardImageBuffer* _preparedSample;
+   LynkeosIntegerRect _preparedRect;      //!< Rectangle of that sample
+   NSLock*            _preparedLock;      //!< Protects the prepared sample
 }
 
 /*!
@@ -178,6 +183,36 @@ extern NSString * const myImageListItemFlatField;   ///< Flat field param key
  */
 - (void) setSelected :(BOOL)value;
 
+/*!
+ * @abstract Set the selection state, optionally without notification
+ * @discussion When changing many items at once, the caller notifies once for
+ *    the whole list afterwards.
+ * @param value The new selection state
+ * @param notify Whether to notify of the change
+ */
+- (void) setSelected :(BOOL)value notify:(BOOL)notify ;
+
+/*!
+ * @abstract Read and calibrate a sample ahead of its processing
+ * @discussion The sample is kept until the next call to getImageSample:inRect:
+ *    which uses it if the rectangle is the same, and then forgets it.
+ * @param rect The sample rectangle, in bitmap coordinates
+ */
+- (void) prepareImageSampleInRect:(LynkeosIntegerRect)rect ;
+
+/*!
+ * @abstract Forget the sample read ahead, as it will not be processed
+ */
+- (void) discardPreparedImageSample ;
+
+/*!
+ * @abstract Warm the caches with the image, which will be read soon
+ * @discussion An image file is read ahead by the system, and a movie frame is
+ *    decoded in the movie cache, if its reader is able to.
+ * @result The number of bytes read ahead by the system
+ */
+- (u_long) prefetchImage ;
+
 /*!
  * @abstract Set the parent object for parameters chain
  * @param parent The parent of this item in the parameter chain
@@ -20,6 +20,11 @@
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
 #import <AppKit/NSCell.h>
 
 #include "LynkeosStandardImageBufferAdditions.h"
@@ -59,6 +64,40 @@ static NSString * const  K_QUALITY_KEY = @"quality";
 // A bad hack for relative URL resolution (until I find a better solution)
 extern NSString *basePath;
 
+/*!
+ * @abstract Ask the system to read a file ahead in its cache
+ * @discussion The read is asynchronous, this only gives the hint.
+ * @param path The file path
+ * @result The file size, zero if it could not be read
+ */
+static u_long adviseFileRead( const char *path )
+{
+   struct stat st;
+   u_long size = 0;
+   int fd = open( path, O_RDONLY );
+
+   if ( fd < 0 )
+      return( 0 );
+
+   if ( fstat( fd, &st ) == 0 && st.st_size > 0 )
+   {
+#ifdef F_RDADVISE
+      struct radvisory advice;
+
+      advice.ra_offset = 0;
+      advice.ra_count = (st.st_size > INT_MAX ? INT_MAX : (int)st.st_size);
+      if ( fcntl( fd, F_RDADVISE, &advice ) != -1 )
+         size = st.st_size;
+#else
+      if ( posix_fadvise( fd, 0, st.st_size, POSIX_FADV_WILLNEED ) == 0 )
+         size = st.st_size;
+#endif
+   }
+   close( fd );
+
+   return( size );
+}
+
 /*!
  * @category MyImageListItem(private)
  * @abstract Internal methods
@@ -316,6 +355,8 @@ extern NSString *basePath;
 
       _flat = nil;
       _dark = nil;
+      _preparedSample = nil;
+      _preparedLock = [[NSLock alloc] init];
    }
 
    return( self );
@@ -368,6 +409,9 @@ extern NSString *basePath;
       [_dark release];
    if ( _flat != nil )
       [_flat release];
+   if ( _preparedSample != nil )
+      [_preparedSample release];
+   [_preparedLock release];
 
    [super dealloc];
 }
@@ -446,6 +490,9 @@ extern NSString *basePath;
 {
    if ( (self = [super initWithCoder:decoder]) != nil )
    {
+      _preparedSample = nil;
+      _preparedLock = [[NSLock alloc] init];
+
       // Try absolute and doc relative URL resolution
       NSFileManager *fManager = [NSFileManager defaultManager];
       NSURL *itemURL = [decoder decodeObjectForKey:K_URL_KEY];
@@ -630,6 +677,11 @@ extern NSString *basePath;
 }
 
 - (void) setSelected :(BOOL)value
+{
+   [self setSelected:value notify:YES];
+}
+
+- (void) setSelected :(BOOL)value notify:(BOOL)notify
 {
    _selection_state = value ? NSOnState : NSOffState;
 
@@ -640,7 +692,7 @@ extern NSString *basePath;
 
       // Propagate that state on all the images
       while ( (item = [list nextObject]) != nil )
-         [item setSelected:value];
+         [item setSelected:value notify:notify];
    }
    else
    {
@@ -651,7 +703,8 @@ extern NSString *basePath;
    }
 
    // Notify for some change
-   [_parameters notifyItemModification:self];
+   if ( notify )
+      [_parameters notifyItemModification:self];
 }
 
 - (void) setParametersParent :(LynkeosProcessingParameterMgr*)parent;
@@ -709,6 +762,8 @@ extern NSString *basePath;
                  inRect:(LynkeosIntegerRect)rect
 {
    id <LynkeosImageBuffer> data = nil;
+   LynkeosStandardImageBuffer *sample;
+   BOOL sameRect;
    LynkeosIntegerRect wRect;
    void * const * planes;
    u_short x, y, c;
@@ -718,6 +773,40 @@ extern NSString *basePath;
    // No image sample should be retrieved at movie level
    NSAssert( _childList == nil, @"getImageSample called at movie level" );
 
+   // Use the sample read ahead, if it is the one asked. Only one thread
+   // takes it, the others read the image
+   [_preparedLock lock];
+   sample = _preparedSample;
+   _preparedSample = nil;
+   sameRect = ( rect.origin.x == _preparedRect.origin.x
+                && rect.origin.y == _preparedRect.origin.y
+                && rect.size.width == _preparedRect.size.width
+                && rect.size.height == _preparedRect.size.height );
+   [_preparedLock unlock];
+
+   if ( sample != nil )
+   {
+      if ( sameRect )
+      {
+         if ( *buffer == nil )
+            *buffer = [sample autorelease];
+         else
+         {
+            NSAssert( (*buffer)->_w == rect.size.width
+                      && (*buffer)->_h == rect.size.height,
+                      @"Sample size inconsistency" );
+            [sample extractSample:[*buffer colorPlanes]
+                              atX:0 Y:0
+                        withWidth:rect.size.width height:rect.size.height
+                       withPlanes:(*buffer)->_nPlanes
+                        lineWidth:(*buffer)->_padw];
+            [sample release];
+         }
+         return;
+      }
+      [sample release];
+   }
+
    // Create an image buffer if needed
    if ( *buffer == nil )
       *buffer = [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
@@ -869,6 +958,59 @@ extern NSString *basePath;
                     lineWidth:transBuf->_padw];
 }
 
+- (void) prepareImageSampleInRect:(LynkeosIntegerRect)rect
+{
+   LynkeosStandardImageBuffer *sample = nil, *previous;
+
+   [self discardPreparedImageSample];
+   [self getImageSample:&sample inRect:rect];
+
+   [_preparedLock lock];
+   previous = _preparedSample;
+   _preparedSample = [sample retain];
+   _preparedRect = rect;
+   [_preparedLock unlock];
+
+   if ( previous != nil )
+      [previous release];
+}
+
+- (u_long) prefetchImage
+{
+   // Nothing to read for a movie, or a processed image
+   if ( _childList != nil
+        || _processedImage != nil || _processedSpectrum != nil )
+      return( 0 );
+
+   if ( _index != NON_SIGNIFICANT_INDEX )
+   {
+      // Movie image, decoded in the movie cache
+      if ( [_reader conformsToProtocol:
+                                    @protocol(LynkeosPrefetchingMovieReader)] )
+         [(id <LynkeosPrefetchingMovieReader>)_reader
+                                                  prefetchFrameAtIndex:_index];
+      return( 0 );
+   }
+
+   if ( _itemURL == nil || ![_itemURL isFileURL] )
+      return( 0 );
+
+   return( adviseFileRead( [[_itemURL path] fileSystemRepresentation] ) );
+}
+
+- (void) discardPreparedImageSample
+{
+   LynkeosStandardImageBuffer *sample;
+
+   [_preparedLock lock];
+   sample = _preparedSample;
+   _preparedSample = nil;
+   [_preparedLock unlock];
+
+   if ( sample != nil )
+      [sample release];
+}
+
 - (void) setImage:(LynkeosStandardImageBuffer*)buffer
 {
    [super setImage:buffer];
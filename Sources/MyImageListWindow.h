@@ -181,6 +181,7 @@ extern NSString * const toolbarProcPrefix;
 // Input output
 - (IBAction) saveStackedImage :(id)sender ;
 - (IBAction) exportMovie :(id)sender ;
+- (IBAction) liveStackAction :(id)sender ;
 //@}
 @end
 
@@ -176,6 +176,9 @@ typedef enum { K_UP, K_DOWN } enumeration_direction_t;
       if ( parent != nil )
          [_textView reloadItem:parent reloadChildren:NO];
    }
+   else if ( item == (MyImageListItem*)_currentList )
+      // Many items were changed at once
+      [_textView reloadData];
 }
 
 - (void) listModified:(NSNotification*)notif
@@ -600,6 +603,13 @@ typedef enum { K_UP, K_DOWN } enumeration_direction_t;
       case K_EXPORT_MOVIE_TAG:
          return( _dataMode == ListData && !_isProcessing
                  && [[_currentList imageArray] count] != 0 );
+      case K_LIVE_STACK_TAG:
+      {
+         BOOL isLive = [(MyDocument*)[self document] isLiveStacking];
+
+         [menuItem setState:(isLive ? NSOnState : NSOffState)];
+         return( isLive || (_listMode == ImageMode && !_isProcessing) );
+      }
       case K_UNDO_TAG:
       case K_REDO_TAG:
          return( !_isProcessing );
@@ -1377,4 +1387,30 @@ typedef enum { K_UP, K_DOWN } enumeration_direction_t;
 {
 }
 
+- (void) liveStackAction :(id)sender
+{
+   MyDocument *doc = (MyDocument*)[self document];
+   NSOpenPanel* panel;
+
+   if ( [doc isLiveStacking] )
+   {
+      [doc stopLiveStack];
+      return;
+   }
+
+   // Ask the user to choose the capture directory
+   panel = [NSOpenPanel openPanel];
+   [panel setCanChooseFiles:NO];
+   [panel setCanChooseDirectories:YES];
+   [panel setAllowsMultipleSelection:NO];
+   if ( [panel runModalForTypes:nil] == NSOKButton
+        && ![doc startLiveStackFromDirectory:
+                                          [[panel filenames] objectAtIndex:0]] )
+      NSRunAlertPanel(NSLocalizedString(@"LiveStackNotReadyTitle",
+                                        @"Live stack not ready alert title"),
+                      NSLocalizedString(@"LiveStackNotReadyText",
+                                        @"Live stack not ready alert text"),
+                      nil, nil, nil );
+}
+
 @end
@@ -30,6 +30,7 @@
 #import <Foundation/Foundation.h>
 
 #include "LynkeosProcessing.h"
+#include "LynkeosProcessingView.h"
 
 #include "MyImageList.h"
 
@@ -45,6 +46,12 @@ extern NSString * const myImageStackerRef;
  */
 extern NSString * const myImageStackerParametersRef;
 
+/*!
+ * @abstract Reference for reading/setting the standard stack accumulator.
+ * @ingroup Processing
+ */
+extern NSString * const myImageStackerAccumulatorRef;
+
 /*!
  * @abstract Mode of stacking
  * @ingroup Processing
@@ -53,7 +60,11 @@ typedef enum
 {
    Stacking_Standard,
    Stacking_Sigma_Reject,
-   Stacking_Extremum
+   Stacking_Extremum,
+   Stacking_Percentile,
+   Stacking_Drizzle,
+   Stacking_Weighted,
+   Stacking_Sigma_Clip
 } Stack_Mode_t;
 
 /*!
@@ -67,6 +78,8 @@ typedef enum
    NormalizeStack       //!< Normalize so that max value = 1
 } PostStack_t;
 
+@protocol MyImageStackerModeStrategy;
+
 /*!
  * @abstract Stacking parameters
  * @discussion The parameters are stored at list level.
@@ -89,16 +102,43 @@ typedef enum
       {
          float          threshold;       //!< Standard deviation rejection thr.
          u_short        pass;            //!< Current pass
+         //! Values kept by pixel for the single pass, two passes if null
+         u_short        reservoir;
       } sigma;
       //! Parameters for "extremum (min/max)" mode
       struct extremum
       {
          BOOL           maxValue;        //!< Wether to keep min or max
       } extremum;
+      //! Parameters for "percentile" mode
+      struct percentile
+      {
+         float          value;           //!< Percentile to keep, 50 is median
+      } percentile;
+      //! Parameters for "drizzle" mode
+      struct drizzle
+      {
+         float          pixfrac;         //!< Drop size, relative to a pixel
+         float          scale;           //!< Output pixels per input pixel
+      } drizzle;
+      //! Parameters for "quality weighted" mode
+      struct weighted
+      {
+         float          exponent;        //!< Weight is quality power exponent
+      } weighted;
+      //! Parameters for "iterative sigma clipping" mode
+      struct clip
+      {
+         float          kappa;           //!< Standard deviations to keep
+         u_short        iterations;      //!< Maximum number of clippings
+         BOOL           winsorized;      //!< Clamp rather than reject
+      } clip;
    }                    _method;
 
    NSLock*              _stackLock;       //!< Lock for orderly recombination
    unsigned             _livingThreads;   //!< How many stacking threads
+   //! Partial stack of an ended thread, waiting to be combined with another
+   NSObject <MyImageStackerModeStrategy> *_pendingStack;
    unsigned long        _imagesStacked;   //!< Total number of images stacked
 }
 @end
@@ -110,9 +150,22 @@ typedef enum
 @protocol MyImageStackerModeStrategy
 - (id) initWithParameters: (id <NSObject>)params
                      list:(id <LynkeosImageList>)list;
+/*!
+ * @abstract Stack an image
+ * @param image The image to stack
+ * @param offsets The offsets of each plane, in the expanded image pixels
+ * @param weight The weight of this image, ignored by the unweighted modes
+ */
 - (void) processImage: (id <LynkeosImageBuffer>)image
-         withOffsets: (NSPoint*)offsets ;
-- (void) finishOneProcessingThreadInList:(id <LynkeosImageList>)list ;
+         withOffsets: (NSPoint*)offsets
+              weight: (double)weight ;
+/*!
+ * @abstract Combine the partial stack of another thread into this one
+ * @discussion This is called without any lock held, the other strategy is
+ *    not used anymore by its thread.
+ * @param stack The strategy of the other thread
+ */
+- (void) mergeStack:(NSObject <MyImageStackerModeStrategy>*)stack ;
 - (void) finishAllProcessingInList: (id <LynkeosImageList>)list;
 - (LynkeosStandardImageBuffer*) stackingResult ;
 @end
@@ -129,6 +182,32 @@ typedef enum
 }
 @end
 
+/*!
+ * @abstract Raw sums of the last standard stack
+ * @discussion They are stored at list level, so that a new stack of the same
+ *    list only adds the newly selected images and substracts the deselected
+ *    ones. The record of each stacked item allows to detect the changes which
+ *    require a complete stack. They are transient, and not saved with the
+ *    document.
+ * @ingroup Processing
+ */
+@interface MyImageStackerAccumulator : NSObject <LynkeosProcessingParameter>
+{
+@public
+   LynkeosStandardImageBuffer* _monoSum; //!< Sum of the mono images
+   LynkeosStandardImageBuffer* _rgbSum;  //!< Sum of the RGB images
+   unsigned long        _nImages;         //!< Number of images in the sums
+   LynkeosIntegerRect   _cropRectangle;   //!< Crop rectangle of the sums
+   u_short              _factor;          //!< Expansion factor of the sums
+   id                   _darkFrame;       //!< Dark frame used, if any
+   id                   _flatField;       //!< Flat field used, if any
+   //! Record of the items in the sums, keyed by the item address
+   NSMutableDictionary* _items;
+   //! Address of the items to substract in the stack under way
+   NSSet*               _removed;
+}
+@end
+
 /*!
  * @abstract Stacker class
  * @discussion This class is able to stack on parallel threads.<br>
@@ -136,7 +215,7 @@ typedef enum
  *    (ie: one mono and one RGB per thread) are all recombined at the end.
  * @ingroup Processing
  */
-@interface MyImageStacker : NSObject <LynkeosProcessing>
+@interface MyImageStacker : NSObject <LynkeosPipelinedProcessing>
 {
 @private
    id <LynkeosDocument> _document;  //!< The document in which we are processing
@@ -146,8 +225,22 @@ typedef enum
    MyImageStackerParameters   *_params;     //!< Stacking parameters
    LynkeosStandardImageBuffer *_monoBuffer; //!< Buffer for reading mono images
    LynkeosStandardImageBuffer *_rgbBuffer;  //!< Buffer for reading RGB images
+   //! Buffer for reading the image part to resample, when not rigidly aligned
+   LynkeosStandardImageBuffer *_warpBuffer;
    unsigned long        _imagesStacked;     //!< Number stacked in this thread
+   //! Address of the items to substract from the previous standard stack
+   NSSet                *_removedItems;
 }
+
+/*!
+ * @abstract Prepare the stack of a list
+ * @discussion It initializes the stacking parameters for the list mode.
+ * @param list The list to stack
+ * @param mode The mode of this list
+ * @result An enumerator on the items to stack
+ */
++ (NSEnumerator*) prepareStackOfList:(id <LynkeosImageList>)list
+                              inMode:(ListMode_t)mode ;
 @end
 
 #endif
\ No newline at end of file
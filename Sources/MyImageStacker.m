@@ -20,14 +20,29 @@
 // Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
 
+#include "LynkeosObjectCache.h"
+#include "LynkeosStandardImageBufferAdditions.h"
+#include "LynkeosBasicAlignResult.h"
 #include "MyUserPrefsController.h"
 #include "MyChromaticAlignerView.h"
 #include "MyImageStackerPrefs.h"
+#include "MyImageAnalyzer.h"
+#include "MyImageListEnumerator.h"
 #include "MyImageStacker.h"
 
 #include "MyImageStacker_Standard.h"
 #include "MyImageStacker_SigmaReject.h"
+#include "MyImageStacker_SigmaStream.h"
 #include "MyImageStacker_Extrema.h"
+#include "MyImageStacker_Percentile.h"
+#include "MyImageStacker_Drizzle.h"
+#include "MyImageStacker_Weighted.h"
+#include "MyImageStacker_SigmaClip.h"
+
+//! Spill memory of the single pass sigma reject, without an images cache
+#define K_SIGMA_SPILL_BUDGET (256*1024*1024)
+//! Below this number of values kept by pixel, the two passes are used
+#define K_SIGMA_MIN_RESERVOIR 2
 
 static NSString * const K_CROP_RECTANGLE_KEY = @"crop";
 static NSString * const K_SIZE_FACTOR_KEY    = @"sizef";
@@ -35,10 +50,285 @@ static NSString * const K_MONOFLAT_KEY       = @"monoflat";
 static NSString * const K_STACK_METHOD_KEY   = @"method";
 static NSString * const K_SIGMA_THRESHOLD_KEY= @"sigmaThreshold";
 static NSString * const K_MIN_MAX_KEY        = @"extremumMinMax";
+static NSString * const K_PERCENTILE_KEY     = @"percentile";
+static NSString * const K_DRIZZLE_PIXFRAC_KEY = @"drizzlePixfrac";
+static NSString * const K_DRIZZLE_SCALE_KEY  = @"drizzleScale";
+static NSString * const K_WEIGHT_EXPONENT_KEY = @"weightExponent";
+static NSString * const K_CLIP_KAPPA_KEY     = @"clipKappa";
+static NSString * const K_CLIP_ITERATIONS_KEY = @"clipIterations";
+static NSString * const K_CLIP_WINSORIZED_KEY = @"clipWinsorized";
 
 NSString * const myImageStackerRef = @"MyImageStacker";
 NSString * const myImageStackerParametersRef = @"StackerParams";
 NSString * const myImageStackerListRef = @"ListToStack";
+NSString * const myImageStackerAccumulatorRef = @"StackAccumulator";
+
+
+/*!
+ * @abstract Bilinear interpolation of a pixel value
+ * @discussion Coordinates outside of the image are clamped to its border
+ */
+static inline REAL interpolatedValue( LynkeosStandardImageBuffer *image,
+                                      u_short c, double x, double y )
+{
+   long ix, iy, ix1, iy1;
+   REAL ax, ay;
+
+   if ( x < 0.0 )
+      x = 0.0;
+   else if ( x > image->_w - 1 )
+      x = image->_w - 1;
+   if ( y < 0.0 )
+      y = 0.0;
+   else if ( y > image->_h - 1 )
+      y = image->_h - 1;
+
+   ix = (long)x;
+   iy = (long)y;
+   ix1 = (ix + 1 < image->_w ? ix + 1 : ix);
+   iy1 = (iy + 1 < image->_h ? iy + 1 : iy);
+   ax = x - ix;
+   ay = y - iy;
+
+   return( (colorValue(image,ix,iy,c)*(1.0-ax) + colorValue(image,ix1,iy,c)*ax)
+           *(1.0-ay)
+           + (colorValue(image,ix,iy1,c)*(1.0-ax)
+              + colorValue(image,ix1,iy1,c)*ax)*ay );
+}
+
+//! Distance between the nodes of the mesh on which the alignment is evaluated
+#define K_WARP_MESH_STEP 8
+
+/*!
+ * @abstract Resample an image sample through a non rigid alignment
+ * @discussion The sample coordinates of each pixel are interpolated between
+ *   the nodes of a mesh. This is exact for rotation and scaling, which are
+ *   affine transforms.
+ * @param image The image sample
+ * @param warped The buffer receiving the resampled image
+ * @param mesh The sample coordinates of each mesh node
+ * @param meshWidth Number of mesh nodes in a row
+ */
+static void warpSample( LynkeosStandardImageBuffer *image,
+                        LynkeosStandardImageBuffer *warped,
+                        const NSPoint *mesh, u_short meshWidth )
+{
+   u_short x, y, c;
+
+   for( y = 0; y < warped->_h; y++ )
+   {
+      const u_short j = y/K_WARP_MESH_STEP;
+      const double fy = (double)(y%K_WARP_MESH_STEP)/(double)K_WARP_MESH_STEP;
+      const NSPoint *row0 = &mesh[j*meshWidth], *row1 = &mesh[(j+1)*meshWidth];
+
+      for( x = 0; x < warped->_w; x++ )
+      {
+         const u_short i = x/K_WARP_MESH_STEP;
+         const double fx =
+                      (double)(x%K_WARP_MESH_STEP)/(double)K_WARP_MESH_STEP;
+         double sx = (row0[i].x*(1.0-fx) + row0[i+1].x*fx)*(1.0-fy)
+                     + (row1[i].x*(1.0-fx) + row1[i+1].x*fx)*fy;
+         double sy = (row0[i].y*(1.0-fx) + row0[i+1].y*fx)*(1.0-fy)
+                     + (row1[i].y*(1.0-fx) + row1[i+1].y*fx)*fy;
+
+         for( c = 0; c < warped->_nPlanes; c++ )
+            colorValue(warped,x,y,c) = interpolatedValue( image, c, sx, sy );
+      }
+   }
+}
+
+/*!
+ * @abstract Values kept by pixel for the single pass sigma reject
+ * @discussion Each list thread keeps the greatest and lowest values of every
+ *    pixel. Together, they shall fit in the memory given to the images.
+ * @param params The stacking parameters
+ * @param reservoir The number of values asked in the preferences
+ * @result The number of values to keep, 0 for the two passes method
+ */
+static u_short sigmaReservoir( MyImageStackerParameters *params,
+                               u_short reservoir )
+{
+   LynkeosObjectCache *imageCache = [LynkeosObjectCache imageProcessingCache];
+   const double budget = (imageCache != nil ? (double)[imageCache capacity]
+                                            : (double)K_SIGMA_SPILL_BUDGET);
+   // Memory taken by each value kept by pixel, in every thread
+   const double valueSize = 2.0*sizeof(REAL)
+                            *(params->_monochromeStack ? 1.0 : 3.0)
+                            *params->_cropRectangle.size.width*params->_factor
+                            *params->_cropRectangle.size.height*params->_factor
+                            *(numberOfCpus > 1 ? numberOfCpus : 1);
+   u_short fit;
+
+   if ( reservoir == 0 || valueSize <= 0.0
+        || (double)reservoir*valueSize <= budget )
+      return( reservoir );
+
+   fit = (u_short)(budget/valueSize);
+   if ( fit < K_SIGMA_MIN_RESERVOIR )
+   {
+      NSLog( @"Not enough memory for the single pass sigma reject, "
+             @"stacking in two passes" );
+      return( 0 );
+   }
+
+   NSLog( @"Sigma reject keeps %u values by pixel instead of %u",
+          fit, reservoir );
+   return( fit );
+}
+
+/*!
+ * @abstract Sample to stack, for an item aligned by a translation
+ * @param item The item to stack
+ * @param alignRes Its alignment result
+ * @param params The stacking parameters
+ * @param shift Receives the integer shift of the crop rectangle
+ * @param p Receives the exact shift of the crop rectangle
+ * @result The sample rectangle, in bitmap coordinates
+ */
+static LynkeosIntegerRect translatedSampleRect(
+                                          id <LynkeosProcessableItem> item,
+                                          id <LynkeosAlignResult> alignRes,
+                                          MyImageStackerParameters *params,
+                                          LynkeosIntegerPoint *shift,
+                                          NSPoint *p )
+{
+   LynkeosIntegerRect r = params->_cropRectangle;
+
+   // Get the image part to add
+   *p = [alignRes offset];
+   p->x *= -1;	// Shift the crop rectangle in the opposite side
+   p->y *= -1;
+
+   // Crop at integer pixels
+   shift->x = (p->x < 0 ? (int)(p->x-1) : (int)p->x);
+   shift->y = (p->y < 0 ? (int)(p->y-1) : (int)p->y);
+   r.origin.x += shift->x;
+   r.origin.y += shift->y;
+
+   // Convert to bitmap coordinate system
+   r.origin.y = [item imageSize].height - r.origin.y - r.size.height;
+
+   return( r );
+}
+
+/*!
+ * @abstract Private methods
+ */
+@interface MyImageStacker(Private)
+/*!
+ * @abstract Read the part of an item matching the stacked rectangle, through
+ *   a non rigid alignment
+ * @param image Buffer which receives the resampled image
+ * @param item The item to read
+ * @param align Its alignment result
+ */
+- (void) getWarpedSample:(LynkeosStandardImageBuffer**)image
+                  ofItem:(id <LynkeosProcessableItem>)item
+               alignedBy:(id <LynkeosAlignResult>)align ;
+@end
+
+@implementation MyImageStacker(Private)
+- (void) getWarpedSample:(LynkeosStandardImageBuffer**)image
+                  ofItem:(id <LynkeosProcessableItem>)item
+               alignedBy:(id <LynkeosAlignResult>)align
+{
+   const LynkeosIntegerRect crop = _params->_cropRectangle;
+   const u_short mw = (crop.size.width+K_WARP_MESH_STEP-1)/K_WARP_MESH_STEP+1,
+                 mh = (crop.size.height+K_WARP_MESH_STEP-1)/K_WARP_MESH_STEP+1;
+   NSPoint *mesh = (NSPoint*)malloc( mw*mh*sizeof(NSPoint) );
+   double xmin = HUGE, xmax = -HUGE, ymin = HUGE, ymax = -HUGE;
+   const LynkeosIntegerSize imageSize = [item imageSize];
+   LynkeosIntegerRect r;
+   long x0, y0, x1, y1;
+   u_short i, j;
+
+   // Where are the mesh nodes in the image
+   for( j = 0; j < mh; j++ )
+   {
+      for( i = 0; i < mw; i++ )
+      {
+         NSPoint p = { crop.origin.x + i*K_WARP_MESH_STEP,
+                       crop.origin.y + crop.size.height - 1
+                       - j*K_WARP_MESH_STEP };
+         NSPoint s = [align correctedCoordinatesFor:p];
+
+         mesh[j*mw+i] = s;
+         if ( s.x < xmin )
+            xmin = s.x;
+         if ( s.x > xmax )
+            xmax = s.x;
+         if ( s.y < ymin )
+            ymin = s.y;
+         if ( s.y > ymax )
+            ymax = s.y;
+      }
+   }
+
+   // Read the image part which covers them, with a margin for interpolation,
+   // clipped to the image (the interpolation clamps to the border)
+   x0 = (long)floor(xmin) - 1;
+   y0 = (long)floor(ymin) - 1;
+   x1 = (long)ceil(xmax) + 2;
+   y1 = (long)ceil(ymax) + 2;
+   if ( x0 < 0 )
+      x0 = 0;
+   else if ( x0 > imageSize.width - 1 )
+      x0 = imageSize.width - 1;
+   if ( y0 < 0 )
+      y0 = 0;
+   else if ( y0 > imageSize.height - 1 )
+      y0 = imageSize.height - 1;
+   if ( x1 > imageSize.width )
+      x1 = imageSize.width;
+   else if ( x1 <= x0 )
+      x1 = x0 + 1;
+   if ( y1 > imageSize.height )
+      y1 = imageSize.height;
+   else if ( y1 <= y0 )
+      y1 = y0 + 1;
+   r = LynkeosMakeIntegerRect( x0, y0, x1 - x0, y1 - y0 );
+
+   if ( _warpBuffer != nil
+        && ( _warpBuffer->_w != r.size.width || _warpBuffer->_h != r.size.height
+             || _warpBuffer->_nPlanes != [item numberOfPlanes] ) )
+   {
+      [_warpBuffer release];
+      _warpBuffer = nil;
+   }
+   LynkeosStandardImageBuffer *sampleBefore = _warpBuffer;
+   [item getImageSample:&_warpBuffer
+                 inRect:LynkeosMakeIntegerRect(r.origin.x,
+                                         imageSize.height - r.origin.y
+                                         - r.size.height,
+                                         r.size.width, r.size.height)];
+   if ( sampleBefore == nil && _warpBuffer != nil )
+      [_warpBuffer retain];  // It was autoreleased by the item
+
+   // Convert the nodes to the sample bitmap coordinates
+   for( j = 0; j < mw*mh; j++ )
+   {
+      mesh[j].x -= r.origin.x;
+      mesh[j].y = r.origin.y + r.size.height - 1 - mesh[j].y;
+   }
+
+   if ( *image == nil
+        || (*image)->_w != crop.size.width || (*image)->_h != crop.size.height
+        || (*image)->_nPlanes != _warpBuffer->_nPlanes )
+   {
+      if ( *image != nil )
+         [*image release];
+      *image = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                        _warpBuffer->_nPlanes
+                                                    width:crop.size.width
+                                                   height:crop.size.height]
+                retain];
+   }
+
+   warpSample( _warpBuffer, *image, mesh, mw );
+
+   free( mesh );
+}
+@end
 
 @implementation MyImageStackerParameters
 - (id) init
@@ -51,6 +341,7 @@ NSString * const myImageStackerListRef = @"ListToStack";
       _stackMethod = Stacking_Standard;
       _postStack = NoPostStack;
       _monochromeStack = NO;
+      _pendingStack = nil;
    }
 
    return( self );
@@ -83,6 +374,25 @@ NSString * const myImageStackerListRef = @"ListToStack";
          [encoder encodeBool:_method.extremum.maxValue
                       forKey:K_MIN_MAX_KEY];
          break;
+      case Stacking_Percentile:
+         [encoder encodeFloat:_method.percentile.value forKey:K_PERCENTILE_KEY];
+         break;
+      case Stacking_Drizzle:
+         [encoder encodeFloat:_method.drizzle.pixfrac
+                       forKey:K_DRIZZLE_PIXFRAC_KEY];
+         [encoder encodeFloat:_method.drizzle.scale forKey:K_DRIZZLE_SCALE_KEY];
+         break;
+      case Stacking_Weighted:
+         [encoder encodeFloat:_method.weighted.exponent
+                       forKey:K_WEIGHT_EXPONENT_KEY];
+         break;
+      case Stacking_Sigma_Clip:
+         [encoder encodeFloat:_method.clip.kappa forKey:K_CLIP_KAPPA_KEY];
+         [encoder encodeInt:_method.clip.iterations
+                     forKey:K_CLIP_ITERATIONS_KEY];
+         [encoder encodeBool:_method.clip.winsorized
+                      forKey:K_CLIP_WINSORIZED_KEY];
+         break;
       default:
          NSAssert( NO, @"Invalid stacking mode" );
    }
@@ -113,6 +423,27 @@ NSString * const myImageStackerListRef = @"ListToStack";
             _method.extremum.maxValue =
                [decoder decodeBoolForKey:K_MIN_MAX_KEY];
             break;
+         case Stacking_Percentile:
+            _method.percentile.value =
+               [decoder decodeFloatForKey:K_PERCENTILE_KEY];
+            break;
+         case Stacking_Drizzle:
+            _method.drizzle.pixfrac =
+               [decoder decodeFloatForKey:K_DRIZZLE_PIXFRAC_KEY];
+            _method.drizzle.scale =
+               [decoder decodeFloatForKey:K_DRIZZLE_SCALE_KEY];
+            break;
+         case Stacking_Weighted:
+            _method.weighted.exponent =
+               [decoder decodeFloatForKey:K_WEIGHT_EXPONENT_KEY];
+            break;
+         case Stacking_Sigma_Clip:
+            _method.clip.kappa = [decoder decodeFloatForKey:K_CLIP_KAPPA_KEY];
+            _method.clip.iterations =
+               [decoder decodeIntForKey:K_CLIP_ITERATIONS_KEY];
+            _method.clip.winsorized =
+               [decoder decodeBoolForKey:K_CLIP_WINSORIZED_KEY];
+            break;
       }
    }
 
@@ -131,13 +462,296 @@ NSString * const myImageStackerListRef = @"ListToStack";
 }
 @end
 
+@implementation MyImageStackerAccumulator
+- (id) init
+{
+   self = [super init];
+   if ( self != nil )
+   {
+      _monoSum = nil;
+      _rgbSum = nil;
+      _nImages = 0;
+      _cropRectangle = LynkeosMakeIntegerRect(0,0,0,0);
+      _factor = 1;
+      _darkFrame = nil;
+      _flatField = nil;
+      _items = [[NSMutableDictionary alloc] init];
+      _removed = nil;
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   if ( _monoSum != nil )
+      [_monoSum release];
+   if ( _rgbSum != nil )
+      [_rgbSum release];
+   if ( _darkFrame != nil )
+      [_darkFrame release];
+   if ( _flatField != nil )
+      [_flatField release];
+   [_items release];
+   if ( _removed != nil )
+      [_removed release];
+
+   [super dealloc];
+}
+
+// The sums are transient, they are not saved with the document
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+}
+
+// Documents saved with the sums get an empty accumulator, never reused
+- (id)initWithCoder:(NSCoder *)decoder
+{
+   return( [self init] );
+}
+@end
+
+/*!
+ * @abstract Record of what an item was stacked with
+ */
+static NSArray *stackedItemRecord( id <LynkeosProcessableItem> item )
+{
+   id align = [item getProcessingParameterWithRef:LynkeosAlignResultRef
+                                    forProcessing:LynkeosAlignRef];
+   id chroma = [item getProcessingParameterWithRef:myChromaticAlignerOffsetsRef
+                                     forProcessing:myChromaticAlignerRef];
+
+   if ( align == nil )
+      return( nil );
+
+   return( [NSArray arrayWithObjects:item, align,
+                                     (chroma != nil ? chroma : [NSNull null]),
+                                     nil] );
+}
+
+/*!
+ * @abstract Whether an item is still stacked as recorded
+ */
+static BOOL isSameRecord( NSArray *record1, NSArray *record2 )
+{
+   return( [record1 objectAtIndex:1] == [record2 objectAtIndex:1]
+           && [record1 objectAtIndex:2] == [record2 objectAtIndex:2] );
+}
+
+/*!
+ * @abstract Enumerator on the images to stack
+ * @discussion When only the selection has changed since the previous standard
+ *    stack, it enumerates only the changed items, and the deselected ones are
+ *    marked in the accumulator, for substraction.
+ */
+static NSEnumerator *stackEnumeratorForList( id <LynkeosImageList> list,
+                                             MyImageStackerParameters *params )
+{
+   MyImageStackerAccumulator *acc =
+      [list getProcessingParameterWithRef:myImageStackerAccumulatorRef
+                            forProcessing:myImageStackerRef];
+   id dark = [list getProcessingParameterWithRef:myImageListItemDarkFrame
+                                   forProcessing:nil];
+   id flat = [list getProcessingParameterWithRef:myImageListItemFlatField
+                                   forProcessing:nil];
+   NSEnumerator *strider = [list imageEnumeratorStartAt:nil
+                                             directSense:YES
+                                          skipUnselected:YES];
+   NSMutableDictionary *items;
+   NSMutableArray *changed;
+   NSMutableSet *removed;
+   NSEnumerator *keys;
+   NSValue *key;
+   id <LynkeosProcessableItem> item;
+
+   // Only the standard stack can be updated
+   if ( params->_stackMethod != Stacking_Standard
+        || params->_postStack != MeanStack )
+   {
+      if ( acc != nil )
+         [list setProcessingParameter:nil
+                              withRef:myImageStackerAccumulatorRef
+                        forProcessing:myImageStackerRef];
+      return( strider );
+   }
+
+   // Record what the aligned images are to be stacked with
+   items = [NSMutableDictionary dictionary];
+   while ( (item = [strider nextObject]) != nil )
+   {
+      NSArray *record = stackedItemRecord( item );
+
+      if ( record != nil )
+         [items setObject:record
+                   forKey:[NSValue valueWithNonretainedObject:item]];
+   }
+
+   // Find out the changes since the previous stack, if it can be updated
+   changed = nil;
+   removed = nil;
+   if ( acc != nil && (acc->_monoSum != nil || acc->_rgbSum != nil)
+        && acc->_cropRectangle.origin.x == params->_cropRectangle.origin.x
+        && acc->_cropRectangle.origin.y == params->_cropRectangle.origin.y
+        && acc->_cropRectangle.size.width == params->_cropRectangle.size.width
+        && acc->_cropRectangle.size.height
+                                       == params->_cropRectangle.size.height
+        && acc->_factor == params->_factor
+        && acc->_darkFrame == dark && acc->_flatField == flat )
+   {
+      changed = [NSMutableArray array];
+      removed = [NSMutableSet set];
+
+      keys = [items keyEnumerator];
+      while ( changed != nil && (key = [keys nextObject]) != nil )
+      {
+         NSArray *old = [acc->_items objectForKey:key];
+
+         if ( old == nil )
+            [changed addObject:[key nonretainedObjectValue]];
+         else if ( ! isSameRecord( old, [items objectForKey:key] ) )
+            changed = nil;    // Realigned, its contribution is unknown
+      }
+
+      keys = [acc->_items keyEnumerator];
+      while ( changed != nil && (key = [keys nextObject]) != nil )
+      {
+         if ( [items objectForKey:key] == nil )
+         {
+            NSArray *old = [acc->_items objectForKey:key];
+            NSArray *record = stackedItemRecord( [old objectAtIndex:0] );
+
+            if ( record == nil || ! isSameRecord( old, record ) )
+               changed = nil;
+            else
+            {
+               [changed addObject:[old objectAtIndex:0]];
+               [removed addObject:key];
+            }
+         }
+      }
+
+      // Updating is worthwile only if less images are read
+      if ( changed != nil && [changed count] >= [items count] )
+         changed = nil;
+   }
+
+   if ( changed == nil )
+   {
+      // Stack everything in new sums
+      acc = [[[MyImageStackerAccumulator alloc] init] autorelease];
+      acc->_cropRectangle = params->_cropRectangle;
+      acc->_factor = params->_factor;
+      acc->_darkFrame = [dark retain];
+      acc->_flatField = [flat retain];
+      strider = [list imageEnumeratorStartAt:nil
+                                 directSense:YES
+                              skipUnselected:YES];
+   }
+   else
+   {
+      // Only process the changes
+      acc->_removed = [removed retain];
+      strider = [[[MyImageListEnumerator alloc] initWithImageList:changed]
+                                                                  autorelease];
+   }
+   [acc->_items setDictionary:items];
+   [list setProcessingParameter:acc
+                        withRef:myImageStackerAccumulatorRef
+                  forProcessing:myImageStackerRef];
+
+   return( strider );
+}
+
 @implementation MyImageStacker
 
 + (ParallelOptimization_t) supportParallelization
 {
-   return( [[NSUserDefaults standardUserDefaults] integerForKey:
+   // The strategies use parallelized operators, mainly for the final steps
+   return( ([[NSUserDefaults standardUserDefaults] integerForKey:
                                                          K_PREF_STACK_MULTIPROC]
-           & ListThreadsOptimizations);
+            & ListThreadsOptimizations)
+           | ImageOperatorsOptimization );
+}
+
++ (BOOL) sampleRectangle:(LynkeosIntegerRect*)rect
+                 forItem:(id <LynkeosProcessableItem>)item
+              parameters:(id <NSObject>)params
+{
+   id <LynkeosAlignResult> alignRes =
+      (id <LynkeosAlignResult>)[item getProcessingParameterWithRef:
+                                                         LynkeosAlignResultRef
+                                          forProcessing:LynkeosAlignRef];
+   MyImageStackerParameters *stackParams =
+      [((MyImageStackerList*)params)->_list
+                       getProcessingParameterWithRef:myImageStackerParametersRef
+                                       forProcessing:myImageStackerRef];
+   LynkeosIntegerPoint shift;
+   NSPoint p;
+
+   // The resampled images are read in processItem
+   if ( alignRes == nil || stackParams == nil
+        || ![(NSObject*)alignRes isMemberOfClass:
+                                             [LynkeosBasicAlignResult class]] )
+      return( NO );
+
+   *rect = translatedSampleRect( item, alignRes, stackParams, &shift, &p );
+
+   return( YES );
+}
+
++ (NSEnumerator*) prepareStackOfList:(id <LynkeosImageList>)list
+                              inMode:(ListMode_t)mode
+{
+   MyImageStackerParameters *params =
+      [list getProcessingParameterWithRef:myImageStackerParametersRef
+                            forProcessing:myImageStackerRef];
+   double reservoir;
+
+   NSAssert( params != nil, @"Stack start without stacking parameters" );
+
+   // Initialize the stacking parameters
+   switch( mode )
+   {
+      case ImageMode:
+      case DarkFrameMode:
+         switch(params->_stackMethod)
+         {
+            case Stacking_Standard:
+               params->_postStack = MeanStack;
+               break;
+            case Stacking_Sigma_Reject:
+               params->_postStack = NoPostStack;
+               params->_method.sigma.pass = 1;
+               // Read through the preference bounds
+               reservoir = 0.0;
+               getNumericPref( &reservoir, K_PREF_STACK_SIGMA_RESERVOIR,
+                               0.0, 64.0 );
+               params->_method.sigma.reservoir =
+                                 sigmaReservoir( params, (u_short)reservoir );
+               break;
+            case Stacking_Extremum:
+               params->_postStack = NoPostStack;
+               break;
+            case Stacking_Percentile:
+            case Stacking_Drizzle:
+            case Stacking_Weighted:
+            case Stacking_Sigma_Clip:
+               params->_postStack = NoPostStack;
+               break;
+            default:
+               NSAssert( NO, @"Invalid stacking method" );
+         }
+         break;
+      case FlatFieldMode:
+         params->_postStack = NormalizeStack;
+         break;
+      default:
+         NSAssert1( NO, @"Invalid list mode %d", mode );
+   }
+   params->_imagesStacked = 0;
+   params->_livingThreads = 0;
+
+   return( stackEnumeratorForList( list, params ) );
 }
 
 - (id <LynkeosProcessing>) initWithDocument: (id <LynkeosDocument>)document
@@ -160,26 +774,60 @@ NSString * const myImageStackerListRef = @"ListToStack";
    NSAssert( _params != nil, @"Failed to find stack parameters" );
    _monoBuffer = nil;
    _rgbBuffer = nil;
+   _warpBuffer = nil;
    _imagesStacked = 0;
+   _removedItems = nil;
 
    // Allocate the strategy
    switch ( _params->_stackMethod )
    {
       case Stacking_Standard:
+      {
+         MyImageStackerAccumulator *acc =
+            [_list getProcessingParameterWithRef:myImageStackerAccumulatorRef
+                                   forProcessing:myImageStackerRef];
+         if ( acc != nil && acc->_removed != nil )
+            _removedItems = [acc->_removed retain];
          _stackingStrategy =
             [[MyImageStacker_Standard alloc] initWithParameters:_params
                                                            list:_list];
          break;
+      }
       case Stacking_Sigma_Reject:
-         _stackingStrategy =
-            [[MyImageStacker_SigmaReject alloc] initWithParameters:_params
-                                                              list:_list];
+         if ( _params->_method.sigma.reservoir != 0 )
+            _stackingStrategy =
+               [[MyImageStacker_SigmaStream alloc] initWithParameters:_params
+                                                                 list:_list];
+         else
+            _stackingStrategy =
+               [[MyImageStacker_SigmaReject alloc] initWithParameters:_params
+                                                                 list:_list];
          break;
       case Stacking_Extremum:
          _stackingStrategy =
             [[MyImageStacker_Extrema alloc] initWithParameters:_params
                                                           list:_list];
          break;
+      case Stacking_Percentile:
+         _stackingStrategy =
+            [[MyImageStacker_Percentile alloc] initWithParameters:_params
+                                                             list:_list];
+         break;
+      case Stacking_Drizzle:
+         _stackingStrategy =
+            [[MyImageStacker_Drizzle alloc] initWithParameters:_params
+                                                          list:_list];
+         break;
+      case Stacking_Weighted:
+         _stackingStrategy =
+            [[MyImageStacker_Weighted alloc] initWithParameters:_params
+                                                           list:_list];
+         break;
+      case Stacking_Sigma_Clip:
+         _stackingStrategy =
+            [[MyImageStacker_SigmaClip alloc] initWithParameters:_params
+                                                            list:_list];
+         break;
       default:
          NSAssert( NO, @"Invalid stacking method" );
    }
@@ -197,6 +845,10 @@ NSString * const myImageStackerListRef = @"ListToStack";
       [_monoBuffer release];
    if ( _rgbBuffer != nil )
       [_rgbBuffer release];
+   if ( _warpBuffer != nil )
+      [_warpBuffer release];
+   if ( _removedItems != nil )
+      [_removedItems release];
    [_stackingStrategy release];
 
    [super dealloc];
@@ -213,36 +865,34 @@ NSString * const myImageStackerListRef = @"ListToStack";
 
    if ( alignRes != nil )
    {
-      LynkeosIntegerRect r = _params->_cropRectangle;
-      LynkeosIntegerPoint shift;
-      NSPoint p = [alignRes offset];
+      LynkeosIntegerPoint shift = {0, 0};
+      NSPoint p = {0.0, 0.0};
       LynkeosStandardImageBuffer **image;
       NSPoint offsets[3];
+      double weight;
       u_short c;
 
-      // Get the image part to add
-      p.x *= -1;	// Shift the crop rectangle in the opposite side
-      p.y *= -1;
-
-      shift.x = (p.x < 0 ? (int)(p.x-1) : (int)p.x);   // Crop at integer pixels
-      shift.y = (p.y < 0 ? (int)(p.y-1) : (int)p.y);
-      r.origin.x += shift.x;
-      r.origin.y += shift.y;
-
-      // Convert to bitmap coordinate system
-      r.origin.y = [item imageSize].height - r.origin.y - r.size.height;
-
       // Work on variables according to planearity
       if ( [item numberOfPlanes] == 1 )
          image = &_monoBuffer;
       else
          image = &_rgbBuffer;
 
-      // Create a buffer from the calibrated image
-      LynkeosStandardImageBuffer *imageBefore = *image;
-      [item getImageSample:image inRect:r];
-      if ( imageBefore == nil && *image != nil )
-         [*image retain];  // It was autoreleased by the item
+      if ( [(NSObject*)alignRes isMemberOfClass:
+                                           [LynkeosBasicAlignResult class]] )
+      {
+         LynkeosIntegerRect r = translatedSampleRect( item, alignRes, _params,
+                                                      &shift, &p );
+
+         // Create a buffer from the calibrated image
+         LynkeosStandardImageBuffer *imageBefore = *image;
+         [item getImageSample:image inRect:r];
+         if ( imageBefore == nil && *image != nil )
+            [*image retain];  // It was autoreleased by the item
+      }
+      else
+         // Rotation or local distortions, the resampled image needs no offset
+         [self getWarpedSample:image ofItem:item alignedBy:alignRes];
 
       // Take the chromatic dispersion correction into account
       MyChromaticAlignParameter *chroma =
@@ -262,8 +912,31 @@ NSString * const myImageStackerListRef = @"ListToStack";
          }
       }
 
+      // The weight is given by the image quality, if it was analyzed
+      weight = 1.0;
+      if ( _params->_stackMethod == Stacking_Weighted )
+      {
+         MyImageAnalyzerResult *quality =
+            [item getProcessingParameterWithRef:myImageAnalyzerResultRef
+                                  forProcessing:myImageAnalyzerRef];
+
+         if ( quality != nil )
+            weight = ( quality->_quality > 0.0 ?
+                       pow( quality->_quality,
+                            _params->_method.weighted.exponent ) :
+                       0.0 );
+      }
+
       // Accumulate
-      [_stackingStrategy processImage:*image withOffsets:offsets];
+      if ( _removedItems != nil
+           && [_removedItems containsObject:
+                               [NSValue valueWithNonretainedObject:item]] )
+         // Deselected since the previous stack
+         [(MyImageStacker_Standard*)_stackingStrategy removeImage:*image
+                                                      withOffsets:offsets];
+      else
+         [_stackingStrategy processImage:*image withOffsets:offsets
+                                  weight:weight];
       _imagesStacked++;
 
       // As the item is not modified, force a notification
@@ -273,17 +946,36 @@ NSString * const myImageStackerListRef = @"ListToStack";
 
 - (void) finishProcessing
 {
-   // Take control of the list
-   [_params->_stackLock lock];
+   BOOL isLast;
 
-   // Finish the processing for this thread
-   [_stackingStrategy finishOneProcessingThreadInList:_list];
+   [_params->_stackLock lock];
 
    _params->_imagesStacked += _imagesStacked;   
 
-   // Finalize everything if we are the last thread
+   // Combine the partial stacks two by two, out of the lock, so that the
+   // threads ending together perform their merges in parallel
+   while ( _params->_pendingStack != nil )
+   {
+      NSObject <MyImageStackerModeStrategy> *partial = _params->_pendingStack;
+      _params->_pendingStack = nil;
+      [_params->_stackLock unlock];
+
+      [_stackingStrategy mergeStack:partial];
+      [partial release];
+
+      [_params->_stackLock lock];
+   }
+
+   // Leave our stack to the threads still running, if any
    _params->_livingThreads--;
-   if ( _params->_livingThreads == 0 )
+   isLast = (_params->_livingThreads == 0);
+   if ( !isLast )
+      _params->_pendingStack = [_stackingStrategy retain];
+
+   [_params->_stackLock unlock];
+
+   // Finalize everything if we are the last thread
+   if ( isLast )
    {
       double b = 0.0, w = -1.0;
 
@@ -324,7 +1016,5 @@ NSString * const myImageStackerListRef = @"ListToStack";
       if ( w > b )
          [_list setBlackLevel:b whiteLevel:w gamma:1.0];
    }
-
-   [_params->_stackLock unlock];
 }
 @end
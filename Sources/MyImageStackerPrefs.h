@@ -33,6 +33,10 @@
 extern NSString * const K_PREF_STACK_IMAGE_UPDATING;
 //! What kind of multiprocessor optimization to use for stacking
 extern NSString * const K_PREF_STACK_MULTIPROC;
+//! Values kept by pixel for a single pass sigma reject, two passes if null
+extern NSString * const K_PREF_STACK_SIGMA_RESERVOIR;
+//! Seconds between two updates of the live stack
+extern NSString * const K_PREF_LIVE_STACK_INTERVAL;
 
 @interface MyImageStackerPrefs : NSObject <LynkeosPreferences>
 {
@@ -42,6 +46,8 @@ extern NSString * const K_PREF_STACK_MULTIPROC;
 
    BOOL                       _stackImageUpdating;
    ParallelOptimization_t     _stackMultiProc;
+   double                     _stackSigmaReservoir;
+   double                     _liveStackInterval;
 }
 
 /*!
@@ -25,6 +25,8 @@
 
 NSString * const K_PREF_STACK_IMAGE_UPDATING = @"Stack image updating";
 NSString * const K_PREF_STACK_MULTIPROC = @"Multiprocessor stack";
+NSString * const K_PREF_STACK_SIGMA_RESERVOIR = @"Stack sigma reservoir";
+NSString * const K_PREF_LIVE_STACK_INTERVAL = @"Live stack refresh interval";
 
 static MyImageStackerPrefs *myImageStackerPrefsInstance = nil;
 
@@ -40,6 +42,8 @@ static MyImageStackerPrefs *myImageStackerPrefsInstance = nil;
    // Set the factory defaults
    _stackImageUpdating = NO;
    _stackMultiProc = ListThreadsOptimizations;
+   _stackSigmaReservoir = 0.0;
+   _liveStackInterval = 5.0;
 }
 
 - (void) readPrefs
@@ -56,6 +60,10 @@ static MyImageStackerPrefs *myImageStackerPrefsInstance = nil;
       _stackMultiProc = (opt == NoParallelOptimization ?
                          opt : ListThreadsOptimizations );
    }
+   getNumericPref(&_stackSigmaReservoir, K_PREF_STACK_SIGMA_RESERVOIR,
+                  0.0, 64.0);
+   getNumericPref(&_liveStackInterval, K_PREF_LIVE_STACK_INTERVAL,
+                  1.0, 600.0);
 }
 
 - (void) updatePanel
@@ -120,6 +128,9 @@ static MyImageStackerPrefs *myImageStackerPrefsInstance = nil;
 {
    [prefs setBool:_stackImageUpdating forKey:K_PREF_STACK_IMAGE_UPDATING];
    [prefs setInteger:_stackMultiProc forKey:K_PREF_STACK_MULTIPROC];
+   [prefs setInteger:(int)_stackSigmaReservoir
+              forKey:K_PREF_STACK_SIGMA_RESERVOIR];
+   [prefs setFloat:_liveStackInterval forKey:K_PREF_LIVE_STACK_INTERVAL];
 }
 
 - (void) revertPreferences
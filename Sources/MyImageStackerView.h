@@ -52,6 +52,16 @@
    IBOutlet NSSlider*         _sigmaRejectSlider; //!< Slider level
    //! Selection between min/max stacking
    IBOutlet NSMatrix*         _minMaxMatrix;
+   NSTextField*               _percentileText;   //!< Text percentile
+   NSSlider*                  _percentileSlider; //!< Slider percentile
+   NSTextField*               _drizzlePixfracText; //!< Drizzle drop size
+   NSTextField*               _drizzleScaleText;   //!< Drizzle output scale
+   NSTextField*               _weightText;   //!< Text quality weight exponent
+   NSSlider*                  _weightSlider; //!< Slider quality weight exponent
+   NSTextField*               _clipKappaText;   //!< Text clipping threshold
+   NSSlider*                  _clipKappaSlider; //!< Slider clipping threshold
+   NSTextField*               _clipIterationsText; //!< Maximum clippings
+   NSButton*                  _clipWinsorizedCheckBox; //!< Winsorized clipping
 
    IBOutlet NSButton*	      _stackButton;       //!< Start stacking
    IBOutlet NSView*           _panel;             //!< Our view
@@ -64,7 +74,7 @@
    BOOL                       _isStacking;        //!< Stacking under process
    //! Whether to refresh each image once processed in the stack
    BOOL                       _imageUpdate;
-   BOOL                       _stackedImagesNb;   //!< Number of stacked images
+   u_long                     _stackedImagesNb;   //!< Number of stacked images
 }
 
 /*!
@@ -97,6 +107,26 @@
  * @param sender The control originating the change
  */
 - (IBAction) minMaxChange:(id)sender ;
+/*!
+ * @abstract Change the percentile to keep
+ * @param sender The control originating the change
+ */
+- (IBAction) percentileChange:(id)sender ;
+/*!
+ * @abstract Change the drizzle drop size or output scale
+ * @param sender The control originating the change
+ */
+- (IBAction) drizzleChange:(id)sender ;
+/*!
+ * @abstract Change the exponent applied to the quality to get the weight
+ * @param sender The control originating the change
+ */
+- (IBAction) weightChange:(id)sender ;
+/*!
+ * @abstract Change the sigma clipping threshold, iterations or variant
+ * @param sender The control originating the change
+ */
+- (IBAction) clipChange:(id)sender ;
 /*!
  * @abstract Start stacking
  * @param sender The button
@@ -299,15 +299,19 @@ static NSString * const K_STACK_NAME = @"name";
 
 - (void) processStarted:(NSNotification*)notif
 {
-   // We are only concerned by stacking process
-   if ( [[notif userInfo] objectForKey:LynkeosUserInfoProcess]
-        == [MyImageStacker class] )
+   // We are only concerned by our own stacking process
+   if ( _isStacking )
    {
+      NSAssert( [[notif userInfo] objectForKey:LynkeosUserInfoProcess]
+                == [MyImageStacker class],
+                @"Unexpected process start while stacking" );
       // Change the button title
       [_stackButton setTitle:NSLocalizedString(@"Stop",@"Stop button")];
       [_stackButton setEnabled:YES];
-      _isStacking = YES;
    }
+   else
+      // Another process is running (live stacking for instance)
+      [_stackButton setEnabled:NO];
 }
 
 - (void) processEnded:(NSNotification*)notif
@@ -322,6 +326,7 @@ static NSString * const K_STACK_NAME = @"name";
       NSAssert( params != nil, @"Process end without stacking parameters" );
       
       if ( params->_stackMethod == Stacking_Sigma_Reject
+           && params->_method.sigma.reservoir == 0
            && params->_method.sigma.pass == 1 )
       {
          // Launch pass 2 (schedule it)
@@ -395,6 +400,9 @@ static NSString * const K_STACK_NAME = @"name";
                            object:_imageView];
       }
    }
+   else
+      // Restore the controls state
+      [self dataModeChanged:nil];
 }
 
 - (void) itemUsedInStack:(NSNotification*)notif
@@ -486,6 +494,25 @@ static NSString * const K_STACK_NAME = @"name";
                                     (params->_method.extremum.maxValue ? 0 : 1)
                                  column:0];
          break;
+      case Stacking_Percentile:
+         [_percentileText setFloatValue:params->_method.percentile.value];
+         [_percentileSlider setFloatValue:params->_method.percentile.value];
+         break;
+      case Stacking_Drizzle:
+         [_drizzlePixfracText setFloatValue:params->_method.drizzle.pixfrac];
+         [_drizzleScaleText setFloatValue:params->_method.drizzle.scale];
+         break;
+      case Stacking_Weighted:
+         [_weightText setFloatValue:params->_method.weighted.exponent];
+         [_weightSlider setFloatValue:params->_method.weighted.exponent];
+         break;
+      case Stacking_Sigma_Clip:
+         [_clipKappaText setFloatValue:params->_method.clip.kappa];
+         [_clipKappaSlider setFloatValue:params->_method.clip.kappa];
+         [_clipIterationsText setIntValue:params->_method.clip.iterations];
+         [_clipWinsorizedCheckBox setState:(params->_method.clip.winsorized ?
+                                            NSOnState : NSOffState)];
+         break;
       default:
          NSAssert( NO, @"Invalid stacking method" );
    }
@@ -598,6 +625,192 @@ static NSString * const K_STACK_NAME = @"name";
       _isStacking = NO;
 
       [NSBundle loadNibNamed:@"MyImageStacker" owner:self];
+
+      // The percentile method is not in the nib
+      [_methodPopup addItemWithTitle:
+                    NSLocalizedString(@"PercentileStack",
+                                      @"Percentile stacking method")];
+      [[_methodPopup lastItem] setTag:Stacking_Percentile];
+
+      NSAssert( [_methodPane numberOfTabViewItems] == Stacking_Percentile,
+                @"Unexpected number of stacking method panes" );
+      NSRect r = [_methodPane contentRect];
+      NSView *pane = [[[NSView alloc] initWithFrame:
+                                NSMakeRect(0,0,r.size.width,r.size.height)]
+                                                                  autorelease];
+      _percentileSlider = [[[NSSlider alloc] initWithFrame:
+                                NSMakeRect(8,(r.size.height-22)/2,
+                                           r.size.width-74,22)] autorelease];
+      [_percentileSlider setMinValue:0.0];
+      [_percentileSlider setMaxValue:100.0];
+      [_percentileSlider setContinuous:YES];
+      [_percentileSlider setTarget:self];
+      [_percentileSlider setAction:@selector(percentileChange:)];
+      [pane addSubview:_percentileSlider];
+      _percentileText = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(r.size.width-58,
+                                           (r.size.height-22)/2,50,22)]
+                                                                  autorelease];
+      [_percentileText setTarget:self];
+      [_percentileText setAction:@selector(percentileChange:)];
+      [pane addSubview:_percentileText];
+      NSTabViewItem *item = [[[NSTabViewItem alloc] initWithIdentifier:
+                                                   @"percentile"] autorelease];
+      [item setLabel:
+                    NSLocalizedString(@"PercentileStack",
+                                      @"Percentile stacking method")];
+      [item setView:pane];
+      [_methodPane addTabViewItem:item];
+
+      // Nor is the drizzle one
+      [_methodPopup addItemWithTitle:
+                    NSLocalizedString(@"DrizzleStack",
+                                      @"Drizzle stacking method")];
+      [[_methodPopup lastItem] setTag:Stacking_Drizzle];
+
+      pane = [[[NSView alloc] initWithFrame:
+                                NSMakeRect(0,0,r.size.width,r.size.height)]
+                                                                  autorelease];
+      NSTextField *label = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(8,r.size.height/2+4,
+                                           r.size.width-74,17)] autorelease];
+      [label setStringValue:NSLocalizedString(@"DrizzlePixfrac",
+                                              @"Drizzle drop size label")];
+      [label setEditable:NO];
+      [label setBordered:NO];
+      [label setDrawsBackground:NO];
+      [pane addSubview:label];
+      _drizzlePixfracText = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(r.size.width-58,
+                                           r.size.height/2+2,50,22)]
+                                                                  autorelease];
+      [_drizzlePixfracText setTarget:self];
+      [_drizzlePixfracText setAction:@selector(drizzleChange:)];
+      [pane addSubview:_drizzlePixfracText];
+      label = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(8,r.size.height/2-22,
+                                           r.size.width-74,17)] autorelease];
+      [label setStringValue:NSLocalizedString(@"DrizzleScale",
+                                              @"Drizzle output scale label")];
+      [label setEditable:NO];
+      [label setBordered:NO];
+      [label setDrawsBackground:NO];
+      [pane addSubview:label];
+      _drizzleScaleText = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(r.size.width-58,
+                                           r.size.height/2-24,50,22)]
+                                                                  autorelease];
+      [_drizzleScaleText setTarget:self];
+      [_drizzleScaleText setAction:@selector(drizzleChange:)];
+      [pane addSubview:_drizzleScaleText];
+      item = [[[NSTabViewItem alloc] initWithIdentifier:
+                                                   @"drizzle"] autorelease];
+      [item setLabel:
+                    NSLocalizedString(@"DrizzleStack",
+                                      @"Drizzle stacking method")];
+      [item setView:pane];
+      [_methodPane addTabViewItem:item];
+
+      // And the quality weighted one
+      [_methodPopup addItemWithTitle:
+                    NSLocalizedString(@"WeightedStack",
+                                      @"Quality weighted stacking method")];
+      [[_methodPopup lastItem] setTag:Stacking_Weighted];
+
+      pane = [[[NSView alloc] initWithFrame:
+                                NSMakeRect(0,0,r.size.width,r.size.height)]
+                                                                  autorelease];
+      label = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(8,r.size.height/2+4,
+                                           r.size.width-16,17)] autorelease];
+      [label setStringValue:NSLocalizedString(@"WeightExponent",
+                                              @"Quality weight exponent label")];
+      [label setEditable:NO];
+      [label setBordered:NO];
+      [label setDrawsBackground:NO];
+      [pane addSubview:label];
+      _weightSlider = [[[NSSlider alloc] initWithFrame:
+                                NSMakeRect(8,r.size.height/2-24,
+                                           r.size.width-74,22)] autorelease];
+      [_weightSlider setMinValue:0.0];
+      [_weightSlider setMaxValue:4.0];
+      [_weightSlider setContinuous:YES];
+      [_weightSlider setTarget:self];
+      [_weightSlider setAction:@selector(weightChange:)];
+      [pane addSubview:_weightSlider];
+      _weightText = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(r.size.width-58,
+                                           r.size.height/2-24,50,22)]
+                                                                  autorelease];
+      [_weightText setTarget:self];
+      [_weightText setAction:@selector(weightChange:)];
+      [pane addSubview:_weightText];
+      item = [[[NSTabViewItem alloc] initWithIdentifier:
+                                                   @"weighted"] autorelease];
+      [item setLabel:
+                    NSLocalizedString(@"WeightedStack",
+                                      @"Quality weighted stacking method")];
+      [item setView:pane];
+      [_methodPane addTabViewItem:item];
+
+      // And the iterative sigma clipping one
+      [_methodPopup addItemWithTitle:
+                    NSLocalizedString(@"SigmaClipStack",
+                                      @"Sigma clipping stacking method")];
+      [[_methodPopup lastItem] setTag:Stacking_Sigma_Clip];
+
+      pane = [[[NSView alloc] initWithFrame:
+                                NSMakeRect(0,0,r.size.width,r.size.height)]
+                                                                  autorelease];
+      _clipKappaSlider = [[[NSSlider alloc] initWithFrame:
+                                NSMakeRect(8,r.size.height/2+14,
+                                           r.size.width-74,22)] autorelease];
+      [_clipKappaSlider setMinValue:0.5];
+      [_clipKappaSlider setMaxValue:5.0];
+      [_clipKappaSlider setContinuous:YES];
+      [_clipKappaSlider setTarget:self];
+      [_clipKappaSlider setAction:@selector(clipChange:)];
+      [pane addSubview:_clipKappaSlider];
+      _clipKappaText = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(r.size.width-58,
+                                           r.size.height/2+14,50,22)]
+                                                                  autorelease];
+      [_clipKappaText setTarget:self];
+      [_clipKappaText setAction:@selector(clipChange:)];
+      [pane addSubview:_clipKappaText];
+      label = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(8,r.size.height/2-10,
+                                           r.size.width-74,17)] autorelease];
+      [label setStringValue:NSLocalizedString(@"ClipIterations",
+                                          @"Sigma clipping iterations label")];
+      [label setEditable:NO];
+      [label setBordered:NO];
+      [label setDrawsBackground:NO];
+      [pane addSubview:label];
+      _clipIterationsText = [[[NSTextField alloc] initWithFrame:
+                                NSMakeRect(r.size.width-58,
+                                           r.size.height/2-12,50,22)]
+                                                                  autorelease];
+      [_clipIterationsText setTarget:self];
+      [_clipIterationsText setAction:@selector(clipChange:)];
+      [pane addSubview:_clipIterationsText];
+      _clipWinsorizedCheckBox = [[[NSButton alloc] initWithFrame:
+                                NSMakeRect(8,r.size.height/2-38,
+                                           r.size.width-16,18)] autorelease];
+      [_clipWinsorizedCheckBox setButtonType:NSSwitchButton];
+      [_clipWinsorizedCheckBox setTitle:
+                             NSLocalizedString(@"ClipWinsorized",
+                                           @"Winsorized sigma clipping label")];
+      [_clipWinsorizedCheckBox setTarget:self];
+      [_clipWinsorizedCheckBox setAction:@selector(clipChange:)];
+      [pane addSubview:_clipWinsorizedCheckBox];
+      item = [[[NSTabViewItem alloc] initWithIdentifier:
+                                                   @"sigmaClip"] autorelease];
+      [item setLabel:
+                    NSLocalizedString(@"SigmaClipStack",
+                                      @"Sigma clipping stacking method")];
+      [item setView:pane];
+      [_methodPane addTabViewItem:item];
    }
 
    return( self );
@@ -779,6 +992,21 @@ static NSString * const K_STACK_NAME = @"name";
       case Stacking_Extremum:
          params->_method.extremum.maxValue = YES;
          break;
+      case Stacking_Percentile:
+         params->_method.percentile.value = 50.0;
+         break;
+      case Stacking_Drizzle:
+         params->_method.drizzle.pixfrac = 0.7;
+         params->_method.drizzle.scale = 2.0;
+         break;
+      case Stacking_Weighted:
+         params->_method.weighted.exponent = 1.0;
+         break;
+      case Stacking_Sigma_Clip:
+         params->_method.clip.kappa = 2.5;
+         params->_method.clip.iterations = 5;
+         params->_method.clip.winsorized = NO;
+         break;
       default:
          NSAssert( NO, @"Invalid stacking method" );
    }
@@ -820,20 +1048,140 @@ static NSString * const K_STACK_NAME = @"name";
                   forProcessing:myImageStackerRef];
 }
 
+- (IBAction) percentileChange:(id)sender
+{
+   // Reconcile slider and text
+   double v = [sender doubleValue];
+
+   if ( sender != _percentileSlider )
+      [_percentileSlider setDoubleValue:v];
+   if ( sender != _percentileText )
+      [_percentileText setDoubleValue:v];
+
+   id <LynkeosImageList> list = [_document currentList];
+   MyImageStackerParameters *params =
+      [list getProcessingParameterWithRef:myImageStackerParametersRef
+                            forProcessing:myImageStackerRef];
+   params->_method.percentile.value = v;
+   [list setProcessingParameter:params
+                        withRef:myImageStackerParametersRef
+                  forProcessing:myImageStackerRef];
+}
+
+- (IBAction) drizzleChange:(id)sender
+{
+   id <LynkeosImageList> list = [_document currentList];
+   MyImageStackerParameters *params =
+      [list getProcessingParameterWithRef:myImageStackerParametersRef
+                            forProcessing:myImageStackerRef];
+   double v = [sender doubleValue];
+
+   // A null drop would receive nothing, a null scale would give no image
+   if ( sender == _drizzlePixfracText )
+   {
+      if ( v <= 0.0 || v > 1.0 )
+      {
+         v = params->_method.drizzle.pixfrac;
+         [sender setDoubleValue:v];
+      }
+      params->_method.drizzle.pixfrac = v;
+   }
+   else
+   {
+      if ( v <= 0.0 || v > 4.0 )
+      {
+         v = params->_method.drizzle.scale;
+         [sender setDoubleValue:v];
+      }
+      params->_method.drizzle.scale = v;
+   }
+   [list setProcessingParameter:params
+                        withRef:myImageStackerParametersRef
+                  forProcessing:myImageStackerRef];
+}
+
+- (IBAction) weightChange:(id)sender
+{
+   // Reconcile slider and text
+   double v = [sender doubleValue];
+
+   if ( sender != _weightSlider )
+      [_weightSlider setDoubleValue:v];
+   if ( sender != _weightText )
+      [_weightText setDoubleValue:v];
+
+   id <LynkeosImageList> list = [_document currentList];
+   MyImageStackerParameters *params =
+      [list getProcessingParameterWithRef:myImageStackerParametersRef
+                            forProcessing:myImageStackerRef];
+   params->_method.weighted.exponent = v;
+   [list setProcessingParameter:params
+                        withRef:myImageStackerParametersRef
+                  forProcessing:myImageStackerRef];
+}
+
+- (IBAction) clipChange:(id)sender
+{
+   id <LynkeosImageList> list = [_document currentList];
+   MyImageStackerParameters *params =
+      [list getProcessingParameterWithRef:myImageStackerParametersRef
+                            forProcessing:myImageStackerRef];
+
+   if ( sender == _clipWinsorizedCheckBox )
+      params->_method.clip.winsorized = ([sender state] == NSOnState);
+
+   else if ( sender == _clipIterationsText )
+   {
+      int n = [sender intValue];
+
+      // At least one clipping, otherwise it is a plain mean
+      if ( n < 1 || n > 100 )
+      {
+         n = params->_method.clip.iterations;
+         [sender setIntValue:n];
+      }
+      params->_method.clip.iterations = n;
+   }
+
+   else
+   {
+      // Reconcile slider and text
+      double v = [sender doubleValue];
+
+      if ( v <= 0.0 )
+      {
+         v = params->_method.clip.kappa;
+         [sender setDoubleValue:v];
+      }
+      if ( sender != _clipKappaSlider )
+         [_clipKappaSlider setDoubleValue:v];
+      if ( sender != _clipKappaText )
+         [_clipKappaText setDoubleValue:v];
+      params->_method.clip.kappa = v;
+   }
+
+   [list setProcessingParameter:params
+                        withRef:myImageStackerParametersRef
+                  forProcessing:myImageStackerRef];
+}
+
 - (IBAction) stackAction :(id)sender
 {
    NSAssert( [_document dataMode] == ListData,
              @"Stacking started in result mode" );
    id <LynkeosImageList> list = [_document currentList];
-   MyImageStackerParameters *params=
-                 [list getProcessingParameterWithRef:myImageStackerParametersRef
-                                       forProcessing:myImageStackerRef];
    ListMode_t mode = [_document listMode];
 
    [sender setEnabled:NO];
 
    if ( _isStacking )
+   {
+      // The stack sums will not match the selection
+      [list setProcessingParameter:nil
+                           withRef:myImageStackerAccumulatorRef
+                     forProcessing:myImageStackerRef];
       [_document stopProcess];
+   }
 
    else
    {
@@ -889,35 +1237,7 @@ static NSString * const K_STACK_NAME = @"name";
                           name: LynkeosItemWasProcessedNotification
                         object:_document];
 
-      // Initialize the stacking parameters
-      switch( mode )
-      {
-         case ImageMode:
-         case DarkFrameMode:
-            switch(params->_stackMethod)
-            {
-               case Stacking_Standard:
-                  params->_postStack = MeanStack;
-                  break;
-               case Stacking_Sigma_Reject:
-                  params->_postStack = NoPostStack;
-                  params->_method.sigma.pass = 1;
-                  break;
-               case Stacking_Extremum:
-                  params->_postStack = NoPostStack;
-                  break;
-               default:
-                  NSAssert( NO, @"Invalid stacking method" );
-            }
-            break;
-         case FlatFieldMode:
-            params->_postStack = NormalizeStack;
-            break;
-         default:
-            NSAssert1( NO, @"Invalid list mode %d", [_document listMode] );
-      }
-      params->_imagesStacked = 0;
-      params->_livingThreads = 0;
+      _stackedImagesNb = 0;
 
       _imageUpdate = [[NSUserDefaults standardUserDefaults] boolForKey:
                                                    K_PREF_STACK_IMAGE_UPDATING];
@@ -927,12 +1247,13 @@ static NSString * const K_STACK_NAME = @"name";
                                                                    autorelease];
       docParam->_list = list;
 
-      // Get an enumerator on the images
-      NSEnumerator *strider = [list imageEnumeratorStartAt:nil
-                                                directSense:YES
-                                             skipUnselected:YES];
+      // Initialize the stacking parameters, and get an enumerator on the
+      // images, or on the changes since the previous stack
+      NSEnumerator *strider = [MyImageStacker prepareStackOfList:list
+                                                          inMode:mode];
 
       // Ask the doc to stack
+      _isStacking = YES;
       [_document startProcess:[MyImageStacker class] withEnumerator:strider
                    parameters:docParam];
    }
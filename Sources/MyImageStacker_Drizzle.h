@@ -0,0 +1,30 @@
+//
+//  MyImageStacker_Drizzle.h
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 16/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#include "MyImageStacker.h"
+
+/*!
+ * @abstract Drizzle stacking strategy
+ * @discussion Each input pixel is shrunk by the "pixfrac" factor, shifted
+ *    and dropped on an output grid "scale" times finer. Its value is
+ *    accumulated in the output pixels it overlaps, weighted by the overlap
+ *    area, which is also accumulated in a weight map. The result is the ratio
+ *    of both maps.
+ * @ingroup Processing
+ */
+@interface MyImageStacker_Drizzle : NSObject <MyImageStackerModeStrategy>
+{
+   @private
+   MyImageStackerParameters*   _params; //!< Stacking parameters
+   LynkeosStandardImageBuffer* _data;   //!< Sum of the weighted drops
+   LynkeosStandardImageBuffer* _weight; //!< Sum of the drops weight
+}
+
+@end
@@ -0,0 +1,233 @@
+//
+//  MyImageStacker_Drizzle.m
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 16/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+#include <stdlib.h>
+#include <math.h>
+
+#include "MyImageStacker_Drizzle.h"
+
+/*!
+ * @abstract Overlap of the drops with the output pixels, along one axis
+ * @discussion The drop of input pixel i covers the output pixels first[i] to
+ *    first[i]+span-1, with the weights weight[i*span] and following. The
+ *    weights of output pixels outside of the image are null.
+ * @param first Receives the first covered output pixel of each input pixel
+ * @param weight Receives the overlaps
+ * @param n Number of input pixels
+ * @param span Number of output pixels covered by a drop
+ * @param nOut Number of output pixels
+ * @param scale Size of an input pixel in output pixels
+ * @param offset Shift of the input, in output pixels
+ * @param drop Size of a drop, in output pixels
+ */
+static void dropOverlaps( long *first, REAL *weight, u_short n, u_short span,
+                          u_short nOut, double scale, double offset,
+                          double drop )
+{
+   u_short i, k;
+
+   for( i = 0; i < n; i++ )
+   {
+      const double lo = ((double)i + 0.5)*scale + offset - drop/2.0;
+      const double hi = lo + drop;
+
+      first[i] = (long)floor(lo);
+      for( k = 0; k < span; k++ )
+      {
+         const long o = first[i] + k;
+         double w = 0.0;
+
+         if ( o >= 0 && o < nOut )
+         {
+            w = (hi < o + 1 ? hi : o + 1) - (lo > o ? lo : o);
+            if ( w < 0.0 )
+               w = 0.0;
+         }
+         weight[i*span + k] = w;
+      }
+   }
+}
+
+@implementation MyImageStacker_Drizzle
+
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _params = nil;
+      _data = nil;
+      _weight = nil;
+   }
+
+   return( self );
+}
+
+- (id) initWithParameters: (id <NSObject>)params
+                     list: (id <LynkeosImageList>)list
+{
+   if ( (self = [self init]) != nil )
+      _params = [params retain];
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   if ( _params != nil )
+      [_params release];
+   if ( _data != nil )
+      [_data release];
+   if ( _weight != nil )
+      [_weight release];
+
+   [super dealloc];
+}
+
+- (void) processImage: (id <LynkeosImageBuffer>)image
+          withOffsets: (NSPoint*)offsets
+               weight: (double)weight
+{
+   LynkeosStandardImageBuffer *src;
+   const double scale = _params->_method.drizzle.scale;
+   const double drop = _params->_method.drizzle.pixfrac*scale;
+   const u_short span = (u_short)ceil(drop) + 1;
+   REAL **data, **wMaps;
+   long *xFirst, *yFirst;
+   REAL *xWeight, *yWeight;
+   u_short x, y, c, kx, ky;
+
+   // The drops are taken from the input pixels, without resampling
+   if ( [image isKindOfClass:[LynkeosStandardImageBuffer class]] )
+      src = (LynkeosStandardImageBuffer*)image;
+   else
+   {
+      NSPoint zero[[image numberOfPlanes]];
+
+      for( c = 0; c < [image numberOfPlanes]; c++ )
+         zero[c] = NSZeroPoint;
+      src = [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                         [image numberOfPlanes]
+                                                                width:
+                                                         [image width]
+                                                               height:
+                                                         [image height]];
+      [src add:image withOffsets:zero withExpansion:1];
+   }
+
+   NSAssert( _data == nil || _data->_nPlanes == src->_nPlanes,
+             @"heterogeneous planes numbers in drizzle stacking" );
+
+   // If this is the first image, create the empty maps
+   if ( _data == nil )
+   {
+      const u_short w = (u_short)(src->_w*scale + 0.5),
+                    h = (u_short)(src->_h*scale + 0.5);
+
+      _data = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                               src->_nPlanes
+                                                                   width:w
+                                                                  height:h]
+                                                                        retain];
+      _weight = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                               src->_nPlanes
+                                                                     width:w
+                                                                    height:h]
+                                                                        retain];
+   }
+   data = (REAL**)[_data colorPlanes];
+   wMaps = (REAL**)[_weight colorPlanes];
+
+   xFirst = (long*)malloc( src->_w*sizeof(long) );
+   yFirst = (long*)malloc( src->_h*sizeof(long) );
+   xWeight = (REAL*)malloc( src->_w*span*sizeof(REAL) );
+   yWeight = (REAL*)malloc( src->_h*span*sizeof(REAL) );
+
+   for( c = 0; c < src->_nPlanes; c++ )
+   {
+      // The offsets are given in the expanded image pixels
+      dropOverlaps( xFirst, xWeight, src->_w, span, _data->_w, scale,
+                    offsets[c].x*scale/(double)_params->_factor, drop );
+      dropOverlaps( yFirst, yWeight, src->_h, span, _data->_h, scale,
+                    offsets[c].y*scale/(double)_params->_factor, drop );
+
+      // Drop the input lines one by one, only a few output lines are then
+      // updated at a time
+      for( y = 0; y < src->_h; y++ )
+      {
+         const REAL *line = &((REAL*)[src colorPlanes][c])[y*src->_padw];
+
+         for( ky = 0; ky < span; ky++ )
+         {
+            const REAL wy = yWeight[y*span + ky];
+            REAL *dLine, *wLine;
+
+            if ( wy == 0.0 )
+               continue;
+
+            dLine = &data[c][(yFirst[y] + ky)*_data->_padw];
+            wLine = &wMaps[c][(yFirst[y] + ky)*_weight->_padw];
+
+            for( x = 0; x < src->_w; x++ )
+            {
+               const REAL v = line[x];
+
+               for( kx = 0; kx < span; kx++ )
+               {
+                  const REAL w = xWeight[x*span + kx]*wy;
+
+                  if ( w != 0.0 )
+                  {
+                     dLine[xFirst[x] + kx] += v*w;
+                     wLine[xFirst[x] + kx] += w;
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   free( xFirst );
+   free( yFirst );
+   free( xWeight );
+   free( yWeight );
+}
+
+- (void) mergeStack:(NSObject <MyImageStackerModeStrategy>*)stack
+{
+   MyImageStacker_Drizzle *other = (MyImageStacker_Drizzle*)stack;
+
+   if ( other->_data == nil )
+      return;
+
+   if ( _data == nil )
+   {
+      _data = [other->_data retain];
+      _weight = [other->_weight retain];
+   }
+   else
+   {
+      [_data setOperatorsStrategy:ParallelizedStrategy];
+      [_data add:other->_data result:_data];
+      [_weight setOperatorsStrategy:ParallelizedStrategy];
+      [_weight add:other->_weight result:_weight];
+   }
+}
+
+- (void) finishAllProcessingInList: (id <LynkeosImageList>)list;
+{
+   // Maybe there was nothing to stack
+   if ( _data == nil )
+      return;
+
+   // The pixels which received no drop are left null
+   [_data setOperatorsStrategy:ParallelizedStrategy];
+   [_data divideBy:_weight result:_data];
+}
+
+- (LynkeosStandardImageBuffer*) stackingResult { return( _data ); }
+
+@end
@@ -8,83 +8,6 @@
 
 #include "MyImageStacker_Extrema.h"
 
-// Private (and temporary) parameter used to recombine the stacks
-static NSString * const myExtremaImageStackerResult = @"ExtremaStackerResult";
-
-@interface ExtremaImageStackerResult : NSObject <LynkeosProcessingParameter>
-{
-@public
-   LynkeosStandardImageBuffer* _extremum; //!< Global extremum
-}
-@end
-
-@implementation ExtremaImageStackerResult
-- (id) init
-{
-   self = [super init];
-   if ( self != nil )
-   {
-      _extremum = nil;
-   }
-
-   return( self );
-}
-
-- (void) dealloc
-{
-   if ( _extremum != nil )
-      [_extremum release];
-
-   [super dealloc];
-}
-
-// This parameter is deleted at process end, it cannot be saved
-- (void)encodeWithCoder:(NSCoder *)encoder
-{
-   [self doesNotRecognizeSelector:_cmd];
-}
-- (id)initWithCoder:(NSCoder *)decoder
-{
-   [self doesNotRecognizeSelector:_cmd];
-   return( nil );
-}
-@end
-
-@interface MyImageStacker_Extrema(Private)
-- (void) processBuffer:(LynkeosStandardImageBuffer*)buf
-            withResult:(LynkeosStandardImageBuffer*)res ;
-@end
-
-@implementation MyImageStacker_Extrema(Private)
-- (void) processBuffer:(LynkeosStandardImageBuffer*)buf
-            withResult:(LynkeosStandardImageBuffer*)res
-{
-   u_short x, y, c;
-   REAL **p = (REAL**)[res colorPlanes];
-
-   for( c = 0; c < buf->_nPlanes; c++ )
-      for( y = 0; y < buf->_h; y++ )
-         for( x = 0; x < buf->_w; x++ )
-         {
-            REAL v = stdColorValue(buf,PROCESSING_PRECISION,x,y,c);
-            if ( _params->_method.extremum.maxValue )
-            {
-               if ( v > stdColorValue(res,PROCESSING_PRECISION,x,y,c) )
-               {
-                  SET_SAMPLE(p[c],PROCESSING_PRECISION,x,y,res->_padw, v);
-               }
-            }
-            else
-            {
-               if ( v < stdColorValue(res,PROCESSING_PRECISION,x,y,c) )
-               {
-                  SET_SAMPLE(p[c],PROCESSING_PRECISION,x,y,res->_padw, v);
-               }
-            }
-         }
-}
-@end
-
 @implementation MyImageStacker_Extrema
 
 - (id) init
@@ -119,6 +42,7 @@ static NSString * const myExtremaImageStackerResult = @"ExtremaStackerResult";
 
 - (void) processImage: (id <LynkeosImageBuffer>)image
           withOffsets: (NSPoint*)offsets
+               weight: (double)weight
 {
    NSAssert( _extremum == nil || _extremum->_nPlanes == [image numberOfPlanes],
             @"heterogeneous planes numbers in extremum stacking" );
@@ -144,28 +68,25 @@ static NSString * const myExtremaImageStackerResult = @"ExtremaStackerResult";
                                                                    buf->_h]
                                                                         retain];
 
-   [self processBuffer:buf withResult:_extremum];
+   [_extremum extremumWith:buf result:_extremum
+                   maximum:_params->_method.extremum.maxValue];
 }
 
-- (void) finishOneProcessingThreadInList:(id <LynkeosImageList>)list ;
+- (void) mergeStack:(NSObject <MyImageStackerModeStrategy>*)stack
 {
-   // Recombine the stacks in the list
-   ExtremaImageStackerResult *res
-      = [list getProcessingParameterWithRef:myExtremaImageStackerResult
-                              forProcessing:myImageStackerRef];
+   MyImageStacker_Extrema *other = (MyImageStacker_Extrema*)stack;
 
-   if ( res == nil )
-   {
-      res = [[[ExtremaImageStackerResult alloc] init] autorelease];
-      
-      [list setProcessingParameter:res withRef:myExtremaImageStackerResult 
-                     forProcessing:myImageStackerRef];
-   }
+   if ( other->_extremum == nil )
+      return;
 
-   if ( res->_extremum == nil )
-      res->_extremum = [_extremum retain];
+   if ( _extremum == nil )
+      _extremum = [other->_extremum retain];
    else
-      [self processBuffer:_extremum withResult:res->_extremum];   
+   {
+      [_extremum setOperatorsStrategy:ParallelizedStrategy];
+      [_extremum extremumWith:other->_extremum result:_extremum
+                      maximum:_params->_method.extremum.maxValue];
+   }
 }
 
 - (void) finishAllProcessingInList: (id <LynkeosImageList>)list;
@@ -0,0 +1,22 @@
+//
+//  MyImageStacker_Percentile.h
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 12/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#include "MyImageStacker_Tiles.h"
+
+/*!
+ * @abstract Median and percentile stacking strategy
+ * @discussion The percentile is selected in each pixel values stack.
+ * @ingroup Processing
+ */
+@interface MyImageStacker_Percentile : MyImageStacker_Tiles
+{
+}
+
+@end
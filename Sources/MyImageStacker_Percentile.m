@@ -0,0 +1,118 @@
+//
+//  MyImageStacker_Percentile.m
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 12/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+#include <stdlib.h>
+
+#include "MyImageStacker_Percentile.h"
+
+/*!
+ * @abstract Select the k-th smallest value of an array
+ * @discussion The array is partially sorted : after the call, the values
+ *    before k are lower or equal, and the values after are greater or equal.
+ * @param v The values
+ * @param n Number of values
+ * @param k Rank of the value to select
+ * @result The selected value
+ */
+static REAL selectValue( REAL *v, long n, long k )
+{
+   long lo = 0, hi = n - 1;
+
+   while( hi > lo )
+   {
+      REAL a = v[lo], b = v[(lo+hi)/2], c = v[hi], pivot;
+      long i = lo, j = hi;
+
+      // Median of three pivot
+      if ( a < b )
+         pivot = ( b < c ? b : (a < c ? c : a) );
+      else
+         pivot = ( a < c ? a : (b < c ? c : b) );
+
+      while( i <= j )
+      {
+         while( v[i] < pivot )
+            i++;
+         while( v[j] > pivot )
+            j--;
+         if ( i <= j )
+         {
+            REAL t = v[i];
+            v[i] = v[j];
+            v[j] = t;
+            i++;
+            j--;
+         }
+      }
+
+      if ( k <= j )
+         hi = j;
+      else if ( k >= i )
+         lo = i;
+      else
+         break;
+   }
+
+   return( v[k] );
+}
+
+/*!
+ * @abstract Percentile of an array, with linear interpolation between ranks
+ * @param v The values, which are reordered
+ * @param n Number of values
+ * @param percentile The percentile, between 0 and 100
+ * @result The percentile value
+ */
+static REAL percentileValue( REAL *v, long n, double percentile )
+{
+   double r = percentile*(double)(n - 1)/100.0;
+   long k = (long)r;
+   REAL low, high;
+   long i;
+
+   if ( k >= n - 1 )
+      return( selectValue( v, n, n - 1 ) );
+
+   low = selectValue( v, n, k );
+   if ( r == (double)k )
+      return( low );
+
+   // The next rank is the lowest value above the selected one
+   high = v[k+1];
+   for( i = k + 2; i < n; i++ )
+      if ( v[i] < high )
+         high = v[i];
+
+   return( low + (REAL)(r - (double)k)*(high - low) );
+}
+
+@implementation MyImageStacker_Percentile
+
+- (size_t) reductionBufferSizeForFrames:(u_long)nFrames side:(u_short)side
+{
+   return( nFrames*sizeof(REAL) );
+}
+
+- (void) reduceStack:(const REAL*)stack frames:(u_long)nFrames
+            tileSize:(size_t)tileSize side:(u_short)side
+                into:(REAL*)tile buffer:(void*)buffer
+{
+   const double percentile = _params->_method.percentile.value;
+   REAL *values = (REAL*)buffer;
+   size_t i;
+   u_long f;
+
+   for( i = 0; i < tileSize; i++ )
+   {
+      for( f = 0; f < nFrames; f++ )
+         values[f] = stack[f*tileSize + i];
+
+      tile[i] = percentileValue( values, nFrames, percentile );
+   }
+}
+
+@end
@@ -0,0 +1,29 @@
+//
+//  MyImageStacker_SigmaClip.h
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 30/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#include "MyImageStacker_Tiles.h"
+
+/*!
+ * @abstract Iterative kappa-sigma clipping stacking strategy
+ * @discussion The mean and standard deviation of each pixel values stack are
+ *    computed again and again, on the values within kappa standard deviations
+ *    of the previous mean, until no more value is rejected. In the winsorized
+ *    variant, the statistics are computed on every value, clamped to the
+ *    bounds instead of rejected, which is more robust with few frames. The
+ *    result is the mean of the values within the final bounds.<br>
+ *    The pixels of a tile row are processed together, in vectors when
+ *    available.
+ * @ingroup Processing
+ */
+@interface MyImageStacker_SigmaClip : MyImageStacker_Tiles
+{
+}
+
+@end
@@ -0,0 +1,306 @@
+//
+//  MyImageStacker_SigmaClip.m
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 30/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+#include <math.h>
+
+#include "MyImageStacker_SigmaClip.h"
+
+#if !defined(DOUBLE_PIXELS) && (defined(__ALTIVEC__) || defined(__SSE__))
+#define CLIP_VECTORS
+#ifndef __ALTIVEC__
+#include <xmmintrin.h>
+#endif
+#endif
+
+/*!
+ * @abstract Which values enter the statistics of a pixel
+ */
+typedef enum
+{
+   AccumulateAll,          //!< Every value
+   AccumulateKept,         //!< Only the values within the bounds
+   AccumulateWinsorized    //!< Every value, clamped to the bounds
+} ClipAccumulation_t;
+
+/*!
+ * @abstract Work arrays for one tile row
+ * @discussion The deviations are accumulated relatively to the current
+ *    center of each pixel, for the sake of precision.
+ */
+typedef struct
+{
+   REAL *center;  //!< Current mean
+   REAL *lo;      //!< Lower bound of the kept values
+   REAL *hi;      //!< Upper bound of the kept values
+   REAL *sum;     //!< Sum of the deviations from the center
+   REAL *sum2;    //!< Sum of the squared deviations
+   REAL *count;   //!< Number of values accumulated
+} ClipRow_t;
+
+/*!
+ * @abstract Accumulate the values stack of a row of pixels
+ * @param s The row in the first frame
+ * @param nFrames Number of frames
+ * @param stride Distance between the same pixel of two frames
+ * @param n Number of pixels in the row
+ * @param row The work arrays
+ * @param mode Which values to accumulate
+ */
+static void std_accumulate_row( const REAL *s, u_long nFrames, size_t stride,
+                                u_short n, ClipRow_t *row,
+                                ClipAccumulation_t mode )
+{
+   u_long f;
+   u_short i;
+
+   for( i = 0; i < n; i++ )
+   {
+      row->sum[i] = 0.0;
+      row->sum2[i] = 0.0;
+      row->count[i] = 0.0;
+   }
+
+   for( f = 0; f < nFrames; f++ )
+   {
+      const REAL *v = &s[f*stride];
+
+      for( i = 0; i < n; i++ )
+      {
+         REAL x = v[i], k = 1.0;
+
+         switch( mode )
+         {
+            case AccumulateKept:
+               if ( x < row->lo[i] || x > row->hi[i] )
+                  k = 0.0;
+               break;
+            case AccumulateWinsorized:
+               if ( x < row->lo[i] )
+                  x = row->lo[i];
+               else if ( x > row->hi[i] )
+                  x = row->hi[i];
+               break;
+            default:
+               break;
+         }
+
+         x = (x - row->center[i])*k;
+         row->sum[i] += x;
+         row->sum2[i] += x*x;
+         row->count[i] += k;
+      }
+   }
+}
+
+#ifdef CLIP_VECTORS
+/*!
+ * @abstract Lowest elements of two vectors
+ */
+static inline REALVECT vect_min( REALVECT a, REALVECT b )
+{
+#ifdef __ALTIVEC__
+   return( vec_min( a, b ) );
+#else
+   return( (REALVECT)_mm_min_ps( (__m128)a, (__m128)b ) );
+#endif
+}
+
+/*!
+ * @abstract Highest elements of two vectors
+ */
+static inline REALVECT vect_max( REALVECT a, REALVECT b )
+{
+#ifdef __ALTIVEC__
+   return( vec_max( a, b ) );
+#else
+   return( (REALVECT)_mm_max_ps( (__m128)a, (__m128)b ) );
+#endif
+}
+
+/*!
+ * @abstract Elements of v, where x is within the bounds, zero elsewhere
+ */
+static inline REALVECT vect_keep( REALVECT v, REALVECT x,
+                                  REALVECT lo, REALVECT hi )
+{
+#ifdef __ALTIVEC__
+   return( vec_and( v, vec_and( vec_cmpge( x, lo ), vec_cmple( x, hi ) ) ) );
+#else
+   return( (REALVECT)_mm_and_ps( (__m128)v,
+                                 _mm_and_ps( _mm_cmpge_ps( (__m128)x,
+                                                           (__m128)lo ),
+                                             _mm_cmple_ps( (__m128)x,
+                                                           (__m128)hi ) ) ) );
+#endif
+}
+
+/*!
+ * @abstract Same accumulation, on 4 pixels at a time, without any branch
+ */
+static void vect_accumulate_row( const REAL *s, u_long nFrames, size_t stride,
+                                 u_short n, ClipRow_t *row,
+                                 ClipAccumulation_t mode )
+{
+   const REALVECT zero = { 0.0, 0.0, 0.0, 0.0 };
+   const REALVECT one = { 1.0, 1.0, 1.0, 1.0 };
+   REALVECT * const center = (REALVECT*)row->center;
+   REALVECT * const lo = (REALVECT*)row->lo;
+   REALVECT * const hi = (REALVECT*)row->hi;
+   REALVECT * const sum = (REALVECT*)row->sum;
+   REALVECT * const sum2 = (REALVECT*)row->sum2;
+   REALVECT * const count = (REALVECT*)row->count;
+   const u_short nv = n/4;
+   u_long f;
+   u_short i;
+
+   for( i = 0; i < nv; i++ )
+   {
+      sum[i] = zero;
+      sum2[i] = zero;
+      count[i] = zero;
+   }
+
+   for( f = 0; f < nFrames; f++ )
+   {
+      const REALVECT *v = (const REALVECT*)&s[f*stride];
+
+      switch( mode )
+      {
+         case AccumulateAll:
+            for( i = 0; i < nv; i++ )
+            {
+               const REALVECT x = v[i] - center[i];
+
+               sum[i] += x;
+               sum2[i] += x*x;
+               count[i] += one;
+            }
+            break;
+         case AccumulateKept:
+            for( i = 0; i < nv; i++ )
+            {
+               const REALVECT x = vect_keep( v[i] - center[i], v[i],
+                                             lo[i], hi[i] );
+
+               sum[i] += x;
+               sum2[i] += x*x;
+               count[i] += vect_keep( one, v[i], lo[i], hi[i] );
+            }
+            break;
+         case AccumulateWinsorized:
+            for( i = 0; i < nv; i++ )
+            {
+               const REALVECT x = vect_min( vect_max( v[i], lo[i] ), hi[i] )
+                                  - center[i];
+
+               sum[i] += x;
+               sum2[i] += x*x;
+               count[i] += one;
+            }
+            break;
+      }
+   }
+}
+#endif
+
+/*!
+ * @abstract Move the center and bounds to the new statistics
+ * @result The number of values which entered the statistics
+ */
+static double update_bounds( u_short n, ClipRow_t *row, REAL kappa )
+{
+   double total = 0.0;
+   u_short i;
+
+   for( i = 0; i < n; i++ )
+   {
+      const REAL k = row->count[i];
+
+      total += k;
+      if ( k > 0.0 )
+      {
+         const REAL d = row->sum[i]/k;
+         REAL var = row->sum2[i]/k - d*d, s;
+
+         if ( var < 0.0 )
+            var = 0.0;
+         s = kappa*sqrt(var);
+         row->center[i] += d;
+         row->lo[i] = row->center[i] - s;
+         row->hi[i] = row->center[i] + s;
+      }
+   }
+
+   return( total );
+}
+
+@implementation MyImageStacker_SigmaClip
+
+- (size_t) reductionBufferSizeForFrames:(u_long)nFrames side:(u_short)side
+{
+   return( 6*side*sizeof(REAL) );
+}
+
+- (void) reduceStack:(const REAL*)stack frames:(u_long)nFrames
+            tileSize:(size_t)tileSize side:(u_short)side
+                into:(REAL*)tile buffer:(void*)buffer
+{
+   const REAL kappa = _params->_method.clip.kappa;
+   const u_short iterations = _params->_method.clip.iterations;
+   const ClipAccumulation_t clipMode = (_params->_method.clip.winsorized ?
+                                        AccumulateWinsorized : AccumulateKept);
+   void (*accumulate_row)( const REAL*, u_long, size_t, u_short, ClipRow_t*,
+                           ClipAccumulation_t ) = std_accumulate_row;
+   ClipRow_t row;
+   size_t r;
+   u_short i, it;
+
+   row.center = (REAL*)buffer;
+   row.lo = row.center + side;
+   row.hi = row.lo + side;
+   row.sum = row.hi + side;
+   row.sum2 = row.sum + side;
+   row.count = row.sum2 + side;
+
+#ifdef CLIP_VECTORS
+   // The rows of the tiles are aligned, as tiles sides are multiple of 4
+   if ( hasSIMD && (side % 4) == 0
+        && ((u_long)stack % sizeof(REALVECT)) == 0
+        && ((u_long)buffer % sizeof(REALVECT)) == 0 )
+      accumulate_row = vect_accumulate_row;
+#endif
+
+   for( r = 0; r < tileSize; r += side )
+   {
+      const REAL *s = &stack[r];
+      double kept = (double)nFrames*side, previous;
+
+      // Start with the statistics of every value
+      for( i = 0; i < side; i++ )
+         row.center[i] = s[i];
+      accumulate_row( s, nFrames, tileSize, side, &row, AccumulateAll );
+      update_bounds( side, &row, kappa );
+
+      // Clip until nothing more is rejected
+      for( it = 0; it < iterations; it++ )
+      {
+         accumulate_row( s, nFrames, tileSize, side, &row, clipMode );
+         previous = kept;
+         kept = update_bounds( side, &row, kappa );
+         if ( clipMode == AccumulateKept && kept == previous )
+            break;
+      }
+
+      // The result is the mean of the values within the final bounds
+      accumulate_row( s, nFrames, tileSize, side, &row, AccumulateKept );
+      for( i = 0; i < side; i++ )
+         tile[r + i] = row.center[i]
+                       + (row.count[i] > 0.0 ? row.sum[i]/row.count[i] : 0.0);
+   }
+}
+
+@end
@@ -16,7 +16,7 @@
    MyImageStackerParameters*   _params; //!< Stacking parameters
    LynkeosStandardImageBuffer* _sum;    //!< Sum of images value
    LynkeosStandardImageBuffer* _sum2;   //!< Sum of images square value
-   u_short*                    _count;  //!< Buffer of pixel counts for pass 2
+   LynkeosStandardImageBuffer* _count;  //!< Pixel counts for pass 2
    id <LynkeosImageList>       _list;   //!< The list being stacked
 }
 
@@ -9,17 +9,15 @@
 
 #include "MyImageStacker_SigmaReject.h"
 
-// Private (and temporary) parameter used to recombine the stacks
+// Private (and temporary) parameter giving the pass 1 statistics to pass 2
 static NSString * const mySigmaRejectImageStackerResult
                            = @"SigmaRejectStackerResult";
 
 @interface SigmaRejectImageStackerResult : NSObject <LynkeosProcessingParameter>
 {
 @public
-   LynkeosStandardImageBuffer* _sum; //!< Sum at end of pass1, mean during pass2
-   //! square sum at end of pass1, Standard deviation during pass2
-   LynkeosStandardImageBuffer* _sum2;
-   u_short*                    _count; //!< Buffer of pixels count during pass2
+   LynkeosStandardImageBuffer* _sum; //!< Mean during pass2
+   LynkeosStandardImageBuffer* _sum2; //!< Standard deviation during pass2
 }
 @end
 
@@ -31,7 +29,6 @@ static NSString * const mySigmaRejectImageStackerResult
    {
       _sum = nil;
       _sum2 = nil;
-      _count = NULL;
    }
 
    return( self );
@@ -43,8 +40,6 @@ static NSString * const mySigmaRejectImageStackerResult
       [_sum release];
    if ( _sum2 != nil )
       [_sum2 release];
-   if ( _count != NULL )
-      free( _count );
 
    [super dealloc];
 }
@@ -70,7 +65,7 @@ static NSString * const mySigmaRejectImageStackerResult
       _params = nil;
       _sum = nil;
       _sum2 = nil;
-      _count = NULL;
+      _count = nil;
       _list = nil;
    }
 
@@ -97,14 +92,15 @@ static NSString * const mySigmaRejectImageStackerResult
       [_sum release];
    if ( _sum2 != nil )
       [_sum2 release];
-   if ( _count != NULL )
-      free( _count );
+   if ( _count != nil )
+      [_count release];
 
    [super dealloc];
 }
 
 - (void) processImage: (id <LynkeosImageBuffer>)image
           withOffsets: (NSPoint*)offsets
+               weight: (double)weight
 {
    NSAssert( _sum == nil || _sum->_nPlanes == [image numberOfPlanes],
              @"heterogeneous planes numbers in sigma reject stacking" );
@@ -154,14 +150,21 @@ static NSString * const mySigmaRejectImageStackerResult
    {
       u_short x, y, c;
       REAL **p = (REAL**)[_sum colorPlanes];
+      REAL **n;
       SigmaRejectImageStackerResult *res
          = [_list getProcessingParameterWithRef:mySigmaRejectImageStackerResult
                                   forProcessing:myImageStackerRef];
       
       // Allocate the count buffer if needed
-      if ( _count == NULL )
-         _count = (u_short*)calloc( buf->_nPlanes*buf->_w*buf->_h,
-                                    sizeof(u_short) );
+      if ( _count == nil )
+         _count = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                                  buf->_nPlanes
+                                                                      width:
+                                                                  buf->_w
+                                                                     height:
+                                                                  buf->_h]
+                                                                        retain];
+      n = (REAL**)[_count colorPlanes];
 
       // Perform pixel addition only when below the standard deviation threshold
       for( c = 0; c < buf->_nPlanes; c++ )
@@ -175,9 +178,11 @@ static NSString * const mySigmaRejectImageStackerResult
                REAL s = stdColorValue(res->_sum2,PROCESSING_PRECISION,x,y,c);
                if ( fabs(v-m) <= s*_params->_method.sigma.threshold )
                {
-                  v += stdColorValue(buf,PROCESSING_PRECISION,x,y,c);
+                  v += stdColorValue(_sum,PROCESSING_PRECISION,x,y,c);
                   SET_SAMPLE(p[c],PROCESSING_PRECISION,x,y,_sum->_padw, v);
-                  _count[(c*buf->_h + y)*buf->_w + x]++;
+                  SET_SAMPLE(n[c],PROCESSING_PRECISION,x,y,_count->_padw,
+                             stdColorValue(_count,PROCESSING_PRECISION,x,y,c)
+                             + 1.0);
                }
             }
          }
@@ -185,46 +190,33 @@ static NSString * const mySigmaRejectImageStackerResult
    }
 }
 
-- (void) finishOneProcessingThreadInList:(id <LynkeosImageList>)list ;
+- (void) mergeStack:(NSObject <MyImageStackerModeStrategy>*)stack
 {
-   // Recombine the stacks in the list
-   SigmaRejectImageStackerResult *res
-      = [list getProcessingParameterWithRef:mySigmaRejectImageStackerResult
-                              forProcessing:myImageStackerRef];
+   MyImageStacker_SigmaReject *other = (MyImageStacker_SigmaReject*)stack;
 
-   if ( res == nil )
-   {
-      res = [[[SigmaRejectImageStackerResult alloc] init] autorelease];
+   if ( other->_sum == nil )
+      return;
 
-      [list setProcessingParameter:res withRef:mySigmaRejectImageStackerResult 
-                     forProcessing:myImageStackerRef];
+   if ( _sum == nil )
+   {
+      _sum = [other->_sum retain];
+      _sum2 = [other->_sum2 retain];
+      _count = [other->_count retain];
+      return;
    }
 
-   if ( res->_sum == nil )
-      res->_sum = [_sum retain];
-   else
-      [res->_sum add:_sum];
+   [_sum setOperatorsStrategy:ParallelizedStrategy];
+   [_sum add:other->_sum result:_sum];
 
    if ( _params->_method.sigma.pass == 1 )
    {
-      if ( res->_sum2 == nil )
-         res->_sum2 = [_sum2 retain];
-      else
-         [res->_sum2 add:_sum2];
+      [_sum2 setOperatorsStrategy:ParallelizedStrategy];
+      [_sum2 add:other->_sum2 result:_sum2];
    }
    else
    {
-      u_short x, y, c;
-
-      if ( res->_count == NULL )
-         res->_count = (u_short*)calloc(_sum->_nPlanes*_sum->_w*_sum->_h,
-                                        sizeof(u_short));
-
-      for( c = 0; c < _sum->_nPlanes; c++ )
-         for( y = 0; y < _sum->_h; y++ )
-            for( x = 0; x < _sum->_w; x++ )
-               res->_count[(c*_sum->_h + y)*_sum->_w + x] +=
-                                          _count[(c*_sum->_h + y)*_sum->_w + x];
+      [_count setOperatorsStrategy:ParallelizedStrategy];
+      [_count add:other->_count result:_count];
    }
 }
 
@@ -233,59 +225,54 @@ static NSString * const mySigmaRejectImageStackerResult
    REAL **p;
    u_short x, y, c;
 
-   // Calculate the stats
-   SigmaRejectImageStackerResult *res
-      = [list getProcessingParameterWithRef:mySigmaRejectImageStackerResult
-                              forProcessing:myImageStackerRef];
-   NSAssert( res != nil, @"No stacking result at sigma reject pass end" );
+   // Maybe there was nothing to stack
+   if ( _sum == nil )
+      return;
+
+   [_sum setOperatorsStrategy:ParallelizedStrategy];
 
    if ( _params->_method.sigma.pass == 1 )
    {
+      SigmaRejectImageStackerResult *res
+         = [[[SigmaRejectImageStackerResult alloc] init] autorelease];
+
       // Compute the mean
       REAL s = 1.0/(REAL)_params->_imagesStacked;
-      [res->_sum multiplyWithScalar:s];
+      [_sum multiplyWithScalar:s];
       // The variance
-      [res->_sum2 multiplyWithScalar:s];
+      [_sum2 setOperatorsStrategy:ParallelizedStrategy];
+      [_sum2 multiplyWithScalar:s];
       LynkeosStandardImageBuffer *buf
          = [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
-                                                             res->_sum->_nPlanes
+                                                             _sum->_nPlanes
                                                                width:
-                                                             res->_sum->_w
+                                                             _sum->_w
                                                               height:
-                                                             res->_sum->_h];
-      [res->_sum multiplyWith:res->_sum result:buf];
-      [res->_sum2 substract:buf];
+                                                             _sum->_h];
+      [_sum multiplyWith:_sum result:buf];
+      [_sum2 substract:buf];
       // And the standard deviation from the variance
-      p = (REAL**)[res->_sum2 colorPlanes];
-      for( c = 0; c < res->_sum2->_nPlanes; c++ )
-         for( y = 0; y < res->_sum2->_h; y++ )
-            for( x = 0; x < res->_sum2->_w; x++ )
+      p = (REAL**)[_sum2 colorPlanes];
+      for( c = 0; c < _sum2->_nPlanes; c++ )
+         for( y = 0; y < _sum2->_h; y++ )
+            for( x = 0; x < _sum2->_w; x++ )
             {
-               REAL v = sqrt(stdColorValue(res->_sum2,PROCESSING_PRECISION,
-                                           x,y,c));
-               SET_SAMPLE(p[c],PROCESSING_PRECISION,x,y,res->_sum2->_padw, v);
+               REAL v = sqrt(stdColorValue(_sum2,PROCESSING_PRECISION,x,y,c));
+               SET_SAMPLE(p[c],PROCESSING_PRECISION,x,y,_sum2->_padw, v);
             }
 
+      // Keep them in the list for the second pass
+      res->_sum = [_sum retain];
+      res->_sum2 = [_sum2 retain];
+      [list setProcessingParameter:res withRef:mySigmaRejectImageStackerResult 
+                     forProcessing:myImageStackerRef];
    }
    else
    {
-      // Compute the second pass mean, and store it
-      p = (REAL**)[_sum colorPlanes];
-      for( c = 0; c < _sum->_nPlanes; c++ )
-         for( y = 0; y < _sum->_h; y++ )
-            for( x = 0; x < _sum->_w; x++ )
-            {
-               REAL v;
-               u_short n = res->_count[(c*res->_sum->_h + y)*res->_sum->_w + x];
-               if ( n == 0 )
-                  v = 0.0;
-               else
-                  v = stdColorValue(res->_sum,PROCESSING_PRECISION,x,y,c)
-                      / (REAL)n;
-               SET_SAMPLE(p[c],PROCESSING_PRECISION,x,y,_sum->_padw, v);
-            }
+      // Compute the second pass mean, null where every value was rejected
+      [_sum divideBy:_count result:_sum];
 
-      // And get rid of the recombining parameter
+      // And get rid of the pass 1 parameter
       [list setProcessingParameter:nil withRef:mySigmaRejectImageStackerResult 
                      forProcessing:myImageStackerRef];   
    }
@@ -0,0 +1,43 @@
+//
+//  MyImageStacker_SigmaStream.h
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 10/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#include "MyImageStacker.h"
+
+/*!
+ * @abstract Single pass standard deviation rejection stacking strategy
+ * @discussion The mean and variance are updated on the fly (Welford's method)
+ *    and, for each pixel, the few greatest and lowest values are kept in a
+ *    spill buffer. At the end, the kept values which are out of the threshold
+ *    are removed from the sum, one by one. The result is exact as long as
+ *    there are no more rejected values on one side of a pixel than the spill
+ *    buffer holds.<br>
+ *    The spill buffers of all the threads shall fit in the memory given to
+ *    the images, the stack is otherwise made in two passes. If they cannot
+ *    be allocated anyway, only the mean is computed.
+ * @ingroup Processing
+ */
+@interface MyImageStacker_SigmaStream : NSObject <MyImageStackerModeStrategy>
+{
+   @private
+   MyImageStackerParameters*   _params;  //!< Stacking parameters
+   LynkeosStandardImageBuffer* _mean;    //!< Running mean of the images
+   //! Running sum of the squared deviations from the mean
+   LynkeosStandardImageBuffer* _m2;
+   u_long                      _nStacked; //!< Number of images in the mean
+   //! Greatest values of each pixel, in decreasing order
+   REAL*                       _highest;
+   //! Opposite of the lowest values of each pixel, in decreasing order
+   REAL*                       _lowest;
+   u_short                     _nExtremes; //!< Number of values kept by pixel
+   LynkeosStandardImageBuffer* _result;  //!< The sigma rejected mean
+   id <LynkeosImageList>       _list;    //!< The list being stacked
+}
+
+@end
@@ -0,0 +1,334 @@
+//
+//  MyImageStacker_SigmaStream.m
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 10/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+#include <stdlib.h>
+
+#include "MyImageStacker_SigmaStream.h"
+
+/*!
+ * @abstract Insert a value in a decreasing list of the greatest values
+ * @param e The list
+ * @param n Number of values in the list
+ * @param k Capacity of the list
+ * @param v The value to insert
+ */
+static inline void insertGreatest( REAL *e, u_short n, u_short k, REAL v )
+{
+   u_short i;
+
+   if ( n == k )
+   {
+      // The list is full, its lowest value goes away
+      if ( v <= e[k-1] )
+         return;
+      i = k - 1;
+   }
+   else
+      i = n;
+
+   for( ; i > 0 && v > e[i-1]; i-- )
+      e[i] = e[i-1];
+   e[i] = v;
+}
+
+@implementation MyImageStacker_SigmaStream
+
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _params = nil;
+      _mean = nil;
+      _m2 = nil;
+      _nStacked = 0;
+      _highest = NULL;
+      _lowest = NULL;
+      _nExtremes = 0;
+      _result = nil;
+      _list = nil;
+   }
+
+   return( self );
+}
+
+- (id) initWithParameters: (id <NSObject>)params
+                     list: (id <LynkeosImageList>)list
+{
+   if ( (self = [self init]) != nil )
+   {
+      _params = [params retain];
+      _list = list;
+      NSAssert( _params->_method.sigma.reservoir != 0,
+                @"Single pass sigma reject stacking without reservoir" );
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   if ( _params != nil )
+      [_params release];
+   if ( _mean != nil )
+      [_mean release];
+   if ( _m2 != nil )
+      [_m2 release];
+   if ( _highest != NULL )
+      free( _highest );
+   if ( _lowest != NULL )
+      free( _lowest );
+   if ( _result != nil )
+      [_result release];
+
+   [super dealloc];
+}
+
+- (void) processImage: (id <LynkeosImageBuffer>)image
+          withOffsets: (NSPoint*)offsets
+               weight: (double)weight
+{
+   NSAssert( _mean == nil || _mean->_nPlanes == [image numberOfPlanes],
+             @"heterogeneous planes numbers in sigma reject stacking" );
+
+   const u_short k = _params->_method.sigma.reservoir;
+   u_short x, y, c;
+   REAL **pm, **pm2;
+   REAL r;
+
+   // Extract the data in a local image buffer
+   LynkeosStandardImageBuffer *buf
+      = [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                [image numberOfPlanes]
+                                                         width:
+                                                [image width]*_params->_factor
+                                                        height:
+                                                [image height]*_params->_factor];
+   [buf add:image withOffsets:offsets withExpansion:_params->_factor];
+
+   // If this is the first image, create the statistics and spill buffers
+   if ( _mean == nil )
+   {
+      const size_t spillSize = (size_t)k*buf->_nPlanes*buf->_w*buf->_h
+                               *sizeof(REAL);
+
+      _mean = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                               buf->_nPlanes
+                                                                   width:
+                                                               buf->_w
+                                                                  height:
+                                                               buf->_h]
+                                                                        retain];
+      _m2 = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                               buf->_nPlanes
+                                                                 width:
+                                                               buf->_w
+                                                                height:
+                                                               buf->_h]
+                                                                        retain];
+      _highest = (REAL*)malloc( spillSize );
+      _lowest = (REAL*)malloc( spillSize );
+      if ( _highest == NULL || _lowest == NULL )
+      {
+         // Go on with the mean only, rather than failing the whole stack
+         NSLog( @"Sigma reject spill buffer allocation failed, "
+                @"no value will be rejected" );
+         if ( _highest != NULL )
+            free( _highest );
+         if ( _lowest != NULL )
+            free( _lowest );
+         _highest = NULL;
+         _lowest = NULL;
+      }
+   }
+
+   // Update the running mean and squared deviations, and the extreme values
+   _nStacked++;
+   r = 1.0/(REAL)_nStacked;
+   pm = (REAL**)[_mean colorPlanes];
+   pm2 = (REAL**)[_m2 colorPlanes];
+   for( c = 0; c < buf->_nPlanes; c++ )
+   {
+      for( y = 0; y < buf->_h; y++ )
+      {
+         for( x = 0; x < buf->_w; x++ )
+         {
+            const u_long e = (((u_long)c*buf->_h + y)*buf->_w + x)*k;
+            REAL v = stdColorValue(buf,PROCESSING_PRECISION,x,y,c);
+            REAL m = stdColorValue(_mean,PROCESSING_PRECISION,x,y,c);
+            REAL d = v - m;
+
+            m += d*r;
+            SET_SAMPLE(pm[c],PROCESSING_PRECISION,x,y,_mean->_padw, m);
+            SET_SAMPLE(pm2[c],PROCESSING_PRECISION,x,y,_m2->_padw,
+                       stdColorValue(_m2,PROCESSING_PRECISION,x,y,c)
+                       + d*(v - m));
+
+            if ( _highest != NULL )
+            {
+               insertGreatest( &_highest[e], _nExtremes, k, v );
+               insertGreatest( &_lowest[e], _nExtremes, k, -v );
+            }
+         }
+      }
+   }
+   if ( _highest != NULL && _nExtremes < k )
+      _nExtremes++;
+}
+
+- (void) mergeStack:(NSObject <MyImageStackerModeStrategy>*)stack
+{
+   MyImageStacker_SigmaStream *other = (MyImageStacker_SigmaStream*)stack;
+   const u_short k = _params->_method.sigma.reservoir;
+
+   if ( other->_mean == nil )
+      return;
+
+   if ( _mean == nil )
+   {
+      _mean = [other->_mean retain];
+      _m2 = [other->_m2 retain];
+      // Take over the spill buffers
+      _highest = other->_highest;
+      _lowest = other->_lowest;
+      _nExtremes = other->_nExtremes;
+      other->_highest = NULL;
+      other->_lowest = NULL;
+   }
+   else
+   {
+      // Merge the statistics of both sets, d being the difference of means
+      const REAL n = (REAL)(_nStacked + other->_nStacked);
+      const u_long nPixels = (u_long)_mean->_nPlanes*_mean->_w*_mean->_h;
+      LynkeosStandardImageBuffer *d = [[other->_mean copy] autorelease];
+      LynkeosStandardImageBuffer *shift;
+      u_long p;
+      u_short j, nExtremes;
+
+      [_mean setOperatorsStrategy:ParallelizedStrategy];
+      [_m2 setOperatorsStrategy:ParallelizedStrategy];
+      [d setOperatorsStrategy:ParallelizedStrategy];
+
+      [d multiplyWithScalar:-1.0];
+      [d add:_mean result:d];
+      shift = [[d copy] autorelease];
+      [shift setOperatorsStrategy:ParallelizedStrategy];
+      [shift multiplyWithScalar:-(REAL)other->_nStacked/n];
+      [_mean add:shift result:_mean];
+
+      [d multiplyWith:d result:d];
+      [d multiplyWithScalar:(REAL)_nStacked*(REAL)other->_nStacked/n];
+      [_m2 add:other->_m2 result:_m2];
+      [_m2 add:d result:_m2];
+
+      // Without both spill buffers, no value can be rejected any more
+      if ( _highest == NULL || other->_highest == NULL )
+      {
+         if ( _highest != NULL )
+         {
+            free( _highest );
+            free( _lowest );
+         }
+         _highest = NULL;
+         _lowest = NULL;
+         _nExtremes = 0;
+      }
+
+      // The extreme values of the union are among the extremes of each set
+      nExtremes = _nExtremes;
+      for( p = 0; p < nPixels && _highest != NULL; p++ )
+      {
+         nExtremes = _nExtremes;
+         for( j = 0; j < other->_nExtremes; j++ )
+         {
+            insertGreatest( &_highest[p*k], nExtremes, k,
+                            other->_highest[p*k+j] );
+            insertGreatest( &_lowest[p*k], nExtremes, k,
+                            other->_lowest[p*k+j] );
+            if ( nExtremes < k )
+               nExtremes++;
+         }
+      }
+      _nExtremes = nExtremes;
+
+      // Free the other spill buffers as soon as possible
+      if ( other->_highest != NULL )
+      {
+         free( other->_highest );
+         free( other->_lowest );
+      }
+      other->_highest = NULL;
+      other->_lowest = NULL;
+   }
+   _nStacked += other->_nStacked;
+   other->_nExtremes = 0;
+}
+
+- (void) finishAllProcessingInList: (id <LynkeosImageList>)list;
+{
+   // Maybe there was nothing to stack
+   if ( _mean == nil )
+      return;
+
+   const u_short k = _params->_method.sigma.reservoir;
+   const REAL n = (REAL)_nStacked;
+   u_short x, y, c, j;
+   REAL **p;
+
+   _result = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                         _mean->_nPlanes
+                                                                  width:
+                                                         _mean->_w
+                                                                 height:
+                                                         _mean->_h]
+                                                                        retain];
+   p = (REAL**)[_result colorPlanes];
+
+   for( c = 0; c < _result->_nPlanes; c++ )
+   {
+      for( y = 0; y < _result->_h; y++ )
+      {
+         for( x = 0; x < _result->_w; x++ )
+         {
+            const u_long e = (((u_long)c*_result->_h + y)*_result->_w + x)*k;
+            REAL m = stdColorValue(_mean,PROCESSING_PRECISION,x,y,c);
+            REAL s = sqrt(stdColorValue(_m2,PROCESSING_PRECISION,x,y,c) / n);
+            REAL t = s*_params->_method.sigma.threshold;
+            double rejectedSum = 0.0, kept, v;
+            u_long rejectedCount = 0;
+
+            // Remove the spilled values which are out of the threshold
+            for( j = 0; j < _nExtremes && _highest[e+j] - m > t; j++ )
+            {
+               rejectedSum += _highest[e+j];
+               rejectedCount++;
+            }
+            for( j = 0; j < _nExtremes && m + _lowest[e+j] > t; j++ )
+            {
+               rejectedSum -= _lowest[e+j];
+               rejectedCount++;
+            }
+
+            kept = n - (double)rejectedCount;
+            if ( kept <= 0.0 )
+               v = 0.0;
+            else
+               v = (n*m - rejectedSum)/kept;
+            SET_SAMPLE(p[c],PROCESSING_PRECISION,x,y,_result->_padw, v);
+         }
+      }
+   }
+
+   // The spill buffers are no more needed
+   free( _highest );
+   free( _lowest );
+   _highest = NULL;
+   _lowest = NULL;
+}
+
+- (LynkeosStandardImageBuffer*) stackingResult { return( _result ); }
+
+@end
@@ -16,5 +16,19 @@
    MyImageStackerParameters* _params;  //!< Stacking parameters
    LynkeosStandardImageBuffer* _monoStack; //!< Stack of mono images
    LynkeosStandardImageBuffer* _rgbStack; //!< Stack of RGB images
+   //! Stack of the mono images to remove from the previous stack
+   LynkeosStandardImageBuffer* _monoRemoved;
+   //! Stack of the RGB images to remove from the previous stack
+   LynkeosStandardImageBuffer* _rgbRemoved;
+   unsigned long             _nAdded;    //!< Number of images stacked
+   unsigned long             _nRemoved;  //!< Number of images removed
 }
+
+/*!
+ * @abstract Stack an image to substract from the previous stack sums
+ * @param image The image to remove
+ * @param offsets The offsets it was stacked with
+ */
+- (void) removeImage: (id <LynkeosImageBuffer>)image
+         withOffsets: (NSPoint*)offsets ;
 @end
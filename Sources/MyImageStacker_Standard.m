@@ -8,51 +8,79 @@
 
 #include "MyImageStacker_Standard.h"
 
-// Private (and temporary) parameter used to recombine the stacks
-static NSString * const myStandardImageStackerResult = @"StandardStackerResult";
-
-@interface StandardImageStackerResult : NSObject <LynkeosProcessingParameter>
-{
-@public
-   LynkeosStandardImageBuffer* _mono;
-   LynkeosStandardImageBuffer* _rgb;
-}
-@end
-
-@implementation StandardImageStackerResult
-- (id) init
+/*!
+ * @abstract Update a sum with the added and removed images stacks
+ * @param sum The sum to update, it is created if needed
+ * @param added The stack of added images, or nil
+ * @param removed The stack of removed images, or nil
+ */
+static void updateSum( LynkeosStandardImageBuffer **sum,
+                       LynkeosStandardImageBuffer *added,
+                       LynkeosStandardImageBuffer *removed )
 {
-   self = [super init];
-   if ( self != nil )
+   if ( *sum == nil )
    {
-      _mono = nil;
-      _rgb = nil;
+      NSCAssert( removed == nil, @"Removing images from an empty stack" );
+      if ( added != nil )
+         *sum = [added copy];
+   }
+   else
+   {
+      [*sum setOperatorsStrategy:ParallelizedStrategy];
+      if ( added != nil )
+         [*sum add:added result:*sum];
+      if ( removed != nil )
+         [*sum substract:removed];
    }
-   
-   return( self );
 }
 
-- (void) dealloc
+/*!
+ * @abstract Stack an image in a mono or RGB stack
+ */
+static void stackImage( id <LynkeosImageBuffer> image, NSPoint *offsets,
+                        u_short factor,
+                        LynkeosStandardImageBuffer **mono,
+                        LynkeosStandardImageBuffer **rgb )
 {
-   if ( _mono != nil )
-      [_mono release];
-   if ( _rgb != nil )
-      [_rgb release];
-   
-   [super dealloc];
-}
+   LynkeosStandardImageBuffer **sum;
 
-// This parameter is deleted at process end, it cannot be saved
-- (void)encodeWithCoder:(NSCoder *)encoder
-{
-   [self doesNotRecognizeSelector:_cmd];
+   if ( [image numberOfPlanes] == 1 )
+      sum = mono;
+   else
+      sum = rgb;
+
+   // If this is the first image, create the empty stack buffer with the same 
+   // number of planes (taking into account the expansion factor)
+   if ( *sum == nil )
+      *sum = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                [image numberOfPlanes]
+                                                                  width:
+                                                [image width]*factor
+                                                                 height:
+                                                [image height]*factor]
+              retain];
+
+   // Accumulate
+   [*sum add:image withOffsets:offsets withExpansion:factor];
 }
-- (id)initWithCoder:(NSCoder *)decoder
+
+/*!
+ * @abstract Merge the stack of another thread
+ */
+static void mergeImage( LynkeosStandardImageBuffer **sum,
+                        LynkeosStandardImageBuffer *other )
 {
-   [self doesNotRecognizeSelector:_cmd];
-   return( nil );
+   if ( other != nil )
+   {
+      if ( *sum == nil )
+         *sum = [other retain];
+      else
+      {
+         [*sum setOperatorsStrategy:ParallelizedStrategy];
+         [*sum add:other result:*sum];
+      }
+   }
 }
-@end
 
 @implementation MyImageStacker_Standard
 
@@ -63,6 +91,10 @@ static NSString * const myStandardImageStackerResult = @"StandardStackerResult";
       _params = nil;
       _monoStack = nil;
       _rgbStack = nil;
+      _monoRemoved = nil;
+      _rgbRemoved = nil;
+      _nAdded = 0;
+      _nRemoved = 0;
    }
 
    return( self );
@@ -85,99 +117,91 @@ static NSString * const myStandardImageStackerResult = @"StandardStackerResult";
       [_monoStack release];
    if ( _rgbStack != nil )
       [_rgbStack release];
+   if ( _monoRemoved != nil )
+      [_monoRemoved release];
+   if ( _rgbRemoved != nil )
+      [_rgbRemoved release];
 
    [super dealloc];
 }
 
 - (void) processImage: (id <LynkeosImageBuffer>)image
          withOffsets: (NSPoint*)offsets
+              weight: (double)weight
 {
-   LynkeosStandardImageBuffer **sum;
-
-   if ( [image numberOfPlanes] == 1 )
-      sum = &_monoStack;
-   else
-      sum = &_rgbStack;
+   stackImage( image, offsets, _params->_factor, &_monoStack, &_rgbStack );
+   _nAdded++;
+}
 
-   // If this is the first image, create the empty stack buffer with the same 
-   // number of planes (taking into account the expansion factor)
-   if ( *sum == nil )
-      *sum = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
-                                                [image numberOfPlanes]
-                                                                  width:
-                                                [image width]*_params->_factor
-                                                                 height:
-                                                [image height]*_params->_factor]
-              retain];
+- (void) removeImage: (id <LynkeosImageBuffer>)image
+         withOffsets: (NSPoint*)offsets
+{
+   stackImage( image, offsets, _params->_factor, &_monoRemoved, &_rgbRemoved );
+   _nRemoved++;
+}
 
-   // Accumulate
-   [*sum add:image withOffsets:offsets withExpansion:_params->_factor];
+- (void) mergeStack:(NSObject <MyImageStackerModeStrategy>*)stack
+{
+   MyImageStacker_Standard *other = (MyImageStacker_Standard*)stack;
+
+   mergeImage( &_monoStack, other->_monoStack );
+   mergeImage( &_rgbStack, other->_rgbStack );
+   mergeImage( &_monoRemoved, other->_monoRemoved );
+   mergeImage( &_rgbRemoved, other->_rgbRemoved );
+   _nAdded += other->_nAdded;
+   _nRemoved += other->_nRemoved;
 }
 
-- (void) finishOneProcessingThreadInList:(id <LynkeosImageList>)list ;
+- (void) finishAllProcessingInList: (id <LynkeosImageList>)list;
 {
-   // Recombine the stacks in the list
-   StandardImageStackerResult *res
-      = [list getProcessingParameterWithRef:myStandardImageStackerResult
-                              forProcessing:myImageStackerRef];
+   MyImageStackerAccumulator *acc =
+      [list getProcessingParameterWithRef:myImageStackerAccumulatorRef
+                            forProcessing:myImageStackerRef];
 
-   if ( res == nil )
+   // Update the raw sums kept in the list, and take them as result
+   if ( acc != nil )
    {
-      res = [[[StandardImageStackerResult alloc] init] autorelease];
-      res->_mono = [_monoStack retain];
-      res->_rgb = [_rgbStack retain];
-      [list setProcessingParameter:res withRef:myStandardImageStackerResult 
-                     forProcessing:myImageStackerRef];
-   }
-   else
-   {
-      if ( _monoStack != nil )
+      updateSum( &acc->_monoSum, _monoStack, _monoRemoved );
+      updateSum( &acc->_rgbSum, _rgbStack, _rgbRemoved );
+      acc->_nImages = acc->_nImages + _nAdded - _nRemoved;
+      if ( acc->_nImages == 0 )
       {
-         if ( res->_mono != nil )
-            [res->_mono add:_monoStack];
-         else
-            res->_mono = [_monoStack retain];
+         // Everything was removed
+         [acc->_monoSum release];
+         acc->_monoSum = nil;
+         [acc->_rgbSum release];
+         acc->_rgbSum = nil;
       }
-      if ( _rgbStack != nil )
+      if ( acc->_removed != nil )
       {
-         if ( res->_rgb != nil )
-            [res->_rgb add:_rgbStack];
-         else
-            res->_rgb = [_rgbStack retain];
+         [acc->_removed release];
+         acc->_removed = nil;
       }
-   }
-}
 
-- (void) finishAllProcessingInList: (id <LynkeosImageList>)list;
-{
-   // Recombine monochrome and RGB stacks if needed
-   StandardImageStackerResult *res
-      = [list getProcessingParameterWithRef:myStandardImageStackerResult
-                              forProcessing:myImageStackerRef];
-   LynkeosStandardImageBuffer *stack = nil;
+      if ( _monoStack != nil )
+         [_monoStack release];
+      _monoStack = [acc->_monoSum copy];
+      if ( _rgbStack != nil )
+         [_rgbStack release];
+      _rgbStack = [acc->_rgbSum copy];
 
-   if ( res->_rgb != nil )
-      stack = [res->_rgb retain];
+      // The mean shall be taken on all the images in the sums
+      _params->_imagesStacked = acc->_nImages;
+   }
 
-   if ( res->_mono != nil )
+   // Recombine monochrome and RGB stacks if needed
+   if ( _monoStack != nil )
    {
-      if ( stack == nil )
-         stack = [res->_mono retain];
+      if ( _rgbStack == nil )
+         _rgbStack = _monoStack;
       else
+      {
          // Add code knows how to add L with RGB
-         [stack add:res->_mono];
+         [_rgbStack add:_monoStack];
+         [_monoStack release];
+      }
+      _monoStack = nil;
    }
-
-   if ( _rgbStack != nil )
-      [_rgbStack release];
-   _rgbStack = stack;
-   if ( _monoStack != nil )
-      [_monoStack release];
-   _monoStack = nil;
-
-   // And get rid of the recombining parameter
-   [list setProcessingParameter:nil withRef:myStandardImageStackerResult 
-                  forProcessing:myImageStackerRef];   
 }
 
 - (LynkeosStandardImageBuffer*) stackingResult { return( _rgbStack ); }
@@ -0,0 +1,56 @@
+//
+//  MyImageStacker_Tiles.h
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 30/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#include "MyImageStacker.h"
+
+@class TiledImageStackerStore;
+
+/*!
+ * @abstract Base of the stacking strategies which need every frame value
+ * @discussion Each frame is cut in square tiles which are written in a
+ *    temporary file, where the tiles of all the frames at the same place are
+ *    contiguous. At the end, each tile pixels stack is read in one go, and
+ *    reduced to one value per pixel by the subclass, tiles being shared
+ *    between the processors. The tile size is chosen to bound the memory used.
+ * @ingroup Processing
+ */
+@interface MyImageStacker_Tiles : NSObject <MyImageStackerModeStrategy>
+{
+   @protected
+   MyImageStackerParameters*   _params; //!< Stacking parameters
+   TiledImageStackerStore*     _store;  //!< The frames file
+   REAL*                       _tile;   //!< Buffer for writing one tile
+   LynkeosStandardImageBuffer* _result; //!< The reduced frames
+   id <LynkeosImageList>       _list;   //!< The list being stacked
+}
+
+/*!
+ * @abstract Size of the work buffer needed to reduce one tile
+ * @param nFrames Number of frames in the stack
+ * @param side Side of the tiles
+ * @result The size in bytes
+ */
+- (size_t) reductionBufferSizeForFrames:(u_long)nFrames side:(u_short)side ;
+
+/*!
+ * @abstract Reduce the frames stack of one tile
+ * @discussion This is called concurrently by several threads, each one with
+ *    its own tile and work buffer.
+ * @param stack The tiles of every frame, one after the other
+ * @param nFrames Number of frames in the stack
+ * @param tileSize Number of values in a tile (all planes)
+ * @param side Side of the tiles, the pixels of a tile row are contiguous
+ * @param tile The tile receiving the result
+ * @param buffer Work buffer
+ */
+- (void) reduceStack:(const REAL*)stack frames:(u_long)nFrames
+            tileSize:(size_t)tileSize side:(u_short)side
+                into:(REAL*)tile buffer:(void*)buffer ;
+@end
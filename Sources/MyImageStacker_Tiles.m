@@ -0,0 +1,407 @@
+//
+//  MyImageStacker_Tiles.m
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 30/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "MyImageStacker_Tiles.h"
+
+//! Maximum memory used by each thread to read the stack of one tile
+#define K_TILES_STACK_BUDGET (8*1024*1024)
+//! Largest tile side
+#define K_TILES_MAX_SIDE 256
+//! Smallest tile side, whatever the memory used
+#define K_TILES_MIN_SIDE 8
+
+// Private (and temporary) parameter used to share the frames file
+static NSString * const myTiledImageStackerStore = @"TiledStackerStore";
+
+/*!
+ * @abstract Temporary file where the frames are transposed by tile
+ * @discussion The file holds, for each tile, the tiles of every frame at this
+ *    place. A tile is made of its color planes, each of side*side pixels.
+ */
+@interface TiledImageStackerStore : NSObject <LynkeosProcessingParameter>
+{
+@public
+   int                         _file;      //!< Descriptor of the file
+   u_short                     _nPlanes;   //!< Number of color planes
+   u_short                     _w;         //!< Frames width
+   u_short                     _h;         //!< Frames height
+   u_short                     _side;      //!< Side of the tiles
+   u_short                     _tilesX;    //!< Number of tiles in a row
+   u_short                     _tilesY;    //!< Number of tiles in a column
+   size_t                      _tileSize;  //!< Number of values in a tile
+   u_long                      _maxFrames; //!< Room for frames in the file
+   u_long                      _nFrames;   //!< Number of frames written
+   NSLock                     *_lock;      //!< Protects the frames counter
+
+   // Tiles reduction
+   LynkeosStandardImageBuffer *_result;    //!< The reduced image
+   MyImageStacker_Tiles       *_reducer;   //!< Strategy reducing the tiles
+   u_long                      _nextTile;  //!< Next tile to process
+   //! Protects the tiles counter, its condition is the number of ended threads
+   NSConditionLock            *_endLock;
+}
+- (id) initWithNumberOfPlanes:(u_short)nPlanes
+                        width:(u_short)w height:(u_short)h
+                    maxFrames:(u_long)maxFrames ;
+- (off_t) offsetOfTile:(u_long)tile frame:(u_long)frame ;
+- (void) processTiles:(id)arg ;
+@end
+
+@implementation TiledImageStackerStore
+- (id) init
+{
+   self = [super init];
+   if ( self != nil )
+   {
+      _file = -1;
+      _nPlanes = 0;
+      _w = 0;
+      _h = 0;
+      _side = 0;
+      _tilesX = 0;
+      _tilesY = 0;
+      _tileSize = 0;
+      _maxFrames = 0;
+      _nFrames = 0;
+      _lock = [[NSLock alloc] init];
+      _result = nil;
+      _reducer = nil;
+      _nextTile = 0;
+      _endLock = nil;
+   }
+
+   return( self );
+}
+
+- (id) initWithNumberOfPlanes:(u_short)nPlanes
+                        width:(u_short)w height:(u_short)h
+                    maxFrames:(u_long)maxFrames
+{
+   if ( (self = [self init]) != nil )
+   {
+      NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:
+                                                     @"LynkeosStack.XXXXXX"];
+      char *name = strdup( [path fileSystemRepresentation] );
+      const size_t pixelSize = nPlanes*maxFrames*sizeof(REAL);
+
+      _nPlanes = nPlanes;
+      _w = w;
+      _h = h;
+      _maxFrames = maxFrames;
+
+      // Largest tile which stack fits in the memory budget
+      _side = K_TILES_MAX_SIDE;
+      while( _side > K_TILES_MIN_SIDE
+             && (size_t)_side*_side*pixelSize > K_TILES_STACK_BUDGET )
+         _side /= 2;
+      _tilesX = (_w + _side - 1)/_side;
+      _tilesY = (_h + _side - 1)/_side;
+      _tileSize = (size_t)_side*_side*_nPlanes;
+
+      // The file is deleted as soon as created, it lives until closed
+      _file = mkstemp( name );
+      if ( _file < 0 )
+      {
+         NSLog( @"Cannot create the stack file %s : %s",
+                name, strerror(errno) );
+         free( name );
+         [self release];
+         return( nil );
+      }
+      unlink( name );
+      free( name );
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   if ( _file >= 0 )
+      close( _file );
+   [_lock release];
+
+   [super dealloc];
+}
+
+- (off_t) offsetOfTile:(u_long)tile frame:(u_long)frame
+{
+   return( ((off_t)tile*_maxFrames + frame)*_tileSize*sizeof(REAL) );
+}
+
+- (void) processTiles:(id)arg
+{
+   const size_t stackSize = _nFrames*_tileSize*sizeof(REAL);
+   REAL *stack = (REAL*)malloc( stackSize );
+   REAL *tileBuf = (REAL*)malloc( _tileSize*sizeof(REAL) );
+   void *work = malloc( [_reducer reductionBufferSizeForFrames:_nFrames
+                                                          side:_side] );
+   REAL **planes = (REAL**)[_result colorPlanes];
+   u_long tile;
+
+   [_endLock lock];
+   tile = _nextTile++;
+   [_endLock unlock];
+
+   while( tile < (u_long)_tilesX*_tilesY )
+   {
+      const u_short x0 = (tile % _tilesX)*_side, y0 = (tile / _tilesX)*_side;
+      u_short x, y, c;
+
+      // Read the pixels stack of this tile in one go
+      if ( pread( _file, stack, stackSize, [self offsetOfTile:tile frame:0] )
+           != (ssize_t)stackSize )
+         NSLog( @"Error reading the stack file : %s", strerror(errno) );
+      else
+      {
+         [_reducer reduceStack:stack frames:_nFrames
+                      tileSize:_tileSize side:_side
+                          into:tileBuf buffer:work];
+
+         for( c = 0; c < _nPlanes; c++ )
+            for( y = y0; y < y0 + _side && y < _h; y++ )
+               for( x = x0; x < x0 + _side && x < _w; x++ )
+                  SET_SAMPLE( planes[c], PROCESSING_PRECISION, x, y,
+                              _result->_padw,
+                              tileBuf[(c*_side + y - y0)*_side + x - x0] );
+      }
+
+      [_endLock lock];
+      tile = _nextTile++;
+      [_endLock unlock];
+   }
+
+   free( stack );
+   free( tileBuf );
+   free( work );
+
+   // Count the ended threads
+   [_endLock lock];
+   [_endLock unlockWithCondition:[_endLock condition]+1];
+}
+
+// This parameter is deleted at process end, it cannot be saved
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+   [self doesNotRecognizeSelector:_cmd];
+}
+- (id)initWithCoder:(NSCoder *)decoder
+{
+   [self doesNotRecognizeSelector:_cmd];
+   return( nil );
+}
+@end
+
+@implementation MyImageStacker_Tiles
+
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _params = nil;
+      _store = nil;
+      _tile = NULL;
+      _result = nil;
+      _list = nil;
+   }
+
+   return( self );
+}
+
+- (id) initWithParameters: (id <NSObject>)params
+                     list: (id <LynkeosImageList>)list
+{
+   if ( (self = [self init]) != nil )
+   {
+      _params = [params retain];
+      _list = list;
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   if ( _params != nil )
+      [_params release];
+   if ( _store != nil )
+      [_store release];
+   if ( _tile != NULL )
+      free( _tile );
+   if ( _result != nil )
+      [_result release];
+
+   [super dealloc];
+}
+
+- (void) processImage: (id <LynkeosImageBuffer>)image
+          withOffsets: (NSPoint*)offsets
+               weight: (double)weight
+{
+   u_short tx, ty, x, y, c;
+   u_long frame;
+
+   // Extract the data in a local image buffer
+   LynkeosStandardImageBuffer *buf
+      = [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                [image numberOfPlanes]
+                                                         width:
+                                                [image width]*_params->_factor
+                                                        height:
+                                                [image height]*_params->_factor];
+   [buf add:image withOffsets:offsets withExpansion:_params->_factor];
+
+   // The first thread to get an image creates the file for everybody
+   if ( _store == nil )
+   {
+      [_params->_stackLock lock];
+      _store = [_list getProcessingParameterWithRef:
+                                                  myTiledImageStackerStore
+                                      forProcessing:myImageStackerRef];
+      if ( _store == nil )
+      {
+         NSEnumerator *items = [_list imageEnumeratorStartAt:nil
+                                                 directSense:YES
+                                              skipUnselected:YES];
+         u_long nItems = 0;
+
+         while ( [items nextObject] != nil )
+            nItems++;
+
+         _store = [[[TiledImageStackerStore alloc]
+                                     initWithNumberOfPlanes:buf->_nPlanes
+                                                      width:buf->_w
+                                                     height:buf->_h
+                                                  maxFrames:nItems]
+                                                                   autorelease];
+         if ( _store != nil )
+            [_list setProcessingParameter:_store
+                                  withRef:myTiledImageStackerStore
+                            forProcessing:myImageStackerRef];
+      }
+      [_store retain];
+      [_params->_stackLock unlock];
+
+      if ( _store == nil )
+         return;
+
+      _tile = (REAL*)malloc( _store->_tileSize*sizeof(REAL) );
+   }
+
+   NSAssert( _store->_nPlanes == buf->_nPlanes
+             && _store->_w == buf->_w && _store->_h == buf->_h,
+             @"heterogeneous images in tiled stacking" );
+
+   // Get a place for this frame
+   [_store->_lock lock];
+   frame = _store->_nFrames++;
+   [_store->_lock unlock];
+   NSAssert( frame < _store->_maxFrames, @"Too many frames in tiled stack" );
+
+   // Write each tile in its own stack
+   for( ty = 0; ty < _store->_tilesY; ty++ )
+   {
+      for( tx = 0; tx < _store->_tilesX; tx++ )
+      {
+         const u_short side = _store->_side;
+         const size_t size = _store->_tileSize*sizeof(REAL);
+
+         for( c = 0; c < buf->_nPlanes; c++ )
+         {
+            for( y = 0; y < side; y++ )
+            {
+               for( x = 0; x < side; x++ )
+               {
+                  const u_short bx = tx*side + x, by = ty*side + y;
+
+                  _tile[(c*side + y)*side + x] =
+                     (bx < buf->_w && by < buf->_h ?
+                      stdColorValue(buf,PROCESSING_PRECISION,bx,by,c) : 0.0);
+               }
+            }
+         }
+
+         if ( pwrite( _store->_file, _tile, size,
+                      [_store offsetOfTile:ty*_store->_tilesX + tx
+                                     frame:frame] )
+              != (ssize_t)size )
+            NSLog( @"Error writing the stack file : %s", strerror(errno) );
+      }
+   }
+}
+
+- (void) mergeStack:(NSObject <MyImageStackerModeStrategy>*)stack
+{
+   // Everything is already in the file
+}
+
+- (void) finishAllProcessingInList: (id <LynkeosImageList>)list;
+{
+   TiledImageStackerStore *store
+      = [list getProcessingParameterWithRef:myTiledImageStackerStore
+                              forProcessing:myImageStackerRef];
+   u_short t, nThreads;
+
+   // Maybe there was nothing to stack
+   if ( store == nil || store->_nFrames == 0 )
+      return;
+
+   _result = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:
+                                                            store->_nPlanes
+                                                                  width:
+                                                            store->_w
+                                                                 height:
+                                                            store->_h]
+                                                                        retain];
+
+   // Share the tiles between the processors available
+   nThreads = cpuBudgetForItem( ImageOperatorsOptimization );
+   store->_result = _result;
+   store->_reducer = self;
+   store->_nextTile = 0;
+   store->_endLock = [[NSConditionLock alloc] initWithCondition:0];
+
+   for( t = 1; t < nThreads; t++ )
+      [NSThread detachNewThreadSelector:@selector(processTiles:)
+                               toTarget:store
+                             withObject:nil];
+   [store processTiles:nil];
+
+   // Wait for all threads completion
+   [store->_endLock lockWhenCondition:nThreads];
+   [store->_endLock unlock];
+   [store->_endLock release];
+   store->_endLock = nil;
+   store->_result = nil;
+   store->_reducer = nil;
+
+   // And get rid of the file
+   [list setProcessingParameter:nil withRef:myTiledImageStackerStore
+                  forProcessing:myImageStackerRef];
+}
+
+- (LynkeosStandardImageBuffer*) stackingResult { return( _result ); }
+
+- (size_t) reductionBufferSizeForFrames:(u_long)nFrames side:(u_short)side
+{
+   [self doesNotRecognizeSelector:_cmd];
+   return( 0 );
+}
+
+- (void) reduceStack:(const REAL*)stack frames:(u_long)nFrames
+            tileSize:(size_t)tileSize side:(u_short)side
+                into:(REAL*)tile buffer:(void*)buffer
+{
+   [self doesNotRecognizeSelector:_cmd];
+}
+
+@end
@@ -0,0 +1,32 @@
+//
+//  MyImageStacker_Weighted.h
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 17/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#include "MyImageStacker.h"
+
+/*!
+ * @abstract Quality weighted stacking strategy
+ * @discussion Each image is added with a weight given by its analysis
+ *    quality, and the sum is divided by the sum of the weights.
+ *    As the shifted images are extended by their borders, each image gives
+ *    the same weight to every pixel, and the weight map is reduced to a
+ *    scalar.
+ * @ingroup Processing
+ */
+@interface MyImageStacker_Weighted : NSObject <MyImageStackerModeStrategy>
+{
+   @private
+   MyImageStackerParameters* _params;  //!< Stacking parameters
+   LynkeosStandardImageBuffer* _monoStack; //!< Stack of mono images
+   LynkeosStandardImageBuffer* _rgbStack; //!< Stack of RGB images
+   double                    _monoWeight; //!< Sum of the mono images weights
+   double                    _rgbWeight;  //!< Sum of the RGB images weights
+}
+
+@end
@@ -0,0 +1,138 @@
+//
+//  MyImageStacker_Weighted.m
+//  Lynkeos
+//
+//  Created by Jean-Etienne LAMIAUD on 17/04/11.
+//  Copyright 2011 Jean-Etienne LAMIAUD. All rights reserved.
+//
+#include "MyImageStacker_Weighted.h"
+
+@implementation MyImageStacker_Weighted
+
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _params = nil;
+      _monoStack = nil;
+      _rgbStack = nil;
+      _monoWeight = 0.0;
+      _rgbWeight = 0.0;
+   }
+
+   return( self );
+}
+
+- (id) initWithParameters: (id <NSObject>)params
+                     list: (id <LynkeosImageList>)list
+{
+   if ( (self = [self init]) != nil )
+   {
+      _params = [params retain];
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   if ( _params != nil )
+      [_params release];
+   if ( _monoStack != nil )
+      [_monoStack release];
+   if ( _rgbStack != nil )
+      [_rgbStack release];
+
+   [super dealloc];
+}
+
+- (void) processImage: (id <LynkeosImageBuffer>)image
+          withOffsets: (NSPoint*)offsets
+               weight: (double)weight
+{
+   const u_short nPlanes = [image numberOfPlanes];
+   const u_short w = [image width]*_params->_factor,
+                 h = [image height]*_params->_factor;
+   LynkeosStandardImageBuffer **sum;
+
+   if ( nPlanes == 1 )
+   {
+      sum = &_monoStack;
+      _monoWeight += weight;
+   }
+   else
+   {
+      sum = &_rgbStack;
+      _rgbWeight += weight;
+   }
+
+   // If this is the first image, create the empty stack buffer with the same
+   // number of planes (taking into account the expansion factor)
+   if ( *sum == nil )
+      *sum = [[LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:nPlanes
+                                                                  width:w
+                                                                 height:h]
+              retain];
+
+   // Accumulate the shifted image with its weight, in one pass
+   [*sum add:image withOffsets:offsets withExpansion:_params->_factor
+      weight:weight];
+}
+
+- (void) mergeStack:(NSObject <MyImageStackerModeStrategy>*)stack
+{
+   MyImageStacker_Weighted *other = (MyImageStacker_Weighted*)stack;
+
+   if ( other->_monoStack != nil )
+   {
+      if ( _monoStack == nil )
+         _monoStack = [other->_monoStack retain];
+      else
+      {
+         [_monoStack setOperatorsStrategy:ParallelizedStrategy];
+         [_monoStack add:other->_monoStack result:_monoStack];
+      }
+   }
+   if ( other->_rgbStack != nil )
+   {
+      if ( _rgbStack == nil )
+         _rgbStack = [other->_rgbStack retain];
+      else
+      {
+         [_rgbStack setOperatorsStrategy:ParallelizedStrategy];
+         [_rgbStack add:other->_rgbStack result:_rgbStack];
+      }
+   }
+   _monoWeight += other->_monoWeight;
+   _rgbWeight += other->_rgbWeight;
+}
+
+- (void) finishAllProcessingInList: (id <LynkeosImageList>)list;
+{
+   const double totalWeight = _monoWeight + _rgbWeight;
+
+   // Recombine the monochrome and RGB weighted sums if needed
+   if ( _monoStack != nil )
+   {
+      if ( _rgbStack == nil )
+         _rgbStack = _monoStack;
+      else
+      {
+         // Add code knows how to add L with RGB
+         [_rgbStack add:_monoStack];
+         [_monoStack release];
+      }
+      _monoStack = nil;
+   }
+
+   // Get the weighted mean of all the images
+   if ( _rgbStack != nil && totalWeight > 0.0 )
+   {
+      [_rgbStack setOperatorsStrategy:ParallelizedStrategy];
+      [_rgbStack multiplyWithScalar:1.0/totalWeight];
+   }
+}
+
+- (LynkeosStandardImageBuffer*) stackingResult { return( _rgbStack ); }
+
+@end
@@ -0,0 +1,80 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun May 01 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+
+/*!
+ * @header
+ * @abstract Definitions for the items prefetcher
+ */
+#ifndef __MYITEMPREFETCHER_H
+#define __MYITEMPREFETCHER_H
+
+#import <Foundation/Foundation.h>
+
+#include "MyItemQueue.h"
+
+//! Initial and minimum number of items warmed ahead
+#define K_PREFETCH_MIN 2
+//! Maximum number of items warmed ahead
+#define K_PREFETCH_MAX 64
+
+/*!
+ * @class MyItemPrefetcher
+ * @abstract Warms the caches with the items which will be processed soon
+ * @discussion A thread walks the items in the processing order, a few items
+ *    ahead of the processing threads : the image files are read ahead by the
+ *    system and the movie frames are decoded in the movie cache.<br>
+ *    The look ahead doubles each time the processing overtakes the
+ *    prefetcher, and shrinks when the prefetcher waits for long. It is
+ *    bounded by the movie cache capacity and, for the files, by the size of
+ *    the image processing cache.
+ * @ingroup Processing
+ */
+@interface MyItemPrefetcher : NSObject
+{
+@private
+   NSArray*     _items;          //!< The items, in processing order
+   MyItemQueue* _queue;          //!< Where the processing takes the items
+   u_long       _lookAhead;      //!< Current number of items warmed ahead
+   u_long       _maxLookAhead;   //!< Bound given by the movie cache
+   u_long       _maxBytes;       //!< Bound of the files read ahead
+}
+
+/*!
+ * @abstract Initialize a prefetcher for a list processing
+ * @param items The items, in processing order
+ * @param queue The queue, filled with the same items, where the processing
+ *    consumes them
+ * @result The initialized prefetcher
+ */
+- (id) initWithItems:(NSArray*)items consumedFrom:(MyItemQueue*)queue ;
+
+/*!
+ * @abstract Start the prefetch thread
+ * @discussion It ends by itself when every item is consumed, or when the
+ *    queue is stopped.
+ */
+- (void) start ;
+
+@end
+
+#endif
@@ -0,0 +1,194 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun May 01 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+
+#include <stdlib.h>
+
+#include "LynkeosObjectCache.h"
+#include "MyImageListItem.h"
+#include "MyItemPrefetcher.h"
+
+//! Poll period, when the look ahead is reached
+#define K_PREFETCH_WAIT 0.01
+//! Wait after which the look ahead shrinks
+#define K_PREFETCH_IDLE 1.0
+//! Files read ahead when there is no image processing cache
+#define K_PREFETCH_DEFAULT_BYTES (256*1024*1024)
+
+/*!
+ * @abstract Private methods of the prefetcher
+ */
+@interface MyItemPrefetcher(Private)
+/*!
+ * @abstract Main method of the prefetch thread
+ * @param arg Unused
+ */
+- (void) prefetchThread:(id)arg ;
+@end
+
+@implementation MyItemPrefetcher(Private)
+
+- (void) prefetchThread:(id)arg
+{
+   NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+   const u_long total = [_items count];
+   u_long *sizes = (u_long*)calloc( total, sizeof(u_long) );
+   u_long next = 0, consumed = 0, bytes = 0;
+   NSTimeInterval idleSince = 0.0;
+
+   NSAssert( sizes != NULL, @"Prefetch sizes allocation failed" );
+
+   while ( next < total && ![_queue isStopped] )
+   {
+      // The queue was filled with every item at once
+      const u_long nowConsumed = total - [_queue count];
+
+      // Slide the window
+      for( ; consumed < nowConsumed; consumed++ )
+         if ( consumed < next )
+            bytes -= sizes[consumed];
+
+      if ( next < consumed )
+      {
+         // The processing overtook us, look further ahead
+         next = consumed;
+         _lookAhead *= 2;
+         if ( _lookAhead > _maxLookAhead )
+            _lookAhead = _maxLookAhead;
+         idleSince = 0.0;
+         continue;
+      }
+
+      if ( next >= consumed + _lookAhead
+           || (next > consumed && bytes >= _maxBytes) )
+      {
+         // Far enough ahead, wait for the processing
+         const NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+
+         if ( idleSince == 0.0 )
+            idleSince = now;
+         else if ( now - idleSince > K_PREFETCH_IDLE )
+         {
+            if ( _lookAhead > K_PREFETCH_MIN )
+               _lookAhead--;
+            idleSince = now;
+         }
+
+         [NSThread sleepUntilDate:
+                       [NSDate dateWithTimeIntervalSinceNow:K_PREFETCH_WAIT]];
+      }
+      else
+      {
+         NSAutoreleasePool *itemPool = [[NSAutoreleasePool alloc] init];
+         id item = [_items objectAtIndex:next];
+
+         idleSince = 0.0;
+         @try
+         {
+            if ( [item respondsToSelector:@selector(prefetchImage)] )
+               sizes[next] = [item prefetchImage];
+         }
+         @catch( NSException *e )
+         {
+            NSLog( @"*** Exception %@ raised in prefetch thread: \"%@\"",
+                   [e name], [e reason] );
+         }
+         bytes += sizes[next];
+         next++;
+
+         [itemPool release];
+      }
+   }
+
+   free( sizes );
+   [pool release];
+}
+
+@end
+
+@implementation MyItemPrefetcher
+
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _items = nil;
+      _queue = nil;
+      _lookAhead = K_PREFETCH_MIN;
+      _maxLookAhead = K_PREFETCH_MAX;
+      _maxBytes = K_PREFETCH_DEFAULT_BYTES;
+   }
+
+   return( self );
+}
+
+- (id) initWithItems:(NSArray*)items consumedFrom:(MyItemQueue*)queue
+{
+   if ( (self = [self init]) != nil )
+   {
+      LynkeosObjectCache *movieCache = [LynkeosObjectCache movieCache];
+      LynkeosObjectCache *imageCache =
+                                    [LynkeosObjectCache imageProcessingCache];
+      NSEnumerator *list = [items objectEnumerator];
+      MyImageListItem *item;
+
+      _items = [items retain];
+      _queue = [queue retain];
+
+      // The decoded frames shall stay in the movie cache until they are read
+      while ( (item = [list nextObject]) != nil )
+      {
+         if ( [item isKindOfClass:[MyImageListItem class]]
+              && [item index] != nil )
+         {
+            if ( movieCache != nil && [movieCache capacity]/2 < _maxLookAhead )
+               _maxLookAhead = [movieCache capacity]/2;
+            break;
+         }
+      }
+      if ( _maxLookAhead < K_PREFETCH_MIN )
+         _maxLookAhead = K_PREFETCH_MIN;
+
+      // Do not read ahead more than the memory given to the images
+      if ( imageCache != nil )
+         _maxBytes = [imageCache capacity];
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   [_items release];
+   [_queue release];
+
+   [super dealloc];
+}
+
+- (void) start
+{
+   [NSThread detachNewThreadSelector:@selector(prefetchThread:)
+                            toTarget:self
+                          withObject:nil];
+}
+
+@end
@@ -0,0 +1,130 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun May 01 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+/*!
+ * @header
+ * @abstract Definitions for the processing items queue
+ */
+#ifndef __MYITEMQUEUE_H
+#define __MYITEMQUEUE_H
+
+#import <Foundation/Foundation.h>
+
+//! Size reserved for each position, to keep them in separate cache lines
+#define K_QUEUE_CACHE_LINE 64
+
+/*!
+ * @abstract One cell of the queue ring
+ */
+typedef struct
+{
+   //! Position for which the cell can be filled or drained
+   volatile u_long _sequence;
+   id              _item;         //!< The item stored in the cell
+} ItemQueueCell_t;
+
+/*!
+ * @class MyItemQueue
+ * @abstract Queue of the items to process, shared by the processing threads
+ * @discussion It is a bounded ring of cells, where several threads can push
+ *    and pop items without any lock : each cell carries a sequence number
+ *    telling whether it is ready to be filled or drained, and the positions
+ *    are claimed by atomic operations.<br>
+ *    The queue also carries two control flags, independent of its content :
+ *    "closed" when no more items will be pushed, and "stopped" when the
+ *    processing shall be abandoned.
+ * @ingroup Processing
+ */
+@interface MyItemQueue : NSObject
+{
+@private
+   ItemQueueCell_t* _cells;              //!< The ring
+   u_long           _mask;               //!< Ring size minus one
+   volatile u_long  _pushPosition;       //!< Next cell to fill
+   //! Keeps the producers and consumers positions in separate cache lines
+   char             _padding[K_QUEUE_CACHE_LINE];
+   volatile u_long  _popPosition;        //!< Next cell to drain
+   volatile BOOL    _closed;             //!< No more items will be pushed
+   volatile BOOL    _stopped;            //!< The consumers shall stop
+}
+
+/*!
+ * @abstract Initialize an empty queue
+ * @param capacity The maximum number of items in the queue, it is rounded up
+ *    to a power of 2
+ * @result The initialized queue
+ */
+- (id) initWithCapacity:(u_long)capacity ;
+
+/*!
+ * @abstract Initialize a queue filled with the items of an array, and closed
+ * @param items The items to push
+ * @result The initialized queue
+ */
+- (id) initWithItems:(NSArray*)items ;
+
+/*!
+ * @abstract Push an item at the end of the queue
+ * @param item The item, it is retained by the queue
+ * @result NO if the queue is full
+ */
+- (BOOL) pushItem:(id)item ;
+
+/*!
+ * @abstract Pop consecutive items from the head of the queue
+ * @discussion The items are claimed in one atomic operation.
+ * @param items Array receiving the items, they are autoreleased
+ * @param count The maximum number of items to pop
+ * @result The number of items popped, zero if the queue is empty
+ */
+- (u_long) popItems:(id*)items maxCount:(u_long)count ;
+
+/*!
+ * @abstract Approximate number of items in the queue
+ */
+- (u_long) count ;
+
+/*!
+ * @abstract Signal that no more items will be pushed
+ */
+- (void) close ;
+
+/*!
+ * @abstract Whether the queue is closed
+ * @discussion Once a consumer has seen the queue closed, an empty pop means
+ *    that there will never be anything more to pop.
+ */
+- (BOOL) isClosed ;
+
+/*!
+ * @abstract Ask the consumers to stop, whatever remains in the queue
+ */
+- (void) stop ;
+
+/*!
+ * @abstract Whether the consumers were asked to stop
+ */
+- (BOOL) isStopped ;
+
+@end
+
+#endif
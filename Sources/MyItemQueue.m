@@ -0,0 +1,194 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun May 01 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include <stdlib.h>
+
+#include "MyItemQueue.h"
+
+@implementation MyItemQueue
+
+- (id) init
+{
+   return( [self initWithCapacity:1] );
+}
+
+- (id) initWithCapacity:(u_long)capacity
+{
+   if ( (self = [super init]) != nil )
+   {
+      u_long size, i;
+
+      for( size = 1; size < capacity; size *= 2 )
+         ;
+      _cells = (ItemQueueCell_t*)malloc( size*sizeof(ItemQueueCell_t) );
+      NSAssert( _cells != NULL, @"Item queue allocation failed" );
+      for( i = 0; i < size; i++ )
+      {
+         _cells[i]._sequence = i;
+         _cells[i]._item = nil;
+      }
+      _mask = size - 1;
+      _pushPosition = 0;
+      _popPosition = 0;
+      _closed = NO;
+      _stopped = NO;
+   }
+
+   return( self );
+}
+
+- (id) initWithItems:(NSArray*)items
+{
+   if ( (self = [self initWithCapacity:[items count]]) != nil )
+   {
+      NSEnumerator *list = [items objectEnumerator];
+      id item;
+
+      while ( (item = [list nextObject]) != nil )
+         [self pushItem:item];
+      [self close];
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   u_long i;
+
+   for( i = 0; i <= _mask; i++ )
+      if ( _cells[i]._item != nil )
+         [_cells[i]._item release];
+   free( _cells );
+
+   [super dealloc];
+}
+
+- (BOOL) pushItem:(id)item
+{
+   ItemQueueCell_t *cell;
+   u_long pos;
+
+   NSAssert( !_closed, @"Push in a closed item queue" );
+
+   for(;;)
+   {
+      long diff;
+
+      pos = _pushPosition;
+      cell = &_cells[pos & _mask];
+      diff = (long)(cell->_sequence - pos);
+
+      if ( diff == 0 )
+      {
+         // The cell is free, try to claim it
+         if ( __sync_bool_compare_and_swap( &_pushPosition, pos, pos+1 ) )
+            break;
+      }
+      else if ( diff < 0 )
+         // The cell was not yet drained since the previous lap
+         return( NO );
+      // Otherwise, another producer took that position, try again
+   }
+
+   cell->_item = [item retain];
+   // Publish the item only once it is written
+   __sync_synchronize();
+   cell->_sequence = pos + 1;
+
+   return( YES );
+}
+
+- (u_long) popItems:(id*)items maxCount:(u_long)count
+{
+   u_long pos, n, i;
+
+   if ( count > _mask + 1 )
+      count = _mask + 1;
+
+   for(;;)
+   {
+      pos = _popPosition;
+
+      // Count the consecutive cells ready to be drained
+      for( n = 0; n < count; n++ )
+         if ( _cells[(pos+n) & _mask]._sequence != pos+n+1 )
+            break;
+
+      if ( n == 0 )
+      {
+         if ( (long)(_cells[pos & _mask]._sequence - (pos+1)) < 0 )
+            // Nothing was pushed there yet
+            return( 0 );
+         // Otherwise, another consumer drained that position, try again
+      }
+      else if ( __sync_bool_compare_and_swap( &_popPosition, pos, pos+n ) )
+         break;
+   }
+
+   // Read the items only after their publication was seen
+   __sync_synchronize();
+   for( i = 0; i < n; i++ )
+   {
+      ItemQueueCell_t * const cell = &_cells[(pos+i) & _mask];
+
+      items[i] = [cell->_item autorelease];
+      cell->_item = nil;
+   }
+   // And give back the cells for the next lap
+   __sync_synchronize();
+   for( i = 0; i < n; i++ )
+      _cells[(pos+i) & _mask]._sequence = pos + i + _mask + 1;
+
+   return( n );
+}
+
+- (u_long) count
+{
+   const u_long pop = _popPosition, push = _pushPosition;
+
+   return( push > pop ? push - pop : 0 );
+}
+
+- (void) close
+{
+   // Every push shall be visible before the queue is seen closed
+   __sync_synchronize();
+   _closed = YES;
+}
+
+- (BOOL) isClosed
+{
+   const BOOL closed = _closed;
+
+   __sync_synchronize();
+   return( closed );
+}
+
+- (void) stop
+{
+   _stopped = YES;
+}
+
+- (BOOL) isStopped { return( _stopped ); }
+
+@end
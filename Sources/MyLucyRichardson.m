@@ -114,9 +114,13 @@ static void constrainPositive( LynkeosStandardImageBuffer *buf )
 
 + (ParallelOptimization_t) supportParallelization
 {
-   return( [[NSUserDefaults standardUserDefaults] integerForKey:
+   // Follow the same threads policy as selected for FFTW
+   if ( ([[NSUserDefaults standardUserDefaults] integerForKey:
                                                  K_PREF_IMAGEPROC_MULTIPROC]
-            & FFTW3ThreadsOptimization);
+         & FFTW3ThreadsOptimization) != 0 )
+      return( FFTW3ThreadsOptimization | ImageOperatorsOptimization );
+   else
+      return( NoParallelOptimization );
 }
 
 - (id) init
@@ -170,10 +174,6 @@ static void constrainPositive( LynkeosStandardImageBuffer *buf )
 
 - (void) processItem:(id <LynkeosProcessableItem>)item
 {
-   // Follow the same threads policy as selected for FFTW
-   ParallelOptimization_t optim = FFTW3ThreadsOptimization &
-                     [[NSUserDefaults standardUserDefaults] integerForKey:
-                                                    K_PREF_IMAGEPROC_MULTIPROC];
    LynkeosFourierBuffer *image, *iterImage, *buffer;
    LynkeosIntegerRect r = {{0,0},{0,0}};
    unsigned int i;
@@ -199,15 +199,13 @@ static void constrainPositive( LynkeosStandardImageBuffer *buf )
                                                 width:image->_w
                                                height:image->_h
                                              withGoal:FOR_DIRECT|FOR_INVERSE];
-   if ( optim != 0 )
-      [iterImage setOperatorsStrategy:ParallelizedStrategy];
+   [iterImage setOperatorsStrategy:ParallelizedStrategy];
    buffer =
       [[LynkeosFourierBuffer alloc] initWithNumberOfPlanes:image->_nPlanes
                                                 width:image->_w
                                                height:image->_h
                                              withGoal:FOR_DIRECT|FOR_INVERSE];
-   if ( optim != 0 )
-      [buffer setOperatorsStrategy:ParallelizedStrategy];
+   [buffer setOperatorsStrategy:ParallelizedStrategy];
 
    // Start the iteration with the image in the temorary result
    [image extractSample:[iterImage colorPlanes]
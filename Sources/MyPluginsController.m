@@ -458,6 +458,29 @@ static int compareWriters( id obj1, id obj2, void *ctx )
       }
    }
    [pluginHelp setEnabled:hasPluginHelp];
+
+   // Add the live stacking after the images adding, in the file menu
+   NSEnumerator *menus = [[[NSApp mainMenu] itemArray] objectEnumerator];
+   NSMenuItem *menu;
+   while( (menu = [menus nextObject]) != nil )
+   {
+      NSMenu *fileMenu = [menu submenu];
+      NSMenuItem *item;
+
+      if ( fileMenu == nil
+           || [fileMenu indexOfItemWithTag:K_ADD_IMAGE_TAG] < 0
+           || [fileMenu itemWithTag:K_LIVE_STACK_TAG] != nil )
+         continue;
+
+      item = [[[NSMenuItem alloc] initWithTitle:
+                              NSLocalizedString(@"LiveStack",@"Live stack menu")
+                                         action:@selector(liveStackAction:)
+                                  keyEquivalent:@""] autorelease];
+      [item setTag:K_LIVE_STACK_TAG];
+      [fileMenu insertItem:item
+                   atIndex:[fileMenu indexOfItemWithTag:K_ADD_IMAGE_TAG] + 1];
+      break;
+   }
 }
 @end
 
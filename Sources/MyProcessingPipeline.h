@@ -0,0 +1,96 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun May 01 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+
+/*!
+ * @header
+ * @abstract Definitions for the list processing pipeline
+ */
+#ifndef __MYPROCESSINGPIPELINE_H
+#define __MYPROCESSINGPIPELINE_H
+
+#import <Foundation/Foundation.h>
+
+#include "LynkeosProcessing.h"
+#include "MyItemQueue.h"
+
+//! Items read ahead, per processing thread
+#define K_PIPELINE_DEPTH 4
+
+/*!
+ * @class MyProcessingPipeline
+ * @abstract Reader stage of a list processing
+ * @discussion The reader threads take the items from an input queue, read and
+ *    calibrate the sample the processing will need, and push the item in the
+ *    output queue, where the processing threads take it.<br>
+ *    Each reader takes a batch of consecutive items, and reads them in order,
+ *    so that the movie readers decode forward instead of seeking.<br>
+ *    The output queue is bounded : when it is full, the readers wait for the
+ *    processing threads, which keeps the memory used by the samples in check.
+ *    It is closed when every item was read, and stopping it also stops the
+ *    readers.
+ * @ingroup Processing
+ */
+@interface MyProcessingPipeline : NSObject
+{
+@private
+   MyItemQueue*     _input;              //!< Items still to read
+   MyItemQueue*     _output;             //!< Items ready to be processed
+   Class            _processingClass;    //!< Gives the samples rectangles
+   id <NSObject>    _params;             //!< Processing parameters
+   volatile u_short _runningReaders;     //!< Reader threads still working
+}
+
+/*!
+ * @abstract Initialize a pipeline for a list processing
+ * @param items The items to process
+ * @param processingClass The processing class, which shall conform to
+ *    LynkeosPipelinedProcessing
+ * @param params The parameters given to the processing initialization
+ * @param depth Maximum number of items read ahead
+ * @result The initialized pipeline
+ */
+- (id) initWithItems:(NSArray*)items
+     processingClass:(Class)processingClass
+          parameters:(id <NSObject>)params
+               depth:(u_long)depth ;
+
+/*!
+ * @abstract Start the reader threads
+ * @param nReaders Number of reader threads
+ */
+- (void) startReaders:(u_short)nReaders ;
+
+/*!
+ * @abstract The queue from which the reader threads take the items
+ * @discussion It is stopped when the output queue is.
+ */
+- (MyItemQueue*) inputQueue ;
+
+/*!
+ * @abstract The queue from which the processing threads take the items
+ */
+- (MyItemQueue*) outputQueue ;
+
+@end
+
+#endif
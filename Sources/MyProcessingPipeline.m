@@ -0,0 +1,178 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun May 01 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+
+#include "MyImageListItem.h"
+#include "MyProcessingPipeline.h"
+
+//! Delay before retrying to push in a full output queue
+#define K_FULL_QUEUE_WAIT 0.005
+//! Consecutive items taken at once by a reader thread
+#define K_READER_BATCH 8
+
+/*!
+ * @abstract Private methods of the pipeline
+ */
+@interface MyProcessingPipeline(Private)
+/*!
+ * @abstract Main method of the reader threads
+ * @param arg Unused
+ */
+- (void) readerThread:(id)arg ;
+@end
+
+@implementation MyProcessingPipeline(Private)
+
+- (void) readerThread:(id)arg
+{
+   NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+   id items[K_READER_BATCH];
+   u_long n, i;
+
+   // A batch of consecutive items lets a movie decoder go forward
+   while ( ![_output isStopped]
+           && (n = [_input popItems:items maxCount:K_READER_BATCH]) != 0 )
+   {
+      for( i = 0; i < n && ![_output isStopped]; i++ )
+      {
+         id item = items[i];
+         NSAutoreleasePool *itemPool = [[NSAutoreleasePool alloc] init];
+         const BOOL prepare =
+                       [item respondsToSelector:
+                                      @selector(prepareImageSampleInRect:)];
+         LynkeosIntegerRect r;
+
+         @try
+         {
+            if ( prepare
+                 && [_processingClass sampleRectangle:&r forItem:item
+                                           parameters:_params] )
+               [item prepareImageSampleInRect:r];
+         }
+         @catch( NSException *e )
+         {
+            // The processing thread will read the sample itself
+            NSLog( @"*** Exception %@ raised in pipeline reader thread: "
+                   @"\"%@\"", [e name], [e reason] );
+         }
+
+         // Wait for the processing threads to make some room
+         while ( ![_output pushItem:item] && ![_output isStopped] )
+            [NSThread sleepUntilDate:
+                     [NSDate dateWithTimeIntervalSinceNow:K_FULL_QUEUE_WAIT]];
+
+         if ( prepare && [_output isStopped] )
+            [item discardPreparedImageSample];
+
+         [itemPool release];
+      }
+   }
+
+   // Whoever watches the input shall know that it will not be read further
+   if ( [_output isStopped] )
+      [_input stop];
+
+   // The last reader tells the processing threads that it is over
+   if ( __sync_sub_and_fetch( &_runningReaders, 1 ) == 0 )
+      [_output close];
+
+   [pool release];
+}
+
+@end
+
+@implementation MyProcessingPipeline
+
+- (id) init
+{
+   if ( (self = [super init]) != nil )
+   {
+      _input = nil;
+      _output = nil;
+      _processingClass = nil;
+      _params = nil;
+      _runningReaders = 0;
+   }
+
+   return( self );
+}
+
+- (id) initWithItems:(NSArray*)items
+     processingClass:(Class)processingClass
+          parameters:(id <NSObject>)params
+               depth:(u_long)depth
+{
+   NSAssert( [processingClass conformsToProtocol:
+                                       @protocol(LynkeosPipelinedProcessing)],
+             @"Pipeline for a processing which cannot read ahead" );
+
+   if ( (self = [self init]) != nil )
+   {
+      _input = [[MyItemQueue alloc] initWithItems:items];
+      _output = [[MyItemQueue alloc] initWithCapacity:depth];
+      _processingClass = processingClass;
+      if ( params != nil )
+         _params = [params retain];
+   }
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   // The last reader thread may release us after its pool
+   NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+   id item;
+
+   // Forget the samples of the items which will not be processed
+   while ( [_output popItems:&item maxCount:1] != 0 )
+      if ( [item respondsToSelector:@selector(discardPreparedImageSample)] )
+         [item discardPreparedImageSample];
+   [pool release];
+
+   [_input release];
+   [_output release];
+   if ( _params != nil )
+      [_params release];
+
+   [super dealloc];
+}
+
+- (void) startReaders:(u_short)nReaders
+{
+   u_short i;
+
+   NSAssert( _runningReaders == 0, @"Pipeline readers started twice" );
+   NSAssert( nReaders > 0, @"Pipeline without reader" );
+
+   _runningReaders = nReaders;
+   for( i = 0; i < nReaders; i++ )
+      [NSThread detachNewThreadSelector:@selector(readerThread:)
+                               toTarget:self
+                             withObject:nil];
+}
+
+- (MyItemQueue*) inputQueue { return( _input ); }
+
+- (MyItemQueue*) outputQueue { return( _output ); }
+
+@end
@@ -32,12 +32,13 @@
 
 #include "LynkeosProcessing.h"
 #include "LynkeosThreadConnection.h"
+#include "MyItemQueue.h"
 
 @class MyDocument;
 
 extern NSString * const K_PROCESS_CONNECTION;     ///< Connection with main thread
 extern NSString * const K_PROCESS_CLASS_KEY;      ///< Class of the "processor"
-extern NSString * const K_PROCESS_ENUMERATOR_KEY; ///< Process items enumerator
+extern NSString * const K_PROCESS_QUEUE_KEY;      ///< Process items queue
 extern NSString * const K_PROCESS_ITEM_KEY;       ///< Alternate form: only item
 extern NSString * const K_PROCESS_PARAMETERS_KEY; ///< Direct parameter
 
@@ -47,8 +48,8 @@ extern NSString * const K_PROCESS_PARAMETERS_KEY; ///< Direct parameter
  * @discussion When the thread is started, the controller :
  *    <ul>
  *      <li>creates and initializes a processing instance.
- *      <li>iterates over the item list and calls the processing instance for 
- *      each item. 
+ *      <li>pops the items from the queue shared with the other threads, in
+ *      batches, and calls the processing instance for each item.
  *      <li>Calls the "end of processing" method of processing instance when
  *      all items have been processed.
  *      <li>Free all the resources and terminates the thread.
@@ -59,10 +60,12 @@ extern NSString * const K_PROCESS_PARAMETERS_KEY; ///< Direct parameter
 @protected
    id <LynkeosProcessing>  _processingInstance;    //!< The processing object !
    MyDocument*             _document;              //!< The document controller
-   NSEnumerator*           _itemList;  //!< Enumerator given at thread creation
+   MyItemQueue*            _itemQueue;      //!< Queue given at thread creation
    id <LynkeosProcessableItem> _item;        //!< Alternate form: only one item
    BOOL                    _processEnded;          //!< Controls the run loop
    NSProxy*                _proxy;             //!< Our proxy in the main thread
+   //! Document seen by the processing object, coalescing its notifications
+   NSProxy*                _coalescer;
 }
 
 /*!
@@ -76,7 +79,7 @@ extern NSString * const K_PROCESS_PARAMETERS_KEY; ///< Direct parameter
 
 /*!
  * @method stopProcessing
- * @abstract Force the thread to exit when next item is processed
+ * @abstract Force the thread to exit when its current batch is processed
  * @result None
  */
 - (oneway void) stopProcessing ;
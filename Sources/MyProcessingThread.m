@@ -25,10 +25,58 @@
 
 NSString * const K_PROCESS_CONNECTION =     @"prCnx";
 NSString * const K_PROCESS_CLASS_KEY =      @"prClass";
-NSString * const K_PROCESS_ENUMERATOR_KEY = @"prEnum";
+NSString * const K_PROCESS_QUEUE_KEY =      @"prQueue";
 NSString * const K_PROCESS_ITEM_KEY =       @"prItem";
 NSString * const K_PROCESS_PARAMETERS_KEY = @"param";
 
+//! Maximum number of items popped at once
+#define K_MAX_ITEMS_BATCH 16
+//! Time to wait for new items, when the queue is empty but not closed
+#define K_EMPTY_QUEUE_WAIT 0.01
+//! Maximum number of processed items sent in one message
+#define K_PROCESSED_ITEMS_SIZE 64
+//! Minimum delay between two processed items messages
+#define K_PROCESSED_ITEMS_PERIOD 0.1
+
+/*!
+ * @abstract Document proxy which coalesces the processed items signals
+ * @discussion Every message is forwarded to the document proxy, except
+ *    itemWasProcessed, which items are accumulated and sent at a bounded rate
+ *    in one itemsWereProcessed message. It is used only by the thread which
+ *    created it.
+ */
+@interface ProcessedItemsCoalescer : NSProxy
+{
+   MyDocument*    _document;                         //!< The document proxy
+   id             _items[K_PROCESSED_ITEMS_SIZE];    //!< Items not yet sent
+   u_short        _nItems;                           //!< Number of such items
+   NSTimeInterval _lastSend;                         //!< Date of the last send
+}
+
+/*!
+ * @abstract Initialize the coalescer
+ * @param document The document proxy
+ * @result The initialized coalescer
+ */
+- (id) initWithDocument:(MyDocument*)document ;
+
+/*!
+ * @abstract Accumulate the item, and send them all if they are due
+ * @param item The item which was processed
+ */
+- (oneway void) itemWasProcessed:(id <LynkeosProcessableItem>)item ;
+
+/*!
+ * @abstract Send the accumulated items if the period has elapsed
+ */
+- (void) sendIfDue ;
+
+/*!
+ * @abstract Send the accumulated items now
+ */
+- (void) send ;
+@end
+
 /*!
  * @abstract Private methods of MyProcessingThread class
  */
@@ -46,16 +94,87 @@ NSString * const K_PROCESS_PARAMETERS_KEY = @"param";
 
 /*!
  * @abstract Process all the items in the list
- * @discussion The loop exits when the last item is processed or if the main 
- *   thread stopped the processing.
+ * @discussion The loop exits when the queue is drained or if the main thread
+ *   stopped the processing.
  *
- *   The run loop is run at each iteration to allow inter-threads method call.
- *   The run loop is just queried for a pending inter-thread message.
+ *   The items are popped in batches, which size decrease as the queue empties,
+ *   for the threads to end together. The autorelease pool and the run loop,
+ *   which is queried for pending inter-thread messages, are handled once per
+ *   batch. A popped batch is always processed entirely, the stop is checked
+ *   between batches.
  */
 - (void) processList ;
 
 @end
 
+@implementation ProcessedItemsCoalescer
+
+- (id) initWithDocument:(MyDocument*)document
+{
+   _document = document;
+   _nItems = 0;
+   _lastSend = [NSDate timeIntervalSinceReferenceDate];
+
+   return( self );
+}
+
+- (void) dealloc
+{
+   u_short i;
+
+   // It is too late to send anything
+   for( i = 0; i < _nItems; i++ )
+      [_items[i] release];
+   [super dealloc];
+}
+
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)aSelector
+{
+   return( [_document methodSignatureForSelector:aSelector] );
+}
+
+- (void)forwardInvocation:(NSInvocation *)anInvocation
+{
+   [anInvocation invokeWithTarget:_document];
+}
+
+- (oneway void) itemWasProcessed:(id <LynkeosProcessableItem>)item
+{
+   _items[_nItems] = [item retain];
+   _nItems++;
+
+   if ( _nItems == K_PROCESSED_ITEMS_SIZE )
+      [self send];
+   else
+      [self sendIfDue];
+}
+
+- (void) sendIfDue
+{
+   if ( _nItems != 0
+        && [NSDate timeIntervalSinceReferenceDate] - _lastSend
+           >= K_PROCESSED_ITEMS_PERIOD )
+      [self send];
+}
+
+- (void) send
+{
+   u_short i;
+
+   if ( _nItems != 0 )
+   {
+      // One inter-thread message for all the items
+      [_document itemsWereProcessed:
+                          [NSArray arrayWithObjects:_items count:_nItems]];
+      for( i = 0; i < _nItems; i++ )
+         [_items[i] release];
+      _nItems = 0;
+   }
+   _lastSend = [NSDate timeIntervalSinceReferenceDate];
+}
+
+@end
+
 @implementation MyProcessingThread(Private)
 
 - (id) initWithAttributes :(NSDictionary*)attributes 
@@ -66,14 +185,15 @@ NSString * const K_PROCESS_PARAMETERS_KEY = @"param";
    {
       _document = document;
       _processEnded = NO;
-      _itemList = [[attributes objectForKey:K_PROCESS_ENUMERATOR_KEY] retain];
+      _itemQueue = [[attributes objectForKey:K_PROCESS_QUEUE_KEY] retain];
       _item = [[attributes objectForKey:K_PROCESS_ITEM_KEY] retain];
-      NSAssert( _itemList == nil || _item == nil,
+      NSAssert( _itemQueue == nil || _item == nil,
                 @"Cannot process a list and an item");
 
+      _coalescer = [[ProcessedItemsCoalescer alloc] initWithDocument:document];
       _processingInstance =
          [[[attributes objectForKey:K_PROCESS_CLASS_KEY] alloc]
-                  initWithDocument:document
+                  initWithDocument:(id <LynkeosDocument>)_coalescer
                         parameters:
                               [attributes objectForKey:K_PROCESS_PARAMETERS_KEY]
                          precision:PROCESSING_PRECISION];
@@ -103,38 +223,66 @@ NSString * const K_PROCESS_PARAMETERS_KEY = @"param";
 
    else
    {
-      while ( ! _processEnded )
+      while ( ! _processEnded && ! [_itemQueue isStopped] )
       {
          NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
 
-         @try
-         {
-            // Null timeout and process next item immediately after
-            [runLoop runMode:NSDefaultRunLoopMode beforeDate:[NSDate date]];
-            if ( ! _processEnded  )
-            {
-               id <LynkeosProcessableItem> item = [_itemList nextObject];
+         id batch[K_MAX_ITEMS_BATCH];
+         // Take a fair share of what remains
+         u_long n = [_itemQueue count]/numberOfCpus/2, i;
+         const BOOL closed = [_itemQueue isClosed];
 
-               if ( item == nil )
-                  // Process is finished
-                  [self stopProcessing];
-               else
-                  [_processingInstance processItem:item];         
-            }
-         }
-         @catch( NSException *e )
+         if ( n < 1 )
+            n = 1;
+         else if ( n > K_MAX_ITEMS_BATCH )
+            n = K_MAX_ITEMS_BATCH;
+         n = [_itemQueue popItems:batch maxCount:n];
+
+         if ( n == 0 )
          {
-            NSLog( @"*** Exception %@ raised in list processing thread: \"%@\"",
-                   [e name], [e reason] );
+            if ( closed )
+               // Process is finished, the other threads end their batches
+               _processEnded = YES;
+            else
+               // Wait for more items, while handling the messages
+               [runLoop runMode:NSDefaultRunLoopMode
+                     beforeDate:[NSDate dateWithTimeIntervalSinceNow:
+                                                          K_EMPTY_QUEUE_WAIT]];
          }
-         @finally
+         else
          {
-            [pool release];
+            // The batch is ours, a stop is only checked between batches
+            for( i = 0; i < n; i++ )
+            {
+               @try
+               {
+                  [_processingInstance processItem:batch[i]];
+               }
+               @catch( NSException *e )
+               {
+                  NSLog( @"*** Exception %@ raised in list processing thread: "
+                         "\"%@\"", [e name], [e reason] );
+               }
+            }
+
+            // Null timeout, just handle the pending messages
+            [runLoop runMode:NSDefaultRunLoopMode beforeDate:[NSDate date]];
          }
+
+         // Do not keep the progress pending while the items are long to come
+         [(ProcessedItemsCoalescer*)_coalescer sendIfDue];
+
+         [pool release];
       }
    }
 
+   // Give our CPU to the threads still processing
+   cpuBudgetLeaveListThread();
+
    [_processingInstance finishProcessing];
+
+   // The progress shall be complete before the end
+   [(ProcessedItemsCoalescer*)_coalescer send];
    [_document processEnded:_proxy];
 }
 
@@ -149,6 +297,7 @@ NSString * const K_PROCESS_PARAMETERS_KEY = @"param";
    LynkeosThreadConnection *cnx;
    MyProcessingThread *threadController;
    MyDocument *doc;
+   Class processingClass;
 
    pool = [[NSAutoreleasePool alloc] init];
 
@@ -161,6 +310,8 @@ NSString * const K_PROCESS_PARAMETERS_KEY = @"param";
                                   forMode:NSDefaultRunLoopMode];
 
       doc = (MyDocument*)[cnx rootProxy];
+      processingClass = [attr objectForKey:K_PROCESS_CLASS_KEY];
+      cpuBudgetEnterListThread( [processingClass supportParallelization] );
       {
          @try
          {
@@ -183,6 +334,7 @@ NSString * const K_PROCESS_PARAMETERS_KEY = @"param";
       }
       else         // In case an exception was caught during controller init
       {
+         cpuBudgetLeaveListThread();
          [doc processStarted:nil connection:cnx];
          [doc processEnded:nil];
       }
@@ -208,14 +360,16 @@ NSString * const K_PROCESS_PARAMETERS_KEY = @"param";
 
 - (oneway void) stopProcessing 
 {
+   // The document stops the queue itself
    _processEnded = YES;
 }
 
 - (void) dealloc
 {
    [_processingInstance release];
+   [_coalescer release];
    [_proxy release];
-   [_itemList release];
+   [_itemQueue release];
    [_item release];
    [super dealloc];
 }
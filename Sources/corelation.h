@@ -71,9 +71,27 @@ extern void correlate_spectrums( LynkeosFourierBuffer *s1, LynkeosFourierBuffer
 * @function corelation_peak
  * @abstract Search the correlation peak in the correlation data
  * @param result Correlation data (result from one correlate call)
- * @param peak Array of CORRELATION_PEAK (one entry per plane in result)
+ * @param peak Array of CORRELATION_PEAK (one entry per plane in result, and
+ *   per image of the batch, the batch index varying first)
  * @ingroup Processing
  */
 extern void corelation_peak( LynkeosFourierBuffer *result, CORRELATION_PEAK *peak );
 
+/*!
+ * @function log_polar_magnitude
+ * @abstract Resample the module of a spectrum on a log-polar grid
+ * @discussion The module of the spectrum does not depend on the image 
+ *   translation, and a rotation or a scaling of the image becomes a 
+ *   translation of its log-polar resampling.<br>
+ *   The angle, along the x axis, covers [0,pi) ; the radius, along the y 
+ *   axis, is logarithmically spaced from 1 to half the spectrum size. Each
+ *   row is centered on its mean value.
+ * @param spectrum The spectrum to resample (first plane only)
+ * @param logPolar Image receiving log(1+|F|) on the log-polar grid
+ * @result The logarithm of the radius ratio between two consecutive rows
+ * @ingroup Processing
+ */
+extern double log_polar_magnitude( LynkeosFourierBuffer *spectrum,
+                                   LynkeosFourierBuffer *logPolar );
+
 #endif
@@ -49,74 +49,156 @@ void correlate( LynkeosFourierBuffer *s1, LynkeosFourierBuffer *s2, LynkeosFouri
    correlate_spectrums( s1, s2, r );
 }
 
-void corelation_peak( LynkeosFourierBuffer *result, CORRELATION_PEAK *peak )
+/*
+ * Search the peak in one image of the correlation data
+ */
+static void search_peak( LynkeosFourierBuffer *result, u_short c,
+                         u_short y0, u_short h, CORRELATION_PEAK *peak )
 {
-   u_short x, y, c; 
+   u_short x, y; 
    double sum, module_max, module_min;
    double xp, yp, s_x2, s_y2;
    u_long nb_pixel;
    REAL r;
 
-   assert( peak != NULL );
+   /* Search for min and max */
+   module_max = 0.0;
+   module_min = HUGE;
 
-   for( c = 0; c < result->_nPlanes; c++ )
+   for( y = 0; y < h; y++ )
    {
-      /* Search for min and max */
-      module_max = 0.0;
-      module_min = HUGE;
-
-      for( y = 0; y < result->_h; y++ )
+      for( x = 0; x < result->_w; x++ )
       {
-         for( x = 0; x < result->_w; x++ )
-         {
-            r = colorValue(result,x,y,c);
+         r = colorValue(result,x,y0+y,c);
 
-            if ( r > module_max )
-               module_max = r;
-            if ( r < module_min )
-               module_min = r;
-         }
+         if ( r > module_max )
+            module_max = r;
+         if ( r < module_min )
+            module_min = r;
       }
+   }
 
-      /* Locate the peak as the barycenter of pixels above (max-min)/sqrt(2) */
-      xp = 0.0;
-      yp = 0.0;
-      s_x2 = 0.0;
-      s_y2 = 0.0;
-      sum = 0.0;
-      nb_pixel = 0;
+   /* Locate the peak as the barycenter of pixels above (max-min)/sqrt(2) */
+   xp = 0.0;
+   yp = 0.0;
+   s_x2 = 0.0;
+   s_y2 = 0.0;
+   sum = 0.0;
+   nb_pixel = 0;
 
-      for( y = 0; y < result->_h; y++ )
+   for( y = 0; y < h; y++ )
+   {
+      for( x = 0; x < result->_w; x++ )
       {
-         for( x = 0; x < result->_w; x++ )
+         double module;
+         r = colorValue(result,x,y0+y,c);
+         module = r - module_min;
+
+         if ( module > (module_max-module_min)*0.707 )
          {
-            double module;
-            r = colorValue(result,x,y,c);
-            module = r - module_min;
-
-            if ( module > (module_max-module_min)*0.707 )
-            {
-               // Get the offset, taking into account the quadrants order
-               // from the inverse FFT
-               double dx = (2*x < result->_w ? x : x - result->_w),
-                      dy = (2*y < result->_h ? y : y - result->_w);
-               xp += dx*module;
-               yp += dy*module;
-               s_x2 += dx*dx*module;
-               s_y2 += dy*dy*module;
-               sum += module;
-               nb_pixel++;
-            }
+            // Get the offset, taking into account the quadrants order
+            // from the inverse FFT
+            double dx = (2*x < result->_w ? x : x - result->_w),
+                   dy = (2*y < h ? y : y - h);
+            xp += dx*module;
+            yp += dy*module;
+            s_x2 += dx*dx*module;
+            s_y2 += dy*dy*module;
+            sum += module;
+            nb_pixel++;
          }
       }
+   }
+
+   /* Present the results */
+   xp /= sum;
+   yp /= sum;
+   peak->val = module_max - module_min;
+   peak->x = xp;
+   peak->y = yp;
+   peak->sigma_x = sqrt(s_x2/sum - xp*xp);
+   peak->sigma_y = sqrt(s_y2/sum - yp*yp);
+}
+
+void corelation_peak( LynkeosFourierBuffer *result, CORRELATION_PEAK *peak )
+{
+   const u_short h = result->_h/result->_batch;
+   u_short b, c;
+
+   assert( peak != NULL );
+
+   for( c = 0; c < result->_nPlanes; c++ )
+      for( b = 0; b < result->_batch; b++ )
+         search_peak( result, c, b*h, h, &peak[c*result->_batch+b] );
+}
 
-      /* Present the results */
-      xp /= sum;
-      yp /= sum;
-      peak[c].val = module_max - module_min;
-      peak[c].x = xp;
-      peak[c].y = yp;
-      peak[c].sigma_x = sqrt(s_x2/sum - xp*xp);
-      peak[c].sigma_y = sqrt(s_y2/sum - yp*yp);
+/*
+ * Module of the spectrum at a non integer frequency
+ */
+static double spectrum_module( LynkeosFourierBuffer *spectrum,
+                               double fx, double fy )
+{
+   long ix, iy, x1, y0, y1;
+   double ax, ay;
+   COMPLEX v00, v01, v10, v11;
+
+   /* Only positive x frequencies are stored, use the conjugate symmetry */
+   if ( fx < 0.0 )
+   {
+      fx = -fx;
+      fy = -fy;
    }
+
+   ix = (long)floor(fx);
+   iy = (long)floor(fy);
+   ax = fx - ix;
+   ay = fy - iy;
+   x1 = (ix+1 < spectrum->_halfw ? ix+1 : ix);
+   y0 = ((iy % spectrum->_h) + spectrum->_h) % spectrum->_h;
+   y1 = (y0+1) % spectrum->_h;
+
+   v00 = colorComplexValue(spectrum,ix,y0,0);
+   v01 = colorComplexValue(spectrum,x1,y0,0);
+   v10 = colorComplexValue(spectrum,ix,y1,0);
+   v11 = colorComplexValue(spectrum,x1,y1,0);
+
+   return( (hypot(__real__ v00,__imag__ v00)*(1.0-ax)
+            + hypot(__real__ v01,__imag__ v01)*ax)*(1.0-ay)
+           + (hypot(__real__ v10,__imag__ v10)*(1.0-ax)
+              + hypot(__real__ v11,__imag__ v11)*ax)*ay );
+}
+
+double log_polar_magnitude( LynkeosFourierBuffer *spectrum,
+                            LynkeosFourierBuffer *logPolar )
+{
+   const double rmax = (spectrum->_w < spectrum->_h ?
+                        spectrum->_w : spectrum->_h)/2.0;
+   const double drho = log(rmax)/(double)logPolar->_h;
+   u_short a, j;
+
+   assert( spectrum->_batch == 1 && logPolar->_batch == 1 );
+
+   for( j = 0; j < logPolar->_h; j++ )
+   {
+      const double radius = exp(j*drho);
+      double mean = 0.0;
+
+      for( a = 0; a < logPolar->_w; a++ )
+      {
+         const double theta = M_PI*(double)a/(double)logPolar->_w;
+         const double v = log( 1.0 + spectrum_module( spectrum,
+                                                      radius*cos(theta),
+                                                      radius*sin(theta) ) );
+
+         colorValue(logPolar,a,j,0) = v;
+         mean += v;
+      }
+
+      /* Remove the radial decrease, which would hide the features */
+      mean /= (double)logPolar->_w;
+      for( a = 0; a < logPolar->_w; a++ )
+         colorValue(logPolar,a,j,0) -= mean;
+   }
+
+   return( drho );
 }
@@ -0,0 +1,116 @@
+/*=============================================================================
+** Lynkeos
+** $Id$
+**-----------------------------------------------------------------------------
+**
+**  Created by Jean-Etienne LAMIAUD on Apr 3, 2011
+**  Copyright (c) 2011. Jean-Etienne LAMIAUD
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+**
+**-----------------------------------------------------------------------------
+*/
+
+/*!
+ * @header
+ * @abstract Definitions related to the star pattern registration
+ */
+#ifndef __STAR_PATTERN_H
+#define __STAR_PATTERN_H
+
+#include "LynkeosCore/LynkeosStandardImageBuffer.h"
+
+/*!
+ * @struct STAR
+ * @abstract A star detected in an image
+ * @ingroup Processing
+ */
+typedef struct
+{
+   double x;            //!< X coordinate of the star centroid
+   double y;            //!< Y coordinate of the star centroid
+   double flux;         //!< Star flux above the background
+} STAR;
+
+/*!
+ * @struct STAR_TRANSFORM
+ * @abstract Affine transform from the reference stars to the image stars
+ * @discussion The image point is (a.x + b.y + tx, c.x + d.y + ty)
+ * @ingroup Processing
+ */
+typedef struct
+{
+   double a, b, c, d;   //!< Linear part
+   double tx, ty;       //!< Translation part
+} STAR_TRANSFORM;
+
+/*!
+ * @abstract Opaque index of the reference stars triangles
+ * @ingroup Processing
+ */
+typedef struct star_index STAR_INDEX;
+
+/*!
+ * @function detect_stars
+ * @abstract Find the brightest stars in an image
+ * @discussion The stars are the local maxima above the background by a few
+ *   times the noise level. Their position is the centroid of the pixels
+ *   around the maximum.
+ * @param image The image (first plane only)
+ * @param stars Array receiving the stars, by decreasing flux
+ * @param maxStars Size of the array
+ * @result The number of stars found
+ * @ingroup Processing
+ */
+extern u_short detect_stars( LynkeosStandardImageBuffer *image,
+                             STAR *stars, u_short maxStars );
+
+/*!
+ * @function build_star_index
+ * @abstract Build the index of the triangles formed by the reference stars
+ * @param stars The reference stars
+ * @param nStars Number of reference stars
+ * @result The index, NULL if there are not enough stars
+ * @ingroup Processing
+ */
+extern STAR_INDEX *build_star_index( const STAR *stars, u_short nStars );
+
+/*!
+ * @function free_star_index
+ * @abstract Release the memory used by an index
+ * @param index The index to free
+ * @ingroup Processing
+ */
+extern void free_star_index( STAR_INDEX *index );
+
+/*!
+ * @function match_stars
+ * @abstract Register the stars of an image against the reference ones
+ * @discussion The triangles of the image stars are looked up in the index,
+ *   each similar triangle votes for its vertices matches. The transform is
+ *   then fitted by least squares on the matched stars, rejecting outliers.
+ * @param index The reference index
+ * @param stars The image stars
+ * @param nStars Number of image stars
+ * @param affine Whether to fit an affine transform instead of a similarity
+ * @param transform The transform from the reference to the image
+ * @result The number of matched stars, 0 if the registration failed
+ * @ingroup Processing
+ */
+extern u_short match_stars( const STAR_INDEX *index,
+                            const STAR *stars, u_short nStars,
+                            BOOL affine, STAR_TRANSFORM *transform );
+
+#endif
@@ -0,0 +1,515 @@
+/*=============================================================================
+** Lynkeos
+** $Id$
+**-----------------------------------------------------------------------------
+**
+**  Created by Jean-Etienne LAMIAUD on Apr 3, 2011
+**  Copyright (c) 2011. Jean-Etienne LAMIAUD
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+**
+**-----------------------------------------------------------------------------
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "star_pattern.h"
+#include "LynkeosStandardImageBufferAdditions.h"
+
+/*! Detection threshold above the background, in noise standard deviations */
+#define K_DETECTION_SIGMA   5.0
+/*! Half size of the window used for the star centroid */
+#define K_CENTROID_RADIUS   2
+/*! Subsampling step for the background estimation */
+#define K_BACKGROUND_STEP   4
+/*! Quantization step of the triangles side ratios */
+#define K_TRIANGLE_STEP     0.01
+/*! Number of quantization steps for a side ratio */
+#define K_TRIANGLE_BINS     101
+/*! Triangles with a smaller side are too sensitive to the centroid error */
+#define K_MIN_TRIANGLE_SIDE 5.0
+/*! Maximum distance between a fitted and a detected star, in pixels */
+#define K_MAX_RESIDUAL      2.0
+/*! Maximum number of outliers rejection passes */
+#define K_FIT_ITERATIONS    3
+
+/*!
+ * @abstract Triangle formed by three stars
+ * @discussion The vertices are ordered by the decreasing length of the
+ *    opposite side, which makes the triangle invariant by similarity.
+ */
+typedef struct
+{
+   u_long  key;          //!< Quantized side ratios, for the lookup
+   double  u;            //!< Ratio of the middle side to the longest
+   double  v;            //!< Ratio of the shortest side to the longest
+   short   orientation;  //!< Sign of the vertices order
+   u_short vertex[3];    //!< Stars indexes
+} TRIANGLE;
+
+struct star_index
+{
+   STAR     *stars;      //!< Reference stars
+   u_short  nStars;      //!< Number of reference stars
+   TRIANGLE *triangles;  //!< Triangles sorted by key
+   u_long   nTriangles;  //!< Number of triangles
+};
+
+/*!
+ * Estimate the background level and noise, by clipping the bright pixels
+ */
+static void image_background( LynkeosStandardImageBuffer *image,
+                              double *level, double *sigma )
+{
+   double mean = 0.0, var = HUGE_VAL;
+   short pass;
+
+   for( pass = 0; pass < 2; pass++ )
+   {
+      const double clip = mean + 3.0*sqrt(var);
+      double s = 0.0, s2 = 0.0;
+      u_long n = 0;
+      u_short x, y;
+
+      for( y = 0; y < image->_h; y += K_BACKGROUND_STEP )
+      {
+         for( x = 0; x < image->_w; x += K_BACKGROUND_STEP )
+         {
+            const double v = colorValue(image,x,y,0);
+
+            if ( pass == 0 || v <= clip )
+            {
+               s += v;
+               s2 += v*v;
+               n++;
+            }
+         }
+      }
+
+      if ( n == 0 )
+         break;
+      mean = s/(double)n;
+      var = s2/(double)n - mean*mean;
+      if ( var < 0.0 )
+         var = 0.0;
+   }
+
+   *level = mean;
+   *sigma = sqrt(var);
+}
+
+u_short detect_stars( LynkeosStandardImageBuffer *image,
+                      STAR *stars, u_short maxStars )
+{
+   double bg, sigma;
+   REAL threshold, neighbourThreshold;
+   u_short nStars = 0;
+   // Signed for the neighbourhood bounds, and wide enough for any frame
+   int x, y;
+
+   image_background( image, &bg, &sigma );
+   if ( sigma <= 0.0 )
+      return( 0 );
+   threshold = bg + K_DETECTION_SIGMA*sigma;
+   neighbourThreshold = bg + K_DETECTION_SIGMA*sigma/2.0;
+
+   for( y = 1; y < image->_h - 1; y++ )
+   {
+      for( x = 1; x < image->_w - 1; x++ )
+      {
+         const REAL v = colorValue(image,x,y,0);
+         BOOL isMax = YES;
+         short dx, dy, i;
+         STAR s;
+
+         if ( v < threshold )
+            continue;
+
+         // Local maximum, the first pixel wins on a plateau
+         for( dy = -1; dy <= 1 && isMax; dy++ )
+         {
+            for( dx = -1; dx <= 1 && isMax; dx++ )
+            {
+               const REAL n = colorValue(image,x+dx,y+dy,0);
+
+               if ( n > v || (n == v && (dy < 0 || (dy == 0 && dx < 0))) )
+                  isMax = NO;
+            }
+         }
+         if ( !isMax )
+            continue;
+
+         // A hot pixel has no bright direct neighbour
+         if ( colorValue(image,x-1,y,0) < neighbourThreshold
+              && colorValue(image,x+1,y,0) < neighbourThreshold
+              && colorValue(image,x,y-1,0) < neighbourThreshold
+              && colorValue(image,x,y+1,0) < neighbourThreshold )
+            continue;
+
+         // Centroid of the signal above the background
+         s.x = 0.0;
+         s.y = 0.0;
+         s.flux = 0.0;
+         for( dy = -K_CENTROID_RADIUS; dy <= K_CENTROID_RADIUS; dy++ )
+         {
+            if ( y+dy < 0 || y+dy >= image->_h )
+               continue;
+            for( dx = -K_CENTROID_RADIUS; dx <= K_CENTROID_RADIUS; dx++ )
+            {
+               double w;
+
+               if ( x+dx < 0 || x+dx >= image->_w )
+                  continue;
+               w = colorValue(image,x+dx,y+dy,0) - bg;
+               if ( w > 0.0 )
+               {
+                  s.x += w*(double)(x+dx);
+                  s.y += w*(double)(y+dy);
+                  s.flux += w;
+               }
+            }
+         }
+         s.x /= s.flux;
+         s.y /= s.flux;
+
+         // Insert it in the list, sorted by decreasing flux
+         if ( nStars == maxStars && stars[nStars-1].flux >= s.flux )
+            continue;
+         i = (nStars < maxStars ? nStars : nStars - 1);
+         for( ; i > 0 && stars[i-1].flux < s.flux; i-- )
+            stars[i] = stars[i-1];
+         stars[i] = s;
+         if ( nStars < maxStars )
+            nStars++;
+      }
+   }
+
+   return( nStars );
+}
+
+/*!
+ * Fill the triangle descriptor for three stars
+ */
+static BOOL make_triangle( const STAR *stars,
+                           u_short i, u_short j, u_short k, TRIANGLE *t )
+{
+   // Each side is stored with its opposite vertex
+   double side[3] = { hypot(stars[j].x - stars[k].x, stars[j].y - stars[k].y),
+                      hypot(stars[i].x - stars[k].x, stars[i].y - stars[k].y),
+                      hypot(stars[i].x - stars[j].x, stars[i].y - stars[j].y) };
+   u_short vertex[3] = { i, j, k };
+   short a, b;
+   double cross;
+
+   // Sort the sides by decreasing length
+   for( a = 0; a < 2; a++ )
+   {
+      for( b = a+1; b < 3; b++ )
+      {
+         if ( side[b] > side[a] )
+         {
+            const double s = side[a];
+            const u_short v = vertex[a];
+            side[a] = side[b];
+            side[b] = s;
+            vertex[a] = vertex[b];
+            vertex[b] = v;
+         }
+      }
+   }
+
+   if ( side[2] < K_MIN_TRIANGLE_SIDE )
+      return( NO );
+
+   t->u = side[1]/side[0];
+   t->v = side[2]/side[0];
+   t->key = (u_long)(t->u/K_TRIANGLE_STEP)*K_TRIANGLE_BINS
+            + (u_long)(t->v/K_TRIANGLE_STEP);
+   cross = (stars[vertex[1]].x - stars[vertex[0]].x)
+           *(stars[vertex[2]].y - stars[vertex[0]].y)
+           - (stars[vertex[1]].y - stars[vertex[0]].y)
+           *(stars[vertex[2]].x - stars[vertex[0]].x);
+   t->orientation = (cross >= 0.0 ? 1 : -1);
+   for( a = 0; a < 3; a++ )
+      t->vertex[a] = vertex[a];
+
+   return( YES );
+}
+
+static int compare_triangles( const void *t1, const void *t2 )
+{
+   const u_long k1 = ((const TRIANGLE*)t1)->key,
+                k2 = ((const TRIANGLE*)t2)->key;
+
+   return( k1 < k2 ? -1 : (k1 > k2 ? 1 : 0) );
+}
+
+STAR_INDEX *build_star_index( const STAR *stars, u_short nStars )
+{
+   STAR_INDEX *index;
+   u_short i, j, k;
+
+   if ( nStars < 3 )
+      return( NULL );
+
+   index = (STAR_INDEX*)malloc( sizeof(STAR_INDEX) );
+   index->stars = (STAR*)malloc( nStars*sizeof(STAR) );
+   memcpy( index->stars, stars, nStars*sizeof(STAR) );
+   index->nStars = nStars;
+   index->triangles = (TRIANGLE*)malloc( (u_long)nStars*(nStars-1)*(nStars-2)
+                                         /6*sizeof(TRIANGLE) );
+   index->nTriangles = 0;
+
+   for( i = 0; i < nStars; i++ )
+      for( j = i+1; j < nStars; j++ )
+         for( k = j+1; k < nStars; k++ )
+            if ( make_triangle( stars, i, j, k,
+                                &index->triangles[index->nTriangles] ) )
+               index->nTriangles++;
+
+   if ( index->nTriangles == 0 )
+   {
+      free_star_index( index );
+      return( NULL );
+   }
+
+   qsort( index->triangles, index->nTriangles, sizeof(TRIANGLE),
+          compare_triangles );
+
+   return( index );
+}
+
+void free_star_index( STAR_INDEX *index )
+{
+   if ( index == NULL )
+      return;
+
+   free( index->stars );
+   free( index->triangles );
+   free( index );
+}
+
+/*!
+ * Find the first triangle of the index with a key not lower than the given one
+ */
+static u_long lower_bound( const STAR_INDEX *index, u_long key )
+{
+   u_long lo = 0, hi = index->nTriangles;
+
+   while( lo < hi )
+   {
+      const u_long mid = (lo + hi)/2;
+
+      if ( index->triangles[mid].key < key )
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   return( lo );
+}
+
+/*!
+ * Make every similar triangle vote for its vertices correspondences
+ */
+static void vote_triangle( const STAR_INDEX *index, const TRIANGLE *t,
+                           u_short nStars, u_short *votes )
+{
+   const long qu = (long)(t->u/K_TRIANGLE_STEP),
+              qv = (long)(t->v/K_TRIANGLE_STEP);
+   long du;
+
+   for( du = -1; du <= 1; du++ )
+   {
+      u_long n;
+
+      if ( qu+du < 0 || qu+du >= K_TRIANGLE_BINS )
+         continue;
+
+      for( n = lower_bound( index, (qu+du)*K_TRIANGLE_BINS
+                                   + (qv > 0 ? qv-1 : 0) );
+           n < index->nTriangles
+           && index->triangles[n].key <= (u_long)((qu+du)*K_TRIANGLE_BINS
+                                                  + qv+1);
+           n++ )
+      {
+         const TRIANGLE *r = &index->triangles[n];
+         short m;
+
+         if ( r->orientation != t->orientation
+              || fabs(r->u - t->u) > K_TRIANGLE_STEP
+              || fabs(r->v - t->v) > K_TRIANGLE_STEP )
+            continue;
+
+         for( m = 0; m < 3; m++ )
+            votes[r->vertex[m]*nStars + t->vertex[m]]++;
+      }
+   }
+}
+
+/*!
+ * Least square fit of the transform on the matched stars
+ */
+static BOOL fit_transform( const STAR *ref, const STAR *img, u_short n,
+                           BOOL affine, STAR_TRANSFORM *tr )
+{
+   double mx = 0.0, my = 0.0, mu = 0.0, mv = 0.0;
+   double sxx = 0.0, sxy = 0.0, syy = 0.0;
+   double sxu = 0.0, sxv = 0.0, syu = 0.0, syv = 0.0;
+   u_short i;
+
+   for( i = 0; i < n; i++ )
+   {
+      mx += ref[i].x;
+      my += ref[i].y;
+      mu += img[i].x;
+      mv += img[i].y;
+   }
+   mx /= (double)n;
+   my /= (double)n;
+   mu /= (double)n;
+   mv /= (double)n;
+
+   for( i = 0; i < n; i++ )
+   {
+      const double x = ref[i].x - mx, y = ref[i].y - my,
+                   u = img[i].x - mu, v = img[i].y - mv;
+
+      sxx += x*x; sxy += x*y; syy += y*y;
+      sxu += x*u; sxv += x*v; syu += y*u; syv += y*v;
+   }
+
+   if ( affine )
+   {
+      const double det = sxx*syy - sxy*sxy;
+
+      if ( fabs(det) < 1e-9 )
+         return( NO );
+      tr->a = (sxu*syy - syu*sxy)/det;
+      tr->b = (syu*sxx - sxu*sxy)/det;
+      tr->c = (sxv*syy - syv*sxy)/det;
+      tr->d = (syv*sxx - sxv*sxy)/det;
+   }
+   else
+   {
+      const double norm = sxx + syy;
+
+      if ( norm < 1e-9 )
+         return( NO );
+      tr->a = (sxu + syv)/norm;
+      tr->c = (sxv - syu)/norm;
+      tr->b = -tr->c;
+      tr->d = tr->a;
+   }
+
+   tr->tx = mu - tr->a*mx - tr->b*my;
+   tr->ty = mv - tr->c*mx - tr->d*my;
+
+   return( YES );
+}
+
+u_short match_stars( const STAR_INDEX *index,
+                     const STAR *stars, u_short nStars,
+                     BOOL affine, STAR_TRANSFORM *transform )
+{
+   const u_short nRef = index->nStars;
+   u_short *votes;
+   STAR *refMatch, *imgMatch;
+   u_short i, j, k, nMatch = 0, iter;
+
+   if ( nStars < 3 )
+      return( 0 );
+
+   // Look up each image triangle in the reference index
+   votes = (u_short*)calloc( (u_long)nRef*nStars, sizeof(u_short) );
+   for( i = 0; i < nStars; i++ )
+   {
+      for( j = i+1; j < nStars; j++ )
+      {
+         for( k = j+1; k < nStars; k++ )
+         {
+            TRIANGLE t;
+
+            if ( make_triangle( stars, i, j, k, &t ) )
+               vote_triangle( index, &t, nStars, votes );
+         }
+      }
+   }
+
+   // Keep the mutual best correspondences
+   refMatch = (STAR*)malloc( nRef*sizeof(STAR) );
+   imgMatch = (STAR*)malloc( nRef*sizeof(STAR) );
+   for( i = 0; i < nRef; i++ )
+   {
+      u_short best = 0;
+      BOOL mutual = YES;
+
+      for( j = 1; j < nStars; j++ )
+         if ( votes[i*nStars+j] > votes[i*nStars+best] )
+            best = j;
+      if ( votes[i*nStars+best] < 2 )
+         continue;
+      for( k = 0; k < nRef && mutual; k++ )
+         if ( k != i && votes[k*nStars+best] >= votes[i*nStars+best] )
+            mutual = NO;
+      if ( !mutual )
+         continue;
+
+      refMatch[nMatch] = index->stars[i];
+      imgMatch[nMatch] = stars[best];
+      nMatch++;
+   }
+   free( votes );
+
+   // Fit the transform, rejecting the outliers
+   for( iter = 0; ; iter++ )
+   {
+      u_short kept = 0;
+
+      if ( nMatch < 3
+           || !fit_transform( refMatch, imgMatch, nMatch, affine, transform ) )
+      {
+         nMatch = 0;
+         break;
+      }
+      if ( iter == K_FIT_ITERATIONS )
+         break;
+
+      for( i = 0; i < nMatch; i++ )
+      {
+         const double x = refMatch[i].x, y = refMatch[i].y;
+
+         if ( hypot( transform->a*x + transform->b*y + transform->tx
+                     - imgMatch[i].x,
+                     transform->c*x + transform->d*y + transform->ty
+                     - imgMatch[i].y ) <= K_MAX_RESIDUAL )
+         {
+            refMatch[kept] = refMatch[i];
+            imgMatch[kept] = imgMatch[i];
+            kept++;
+         }
+      }
+      if ( kept == nMatch )
+         break;
+      nMatch = kept;
+   }
+
+   free( refMatch );
+   free( imgMatch );
+
+   return( nMatch );
+}
@@ -588,4 +588,82 @@ extern BOOL testInitialized;
 {
    [self testImageDivWithVect:YES withThreads:YES];
 }
+
+- (void) testBatchTransform
+{
+   const u_short w = 64, h = 48, n = 4;
+   u_short x, y, b;
+   LynkeosFourierBuffer *batch =
+      [LynkeosFourierBuffer fourierBufferWithNumberOfPlanes:1
+                                                      width:w
+                                                     height:h
+                                                      batch:n
+                                                   withGoal:FOR_DIRECT];
+
+   STAssertEquals( batch->_h, (u_short)(h*n), @"Wrong batch buffer height" );
+
+   // Each image of the batch has its own pattern
+   for( b = 0; b < n; b++ )
+      for( y = 0; y < h; y++ )
+         for( x = 0; x < w; x++ )
+            colorValue(batch,x,b*h+y,0) = sin((x+1.0)*(b+1.0)/7.0)
+                                          * cos((y+2.0)*(b+1.0)/5.0);
+
+   [batch directTransform];
+
+   // And compare with the images transformed one by one
+   for( b = 0; b < n; b++ )
+   {
+      LynkeosFourierBuffer *single =
+         [LynkeosFourierBuffer fourierBufferWithNumberOfPlanes:1
+                                                         width:w
+                                                        height:h
+                                                      withGoal:FOR_DIRECT];
+
+      for( y = 0; y < h; y++ )
+         for( x = 0; x < w; x++ )
+            colorValue(single,x,y,0) = sin((x+1.0)*(b+1.0)/7.0)
+                                       * cos((y+2.0)*(b+1.0)/5.0);
+      [single directTransform];
+
+      for( y = 0; y < h; y++ )
+      {
+         for( x = 0; x < single->_halfw; x++ )
+         {
+            COMPLEX vb = colorComplexValue(batch,x,b*h+y,0);
+            COMPLEX vs = colorComplexValue(single,x,y,0);
+
+            STAssertEqualsWithAccuracy(__real__ vb, __real__ vs, 1e-3,
+                                       @"at %d,%d in image %d", x, y, b );
+            STAssertEqualsWithAccuracy(__imag__ vb, __imag__ vs, 1e-3,
+                                       @"at %d,%d in image %d", x, y, b );
+         }
+      }
+   }
+}
+
+- (void) testCpuBudget
+{
+   u_short n, i;
+
+   // The list threads take every CPU
+   n = cpuBudgetStartListThreads( ListThreadsOptimizations );
+   STAssertEquals( n, numberOfCpus, @"Wrong number of list threads" );
+   STAssertEquals( cpuBudgetForItem(ImageOperatorsOptimization), (u_short)1,
+                   @"No CPU shall be left to the items" );
+
+   // The last one gets them back
+   for( i = 1; i < n; i++ )
+      cpuBudgetLeaveListThread();
+   STAssertEquals( cpuBudgetForItem(FFTW3ThreadsOptimization), numberOfCpus,
+                   @"The last thread shall get every CPU" );
+   cpuBudgetLeaveListThread();
+
+   // Without list threads, the item gets every CPU
+   n = cpuBudgetStartListThreads( FFTW3ThreadsOptimization );
+   STAssertEquals( n, (u_short)1, @"Wrong number of list threads" );
+   STAssertEquals( cpuBudgetForItem(FFTW3ThreadsOptimization), numberOfCpus,
+                   @"The item shall get every CPU" );
+   cpuBudgetLeaveListThread();
+}
 @end
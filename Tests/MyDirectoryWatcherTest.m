@@ -0,0 +1,107 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun Apr 24 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "MyDirectoryWatcherTest.h"
+
+#include "MyDirectoryWatcher.h"
+
+// Write a capture file in the test directory
+static void writeFile( NSString *dir, NSString *name, int length )
+{
+   char bytes[length];
+
+   memset( bytes, 'x', length );
+   [[NSData dataWithBytes:bytes length:length]
+                      writeToFile:[dir stringByAppendingPathComponent:name]
+                       atomically:NO];
+}
+
+@implementation MyDirectoryWatcherTest
+
+- (void) setUp
+{
+   _dir = [[NSTemporaryDirectory() stringByAppendingPathComponent:
+                     [NSString stringWithFormat:@"LynkeosWatcherTest%d",
+                                                getpid()]] retain];
+   [[NSFileManager defaultManager] createDirectoryAtPath:_dir attributes:nil];
+}
+
+- (void) tearDown
+{
+   [[NSFileManager defaultManager] removeFileAtPath:_dir handler:nil];
+   [_dir release];
+}
+
+- (void) testCompleteFiles
+{
+   MyDirectoryWatcher *watcher =
+      [[[MyDirectoryWatcher alloc] initWithPath:_dir
+                                      fileTypes:[NSArray arrayWithObject:@"fit"]]
+                                                                  autorelease];
+   NSArray *files;
+
+   writeFile( _dir, @"2.fit", 16 );
+   writeFile( _dir, @"1.FIT", 16 );
+   writeFile( _dir, @"note.txt", 16 );
+
+   // The first poll only records the files
+   files = [watcher pollCompletedFiles];
+   STAssertEquals( [files count], (NSUInteger)0, @"Files reported too early" );
+
+   // Unchanged, they are complete, sorted by name
+   files = [watcher pollCompletedFiles];
+   STAssertEquals( [files count], (NSUInteger)2, @"Bad complete files count" );
+   STAssertEqualObjects( [[files objectAtIndex:0] lastPathComponent], @"1.FIT",
+                         @"Bad first file" );
+   STAssertEqualObjects( [[files objectAtIndex:1] lastPathComponent], @"2.fit",
+                         @"Bad second file" );
+
+   // And they are not reported again
+   files = [watcher pollCompletedFiles];
+   STAssertEquals( [files count], (NSUInteger)0, @"Files reported twice" );
+}
+
+- (void) testGrowingFile
+{
+   MyDirectoryWatcher *watcher =
+      [[[MyDirectoryWatcher alloc] initWithPath:_dir fileTypes:nil]
+                                                                  autorelease];
+   NSArray *files;
+
+   // An empty file is still being created
+   writeFile( _dir, @"3.fit", 0 );
+   files = [watcher pollCompletedFiles];
+   files = [watcher pollCompletedFiles];
+   STAssertEquals( [files count], (NSUInteger)0, @"Empty file reported" );
+
+   // A growing file is not complete
+   writeFile( _dir, @"3.fit", 16 );
+   files = [watcher pollCompletedFiles];
+   writeFile( _dir, @"3.fit", 32 );
+   files = [watcher pollCompletedFiles];
+   STAssertEquals( [files count], (NSUInteger)0, @"Growing file reported" );
+
+   files = [watcher pollCompletedFiles];
+   STAssertEquals( [files count], (NSUInteger)1, @"Complete file not reported" );
+}
+
+@end
@@ -36,6 +36,8 @@ BOOL processTestInitialized = NO;
 NSString * const K_PREF_END_PROCESS_SOUND = @"End of processing sound";
 NSString * const K_PREF_ALIGN_MULTIPROC = @"Multiprocessor align";
 NSString * const K_PREF_ALIGN_CHECK = @"Align check";
+NSString * const myImageAnalyzerRef = @"MyImageAnalyzer";
+NSString * const myImageAnalyzerResultRef = @"AnalysisResult";
 
 // Notification flag
 NSString *K_ITEM_ALIGNED_REF = @"ItemAlignedFlag";
@@ -607,4 +609,93 @@ NSString *K_ITEM_ALIGNED_REF = @"ItemAlignedFlag";
    [obs release];
    [doc release];
 }
+
+// Verify the alignment on the object centroid
+- (void) testCentroidAlign
+{
+   const double expected[4][2] = { {0.0, 0.0}, {-20.0, 20.0},
+                                   {0.0, 20.0}, {-20.0, 0.0} };
+   u_short i;
+
+   // Create the document
+   MyDocument *doc = [[MyDocument alloc] init];
+
+   // Prepare the parameters
+   MyImageAlignerListParameters *listParams = 
+                                    [[MyImageAlignerListParameters alloc] init];
+   listParams->_referenceItem = [[MyImageListItem alloc] initWithURL:
+                                   [NSURL URLWithString:@"file:///image1.tst"]];
+   listParams->_alignOrigin = LynkeosMakeIntegerPoint(10,20);
+   listParams->_alignSize = LynkeosMakeIntegerSize(30,30);
+   listParams->_cutoff = 0.707;
+   listParams->_precisionThreshold = 0.125;
+   listParams->_checkAlignResult = NO;
+   listParams->_alignMethod = CentroidAlign;
+   listParams->_centroidLevel = 0.25;
+
+   // Add all the items to the document
+   [doc addEntry:(MyImageListItem*)listParams->_referenceItem];
+   [doc addEntry:[[MyImageListItem alloc] initWithURL:
+                                  [NSURL URLWithString:@"file:///image5.tst"]]];
+   [doc addEntry:[[MyImageListItem alloc] initWithURL:
+                                  [NSURL URLWithString:@"file:///image6.tst"]]];
+   [doc addEntry:[[MyImageListItem alloc] initWithURL:
+                                  [NSURL URLWithString:@"file:///image7.tst"]]];
+
+   // Set the parameters in the list
+   [[doc imageList] setProcessingParameter:listParams
+                                   withRef:myImageAlignerParametersRef
+                             forProcessing:myImageAlignerRef];
+
+   // Register for doc notifications
+   TestObserver *obs = [[TestObserver alloc] init];
+   [[NSNotificationCenter defaultCenter] addObserver:obs
+                                            selector:@selector(alignEnded:)
+                                                name:
+                                                 LynkeosProcessEndedNotification
+                                              object:doc];
+
+   obs->alignDone = NO;
+
+   // Ask the doc to align
+   NSEnumerator *strider =[[doc imageList] imageEnumeratorStartAt:nil
+                                                      directSense:YES
+                                                   skipUnselected:YES];
+   [doc startProcess:[MyImageAligner class] withEnumerator:strider
+          parameters:listParams];
+
+   // Wait for process end
+   NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:2.0];
+   while ( [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                                    beforeDate:timeout]
+           && [timeout compare:[NSDate date]] == NSOrderedDescending
+           && ! obs->alignDone )
+      ;
+
+   STAssertTrue( obs->alignDone, @"Align not performed after delay" );
+
+   // Verify the results
+   strider = [[doc imageList] imageEnumerator];
+   for( i = 0; i < 4; i++ )
+   {
+      MyImageListItem *item = [strider nextObject];
+      id <LynkeosAlignResult> res =
+         (id <LynkeosAlignResult>)[item getProcessingParameterWithRef:
+                                                         LynkeosAlignResultRef
+                                                        forProcessing:
+                                                             LynkeosAlignRef];
+      STAssertNotNil( res, @"No alignment result for item %d", i );
+      if ( res != nil )
+      {
+         STAssertEqualsWithAccuracy( (double)[res offset].x, expected[i][0],
+                                     1e-2, @"x item %d", i );
+         STAssertEqualsWithAccuracy( (double)[res offset].y, expected[i][1],
+                                     1e-2, @"y item %d", i );
+      }
+   }
+
+   [[NSNotificationCenter defaultCenter] removeObserver:obs];
+   [obs release];
+   [doc release];
+}
 @end
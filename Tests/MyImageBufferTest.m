@@ -32,6 +32,9 @@ BOOL testInitialized;
 - (void) testMulWithVect:(BOOL)vect withThreads:(BOOL)thread ;
 - (void) testScaleWithVect:(BOOL)vect withThreads:(BOOL)thread ;
 - (void) testDivWithVect:(BOOL)vect withThreads:(BOOL)thread ;
+- (void) testAddWithVect:(BOOL)vect withThreads:(BOOL)thread ;
+- (void) testWeightedAddWithVect:(BOOL)vect withThreads:(BOOL)thread ;
+- (void) testMaxWithThreads:(BOOL)thread ;
 @end
 
 @implementation MyImageBufferTest(Utilities)
@@ -213,6 +216,178 @@ BOOL testInitialized;
    if ( ! vect )
       hasSIMD = reallyHasSIMD;
 }
+
+- (void) testAddWithVect:(BOOL)vect withThreads:(BOOL)thread
+{
+   u_short x, y, c;
+   BOOL reallyHasSIMD = hasSIMD;
+
+   if ( vect )
+   {
+      if ( ! hasSIMD )
+      {
+         NSLog( @"This machine has no vector, skipping test" );
+         return;
+      }
+   }
+   else
+      hasSIMD = NO;
+
+   LynkeosStandardImageBuffer *image1 =
+                 [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:3
+                                                                     width:640
+                                                                    height:480];
+   LynkeosStandardImageBuffer *image2 =
+                 [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:3
+                                                                     width:640
+                                                                    height:480];
+
+   // Prepare the test images
+   for( y = 0; y < 480; y++ )
+   {
+      for( x = 0; x < 640; x++ )
+      {
+         for( c = 0; c < 3; c++ )
+         {
+            colorValue(image1,x,y,c) = x/6.4 + y/48.0 + (REAL)c;
+            colorValue(image2,x,y,c) = (640-x)/3.2 + (480-y)/24.0 - (REAL)c;
+         }
+      }
+   }
+
+   if ( thread )
+      [image1 setOperatorsStrategy:ParallelizedStrategy];
+
+   NSDate *start = [NSDate date];
+   [image1 add:image2 result:image1];
+   NSLog( @"Processing time %f", -[start timeIntervalSinceNow] );
+
+   for( y = 0; y < 480; y++ )
+   {
+      for( x = 0; x < 640; x++ )
+      {
+         for( c = 0; c < 3; c++ )
+         {
+            REAL v = colorValue(image1,x,y,c);
+
+            STAssertEqualsWithAccuracy(v, (REAL)(220.0 - x/6.4 - y/48.0),
+                                       1e-4, @"at %d,%d", x, y );
+         }
+      }
+   }
+
+   if ( ! vect )
+      hasSIMD = reallyHasSIMD;
+}
+
+- (void) testWeightedAddWithVect:(BOOL)vect withThreads:(BOOL)thread
+{
+   u_short x, y, c;
+   BOOL reallyHasSIMD = hasSIMD;
+
+   if ( vect )
+   {
+      if ( ! hasSIMD )
+      {
+         NSLog( @"This machine has no vector, skipping test" );
+         return;
+      }
+   }
+   else
+      hasSIMD = NO;
+
+   LynkeosStandardImageBuffer *image1 =
+                 [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:3
+                                                                     width:640
+                                                                    height:480];
+   LynkeosStandardImageBuffer *image2 =
+                 [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:3
+                                                                     width:640
+                                                                    height:480];
+
+   // Prepare the test images
+   for( y = 0; y < 480; y++ )
+   {
+      for( x = 0; x < 640; x++ )
+      {
+         for( c = 0; c < 3; c++ )
+         {
+            colorValue(image1,x,y,c) = x/6.4 + y/48.0 + (REAL)c;
+            colorValue(image2,x,y,c) = (640-x)/3.2 + (480-y)/24.0 - (REAL)c;
+         }
+      }
+   }
+
+   if ( thread )
+      [image1 setOperatorsStrategy:ParallelizedStrategy];
+
+   NSDate *start = [NSDate date];
+   [image1 add:image2 weight:0.5 result:image1];
+   NSLog( @"Processing time %f", -[start timeIntervalSinceNow] );
+
+   for( y = 0; y < 480; y++ )
+   {
+      for( x = 0; x < 640; x++ )
+      {
+         for( c = 0; c < 3; c++ )
+         {
+            REAL v = colorValue(image1,x,y,c);
+
+            STAssertEqualsWithAccuracy(v, (REAL)(110.0 + c/2.0),
+                                       1e-4, @"at %d,%d", x, y );
+         }
+      }
+   }
+
+   if ( ! vect )
+      hasSIMD = reallyHasSIMD;
+}
+
+- (void) testMaxWithThreads:(BOOL)thread
+{
+   u_short x, y, c;
+
+   LynkeosStandardImageBuffer *image1 =
+                 [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:3
+                                                                     width:640
+                                                                    height:480];
+   LynkeosStandardImageBuffer *image2 =
+                 [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:3
+                                                                     width:640
+                                                                    height:480];
+
+   // Prepare the test images
+   for( y = 0; y < 480; y++ )
+   {
+      for( x = 0; x < 640; x++ )
+      {
+         for( c = 0; c < 3; c++ )
+         {
+            colorValue(image1,x,y,c) = (REAL)x + (REAL)c;
+            colorValue(image2,x,y,c) = (REAL)(640-x);
+         }
+      }
+   }
+
+   if ( thread )
+      [image1 setOperatorsStrategy:ParallelizedStrategy];
+
+   [image1 extremumWith:image2 result:image1 maximum:YES];
+
+   for( y = 0; y < 480; y++ )
+   {
+      for( x = 0; x < 640; x++ )
+      {
+         for( c = 0; c < 3; c++ )
+         {
+            REAL v = colorValue(image1,x,y,c);
+            REAL m = ( x + c > 640 - x ? x + c : 640 - x );
+
+            STAssertEqualsWithAccuracy( v, m, 1e-5, @"at %d,%d", x, y );
+         }
+      }
+   }
+}
 @end
 
 @implementation MyImageBufferTest
@@ -625,4 +800,53 @@ BOOL testInitialized;
 {
    [self testScaleWithVect:YES withThreads:YES];
 }
+- (void) testAdd_noVect_noThread
+{
+   [self testAddWithVect:NO withThreads:NO];
+}
+
+- (void) testAdd_noVect_withThread
+{
+   [self testAddWithVect:NO withThreads:YES];
+}
+
+- (void) testAdd_withVect_noThread
+{
+   [self testAddWithVect:YES withThreads:NO];
+}
+
+- (void) testAdd_withVect_withThread
+{
+   [self testAddWithVect:YES withThreads:YES];
+}
+
+- (void) testWeightedAdd_noVect_noThread
+{
+   [self testWeightedAddWithVect:NO withThreads:NO];
+}
+
+- (void) testWeightedAdd_noVect_withThread
+{
+   [self testWeightedAddWithVect:NO withThreads:YES];
+}
+
+- (void) testWeightedAdd_withVect_noThread
+{
+   [self testWeightedAddWithVect:YES withThreads:NO];
+}
+
+- (void) testWeightedAdd_withVect_withThread
+{
+   [self testWeightedAddWithVect:YES withThreads:YES];
+}
+
+- (void) testMax_noThread
+{
+   [self testMaxWithThreads:NO];
+}
+
+- (void) testMax_withThread
+{
+   [self testMaxWithThreads:YES];
+}
 @end
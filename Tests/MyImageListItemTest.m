@@ -426,4 +426,47 @@ NSString *basePath = nil;
    }  
 }
 
+- (void) testPreparedSample
+{
+   // Create an item
+   MyImageListItem *item = [MyImageListItem imageListItemWithURL:
+                                             [NSURL URLWithString:@"1.tsturl"]];
+   LynkeosStandardImageBuffer *testBuf =
+      [LynkeosStandardImageBuffer imageBufferWithNumberOfPlanes:1
+                                                          width:10
+                                                         height:10];
+   LynkeosStandardImageBuffer *otherBuf = nil;
+   u_short x, y;
+
+   // Read ahead a sample, and get it in a monochrome buffer
+   [item prepareImageSampleInRect:LynkeosMakeIntegerRect(10,5,10,10)];
+   [item getImageSample:&testBuf inRect:LynkeosMakeIntegerRect(10,5,10,10)];
+
+   for( y = 0; y < 5; y++ )
+   {
+      for( x = 0; x < 10; x++ )
+      {
+         STAssertEqualsWithAccuracy((double)colorValue(testBuf,x,y,0),
+                                    (x+10)/93.0+(y+5)/57.0+((x+y+15)%10)/30.0,
+                                    1e-5,
+                                    @"monochrome at %d,%d", x, y );
+      }
+   }
+
+   // A sample prepared for another rectangle shall not be used
+   [item prepareImageSampleInRect:LynkeosMakeIntegerRect(0,0,10,10)];
+   [item getImageSample:&otherBuf inRect:LynkeosMakeIntegerRect(10,5,10,10)];
+
+   STAssertNotNil( otherBuf, @"Test image not read" );
+   for( y = 0; y < 5; y++ )
+   {
+      for( x = 0; x < 10; x++ )
+      {
+         STAssertEqualsWithAccuracy((double)colorValue(otherBuf,x,y,0),
+                                    (x+10)/31.0,1e-5,
+                                    @"red at %d,%d", x, y );
+      }
+   }
+}
+
 @end
@@ -0,0 +1,161 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun May 01 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "MyItemQueueTest.h"
+
+#include "MyItemQueue.h"
+
+//! Number of items pushed by the threads test
+#define K_NB_ITEMS 10000
+//! Number of consumer threads
+#define K_NB_CONSUMERS 4
+
+/*!
+ * @abstract Consumer popping numbers from the queue
+ */
+@interface QueueConsumer : NSObject
+{
+@public
+   MyItemQueue      *_queue;    //!< The queue to drain
+   NSConditionLock  *_endLock;  //!< Counts the ended consumers
+   u_long            _count;    //!< Number of items popped
+   long long         _sum;      //!< Sum of the numbers popped
+}
+- (void) consume:(id)arg ;
+@end
+
+@implementation QueueConsumer
+- (void) consume:(id)arg
+{
+   NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+   id items[7];
+
+   _count = 0;
+   _sum = 0;
+   for(;;)
+   {
+      const BOOL closed = [_queue isClosed];
+      u_long n = [_queue popItems:items maxCount:7], i;
+
+      if ( n == 0 )
+      {
+         if ( closed )
+            break;
+         [NSThread sleepUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.001]];
+      }
+      for( i = 0; i < n; i++ )
+      {
+         _count++;
+         _sum += [items[i] longValue];
+      }
+      [pool release];
+      pool = [[NSAutoreleasePool alloc] init];
+   }
+   [pool release];
+
+   [_endLock lock];
+   [_endLock unlockWithCondition:[_endLock condition]+1];
+}
+@end
+
+@implementation MyItemQueueTest
+
+- (void) testOrderAndBatches
+{
+   MyItemQueue *queue = [[[MyItemQueue alloc] initWithCapacity:5] autorelease];
+   id items[8];
+   u_long n, i;
+
+   // The capacity is rounded to 8
+   for( i = 0; i < 8; i++ )
+      STAssertTrue( [queue pushItem:[NSNumber numberWithInt:i]],
+                    @"Push failed at %lu", i );
+   STAssertFalse( [queue pushItem:[NSNumber numberWithInt:8]],
+                  @"Push in a full queue" );
+   STAssertEquals( [queue count], (u_long)8, @"Wrong count" );
+
+   n = [queue popItems:items maxCount:3];
+   STAssertEquals( n, (u_long)3, @"Wrong batch size" );
+   for( i = 0; i < n; i++ )
+      STAssertEquals( [items[i] intValue], (int)i, @"Wrong order" );
+
+   // The free cells can be used again
+   STAssertTrue( [queue pushItem:[NSNumber numberWithInt:8]],
+                 @"Push after pop failed" );
+   n = [queue popItems:items maxCount:8];
+   STAssertEquals( n, (u_long)6, @"Wrong last batch size" );
+   for( i = 0; i < n; i++ )
+      STAssertEquals( [items[i] intValue], (int)i+3, @"Wrong order" );
+
+   STAssertEquals( [queue popItems:items maxCount:8], (u_long)0,
+                   @"Pop in an empty queue" );
+   STAssertFalse( [queue isClosed], @"Queue closed by itself" );
+   [queue stop];
+   STAssertTrue( [queue isStopped], @"Queue not stopped" );
+}
+
+- (void) testThreads
+{
+   MyItemQueue *queue =
+              [[[MyItemQueue alloc] initWithCapacity:64] autorelease];
+   NSConditionLock *endLock = [[[NSConditionLock alloc] initWithCondition:0]
+                                                                   autorelease];
+   QueueConsumer *consumers[K_NB_CONSUMERS];
+   u_long count = 0;
+   long long sum = 0;
+   int i;
+
+   for( i = 0; i < K_NB_CONSUMERS; i++ )
+   {
+      consumers[i] = [[[QueueConsumer alloc] init] autorelease];
+      consumers[i]->_queue = queue;
+      consumers[i]->_endLock = endLock;
+      [NSThread detachNewThreadSelector:@selector(consume:)
+                               toTarget:consumers[i]
+                             withObject:nil];
+   }
+
+   // Push while the consumers drain the queue
+   for( i = 1; i <= K_NB_ITEMS; i++ )
+   {
+      NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+      while ( ![queue pushItem:[NSNumber numberWithLong:i]] )
+         [NSThread sleepUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.001]];
+      [pool release];
+   }
+   [queue close];
+
+   [endLock lockWhenCondition:K_NB_CONSUMERS];
+   [endLock unlock];
+
+   for( i = 0; i < K_NB_CONSUMERS; i++ )
+   {
+      count += consumers[i]->_count;
+      sum += consumers[i]->_sum;
+   }
+   STAssertEquals( count, (u_long)K_NB_ITEMS, @"Items lost or duplicated" );
+   STAssertEquals( sum, (long long)K_NB_ITEMS*(K_NB_ITEMS+1)/2,
+                   @"Wrong items popped" );
+}
+
+@end
@@ -0,0 +1,148 @@
+//
+//  Lynkeos
+//  $Id$
+//
+//  Created by Jean-Etienne LAMIAUD on Sun May 15 2011.
+//  Copyright (c) 2011. Jean-Etienne LAMIAUD
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+
+#include "LynkeosProcessing.h"
+#include "MyPluginsController.h"
+#include "MyDocument.h"
+
+#include "MyProcessingThreadTest.h"
+
+//! Number of items in the processed list
+#define K_NB_ITEMS 200
+//! Number of list threads
+#define K_NB_THREADS 4
+
+// Shared with the other tests of the processing
+extern BOOL processTestInitialized;
+
+//! Number of times each item was processed
+static volatile int32_t processedCount[K_NB_ITEMS];
+
+/*!
+ * @abstract Processing which only counts the items
+ */
+@interface CountingProcess : NSObject <LynkeosProcessing>
+@end
+
+// Notification observer shall be separate from the test class
+@interface CountingObserver : NSObject
+{
+@public
+   BOOL processDone;
+}
+- (void) processEnded:(NSNotification*)notif ;
+@end
+
+@implementation CountingProcess
++ (ParallelOptimization_t) supportParallelization
+{
+   return( ListThreadsOptimizations );
+}
+
+- (id <LynkeosProcessing>) initWithDocument: (id <LynkeosDocument>)document
+                                 parameters:(id <NSObject>)params
+                                  precision:(floating_precision_t)precision
+{
+   return( [self init] );
+}
+
+- (void) processItem :(id <LynkeosProcessableItem>)item
+{
+   __sync_fetch_and_add( &processedCount[[(NSNumber*)item intValue]], 1 );
+
+   // Let the threads overlap
+   [NSThread sleepUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.001]];
+}
+
+- (void) finishProcessing
+{
+}
+@end
+
+@implementation CountingObserver
+- (void) processEnded:(NSNotification*)notif
+{
+   processDone = YES;
+}
+@end
+
+@implementation MyProcessingThreadTest
++ (void) initialize
+{
+   if ( !processTestInitialized )
+   {
+      processTestInitialized = YES;
+      // Initialize vector and multiprocessor stuff
+      initializeProcessing();
+      // Create the plugins controller singleton, and initialize it
+      [[[MyPluginsController alloc] init] awakeFromNib];
+   }
+}
+
+// The threads which end first shall not cut the batches of the others
+- (void) testAllItemsProcessed
+{
+   MyDocument *doc = [[MyDocument alloc] init];
+   CountingObserver *obs = [[CountingObserver alloc] init];
+   NSMutableArray *items = [NSMutableArray arrayWithCapacity:K_NB_ITEMS];
+   const u_short cpus = numberOfCpus;
+   int i;
+
+   for( i = 0; i < K_NB_ITEMS; i++ )
+   {
+      processedCount[i] = 0;
+      [items addObject:[NSNumber numberWithInt:i]];
+   }
+
+   obs->processDone = NO;
+   [[NSNotificationCenter defaultCenter] addObserver:obs
+                                            selector:@selector(processEnded:)
+                                                name:
+                                             LynkeosProcessEndedNotification
+                                              object:doc];
+
+   // Process with several list threads, whatever the machine
+   numberOfCpus = K_NB_THREADS;
+   [doc startProcess:[CountingProcess class]
+      withEnumerator:[items objectEnumerator]
+          parameters:nil];
+   numberOfCpus = cpus;
+
+   // Wait for process end
+   NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+   while ( [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                                    beforeDate:timeout]
+           && [timeout compare:[NSDate date]] == NSOrderedDescending
+           && ! obs->processDone )
+      ;
+
+   STAssertTrue( obs->processDone, @"Process not ended after delay" );
+   for( i = 0; i < K_NB_ITEMS; i++ )
+      STAssertEquals( (int)processedCount[i], 1,
+                      @"Item %d processed %d times", i, processedCount[i] );
+
+   [[NSNotificationCenter defaultCenter] removeObserver:obs];
+   [obs release];
+   [doc release];
+}
+
+@end